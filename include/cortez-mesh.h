@@ -7,6 +7,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 #include <time.h>
 #include <sys/types.h>
 #include <sys/uio.h>
@@ -24,7 +25,8 @@ typedef struct cortez_write_handle cortez_write_handle_t; // New handle for zero
 
 typedef struct {
     uint64_t magic;
-    uint32_t total_len;
+    uint64_t commit; // Set on a message committed out of turn (internal)
+    uint32_t total_len; // Whole record, rounded up to 8 bytes
     uint32_t payload_len;
     uint16_t msg_type;
     uint16_t iov_count;
@@ -42,7 +44,10 @@ typedef struct {
     volatile uint32_t active_connections;
     volatile uint64_t head;
     volatile uint64_t tail;
-    volatile uint64_t tx_head; // Transactional head
+    volatile uint64_t tx_head; // End of the last reserved write; head catches up as writers commit
+    volatile uint32_t publish_futex;   // Bumped whenever head moves; writers waiting to be published park on it
+    volatile uint32_t publish_waiters; // Writers parked on publish_futex
+    volatile uint32_t read_waiters;    // Readers parked on futex_word; writers skip the wake without one
     volatile uint64_t messages_written;
     volatile uint64_t messages_read;
     volatile uint64_t bytes_written;
@@ -57,6 +62,30 @@ struct cortez_msg {
     void* linear_buffer;
 };
 
+// A write reservation. cortez_begin_write() returns one on the heap; callers
+// on a hot path can own one and use cortez_begin_write_into() instead.
+struct cortez_tx {
+    uint64_t reserved_head;
+    uint32_t reserved_size;
+    int heap; // Freed by commit/abort (internal)
+};
+
+// One message of a batch send.
+typedef struct {
+    uint16_t msg_type;
+    const void* payload;
+    uint32_t payload_size;
+} cortez_batch_msg_t;
+
+// A message handed out by a batch read. The payload points into the channel
+// and stays valid until the batch is released; it is split in two segments
+// when it wraps around the end of the ring (payload[1] is empty otherwise).
+typedef struct {
+    CortezMessageHeader header;
+    struct iovec payload[2];
+    uint64_t end; // Channel position just past this message (internal)
+} cortez_msg_view_t;
+
 // --- Mesh-specific Message Types ---
 // These are used on the internal registry channel for discovery and healing.
 enum cortez_mesh_msg_types {
@@ -99,9 +128,14 @@ typedef enum {
     CORTEZ_JOIN_ONLY,
 } cortez_create_policy;
 
+// Readers busy-wait this long for a message before parking on the futex.
+// Spinning is skipped on single-CPU machines, where it cannot help.
+#define CORTEZ_DEFAULT_READ_SPIN_US 20
+
 typedef struct {
     size_t size;
     cortez_create_policy create_policy;
+    int read_spin_us; // Spin budget of cortez_read: 0 for the default, negative to never spin
 } cortez_options_t;
 
 typedef struct {
@@ -169,6 +203,16 @@ int cortez_mesh_send(cortez_mesh_t* mesh, pid_t target_pid, uint16_t msg_type, c
  */
 cortez_write_handle_t* cortez_mesh_begin_send_zc(cortez_mesh_t* mesh, pid_t target_pid, uint32_t payload_size);
 
+/**
+ * @brief (Zero-Copy) Like cortez_mesh_begin_send_zc(), but fills a handle owned
+ * by the caller (typically on the stack), so the send does not allocate.
+ * Commit or abort it with the usual calls; they do not free it.
+ *
+ * @return CORTEZ_OK on success, or an error code.
+ */
+int cortez_mesh_begin_send_zc_into(cortez_mesh_t* mesh, pid_t target_pid, uint32_t payload_size,
+                                   cortez_write_handle_t* handle);
+
 /**
  * @brief (Zero-Copy) Commits a message send transaction.
  * After writing the payload to the buffer pointers from the handle, call this
@@ -190,6 +234,19 @@ int cortez_mesh_commit_send_zc(cortez_write_handle_t* handle, uint16_t msg_type)
 void cortez_mesh_abort_send_zc(cortez_write_handle_t* handle);
 
 
+/**
+ * @brief Sends several messages to a peer with a single reservation.
+ * All messages are published together with one head update and at most one
+ * wake, or none is sent. The whole batch must fit in the peer's channel.
+ *
+ * @param mesh The mesh handle.
+ * @param target_pid The PID of the destination node.
+ * @param msgs The messages, in the order the peer will read them.
+ * @param count Number of messages.
+ * @return CORTEZ_OK on success, or an error code.
+ */
+int cortez_mesh_send_batch(cortez_mesh_t* mesh, pid_t target_pid, const cortez_batch_msg_t* msgs, size_t count);
+
 /**
  * @brief Reads a message from this node's private inbox.
  *
@@ -199,6 +256,29 @@ void cortez_mesh_abort_send_zc(cortez_write_handle_t* handle);
  */
 cortez_msg_t* cortez_mesh_read(cortez_mesh_t* mesh, int timeout_ms);
 
+/**
+ * @brief Reads up to max_views messages from this node's inbox without copying them.
+ * Waits like cortez_mesh_read() for the first one, then takes whatever else is
+ * already published. The views stay valid until cortez_mesh_release_batch().
+ *
+ * @return The number of views filled (0 only when timeout_ms is 0), or an error code.
+ */
+int cortez_mesh_read_batch(cortez_mesh_t* mesh, cortez_msg_view_t* views, int max_views, int timeout_ms);
+
+/**
+ * @brief Consumes the first count views of the last batch read with one tail update.
+ */
+int cortez_mesh_release_batch(cortez_mesh_t* mesh, const cortez_msg_view_t* views, int count);
+
+/**
+ * @brief Reads one message as a view: no allocation, and no copy even when it
+ * wraps around the ring. Release it with cortez_mesh_release_batch(mesh, view, 1).
+ *
+ * @return CORTEZ_OK, or an error code (CORTEZ_E_BUFFER_FULL when timeout_ms is 0
+ * and the inbox is empty).
+ */
+int cortez_mesh_read_view(cortez_mesh_t* mesh, cortez_msg_view_t* view, int timeout_ms);
+
 /**
  * @brief Prints a list of currently known, active peers in the mesh to stdout.
  *
@@ -228,12 +308,24 @@ cortez_msg_t* cortez_read(cortez_ch_t* ch, int timeout_ms);
 cortez_msg_t* cortez_peek(cortez_ch_t* ch);
 int cortez_msg_release(cortez_ch_t* ch, cortez_msg_t* msg);
 
+int cortez_write_batch(cortez_ch_t* ch, const cortez_batch_msg_t* msgs, size_t count);
+int cortez_read_batch(cortez_ch_t* ch, cortez_msg_view_t* views, int max_views, int timeout_ms);
+int cortez_release_batch(cortez_ch_t* ch, const cortez_msg_view_t* views, int count);
+int cortez_read_view(cortez_ch_t* ch, cortez_msg_view_t* view, int timeout_ms);
+
+// Any number of writers may hold reservations on a channel at once. Commits
+// are published in reservation order, so a thread must commit or abort its
+// own reservations in the order it made them. A commit still waiting on an
+// earlier writer after 2 seconds drops its message and fails with
+// CORTEZ_E_CHAN_STALE; the channel itself carries on.
 cortez_tx_t* cortez_begin_write(cortez_ch_t* ch, uint32_t total_size);
+int cortez_begin_write_into(cortez_ch_t* ch, uint32_t total_size, cortez_tx_t* tx);
 int cortez_commit_write(cortez_ch_t* ch, cortez_tx_t* tx, uint16_t msg_type, const struct iovec* iov, int iovcnt);
 void cortez_abort_write(cortez_ch_t* ch, cortez_tx_t* tx);
 
 // --- NEW ZERO-COPY CHANNEL API ---
 cortez_write_handle_t* cortez_begin_write_zc(cortez_ch_t* ch, uint32_t payload_size);
+int cortez_begin_write_zc_into(cortez_ch_t* ch, uint32_t payload_size, cortez_write_handle_t* handle);
 int cortez_commit_write_zc(cortez_write_handle_t* handle, uint16_t msg_type);
 void cortez_abort_write_zc(cortez_write_handle_t* handle);
 
@@ -275,15 +367,46 @@ static inline struct timespec cortez_msg_timestamp(const cortez_msg_t* msg) {
     return (struct timespec){0, 0};
 }
 
+// --- Inline Accessors for Batch Views ---
+static inline uint16_t cortez_msg_view_type(const cortez_msg_view_t* view) {
+    return view->header.msg_type;
+}
+
+static inline pid_t cortez_msg_view_sender_pid(const cortez_msg_view_t* view) {
+    return view->header.sender_pid;
+}
+
+static inline uint32_t cortez_msg_view_payload_size(const cortez_msg_view_t* view) {
+    return view->header.payload_len;
+}
+
+/**
+ * @brief Copies up to len bytes of a view's payload into dest, joining the
+ * two segments of a wrapped message.
+ *
+ * @return The number of bytes copied.
+ */
+static inline size_t cortez_msg_view_copy_payload(const cortez_msg_view_t* view, void* dest, size_t len) {
+    size_t copied = 0;
+    for (int i = 0; i < 2 && copied < len; ++i) {
+        size_t n = view->payload[i].iov_len;
+        if (n > len - copied) n = len - copied;
+        memcpy((char*)dest + copied, view->payload[i].iov_base, n);
+        copied += n;
+    }
+    return copied;
+}
+
 // --- Inline Accessors for Zero-Copy Write Handle ---
 // The concrete implementation is hidden in the .c file.
 struct cortez_write_handle {
     cortez_ch_t* ch;
-    cortez_tx_t* tx;
+    cortez_tx_t tx;
     void* part1;
     size_t part1_size;
     void* part2;
     size_t part2_size;
+    int heap; // Freed by commit/abort (internal)
 };
 
 /**
@@ -185,10 +185,30 @@ typedef struct {
     char item_path[MAX_PATH_LEN];
 } lookup_result_t;
 
+typedef enum {
+    LOOKUP_EXACT = 0,   // Basename equals item_name
+    LOOKUP_PREFIX,      // Basename starts with item_name
+    LOOKUP_GLOB         // Basename matches item_name as an fnmatch(3) pattern
+} lookup_mode_t;
+
 typedef struct {
     char item_name[MAX_PATH_LEN];
+    uint8_t mode;       // lookup_mode_t
+    uint32_t offset;    // Index of the first match to return
+    uint32_t limit;     // Max results in this page, 0 for the daemon default
 } lookup_req_t;
 
+// For MSG_LOOKUP_RESPONSE: one page of results. data holds item_count pairs
+// of NUL-terminated strings (node name, then the item's full path). Request
+// the next page with offset = next_offset while more is set.
+typedef struct {
+    uint32_t item_count;
+    uint32_t total;         // Matches across all pages
+    uint32_t next_offset;
+    uint8_t more;
+    char data[0];
+} lookup_resp_t;
+
 // For MSG_PIN_ITEM
 typedef struct {
     char pin_name[MAX_NODE_NAME_LEN];
@@ -0,0 +1,68 @@
+/*
+ * exodus-diff.h
+ * Line diff engine shared by the daemons and the snapshot tool.
+ *
+ * Lines are interned into integer classes (hashed once), lines that only
+ * occur on one side are set aside, and the rest is diffed with Myers' O(ND)
+ * algorithm using the linear-space middle-snake refinement. Memory is O(N).
+ * Very expensive inputs are cut at a cost limit, which keeps the result a
+ * valid (if not always minimal) edit script.
+ */
+#ifndef EXODUS_DIFF_H
+#define EXODUS_DIFF_H
+
+#include <stddef.h>
+
+typedef enum {
+    EXODUS_DIFF_SAME = 0,
+    EXODUS_DIFF_ADD,
+    EXODUS_DIFF_DEL
+} exodus_diff_op_type;
+
+typedef struct {
+    const char* data;   // Not necessarily NUL-terminated
+    size_t len;
+} exodus_diff_line;
+
+typedef struct {
+    exodus_diff_op_type type;
+    int old_index;      // 0-based line in the old file, -1 for ADD
+    int new_index;      // 0-based line in the new file, -1 for DEL
+    int moved;          // ADD/DEL paired into a move (see exodus_diff_result.moves)
+} exodus_diff_op;
+
+typedef struct {
+    int old_index;      // 0-based line removed from the old file
+    int new_index;      // 0-based line added to the new file
+} exodus_diff_move;
+
+typedef struct {
+    exodus_diff_op* ops;        // In file order
+    size_t op_count;
+    exodus_diff_move* moves;    // Ordered by old_index
+    size_t move_count;
+} exodus_diff_result;
+
+// Flags for exodus_diff_compute()
+#define EXODUS_DIFF_DETECT_MOVES 0x1
+
+/*
+ * Splits buf into lines in place ('\n' is replaced by '\0', so every
+ * line's data is also a C string). A trailing newline does not start an
+ * extra empty line. Returns the line count, or -1 when out of memory.
+ * *lines_out must be freed by the caller.
+ */
+int exodus_diff_split_lines(char* buf, size_t size, exodus_diff_line** lines_out);
+
+/*
+ * Diffs two line arrays. With EXODUS_DIFF_DETECT_MOVES, each removed line
+ * is paired with the first unpaired added line of identical content.
+ * Returns 0 on success, -1 when out of memory.
+ */
+int exodus_diff_compute(const exodus_diff_line* old_lines, int old_count,
+                        const exodus_diff_line* new_lines, int new_count,
+                        int flags, exodus_diff_result* out);
+
+void exodus_diff_result_free(exodus_diff_result* result);
+
+#endif // EXODUS_DIFF_H
@@ -0,0 +1,75 @@
+/*
+ * exodus-graph.h
+ * Commit graph and tag index of a node.
+ *
+ * <node>/.log/commit-graph holds one record per known commit: its parent,
+ * anchor and promoted links, tree, generation number, author time, author
+ * and tag (the first line of the message). Loading it builds a hash table
+ * by commit and one by tag, so resolving a version tag or listing history
+ * needs no commit objects at all.
+ *
+ * The file is append-only. Every commit in the graph has its whole parent
+ * chain in the graph too; a record whose parent is missing (or a damaged
+ * tail) is dropped on load and rediscovered from the objects next time.
+ */
+#ifndef EXODUS_GRAPH_H
+#define EXODUS_GRAPH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define EXODUS_GRAPH_FILE "commit-graph"
+
+#define EXODUS_GRAPH_HASH_LEN 64
+
+typedef struct exodus_graph exodus_graph;
+
+typedef struct {
+    char hash[EXODUS_GRAPH_HASH_LEN + 1];
+    char parent[EXODUS_GRAPH_HASH_LEN + 1];     // "" for the first commit of a history
+    char tree[EXODUS_GRAPH_HASH_LEN + 1];
+    char anchor[EXODUS_GRAPH_HASH_LEN + 1];     // S-COMMITs: the trunk commit they start from
+    char promoted[EXODUS_GRAPH_HASH_LEN + 1];   // Promotions: the subsection head merged in
+    char type;                                  // 'T', 'S', or 0 if the commit has no type line
+    int64_t timestamp;                          // Author time
+    uint32_t generation;                        // 1 without a parent, else the parent's + 1
+    const char* tag;                            // First line of the message
+    const char* author;                         // "name <uid@exodus>", "" if absent
+} exodus_graph_commit;
+
+/*
+ * Loads the graph of a node. A missing file loads as empty. Returns NULL
+ * only when out of memory.
+ */
+exodus_graph* exodus_graph_load(const char* node_path);
+
+// Returns the commit, or NULL if it is not in the graph.
+const exodus_graph_commit* exodus_graph_lookup(const exodus_graph* graph, const char* hash);
+
+// Returns the parent of a commit in the graph, or NULL for the first one.
+const exodus_graph_commit* exodus_graph_parent(const exodus_graph* graph, const exodus_graph_commit* commit);
+
+/*
+ * Returns the newest commit tagged tag in the history of head (head
+ * included), or NULL. The candidates come from the tag table; only they
+ * are checked against the parent chain.
+ */
+const exodus_graph_commit* exodus_graph_find_tag(const exodus_graph* graph, const exodus_graph_commit* head,
+                                                 const char* tag);
+
+/*
+ * Adds a commit. Its parent must already be in the graph; generation is
+ * computed here. Adding a known commit does nothing. Returns 0 on success,
+ * -1 on a missing parent, a malformed hash or when out of memory.
+ */
+int exodus_graph_add(exodus_graph* graph, const exodus_graph_commit* commit);
+
+/*
+ * Appends the commits added since load to the file in a single write.
+ * Returns 0 on success, -1 on error.
+ */
+int exodus_graph_save(exodus_graph* graph, const char* node_path);
+
+void exodus_graph_free(exodus_graph* graph);
+
+#endif // EXODUS_GRAPH_H
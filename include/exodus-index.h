@@ -0,0 +1,86 @@
+/*
+ * exodus-index.h
+ * Stat cache for snapshot commits.
+ *
+ * <node>/.log/index remembers, for every regular file of the last commit,
+ * the stat data it was hashed with (mtime, ctime, size, inode, mode) and the
+ * object it produced (type, hash, entropy). A commit only re-reads files
+ * whose stat data changed, so its cost follows the changed set rather than
+ * the node size.
+ *
+ * <node>/.log/index.dirty is appended to by the cloud daemon with the paths
+ * its watcher saw change. Those paths (and anything below them) are rehashed
+ * even if their stat data looks unchanged. The stat comparison stays
+ * authoritative: a missing or truncated dirty list only costs that hint.
+ */
+#ifndef EXODUS_INDEX_H
+#define EXODUS_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#define EXODUS_INDEX_FILE "index"
+#define EXODUS_INDEX_DIRTY_FILE "index.dirty"
+
+// The daemon stops recording dirty paths past this size; stat still catches them.
+#define EXODUS_INDEX_DIRTY_MAX_BYTES (4 * 1024 * 1024)
+
+#define EXODUS_INDEX_HASH_LEN 64
+
+typedef struct exodus_index exodus_index;
+
+typedef struct {
+    char type;                                  // 'B' (blob) or 'M' (manifest)
+    char hash[EXODUS_INDEX_HASH_LEN + 1];
+    double entropy;
+} exodus_index_object;
+
+/*
+ * Loads the index of a node together with its pending dirty paths. A
+ * missing or corrupt index loads as empty (everything is rehashed).
+ * Returns NULL only when out of memory.
+ */
+exodus_index* exodus_index_load(const char* node_path);
+
+/*
+ * Looks up a file by its path relative to the node root. Returns 1 and
+ * fills obj if the entry is present, not dirty, and st matches what was
+ * recorded; returns 0 otherwise. Entries whose ctime is not older than
+ * the walk that recorded them are never trusted (they may have changed
+ * again within the same timestamp tick).
+ */
+int exodus_index_lookup(exodus_index* index, const char* relative_path, const struct stat* st,
+                        exodus_index_object* obj);
+
+/*
+ * Records the object a file hashed to. Every path looked up or recorded
+ * during a walk is kept on save; everything else (deleted files) is dropped.
+ * Returns 0 on success, -1 when out of memory.
+ */
+int exodus_index_record(exodus_index* index, const char* relative_path, const struct stat* st,
+                        const exodus_index_object* obj);
+
+/*
+ * Calls fn with the object of every entry in the index, loaded or recorded,
+ * until fn returns nonzero. Returns that value, or 0.
+ */
+int exodus_index_for_each_object(const exodus_index* index,
+                                 int (*fn)(const exodus_index_object* obj, void* ctx), void* ctx);
+
+/*
+ * Writes the index (temp file + rename) and consumes the dirty paths that
+ * were read by exodus_index_load(). Call only after a successful walk.
+ * Returns 0 on success, -1 on error.
+ */
+int exodus_index_save(exodus_index* index, const char* node_path);
+
+void exodus_index_free(exodus_index* index);
+
+/*
+ * Appends changed paths (relative to the node root) to the node's dirty
+ * list in a single write. Returns 0 on success, -1 on error.
+ */
+int exodus_index_mark_dirty(const char* node_path, const char* const* paths, size_t count);
+
+#endif // EXODUS_INDEX_H
@@ -0,0 +1,82 @@
+/*
+ * exodus-journal.h
+ * Append-only binary event journal for node activity.
+ *
+ * Every file system event of a node is appended to
+ * <node>/.log/history.journal as a length-prefixed, CRC32-checked record.
+ * Recording an event is a single append, independent of history size.
+ *
+ * <node>/.log/history.json is kept as the export view: the journal is folded
+ * into it lazily (when a reader asks for the history, or when the journal
+ * grows past EXODUS_JOURNAL_COMPACT_BYTES) using a temp file + rename, so a
+ * crash at any point leaves either the old or the new view plus a journal
+ * that still holds every record not yet folded.
+ */
+#ifndef EXODUS_JOURNAL_H
+#define EXODUS_JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ctz-json.h"
+
+#define EXODUS_JOURNAL_FILE "history.journal"
+#define EXODUS_HISTORY_FILE "history.json"
+
+// Fold the journal into history.json once it grows past this size.
+#define EXODUS_JOURNAL_COMPACT_BYTES (4 * 1024 * 1024)
+
+// Same order as the daemons' EventType enums.
+typedef enum {
+    EXODUS_JOURNAL_CREATED = 0,
+    EXODUS_JOURNAL_DELETED = 1,
+    EXODUS_JOURNAL_MODIFIED = 2,
+    EXODUS_JOURNAL_MOVED = 3
+} exodus_journal_type;
+
+typedef struct {
+    exodus_journal_type type;
+    int64_t timestamp;      // Unix time of the event
+    int time_real;          // 1 = export timestamp as "%Y-%m-%d %H:%M:%S"
+    const char* name;       // Path relative to the node root
+    const char* user;       // NULL is exported as "unknown"
+    const char* details;    // Compact JSON object exported as "changes", or NULL
+} exodus_journal_event_t;
+
+/*
+ * Appends one event. O(1) in the size of the history.
+ * If journal_size_out is not NULL it receives the journal size after the
+ * append, so callers can decide when to compact.
+ * Returns 0 on success, -1 on error.
+ */
+int exodus_journal_append(const char* node_path, const exodus_journal_event_t* ev, size_t* journal_size_out);
+
+/*
+ * Folds all pending journal records into history.json and clears the journal.
+ * Also finishes a compaction interrupted by a crash.
+ * Returns 0 on success (including when nothing was pending), -1 on error.
+ */
+int exodus_journal_materialize(const char* node_path);
+
+/*
+ * Returns the full history (history.json + pending journal records) as a
+ * JSON array. Materializes on disk when possible and falls back to an
+ * in-memory view when the caller may not write to .log.
+ * Never returns NULL unless out of memory.
+ */
+ctz_json_value* exodus_journal_load_history(const char* node_path);
+
+/*
+ * Drops every pending record and resets history.json to an empty array.
+ * Used when uncommitted history is cleared (commit, clean).
+ */
+int exodus_journal_reset(const char* node_path);
+
+/*
+ * Replaces history.json with the given JSON array (e.g. after merging a
+ * remote history). Records appended since the caller's
+ * exodus_journal_load_history() stay pending in the journal.
+ */
+int exodus_journal_replace(const char* node_path, const ctz_json_value* history_array);
+
+#endif // EXODUS_JOURNAL_H
@@ -7,7 +7,7 @@
 static const char* exodus_commands[] = {
     "start", "stop",
     "node-conf", "node-status", "node-edit", "node-man",
-    "commit", "rebuild", "checkout", "diff", "history", "log", "clean",
+    "commit", "rebuild", "checkout", "diff", "history", "log", "clean", "repack", "gc",
     "list-subs", "add-subs", "remove-subs", "switch", "promote",
     "pack", "unpack", "pack-info", "send", "expose-node",
     "add-node", "list-nodes", "remove-node", "view-node", 
@@ -0,0 +1,301 @@
+/*
+ * cortez-mesh-bench.c - Write contention benchmark for cortez-mesh channels
+ *
+ * Several producer threads write to one channel while a consumer drains
+ * it. Every message carries its producer and sequence number plus a fill
+ * pattern, and the consumer checks that each producer's messages arrive
+ * complete and in order, so a run doubles as a stress test of the
+ * reservation, batch and view paths.
+ *
+ * It links the userland (shm_open) mesh, so it runs without the
+ * cortez_tunnel module:
+ *   make bench                       (or: cmake --build <dir> --target cortez-mesh-bench)
+ *
+ * For a sanitizer run, build it dynamically (swap in address,undefined
+ * for ASan/UBSan) and cover each -w/-r pair:
+ *   gcc -O1 -g -fsanitize=thread -Iinclude -Ik-module src/cortez-mesh-bench.c \
+ *       src/cortez_mesh_userland.c -o cortez-mesh-bench -pthread -lrt
+ *
+ * Usage: cortez-mesh-bench [-p producers] [-n messages] [-s max_payload]
+ *                          [-w copy|zc|batch] [-r read|view] [-b batch] [-k channel_kib]
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "cortez-mesh.h"
+
+#define BENCH_MSG_TYPE 100
+#define BENCH_MAX_PRODUCERS 64
+#define BENCH_MAX_BATCH 256
+#define BENCH_READ_TIMEOUT_MS 5000
+#define BENCH_ABORT_EVERY 97 // zc producers abort one reservation in this many
+
+typedef enum { WRITE_COPY, WRITE_ZC, WRITE_BATCH } write_mode_t;
+typedef enum { READ_MSG, READ_VIEW } read_mode_t;
+
+typedef struct {
+    uint32_t producer;
+    uint32_t seq;
+} bench_msg_head_t;
+
+static struct {
+    int producers;
+    int messages;
+    uint32_t max_payload;
+    write_mode_t write_mode;
+    read_mode_t read_mode;
+    int batch;
+    size_t channel_kib;
+    char channel_name[64];
+} g_cfg = {
+    .producers = 4,
+    .messages = 200000,
+    .max_payload = 256,
+    .write_mode = WRITE_COPY,
+    .read_mode = READ_MSG,
+    .batch = 16,
+    .channel_kib = 64,
+};
+
+static long g_full_retries;
+static volatile int g_failed;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Payload sizes vary per message so regions wrap at every offset.
+static uint32_t payload_size(uint32_t producer, uint32_t seq) {
+    uint32_t span = g_cfg.max_payload - sizeof(bench_msg_head_t) + 1;
+    return sizeof(bench_msg_head_t) + (seq * 7 + producer) % span;
+}
+
+static uint8_t fill_byte(uint32_t producer, uint32_t seq) {
+    return (uint8_t)(producer * 31 + seq);
+}
+
+static void fill_payload(uint8_t* buf, uint32_t producer, uint32_t seq, uint32_t len) {
+    bench_msg_head_t head = { producer, seq };
+    memcpy(buf, &head, sizeof(head));
+    memset(buf + sizeof(head), fill_byte(producer, seq), len - sizeof(head));
+}
+
+static void fail(const char* what, int producer, int rc) {
+    fprintf(stderr, "producer %d: %s: %s\n", producer, what, cortez_strerror(rc));
+    g_failed = 1;
+}
+
+static void backoff(void) {
+    __atomic_add_fetch(&g_full_retries, 1, __ATOMIC_RELAXED);
+    sched_yield();
+}
+
+static void* producer_main(void* arg) {
+    const uint32_t id = (uint32_t)(long)arg;
+    cortez_options_t opts = { .create_policy = CORTEZ_JOIN_ONLY };
+    cortez_ch_t* ch = cortez_join(g_cfg.channel_name, &opts);
+    if (!ch) { fail("join", id, CORTEZ_E_CHAN_NOT_FOUND); return NULL; }
+
+    uint8_t* payloads = malloc((size_t)g_cfg.max_payload * BENCH_MAX_BATCH);
+    cortez_batch_msg_t batch[BENCH_MAX_BATCH];
+    if (!payloads) { fail("malloc", id, CORTEZ_E_NO_MEM); cortez_leave(ch); return NULL; }
+
+    for (uint32_t seq = 0; seq < (uint32_t)g_cfg.messages && !g_failed;) {
+        uint32_t len = payload_size(id, seq);
+        int rc;
+
+        switch (g_cfg.write_mode) {
+            case WRITE_COPY:
+                fill_payload(payloads, id, seq, len);
+                rc = cortez_write(ch, BENCH_MSG_TYPE, payloads, len);
+                if (rc == CORTEZ_E_BUFFER_FULL) { backoff(); continue; }
+                if (rc != CORTEZ_OK) { fail("write", id, rc); goto out; }
+                seq++;
+                break;
+
+            case WRITE_ZC: {
+                cortez_write_handle_t handle;
+                if (seq % BENCH_ABORT_EVERY == 5 && cortez_begin_write_zc_into(ch, len, &handle) == CORTEZ_OK) {
+                    cortez_abort_write_zc(&handle);
+                }
+                rc = cortez_begin_write_zc_into(ch, len, &handle);
+                if (rc == CORTEZ_E_BUFFER_FULL) { backoff(); continue; }
+                if (rc != CORTEZ_OK) { fail("begin_write_zc", id, rc); goto out; }
+
+                fill_payload(payloads, id, seq, len);
+                size_t part1_size = 0, part2_size = 0;
+                void* part1 = cortez_write_handle_get_part1(&handle, &part1_size);
+                void* part2 = cortez_write_handle_get_part2(&handle, &part2_size);
+                memcpy(part1, payloads, part1_size);
+                if (part2) memcpy(part2, payloads + part1_size, part2_size);
+
+                rc = cortez_commit_write_zc(&handle, BENCH_MSG_TYPE);
+                if (rc != CORTEZ_OK) { fail("commit_write_zc", id, rc); goto out; }
+                seq++;
+                break;
+            }
+
+            case WRITE_BATCH: {
+                int count = 0;
+                for (uint32_t s = seq; count < g_cfg.batch && s < (uint32_t)g_cfg.messages; s++, count++) {
+                    uint8_t* buf = payloads + (size_t)count * g_cfg.max_payload;
+                    uint32_t n = payload_size(id, s);
+                    fill_payload(buf, id, s, n);
+                    batch[count] = (cortez_batch_msg_t){ .msg_type = BENCH_MSG_TYPE, .payload = buf, .payload_size = n };
+                }
+                rc = cortez_write_batch(ch, batch, count);
+                if (rc == CORTEZ_E_BUFFER_FULL) { backoff(); continue; }
+                if (rc != CORTEZ_OK) { fail("write_batch", id, rc); goto out; }
+                seq += count;
+                break;
+            }
+        }
+    }
+
+out:
+    free(payloads);
+    cortez_leave(ch);
+    return NULL;
+}
+
+// Checks one received payload against what its producer wrote.
+static int check_payload(const uint8_t* buf, uint32_t len, uint32_t* next_seq) {
+    bench_msg_head_t head;
+    if (len < sizeof(head)) return -1;
+    memcpy(&head, buf, sizeof(head));
+    if (head.producer >= (uint32_t)g_cfg.producers || head.seq != next_seq[head.producer] ||
+        len != payload_size(head.producer, head.seq)) {
+        fprintf(stderr, "out of order or wrong size: producer %u seq %u (expected %u), %u bytes\n",
+                head.producer, head.seq, head.producer < (uint32_t)g_cfg.producers ? next_seq[head.producer] : 0, len);
+        return -1;
+    }
+    const uint8_t fill = fill_byte(head.producer, head.seq);
+    for (uint32_t i = sizeof(head); i < len; i++) {
+        if (buf[i] != fill) {
+            fprintf(stderr, "corrupt payload: producer %u seq %u, byte %u\n", head.producer, head.seq, i);
+            return -1;
+        }
+    }
+    next_seq[head.producer]++;
+    return 0;
+}
+
+static int consume(cortez_ch_t* ch, long total) {
+    uint32_t next_seq[BENCH_MAX_PRODUCERS] = {0};
+    uint8_t* scratch = malloc(g_cfg.max_payload);
+    cortez_msg_view_t views[BENCH_MAX_BATCH];
+    if (!scratch) return -1;
+
+    long received = 0;
+    while (received < total && !g_failed) {
+        if (g_cfg.read_mode == READ_MSG) {
+            cortez_msg_t* msg = cortez_read(ch, BENCH_READ_TIMEOUT_MS);
+            if (!msg) {
+                fprintf(stderr, "read: %s after %ld messages\n", cortez_strerror(cortez_get_last_error(ch)), received);
+                break;
+            }
+            int rc = check_payload(cortez_msg_payload(msg), cortez_msg_payload_size(msg), next_seq);
+            cortez_msg_release(ch, msg);
+            if (rc != 0) break;
+            received++;
+        } else {
+            int count = cortez_read_batch(ch, views, BENCH_MAX_BATCH, BENCH_READ_TIMEOUT_MS);
+            if (count <= 0) {
+                fprintf(stderr, "read_batch: %s after %ld messages\n", cortez_strerror(count < 0 ? count : CORTEZ_E_TIMED_OUT), received);
+                break;
+            }
+            int rc = 0;
+            for (int i = 0; i < count && rc == 0; i++) {
+                uint32_t len = cortez_msg_view_payload_size(&views[i]);
+                if (len > g_cfg.max_payload) { rc = -1; break; }
+                cortez_msg_view_copy_payload(&views[i], scratch, len);
+                rc = check_payload(scratch, len, next_seq);
+            }
+            cortez_release_batch(ch, views, count);
+            if (rc != 0) break;
+            received += count;
+        }
+    }
+    free(scratch);
+    return received == total ? 0 : -1;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [-p producers] [-n messages] [-s max_payload] [-w copy|zc|batch]\n"
+            "          [-r read|view] [-b batch] [-k channel_kib]\n", prog);
+}
+
+int main(int argc, char** argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "p:n:s:w:r:b:k:h")) != -1) {
+        switch (opt) {
+            case 'p': g_cfg.producers = atoi(optarg); break;
+            case 'n': g_cfg.messages = atoi(optarg); break;
+            case 's': g_cfg.max_payload = (uint32_t)atoi(optarg); break;
+            case 'b': g_cfg.batch = atoi(optarg); break;
+            case 'k': g_cfg.channel_kib = (size_t)atoi(optarg); break;
+            case 'w':
+                if (strcmp(optarg, "copy") == 0) g_cfg.write_mode = WRITE_COPY;
+                else if (strcmp(optarg, "zc") == 0) g_cfg.write_mode = WRITE_ZC;
+                else if (strcmp(optarg, "batch") == 0) g_cfg.write_mode = WRITE_BATCH;
+                else { usage(argv[0]); return 2; }
+                break;
+            case 'r':
+                if (strcmp(optarg, "read") == 0) g_cfg.read_mode = READ_MSG;
+                else if (strcmp(optarg, "view") == 0) g_cfg.read_mode = READ_VIEW;
+                else { usage(argv[0]); return 2; }
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (g_cfg.producers < 1 || g_cfg.producers > BENCH_MAX_PRODUCERS || g_cfg.messages < 1 ||
+        g_cfg.max_payload < sizeof(bench_msg_head_t) || g_cfg.batch < 1 || g_cfg.batch > BENCH_MAX_BATCH ||
+        g_cfg.channel_kib < 4) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    snprintf(g_cfg.channel_name, sizeof(g_cfg.channel_name), "mesh_bench_%d", getpid());
+    cortez_options_t opts = { .size = g_cfg.channel_kib * 1024, .create_policy = CORTEZ_CREATE_ONLY };
+    cortez_ch_t* ch = cortez_join(g_cfg.channel_name, &opts);
+    if (!ch) {
+        fprintf(stderr, "Failed to create channel %s\n", g_cfg.channel_name);
+        return 1;
+    }
+
+    pthread_t threads[BENCH_MAX_PRODUCERS];
+    const long total = (long)g_cfg.producers * g_cfg.messages;
+    const double start = now_sec();
+    for (long i = 0; i < g_cfg.producers; i++) {
+        pthread_create(&threads[i], NULL, producer_main, (void*)i);
+    }
+    int rc = consume(ch, total);
+    if (rc != 0) g_failed = 1;
+    for (int i = 0; i < g_cfg.producers; i++) pthread_join(threads[i], NULL);
+    const double elapsed = now_sec() - start;
+
+    cortez_stats_t stats = {0};
+    cortez_get_stats(ch, &stats);
+    if (!g_failed) {
+        printf("%d producers x %d messages: %.3f s, %.2f Mmsg/s, %.1f MB/s\n",
+               g_cfg.producers, g_cfg.messages, elapsed, total / elapsed / 1e6, stats.bytes_read / elapsed / 1e6);
+        printf("write contention: %llu, buffer-full retries: %ld\n",
+               (unsigned long long)stats.write_contention_count, g_full_retries);
+    }
+    cortez_leave(ch);
+    return g_failed ? 1 : 0;
+}
@@ -19,6 +19,7 @@
 #include <signal.h>
 #include <limits.h>
 #include <pthread.h>
+#include <sched.h>
 #include <dirent.h> // For mesh discovery
 
 // --- USERLAND-SPECIFIC INCLUDES ---
@@ -38,6 +39,7 @@
 #define CORTEZ_CHANNEL_MAGIC 0xDEADBEEFCAFEFACE
 #define CORTEZ_MESSAGE_MAGIC 0xBAADF00DBAADF00D
 #define CORTEZ_JUMP_MAGIC    0x1EABC0DE1EABC0DE
+#define CORTEZ_REGION_ALIGN  8 // Write reservations and the buffer capacity are multiples of this
 
 #define CORTEZ_REGISTRY_CHANNEL "_cortez_registry"
 #define HEARTBEAT_INTERVAL_SEC 2
@@ -59,25 +61,27 @@ struct cortez_ch {
     uint64_t local_head_cache;
     uint64_t local_tail_cache;
     int is_owner;
+    int64_t read_spin_ns; // Busy-wait in cortez_read before parking
+    cortez_msg_t* spare_msg; // Released message struct kept for the next peek
     volatile int ref_count;
 };
 
 // All other structs are identical to cortez-mesh.c
 typedef struct {
     uint64_t magic;
+    uint64_t commit;
     uint32_t total_len;
 } CortezJumpHeader;
 
-struct cortez_tx {
-    uint64_t reserved_head;
-    uint32_t reserved_size;
-};
+#define PEER_BUCKETS 128
 
 typedef struct cortez_peer {
     cortez_mesh_peer_info_t info;
-    int64_t last_heartbeat;
-    cortez_ch_t* comm_channel;
-    struct cortez_peer* next;
+    int64_t last_heartbeat; // monotonic ns; refreshed atomically under the read lock
+    cortez_ch_t* comm_channel; // Cached channel handle for sending; set once, by CAS
+    size_t name_len; // Node name part of info.inbox_channel_name ("<name>-<pid>")
+    struct cortez_peer* next_by_pid;
+    struct cortez_peer* next_by_name;
 } cortez_peer_t;
 
 struct cortez_mesh {
@@ -85,8 +89,12 @@ struct cortez_mesh {
     cortez_ch_t* inbox_ch;
     cortez_ch_t* registry_ch;
     
-    cortez_peer_t* peer_list;
-    pthread_mutex_t peer_list_mutex;
+    // Peers hashed by pid and by node name. Sends, name lookups and heartbeats
+    // of known peers only take the read lock; joins, leaves and time-outs
+    // take it for writing.
+    cortez_peer_t* peers_by_pid[PEER_BUCKETS];
+    cortez_peer_t* peers_by_name[PEER_BUCKETS];
+    pthread_rwlock_t peer_lock;
 
     pthread_t housekeeper_thread;
     volatile int housekeeper_running;
@@ -109,6 +117,15 @@ static int futex_wake(volatile uint32_t *uaddr, int num_waiters) {
     return syscall(SYS_futex, uaddr, FUTEX_WAKE, num_waiters, NULL, NULL, 0);
 }
 
+// Bitset variants: a waiter is only woken by wakes whose bits overlap its own.
+static int futex_wait_bitset(volatile uint32_t *uaddr, uint32_t val, const struct timespec *abs_timeout, uint32_t bits) {
+    return syscall(SYS_futex, uaddr, FUTEX_WAIT_BITSET, val, abs_timeout, NULL, bits);
+}
+
+static int futex_wake_bitset(volatile uint32_t *uaddr, uint32_t bits) {
+    return syscall(SYS_futex, uaddr, FUTEX_WAKE_BITSET, INT_MAX, NULL, NULL, bits);
+}
+
 static const char* internal_strerror(int err) {
     switch (err) {
         case CORTEZ_OK: return "Success";
@@ -150,13 +167,16 @@ static void internal_init_header(CortezChannelHeader* header, size_t shm_size, i
         memset(header, 0, sizeof(CortezChannelHeader));
         header->magic = CORTEZ_CHANNEL_MAGIC;
         header->total_shm_size = shm_size;
-        header->buffer_capacity = shm_size - sizeof(CortezChannelHeader);
+        header->buffer_capacity = (shm_size - sizeof(CortezChannelHeader)) & ~(size_t)(CORTEZ_REGION_ALIGN - 1);
         header->owner_pid = getpid();
     }
     __atomic_store_n(&header->futex_word, 0, __ATOMIC_RELAXED);
     __atomic_store_n(&header->head, 0, __ATOMIC_RELAXED);
     __atomic_store_n(&header->tail, 0, __ATOMIC_RELAXED);
     __atomic_store_n(&header->tx_head, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&header->publish_futex, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&header->publish_waiters, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&header->read_waiters, 0, __ATOMIC_RELAXED);
     __atomic_store_n(&header->messages_written, 0, __ATOMIC_RELAXED);
     __atomic_store_n(&header->messages_read, 0, __ATOMIC_RELAXED);
     __atomic_store_n(&header->bytes_written, 0, __ATOMIC_RELAXED);
@@ -216,6 +236,179 @@ static void copy_from_buffer(void* dest, const CortezChannelHeader* h, uint64_t
     }
 }
 
+// --- Write Reservations ---
+// Writers claim space by advancing tx_head with a CAS, so any number of them
+// can fill disjoint regions at once. head is published in reservation order.
+// A writer whose region is next moves head itself. One that finishes out of
+// turn stores its region's end in the commit word of the region's first
+// header, and whoever moves head up to that region carries it on past it.
+// A writer still unpublished after CORTEZ_PUBLISH_TIMEOUT_NS takes its commit
+// back and leaves a jump record instead, so the channel keeps flowing once
+// the writer ahead of it is done. A thread must therefore commit or abort its
+// reservations on a channel in the order it made them.
+#define CORTEZ_PUBLISH_SPINS 1024
+#define CORTEZ_PUBLISH_TIMEOUT_NS (2LL * 1000000000LL) // The writer ahead of us is stuck or gone
+#define CORTEZ_COMMIT_CLAIMED 1 // Set in a commit word by the thread publishing the region
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// Spinning only helps when the thread we wait for can run at the same time.
+static int have_parallel_cpus(void) {
+    static int parallel = -1;
+    int p = __atomic_load_n(&parallel, __ATOMIC_RELAXED);
+    if (unlikely(p < 0)) {
+        p = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+        __atomic_store_n(&parallel, p, __ATOMIC_RELAXED);
+    }
+    return p;
+}
+
+// Writers waiting for head to reach a position park on the publish futex
+// under that position's bit, so a publish wakes the writer it concerns
+// rather than every parked writer.
+static inline uint32_t publish_bit(uint64_t position) {
+    return 1u << ((position * 0x9E3779B97F4A7C15ULL) >> 59);
+}
+
+static inline uint32_t region_size(uint32_t len) {
+    return (len + CORTEZ_REGION_ALIGN - 1) & ~(uint32_t)(CORTEZ_REGION_ALIGN - 1);
+}
+
+// Regions start 8-byte aligned in a buffer whose capacity is a multiple of
+// 8, so the commit word never straddles the end of the ring.
+static inline uint64_t* commit_word(CortezChannelHeader* h, uint64_t region) {
+    return (uint64_t*)(h->buffer + (region + offsetof(CortezMessageHeader, commit)) % h->buffer_capacity);
+}
+
+// Nothing clears a commit word when its region is reserved, so it holds
+// whatever the last lap left there, payload bytes included. A commit stores
+// the region's end keyed to the region itself; a leftover value decodes to
+// an end for some other region and is rejected. region is a multiple of 8,
+// so the key leaves CORTEZ_COMMIT_CLAIMED alone.
+static inline uint64_t commit_key(uint64_t region) {
+    return region * 0x9E3779B97F4A7C15ULL;
+}
+
+static inline uint64_t commit_value(uint64_t region, uint64_t end) {
+    return end ^ commit_key(region);
+}
+
+// Writes the header that starts a region, all but its commit word, which
+// other writers may be looking at.
+static void write_region_header(CortezChannelHeader* h, uint64_t region, const void* header, size_t len) {
+    const size_t at = offsetof(CortezMessageHeader, commit), after = at + sizeof(uint64_t);
+    copy_to_buffer(h, region, header, at);
+    copy_to_buffer(h, region + after, (const char*)header + after, len - after);
+}
+
+static void write_jump(CortezChannelHeader* h, uint64_t region, uint32_t len) {
+    CortezJumpHeader jump = { .magic = CORTEZ_JUMP_MAGIC, .total_len = len };
+    write_region_header(h, region, &jump, sizeof(jump));
+}
+
+// Claims the region head just reached if its writer committed it out of
+// turn. Returns the region's end, or 0.
+static uint64_t claim_committed(CortezChannelHeader* h, uint64_t region) {
+    const uint64_t reserved = __atomic_load_n(&h->tx_head, __ATOMIC_SEQ_CST);
+    if (region == reserved) return 0;
+    uint64_t* word = commit_word(h, region);
+    uint64_t value = __atomic_load_n(word, __ATOMIC_SEQ_CST);
+    const uint64_t end = value ^ commit_key(region);
+    // Anything outside (region, reserved] was not committed for this region
+    if (end <= region || end > reserved || (end & CORTEZ_COMMIT_CLAIMED)) return 0;
+    if (!__atomic_compare_exchange_n(word, &value, value | CORTEZ_COMMIT_CLAIMED, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) return 0;
+    return end;
+}
+
+// Moves head to end, then on past every region behind it that was already
+// committed, waking their writers and the reader. head, the commit words,
+// futex_word and the waiter counts are sequentially consistent, so a
+// publisher that sees no commit or no waiter has published before the other
+// side looks at head.
+static void publish_from(CortezChannelHeader* h, uint64_t end) {
+    do {
+        __atomic_store_n(&h->head, end, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&h->publish_futex, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&h->publish_waiters, __ATOMIC_SEQ_CST) != 0) {
+            futex_wake_bitset(&h->publish_futex, publish_bit(end));
+        }
+        end = claim_committed(h, end);
+    } while (end != 0);
+
+    __atomic_add_fetch(&h->futex_word, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&h->read_waiters, __ATOMIC_SEQ_CST) != 0) {
+        futex_wake(&h->futex_word, 1);
+    }
+}
+
+// Publishes a finished region if it is next, or commits it for whoever
+// publishes the region before it. Returns 1 if it was published.
+static int commit_region(CortezChannelHeader* h, uint64_t region, uint64_t end) {
+    if (likely(__atomic_load_n(&h->head, __ATOMIC_SEQ_CST) == region)) {
+        publish_from(h, end);
+        return 1;
+    }
+    __atomic_store_n(commit_word(h, region), commit_value(region, end), __ATOMIC_SEQ_CST);
+    // head may have reached us before the commit was visible
+    if (__atomic_load_n(&h->head, __ATOMIC_SEQ_CST) == region && claim_committed(h, region) == end) {
+        publish_from(h, end);
+        return 1;
+    }
+    return 0;
+}
+
+// Waits until head reaches target, or until deadline_ns unless it is 0.
+static int wait_for_head(CortezChannelHeader* h, uint64_t target, int64_t deadline_ns) {
+    const unsigned spin_budget = have_parallel_cpus() ? CORTEZ_PUBLISH_SPINS : 0;
+    const struct timespec deadline = { deadline_ns / 1000000000LL, deadline_ns % 1000000000LL };
+    for (unsigned spins = 0; __atomic_load_n(&h->head, __ATOMIC_SEQ_CST) < target; spins++) {
+        if (spins < spin_budget) { cpu_relax(); continue; }
+        if (deadline_ns != 0 && now_mono_ns() > deadline_ns) return CORTEZ_E_TIMED_OUT;
+
+        __atomic_add_fetch(&h->publish_waiters, 1, __ATOMIC_SEQ_CST);
+        uint32_t seen = __atomic_load_n(&h->publish_futex, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&h->head, __ATOMIC_SEQ_CST) < target) {
+            futex_wait_bitset(&h->publish_futex, seen, deadline_ns != 0 ? &deadline : NULL, publish_bit(target));
+        }
+        __atomic_sub_fetch(&h->publish_waiters, 1, __ATOMIC_SEQ_CST);
+    }
+    return CORTEZ_OK;
+}
+
+// Publishes tx's region once every region reserved before it is published.
+// If that takes too long the region becomes a jump record instead and the
+// message is dropped with CORTEZ_E_CHAN_STALE.
+static int publish_reservation(CortezChannelHeader* h, const cortez_tx_t* tx) {
+    const uint64_t region = tx->reserved_head, end = region + tx->reserved_size;
+    if (likely(commit_region(h, region, end))) return CORTEZ_OK;
+
+    __atomic_add_fetch(&h->write_contention_count, 1, __ATOMIC_RELAXED);
+    if (wait_for_head(h, end, now_mono_ns() + CORTEZ_PUBLISH_TIMEOUT_NS) == CORTEZ_OK) return CORTEZ_OK;
+
+    // Take the commit back, unless a publisher has just claimed it
+    uint64_t committed = commit_value(region, end);
+    if (!__atomic_compare_exchange_n(commit_word(h, region), &committed, 0, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        wait_for_head(h, end, 0);
+        return CORTEZ_OK;
+    }
+    write_jump(h, region, tx->reserved_size);
+    commit_region(h, region, end);
+    return CORTEZ_E_CHAN_STALE;
+}
+
+// Turns an unused reservation into a jump record the reader skips. It never
+// waits: whoever publishes the region before it carries head past it.
+static void cancel_reservation(CortezChannelHeader* h, const cortez_tx_t* tx) {
+    write_jump(h, tx->reserved_head, tx->reserved_size);
+    commit_region(h, tx->reserved_head, tx->reserved_head + tx->reserved_size);
+}
+
 static cortez_ch_t* cortez_channel_ref(cortez_ch_t* ch) {
     if (ch) {
         __atomic_add_fetch(&ch->ref_count, 1, __ATOMIC_RELAXED);
@@ -337,7 +530,9 @@ cortez_ch_t* cortez_join(const char* channel_name, const cortez_options_t* optio
     if (!is_pid_alive(ch->header->owner_pid)) { set_error(ch, CORTEZ_E_CHAN_STALE); }
     ch->local_head_cache = __atomic_load_n(&ch->header->head, __ATOMIC_ACQUIRE);
     ch->local_tail_cache = __atomic_load_n(&ch->header->tail, __ATOMIC_ACQUIRE);
-    ch->ref_count = 1;
+    ch->ref_count = 1; // Initial reference
+    int spin_us = options->read_spin_us ? options->read_spin_us : CORTEZ_DEFAULT_READ_SPIN_US;
+    ch->read_spin_ns = (spin_us > 0 && have_parallel_cpus()) ? (int64_t)spin_us * 1000 : 0;
     set_error(ch, CORTEZ_OK);
     return ch;
 }
@@ -351,6 +546,7 @@ int cortez_leave(cortez_ch_t* ch) {
     }
     
     // Last reference is gone, perform full cleanup.
+    free(ch->spare_msg);
     if(ch->header && ch->shm_base != MAP_FAILED) {
         __atomic_sub_fetch(&ch->header->active_connections, 1, __ATOMIC_RELAXED);
         munmap(ch->shm_base, ch->shm_size);
@@ -392,36 +588,46 @@ int cortez_get_channel_fd(cortez_ch_t* ch) {
 }
 
 
-cortez_tx_t* cortez_begin_write(cortez_ch_t* ch, uint32_t total_size) {
-    if (unlikely(!ch || total_size == 0)) { set_error(ch, CORTEZ_E_INVALID_ARG); return NULL; }
-    if (unlikely(total_size > ch->header->buffer_capacity)) { set_error(ch, CORTEZ_E_MSG_TOO_LARGE); return NULL; }
-
-    uint64_t expected_tx = 0;
-    if (!__atomic_compare_exchange_n(&ch->header->tx_head, &expected_tx, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
-        set_error(ch, CORTEZ_E_TX_IN_PROGRESS); return NULL;
-    }
+int cortez_begin_write_into(cortez_ch_t* ch, uint32_t total_size, cortez_tx_t* tx) {
+    if (unlikely(!ch || !tx || total_size < sizeof(CortezMessageHeader))) { set_error(ch, CORTEZ_E_INVALID_ARG); return CORTEZ_E_INVALID_ARG; }
+    if (unlikely(total_size > ch->header->buffer_capacity)) { set_error(ch, CORTEZ_E_MSG_TOO_LARGE); return CORTEZ_E_MSG_TOO_LARGE; }
 
     CortezChannelHeader* h = ch->header;
-    uint64_t head = __atomic_load_n(&h->head, __ATOMIC_RELAXED);
-    const uint64_t tail = __atomic_load_n(&h->tail, __ATOMIC_ACQUIRE);
-
-    if (unlikely(get_write_space(h, head, tail) <= total_size)) {
-        __atomic_store_n(&h->tx_head, 0, __ATOMIC_RELEASE);
-        set_error(ch, CORTEZ_E_BUFFER_FULL);
-        return NULL;
+    const uint32_t size = region_size(total_size);
+    uint64_t reserved;
+    for (;;) {
+        // tail first: it never passes head, and head never passes tx_head.
+        const uint64_t tail = __atomic_load_n(&h->tail, __ATOMIC_ACQUIRE);
+        reserved = __atomic_load_n(&h->tx_head, __ATOMIC_ACQUIRE);
+        if (unlikely(get_write_space(h, reserved, tail) <= size)) {
+            set_error(ch, CORTEZ_E_BUFFER_FULL);
+            return CORTEZ_E_BUFFER_FULL;
+        }
+        if (__atomic_compare_exchange_n(&h->tx_head, &reserved, reserved + size, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) break;
+        __atomic_add_fetch(&h->write_contention_count, 1, __ATOMIC_RELAXED);
     }
 
-    cortez_tx_t* tx = malloc(sizeof(cortez_tx_t));
-    if (!tx) { __atomic_store_n(&h->tx_head, 0, __ATOMIC_RELEASE); set_error(ch, CORTEZ_E_NO_MEM); return NULL; }
-
-    tx->reserved_head = head;
-    tx->reserved_size = total_size;
-    uint64_t next_tx_head = head + total_size;
-    __atomic_store_n(&h->tx_head, next_tx_head, __ATOMIC_RELEASE);
+    tx->reserved_head = reserved;
+    tx->reserved_size = size;
+    tx->heap = 0;
     set_error(ch, CORTEZ_OK);
+    return CORTEZ_OK;
+}
+
+cortez_tx_t* cortez_begin_write(cortez_ch_t* ch, uint32_t total_size) {
+    cortez_tx_t* tx = malloc(sizeof(cortez_tx_t));
+    if (!tx) { set_error(ch, CORTEZ_E_NO_MEM); return NULL; }
+    if (cortez_begin_write_into(ch, total_size, tx) != CORTEZ_OK) { free(tx); return NULL; }
+    tx->heap = 1;
     return tx;
 }
 
+// Frees a transaction that came from cortez_begin_write().
+static void release_tx(cortez_tx_t* tx) {
+    if (tx->heap) free(tx);
+}
+
 int cortez_commit_write(cortez_ch_t* ch, cortez_tx_t* tx, uint16_t msg_type, const struct iovec* iov, int iovcnt) {
     if (unlikely(!ch || !tx || !iov || iovcnt < 0)) { set_error(ch, CORTEZ_E_INVALID_ARG); return CORTEZ_E_INVALID_ARG; }
 
@@ -429,8 +635,8 @@ int cortez_commit_write(cortez_ch_t* ch, cortez_tx_t* tx, uint16_t msg_type, con
     uint32_t payload_size = 0;
     for (int i = 0; i < iovcnt; ++i) payload_size += iov[i].iov_len;
 
-    if (unlikely(tx->reserved_size != sizeof(CortezMessageHeader) + payload_size)) {
-        __atomic_store_n(&h->tx_head, 0, __ATOMIC_RELEASE); free(tx);
+    if (unlikely(tx->reserved_size != region_size(sizeof(CortezMessageHeader) + payload_size))) {
+        cancel_reservation(h, tx); release_tx(tx);
         set_error(ch, CORTEZ_E_INVALID_ARG); return CORTEZ_E_INVALID_ARG;
     }
 
@@ -443,7 +649,7 @@ int cortez_commit_write(cortez_ch_t* ch, cortez_tx_t* tx, uint16_t msg_type, con
 
 
     uint64_t write_offset = tx->reserved_head;
-    copy_to_buffer(h, write_offset, &msg_header, sizeof(msg_header));
+    write_region_header(h, write_offset, &msg_header, sizeof(msg_header));
     write_offset += sizeof(msg_header);
 
     for (int i = 0; i < iovcnt; ++i) {
@@ -451,29 +657,30 @@ int cortez_commit_write(cortez_ch_t* ch, cortez_tx_t* tx, uint16_t msg_type, con
         write_offset += iov[i].iov_len;
     }
 
-    __atomic_store_n(&h->head, tx->reserved_head + tx->reserved_size, __ATOMIC_RELEASE);
-    __atomic_store_n(&h->tx_head, 0, __ATOMIC_RELEASE);
-    __atomic_add_fetch(&h->futex_word, 1, __ATOMIC_RELAXED);
-    futex_wake(&h->futex_word, 1);
-    __atomic_add_fetch(&h->messages_written, 1, __ATOMIC_RELAXED);
-    __atomic_add_fetch(&h->bytes_written, tx->reserved_size, __ATOMIC_RELAXED);
+    int rc = publish_reservation(h, tx);
+    if (likely(rc == CORTEZ_OK)) {
+        __atomic_add_fetch(&h->messages_written, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&h->bytes_written, tx->reserved_size, __ATOMIC_RELAXED);
+    }
 
-    free(tx); set_error(ch, CORTEZ_OK); return CORTEZ_OK;
+    release_tx(tx); set_error(ch, rc); return rc;
 }
 
 void cortez_abort_write(cortez_ch_t* ch, cortez_tx_t* tx) {
     if (!ch || !tx) return;
-    __atomic_store_n(&ch->header->tx_head, 0, __ATOMIC_RELEASE);
-    free(tx);
+    cancel_reservation(ch->header, tx);
+    set_error(ch, CORTEZ_OK);
+    release_tx(tx);
 }
 
 int cortez_writev(cortez_ch_t* ch, uint16_t msg_type, const struct iovec* iov, int iovcnt) {
     uint32_t payload_size = 0;
     for (int i = 0; i < iovcnt; ++i) payload_size += iov[i].iov_len;
     uint32_t total_size = sizeof(CortezMessageHeader) + payload_size;
-    cortez_tx_t* tx = cortez_begin_write(ch, total_size);
-    if (!tx) return ch->last_error;
-    return cortez_commit_write(ch, tx, msg_type, iov, iovcnt);
+    cortez_tx_t tx;
+    int rc = cortez_begin_write_into(ch, total_size, &tx);
+    if (rc != CORTEZ_OK) return rc;
+    return cortez_commit_write(ch, &tx, msg_type, iov, iovcnt);
 }
 
 int cortez_write(cortez_ch_t* ch, uint16_t msg_type, const void* payload, uint32_t payload_size) {
@@ -481,56 +688,117 @@ int cortez_write(cortez_ch_t* ch, uint16_t msg_type, const void* payload, uint32
     return cortez_writev(ch, msg_type, &iov, 1);
 }
 
-cortez_write_handle_t* cortez_begin_write_zc(cortez_ch_t* ch, uint32_t payload_size) {
-    if (unlikely(!ch || payload_size == 0)) {
-        set_error(ch, CORTEZ_E_INVALID_ARG);
-        return NULL;
+int cortez_write_batch(cortez_ch_t* ch, const cortez_batch_msg_t* msgs, size_t count) {
+    if (unlikely(!ch || (count > 0 && !msgs))) { set_error(ch, CORTEZ_E_INVALID_ARG); return CORTEZ_E_INVALID_ARG; }
+    if (count == 0) { set_error(ch, CORTEZ_OK); return CORTEZ_OK; }
+
+    uint64_t total_size = 0;
+    // Every message is padded to the region alignment so the next header stays aligned
+    for (size_t i = 0; i < count && total_size <= UINT32_MAX; ++i) {
+        total_size += (sizeof(CortezMessageHeader) + (uint64_t)msgs[i].payload_size + CORTEZ_REGION_ALIGN - 1) &
+                      ~(uint64_t)(CORTEZ_REGION_ALIGN - 1);
     }
+    if (unlikely(total_size > UINT32_MAX)) { set_error(ch, CORTEZ_E_MSG_TOO_LARGE); return CORTEZ_E_MSG_TOO_LARGE; }
 
-    uint32_t total_size = sizeof(CortezMessageHeader) + payload_size;
+    cortez_tx_t tx;
+    int rc = cortez_begin_write_into(ch, (uint32_t)total_size, &tx);
+    if (rc != CORTEZ_OK) return rc;
 
-    cortez_tx_t* tx = cortez_begin_write(ch, total_size);
-    if (!tx) {
-        return NULL;
+    CortezChannelHeader* h = ch->header;
+    CortezMessageHeader msg_header = {
+        .magic = CORTEZ_MESSAGE_MAGIC, .iov_count = 1, .sender_pid = getpid()
+    };
+    clock_gettime(CLOCK_MONOTONIC, &msg_header.timestamp);
+
+    uint64_t write_offset = tx.reserved_head;
+    for (size_t i = 0; i < count; ++i) {
+        msg_header.total_len = region_size(sizeof(CortezMessageHeader) + msgs[i].payload_size);
+        msg_header.payload_len = msgs[i].payload_size;
+        msg_header.msg_type = msgs[i].msg_type;
+        if (i == 0) {
+            write_region_header(h, write_offset, &msg_header, sizeof(msg_header));
+        } else {
+            copy_to_buffer(h, write_offset, &msg_header, sizeof(msg_header));
+        }
+        if (msgs[i].payload_size > 0) {
+            copy_to_buffer(h, write_offset + sizeof(msg_header), msgs[i].payload, msgs[i].payload_size);
+        }
+        write_offset += msg_header.total_len;
     }
 
-    cortez_write_handle_t* handle = calloc(1, sizeof(cortez_write_handle_t));
-    if (!handle) {
-        cortez_abort_write(ch, tx);
-        set_error(ch, CORTEZ_E_NO_MEM);
-        return NULL;
+    // One head update and at most one wake for the whole batch
+    rc = publish_reservation(h, &tx);
+    if (likely(rc == CORTEZ_OK)) {
+        __atomic_add_fetch(&h->messages_written, count, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&h->bytes_written, tx.reserved_size, __ATOMIC_RELAXED);
+    }
+
+    set_error(ch, rc); return rc;
+}
+
+int cortez_begin_write_zc_into(cortez_ch_t* ch, uint32_t payload_size, cortez_write_handle_t* handle) {
+    if (unlikely(!ch || !handle || payload_size == 0)) {
+        set_error(ch, CORTEZ_E_INVALID_ARG);
+        return CORTEZ_E_INVALID_ARG;
+    }
+
+    // Use the existing transaction logic to reserve a contiguous block
+    int rc = cortez_begin_write_into(ch, sizeof(CortezMessageHeader) + payload_size, &handle->tx);
+    if (rc != CORTEZ_OK) {
+        return rc; // cortez_begin_write_into already set the error
     }
 
     handle->ch = ch;
-    handle->tx = tx;
+    handle->heap = 0;
 
     CortezChannelHeader* h = ch->header;
-    uint64_t payload_start_pos = tx->reserved_head + sizeof(CortezMessageHeader);
+    uint64_t payload_start_pos = handle->tx.reserved_head + sizeof(CortezMessageHeader);
     uint64_t start_offset = payload_start_pos % h->buffer_capacity;
 
     if (start_offset + payload_size <= h->buffer_capacity) {
+        // Payload fits in a single contiguous block
         handle->part1 = h->buffer + start_offset;
         handle->part1_size = payload_size;
         handle->part2 = NULL;
         handle->part2_size = 0;
     } else {
+        // Payload wraps around the end of the ring buffer
         handle->part1 = h->buffer + start_offset;
         handle->part1_size = h->buffer_capacity - start_offset;
         handle->part2 = h->buffer;
         handle->part2_size = payload_size - handle->part1_size;
     }
 
-    set_error(ch, CORTEZ_OK);
+    return CORTEZ_OK;
+}
+
+cortez_write_handle_t* cortez_begin_write_zc(cortez_ch_t* ch, uint32_t payload_size) {
+    cortez_write_handle_t* handle = malloc(sizeof(cortez_write_handle_t));
+    if (!handle) {
+        set_error(ch, CORTEZ_E_NO_MEM);
+        return NULL;
+    }
+    if (cortez_begin_write_zc_into(ch, payload_size, handle) != CORTEZ_OK) {
+        free(handle);
+        return NULL;
+    }
+    handle->heap = 1;
     return handle;
 }
 
+// Ends a handle's transaction; frees it if it came from cortez_begin_write_zc().
+static void release_handle(cortez_write_handle_t* handle) {
+    handle->ch = NULL;
+    if (handle->heap) free(handle);
+}
+
 int cortez_commit_write_zc(cortez_write_handle_t* handle, uint16_t msg_type) {
-    if (unlikely(!handle || !handle->ch || !handle->tx)) {
+    if (unlikely(!handle || !handle->ch)) {
         return CORTEZ_E_INVALID_ARG;
     }
 
     cortez_ch_t* ch = handle->ch;
-    cortez_tx_t* tx = handle->tx;
+    cortez_tx_t* tx = &handle->tx;
     CortezChannelHeader* h = ch->header;
 
     uint32_t payload_size = handle->part1_size + handle->part2_size;
@@ -545,30 +813,44 @@ int cortez_commit_write_zc(cortez_write_handle_t* handle, uint16_t msg_type) {
     };
     clock_gettime(CLOCK_REALTIME, &msg_header.timestamp); 
 
-    copy_to_buffer(h, tx->reserved_head, &msg_header, sizeof(msg_header));
+    write_region_header(h, tx->reserved_head, &msg_header, sizeof(msg_header));
 
-    __atomic_store_n(&h->head, tx->reserved_head + tx->reserved_size, __ATOMIC_RELEASE);
-    __atomic_store_n(&h->tx_head, 0, __ATOMIC_RELEASE);
-    __atomic_add_fetch(&h->futex_word, 1, __ATOMIC_RELAXED);
-    futex_wake(&h->futex_word, 1);
-    __atomic_add_fetch(&h->messages_written, 1, __ATOMIC_RELAXED);
-    __atomic_add_fetch(&h->bytes_written, tx->reserved_size, __ATOMIC_RELAXED);
+    // Publish once every earlier reservation is in, then wake the reader
+    int rc = publish_reservation(h, tx);
+    if (likely(rc == CORTEZ_OK)) {
+        __atomic_add_fetch(&h->messages_written, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&h->bytes_written, tx->reserved_size, __ATOMIC_RELAXED);
+    }
 
-    free(tx);
-    free(handle);
-    set_error(ch, CORTEZ_OK);
-    return CORTEZ_OK;
+    release_handle(handle);
+    set_error(ch, rc);
+    return rc;
 }
 
 void cortez_abort_write_zc(cortez_write_handle_t* handle) {
-    if (!handle || !handle->ch || !handle->tx) return;
-    cortez_abort_write(handle->ch, handle->tx);
-    free(handle);
+    if (!handle || !handle->ch) return;
+    cortez_abort_write(handle->ch, &handle->tx);
+    release_handle(handle);
 }
 
-cortez_msg_t* cortez_read(cortez_ch_t* ch, int timeout_ms) {
-    if (unlikely(!ch)) return NULL;
+// Spins for up to the handle's budget waiting for a message header to be
+// published. Returns 1 if one was.
+static int spin_for_message(cortez_ch_t* ch) {
+    if (ch->read_spin_ns <= 0) return 0;
+    CortezChannelHeader* h = ch->header;
+    const int64_t until = now_mono_ns() + ch->read_spin_ns;
+    for (unsigned i = 1;; i++) {
+        cpu_relax();
+        ch->local_head_cache = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+        if (get_read_space(h, ch->local_head_cache, ch->local_tail_cache) >= sizeof(CortezMessageHeader)) return 1;
+        if ((i & 63) == 0 && now_mono_ns() > until) return 0;
+    }
+}
 
+// Waits until at least a message header's worth of data is published.
+// Returns CORTEZ_OK, CORTEZ_E_TIMED_OUT, or CORTEZ_E_BUFFER_FULL when
+// timeout_ms is 0 and the channel is empty.
+static int wait_for_message(cortez_ch_t* ch, int timeout_ms) {
     CortezChannelHeader* h = ch->header;
     struct timespec timeout_spec, *timeout_ptr = NULL;
 
@@ -576,33 +858,125 @@ cortez_msg_t* cortez_read(cortez_ch_t* ch, int timeout_ms) {
         timeout_spec.tv_sec = timeout_ms / 1000;
         timeout_spec.tv_nsec = (timeout_ms % 1000) * 1000000;
         timeout_ptr = &timeout_spec;
-    } else if (timeout_ms == -1) {
-        timeout_ptr = NULL;
     }
 
-    uint32_t current_futex_val = __atomic_load_n(&h->futex_word, __ATOMIC_ACQUIRE);
     ch->local_head_cache = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
-
-    while (get_read_space(h, ch->local_head_cache, ch->local_tail_cache) < sizeof(CortezMessageHeader)) {
-        if (timeout_ms == 0) { set_error(ch, CORTEZ_E_BUFFER_FULL); return NULL; }
+    if (get_read_space(h, ch->local_head_cache, ch->local_tail_cache) >= sizeof(CortezMessageHeader)) return CORTEZ_OK;
+    if (timeout_ms == 0) return CORTEZ_E_BUFFER_FULL;
+    if (spin_for_message(ch)) return CORTEZ_OK;
+
+    // Announce ourselves before the last look at head, so writers know to
+    // wake us (see publish_reservation).
+    __atomic_add_fetch(&h->read_waiters, 1, __ATOMIC_SEQ_CST);
+    int rc = CORTEZ_OK;
+    for (;;) {
+        uint32_t current_futex_val = __atomic_load_n(&h->futex_word, __ATOMIC_SEQ_CST);
+        ch->local_head_cache = __atomic_load_n(&h->head, __ATOMIC_SEQ_CST);
+        if (get_read_space(h, ch->local_head_cache, ch->local_tail_cache) >= sizeof(CortezMessageHeader)) break;
 
         int r = futex_wait(&h->futex_word, current_futex_val, timeout_ptr);
-        if (r == -1) {
-            if (errno == ETIMEDOUT) {
-                set_error(ch, CORTEZ_E_TIMED_OUT);
-                return NULL;
-            }
-            if (errno == EINTR) {
-                current_futex_val = __atomic_load_n(&h->futex_word, __ATOMIC_ACQUIRE);
-                ch->local_head_cache = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
-                continue;
+        if (r == -1 && errno == ETIMEDOUT) { rc = CORTEZ_E_TIMED_OUT; break; }
+    }
+    __atomic_sub_fetch(&h->read_waiters, 1, __ATOMIC_SEQ_CST);
+    return rc;
+}
+
+cortez_msg_t* cortez_read(cortez_ch_t* ch, int timeout_ms) {
+    if (unlikely(!ch)) return NULL;
+
+    for (;;) {
+        int rc = wait_for_message(ch, timeout_ms);
+        if (rc != CORTEZ_OK) { set_error(ch, rc); return NULL; }
+
+        // An aborted write leaves a jump record; if that was all there was,
+        // peek finds nothing after skipping it and we wait again.
+        cortez_msg_t* msg = cortez_peek(ch);
+        if (msg || ch->last_error != CORTEZ_E_BUFFER_FULL || timeout_ms == 0) return msg;
+    }
+}
+
+// Fills views with the published messages from the read position on, without
+// consuming them. Jump records ahead of the first message are consumed here;
+// later ones are consumed with the batch.
+static int collect_views(cortez_ch_t* ch, cortez_msg_view_t* views, int max_views) {
+    CortezChannelHeader* h = ch->header;
+    const uint64_t head = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+    ch->local_head_cache = head;
+
+    uint64_t pos = ch->local_tail_cache;
+    int count = 0;
+    while (count < max_views && head - pos >= sizeof(CortezMessageHeader)) {
+        CortezMessageHeader hdr;
+        copy_from_buffer(&hdr, h, pos, sizeof(hdr));
+
+        if (unlikely(hdr.magic == CORTEZ_JUMP_MAGIC)) {
+            CortezJumpHeader jump;
+            memcpy(&jump, &hdr, sizeof(jump));
+            pos += jump.total_len;
+            if (count == 0) {
+                ch->local_tail_cache = pos;
+                __atomic_store_n(&h->tail, pos, __ATOMIC_RELEASE);
             }
+            continue;
         }
-        current_futex_val = __atomic_load_n(&h->futex_word, __ATOMIC_ACQUIRE);
-        ch->local_head_cache = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+        if (unlikely(hdr.magic != CORTEZ_MESSAGE_MAGIC || hdr.total_len < sizeof(hdr) || head - pos < hdr.total_len)) {
+            if (count == 0) { set_error(ch, CORTEZ_E_CORRUPT); return CORTEZ_E_CORRUPT; }
+            break; // Hand out what we have; the next call reports it
+        }
+
+        cortez_msg_view_t* view = &views[count++];
+        view->header = hdr;
+        uint64_t start = (pos + sizeof(hdr)) % h->buffer_capacity;
+        size_t first = hdr.payload_len;
+        if (start + first > h->buffer_capacity) first = h->buffer_capacity - start;
+        view->payload[0].iov_base = h->buffer + start;
+        view->payload[0].iov_len = first;
+        view->payload[1].iov_base = h->buffer;
+        view->payload[1].iov_len = hdr.payload_len - first;
+        pos += hdr.total_len;
+        view->end = pos;
     }
+    set_error(ch, CORTEZ_OK);
+    return count;
+}
+
+int cortez_read_batch(cortez_ch_t* ch, cortez_msg_view_t* views, int max_views, int timeout_ms) {
+    if (unlikely(!ch || !views || max_views <= 0)) { set_error(ch, CORTEZ_E_INVALID_ARG); return CORTEZ_E_INVALID_ARG; }
+
+    for (;;) {
+        int rc = wait_for_message(ch, timeout_ms);
+        if (rc == CORTEZ_E_BUFFER_FULL) { set_error(ch, CORTEZ_OK); return 0; }
+        if (rc != CORTEZ_OK) { set_error(ch, rc); return rc; }
 
-    return cortez_peek(ch);
+        int count = collect_views(ch, views, max_views);
+        if (count != 0 || timeout_ms == 0) return count;
+    }
+}
+
+int cortez_release_batch(cortez_ch_t* ch, const cortez_msg_view_t* views, int count) {
+    if (unlikely(!ch || count < 0 || (count > 0 && !views))) return CORTEZ_E_INVALID_ARG;
+    if (count == 0) return CORTEZ_OK;
+
+    CortezChannelHeader* h = ch->header;
+    const uint64_t end = views[count - 1].end;
+    const uint64_t bytes = end - ch->local_tail_cache;
+    ch->local_tail_cache = end;
+    __atomic_store_n(&h->tail, end, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&h->messages_read, count, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&h->bytes_read, bytes, __ATOMIC_RELAXED);
+    return CORTEZ_OK;
+}
+
+int cortez_read_view(cortez_ch_t* ch, cortez_msg_view_t* view, int timeout_ms) {
+    int count = cortez_read_batch(ch, view, 1, timeout_ms);
+    if (count == 0) { set_error(ch, CORTEZ_E_BUFFER_FULL); return CORTEZ_E_BUFFER_FULL; }
+    return count < 0 ? count : CORTEZ_OK;
+}
+
+// Keeps a released message struct for the next peek, so steady-state reads
+// do not allocate.
+static void recycle_msg(cortez_ch_t* ch, cortez_msg_t* msg) {
+    free(__atomic_exchange_n(&ch->spare_msg, msg, __ATOMIC_ACQ_REL));
 }
 
 cortez_msg_t* cortez_peek(cortez_ch_t* ch) {
@@ -633,12 +1007,16 @@ cortez_msg_t* cortez_peek(cortez_ch_t* ch) {
     if (unlikely(msg_header_ptr->magic != CORTEZ_MESSAGE_MAGIC)) { set_error(ch, CORTEZ_E_CORRUPT); return NULL; }
     if (unlikely(available_data < msg_header_ptr->total_len)) { set_error(ch, CORTEZ_E_BUFFER_FULL); return NULL; }
 
-    cortez_msg_t* msg = calloc(1, sizeof(cortez_msg_t));
-    if (!msg) { set_error(ch, CORTEZ_E_NO_MEM); return NULL; }
+    cortez_msg_t* msg = __atomic_exchange_n(&ch->spare_msg, NULL, __ATOMIC_ACQ_REL);
+    if (!msg) {
+        msg = malloc(sizeof(cortez_msg_t));
+        if (!msg) { set_error(ch, CORTEZ_E_NO_MEM); return NULL; }
+    }
+    msg->linear_buffer = NULL;
 
     if (unlikely(tail_offset + msg_header_ptr->total_len > h->buffer_capacity)) {
         msg->linear_buffer = malloc(msg_header_ptr->total_len);
-        if (!msg->linear_buffer) { free(msg); set_error(ch, CORTEZ_E_NO_MEM); return NULL; }
+        if (!msg->linear_buffer) { recycle_msg(ch, msg); set_error(ch, CORTEZ_E_NO_MEM); return NULL; }
         copy_from_buffer(msg->linear_buffer, h, ch->local_tail_cache, msg_header_ptr->total_len);
         msg->header = msg->linear_buffer;
     } else {
@@ -657,7 +1035,7 @@ int cortez_msg_release(cortez_ch_t* ch, cortez_msg_t* msg) {
     __atomic_add_fetch(&h->messages_read, 1, __ATOMIC_RELAXED);
     __atomic_add_fetch(&h->bytes_read, hdr->total_len, __ATOMIC_RELAXED);
     if (msg->linear_buffer) free(msg->linear_buffer);
-    free(msg);
+    recycle_msg(ch, msg);
     return CORTEZ_OK;
 }
 
@@ -684,23 +1062,49 @@ int cortez_get_stats(cortez_ch_t* ch, cortez_stats_t* stats) {
 
 // --- MESH API ---
 
+static size_t pid_bucket(pid_t pid) {
+    return ((uint32_t)pid * 2654435761u) % PEER_BUCKETS;
+}
+
+static size_t name_bucket(const char* name, size_t len) {
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < len; i++) hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+    return hash % PEER_BUCKETS;
+}
+
+// Callers hold peer_lock, in either mode.
+static cortez_peer_t* find_peer_locked(cortez_mesh_t* mesh, pid_t pid) {
+    for (cortez_peer_t* peer = mesh->peers_by_pid[pid_bucket(pid)]; peer; peer = peer->next_by_pid) {
+        if (peer->info.pid == pid) return peer;
+    }
+    return NULL;
+}
+
+// Find, add, or update a peer in the tables. Callers hold peer_lock for writing.
 static cortez_peer_t* update_peer(cortez_mesh_t* mesh, const cortez_mesh_peer_info_t* peer_info) {
-    cortez_peer_t* peer = NULL;
-    for (peer = mesh->peer_list; peer != NULL; peer = peer->next) {
-        if (peer->info.pid == peer_info->pid) {
-            peer->last_heartbeat = now_mono_ns();
-            return peer;
-        }
+    cortez_peer_t* peer = find_peer_locked(mesh, peer_info->pid);
+    if (peer) {
+        __atomic_store_n(&peer->last_heartbeat, now_mono_ns(), __ATOMIC_RELAXED);
+        return peer;
     }
 
+    // Not found, add new peer
     peer = calloc(1, sizeof(cortez_peer_t));
     if (!peer) return NULL;
     
     peer->info = *peer_info;
+    peer->info.inbox_channel_name[sizeof(peer->info.inbox_channel_name) - 1] = '\0';
     peer->last_heartbeat = now_mono_ns();
-    peer->comm_channel = NULL;
-    peer->next = mesh->peer_list;
-    mesh->peer_list = peer;
+    peer->comm_channel = NULL; // Lazily connect
+    const char* dash = strrchr(peer->info.inbox_channel_name, '-');
+    peer->name_len = dash ? (size_t)(dash - peer->info.inbox_channel_name) : strlen(peer->info.inbox_channel_name);
+
+    size_t pb = pid_bucket(peer->info.pid);
+    size_t nb = name_bucket(peer->info.inbox_channel_name, peer->name_len);
+    peer->next_by_pid = mesh->peers_by_pid[pb];
+    mesh->peers_by_pid[pb] = peer;
+    peer->next_by_name = mesh->peers_by_name[nb]; // Newest first, as lookups by name expect
+    mesh->peers_by_name[nb] = peer;
 
     char process_name[64];
     get_process_name_by_pid(peer->info.pid, process_name, sizeof(process_name));
@@ -708,21 +1112,71 @@ static cortez_peer_t* update_peer(cortez_mesh_t* mesh, const cortez_mesh_peer_in
     return peer;
 }
 
+// Unlinks a peer from both tables and frees it. Callers hold peer_lock for writing.
+static void drop_peer(cortez_mesh_t* mesh, cortez_peer_t* peer) {
+    cortez_peer_t** pptr = &mesh->peers_by_pid[pid_bucket(peer->info.pid)];
+    while (*pptr != peer) pptr = &(*pptr)->next_by_pid;
+    *pptr = peer->next_by_pid;
+
+    pptr = &mesh->peers_by_name[name_bucket(peer->info.inbox_channel_name, peer->name_len)];
+    while (*pptr != peer) pptr = &(*pptr)->next_by_name;
+    *pptr = peer->next_by_name;
+
+    if (peer->comm_channel) cortez_leave(peer->comm_channel);
+    free(peer);
+}
+
 static void remove_peer(cortez_mesh_t* mesh, pid_t pid) {
-    cortez_peer_t** pptr = &mesh->peer_list;
-    while (*pptr) {
-        cortez_peer_t* entry = *pptr;
-        if (entry->info.pid == pid) {
-            *pptr = entry->next;
-            char process_name[64];
-            get_process_name_by_pid(entry->info.pid, process_name, sizeof(process_name));
-            printf("[Mesh] Peer '%s' left/timed out: %d\n", process_name, entry->info.pid);
-            if (entry->comm_channel) cortez_leave(entry->comm_channel);
-            free(entry);
-            return;
+    cortez_peer_t* entry = find_peer_locked(mesh, pid);
+    if (!entry) return;
+    char process_name[64];
+    get_process_name_by_pid(entry->info.pid, process_name, sizeof(process_name));
+    printf("[Mesh] Peer '%s' left/timed out: %d\n", process_name, entry->info.pid);
+    drop_peer(mesh, entry);
+}
+
+// Refreshes the heartbeat of a known peer under the read lock. Returns 0 if
+// the peer is unknown.
+static int touch_peer(cortez_mesh_t* mesh, pid_t pid) {
+    pthread_rwlock_rdlock(&mesh->peer_lock);
+    cortez_peer_t* peer = find_peer_locked(mesh, pid);
+    if (peer) __atomic_store_n(&peer->last_heartbeat, now_mono_ns(), __ATOMIC_RELAXED);
+    pthread_rwlock_unlock(&mesh->peer_lock);
+    return peer != NULL;
+}
+
+static int peer_expired(const cortez_peer_t* peer, int64_t now_ns) {
+    return now_ns - __atomic_load_n(&peer->last_heartbeat, __ATOMIC_RELAXED) > (int64_t)PEER_TIMEOUT_SEC * 1000000000LL;
+}
+
+// Drops peers whose heartbeats stopped. They are looked for under the read
+// lock first, so the write lock is only taken when one is found.
+static void purge_expired_peers(cortez_mesh_t* mesh, int64_t now_ns) {
+    int found = 0;
+    pthread_rwlock_rdlock(&mesh->peer_lock);
+    for (size_t b = 0; b < PEER_BUCKETS && !found; b++) {
+        for (cortez_peer_t* peer = mesh->peers_by_pid[b]; peer; peer = peer->next_by_pid) {
+            if (peer_expired(peer, now_ns)) { found = 1; break; }
+        }
+    }
+    pthread_rwlock_unlock(&mesh->peer_lock);
+    if (!found) return;
+
+    pthread_rwlock_wrlock(&mesh->peer_lock);
+    for (size_t b = 0; b < PEER_BUCKETS; b++) {
+        cortez_peer_t* peer = mesh->peers_by_pid[b];
+        while (peer) {
+            cortez_peer_t* next = peer->next_by_pid;
+            if (peer_expired(peer, now_ns)) {
+                char process_name[64];
+                get_process_name_by_pid(peer->info.pid, process_name, sizeof(process_name));
+                printf("[Mesh] Peer '%s' timed out: %d\n", process_name, peer->info.pid);
+                drop_peer(mesh, peer);
+            }
+            peer = next;
         }
-        pptr = &(*pptr)->next;
     }
+    pthread_rwlock_unlock(&mesh->peer_lock);
 }
 
 static void* housekeeper_thread_main(void* arg) {
@@ -742,17 +1196,21 @@ static void* housekeeper_thread_main(void* arg) {
                 continue;
             }
 
-            pthread_mutex_lock(&mesh->peer_list_mutex);
             switch (cortez_msg_type(msg)) {
                 case MESH_MSG_REGISTER:
                 case MESH_MSG_HEARTBEAT:
-                    update_peer(mesh, peer_info);
+                    if (!touch_peer(mesh, peer_info->pid)) {
+                        pthread_rwlock_wrlock(&mesh->peer_lock);
+                        update_peer(mesh, peer_info);
+                        pthread_rwlock_unlock(&mesh->peer_lock);
+                    }
                     break;
                 case MESH_MSG_GOODBYE:
+                    pthread_rwlock_wrlock(&mesh->peer_lock);
                     remove_peer(mesh, peer_info->pid);
+                    pthread_rwlock_unlock(&mesh->peer_lock);
                     break;
             }
-            pthread_mutex_unlock(&mesh->peer_list_mutex);
             cortez_msg_release(mesh->registry_ch, msg);
         }
 
@@ -762,22 +1220,7 @@ static void* housekeeper_thread_main(void* arg) {
             last_heartbeat_sent_ns = now_ns;
         }
 
-        pthread_mutex_lock(&mesh->peer_list_mutex);
-        cortez_peer_t** pptr = &mesh->peer_list;
-        while(*pptr) {
-            cortez_peer_t* entry = *pptr;
-            if (now_ns - entry->last_heartbeat > (int64_t)PEER_TIMEOUT_SEC * 1000000000LL) {
-                 *pptr = entry->next;
-                 char process_name[64];
-                 get_process_name_by_pid(entry->info.pid, process_name, sizeof(process_name));
-                 printf("[Mesh] Peer '%s' timed out: %d\n", process_name, entry->info.pid);
-                 if (entry->comm_channel) cortez_leave(entry->comm_channel);
-                 free(entry);
-            } else {
-                pptr = &(*pptr)->next;
-            }
-        }
-        pthread_mutex_unlock(&mesh->peer_list_mutex);
+        purge_expired_peers(mesh, now_ns);
         
        usleep(100000);
     }
@@ -797,11 +1240,12 @@ cortez_mesh_t* cortez_mesh_init(const char* node_name, const cortez_options_t* o
     snprintf(mesh->self_info.inbox_channel_name, sizeof(mesh->self_info.inbox_channel_name),
              "%s-%d", node_name, mesh->self_info.pid);
              
-    pthread_mutex_init(&mesh->peer_list_mutex, NULL);
+    pthread_rwlock_init(&mesh->peer_lock, NULL);
     
     cortez_options_t inbox_opts = {.size=1024*1024, .create_policy=CORTEZ_CREATE_OR_JOIN};
     if (options) { 
         inbox_opts.size = options->size;
+        inbox_opts.read_spin_us = options->read_spin_us;
     }
 
     mesh->inbox_ch = cortez_join(mesh->self_info.inbox_channel_name, &inbox_opts);
@@ -816,7 +1260,7 @@ cortez_mesh_t* cortez_mesh_init(const char* node_name, const cortez_options_t* o
         if (cortez_channel_recover(mesh->inbox_ch) != CORTEZ_OK) {
             fprintf(stderr, "Failed to recover stale inbox channel.\n");
             cortez_leave(mesh->inbox_ch);
-            pthread_mutex_destroy(&mesh->peer_list_mutex);
+            pthread_rwlock_destroy(&mesh->peer_lock);
             free(mesh);
             return NULL;
         }
@@ -827,7 +1271,7 @@ cortez_mesh_t* cortez_mesh_init(const char* node_name, const cortez_options_t* o
     if (!mesh->registry_ch) {
         fprintf(stderr, "Failed to join registry channel\n");
         cortez_leave(mesh->inbox_ch);
-        pthread_mutex_destroy(&mesh->peer_list_mutex);
+        pthread_rwlock_destroy(&mesh->peer_lock);
         free(mesh);
         return NULL;
     }
@@ -838,7 +1282,7 @@ cortez_mesh_t* cortez_mesh_init(const char* node_name, const cortez_options_t* o
             fprintf(stderr, "Failed to recover stale registry channel.\n");
             cortez_leave(mesh->inbox_ch);
             cortez_leave(mesh->registry_ch);
-            pthread_mutex_destroy(&mesh->peer_list_mutex);
+            pthread_rwlock_destroy(&mesh->peer_lock);
             free(mesh);
             return NULL;
         }
@@ -857,7 +1301,7 @@ cortez_mesh_t* cortez_mesh_init(const char* node_name, const cortez_options_t* o
         mesh->housekeeper_running = 0;
         cortez_leave(mesh->inbox_ch);
         cortez_leave(mesh->registry_ch);
-        pthread_mutex_destroy(&mesh->peer_list_mutex);
+        pthread_rwlock_destroy(&mesh->peer_lock);
         free(mesh);
         return NULL;
     }
@@ -875,17 +1319,20 @@ int cortez_mesh_shutdown(cortez_mesh_t* mesh) {
     
     cortez_write(mesh->registry_ch, MESH_MSG_GOODBYE, &mesh->self_info, sizeof(mesh->self_info));
     
-    pthread_mutex_lock(&mesh->peer_list_mutex);
-    cortez_peer_t* peer = mesh->peer_list;
-    while(peer) {
-        cortez_peer_t* next = peer->next;
-        if(peer->comm_channel) cortez_leave(peer->comm_channel);
-        free(peer);
-        peer = next;
-    }
-    mesh->peer_list = NULL;
-    pthread_mutex_unlock(&mesh->peer_list_mutex);
-    pthread_mutex_destroy(&mesh->peer_list_mutex);
+    pthread_rwlock_wrlock(&mesh->peer_lock);
+    for (size_t b = 0; b < PEER_BUCKETS; b++) {
+        cortez_peer_t* peer = mesh->peers_by_pid[b];
+        while (peer) {
+            cortez_peer_t* next = peer->next_by_pid;
+            if (peer->comm_channel) cortez_leave(peer->comm_channel);
+            free(peer);
+            peer = next;
+        }
+        mesh->peers_by_pid[b] = NULL;
+        mesh->peers_by_name[b] = NULL;
+    }
+    pthread_rwlock_unlock(&mesh->peer_lock);
+    pthread_rwlock_destroy(&mesh->peer_lock);
     
     if(mesh->inbox_ch) cortez_leave(mesh->inbox_ch);
     if(mesh->registry_ch) cortez_leave(mesh->registry_ch);
@@ -894,37 +1341,70 @@ int cortez_mesh_shutdown(cortez_mesh_t* mesh) {
     return CORTEZ_OK;
 }
 
+// Returns a reference to the inbox of a peer, joining it on first use, or
+// NULL with *err set. Release it with cortez_leave().
+static cortez_ch_t* peer_channel_ref(cortez_mesh_t* mesh, pid_t target_pid, int* err) {
+    cortez_ch_t* peer_ch = NULL;
+    *err = CORTEZ_E_PEER_NOT_FOUND;
+
+    pthread_rwlock_rdlock(&mesh->peer_lock);
+    cortez_peer_t* peer = find_peer_locked(mesh, target_pid);
+    if (peer) {
+        cortez_ch_t* ch = __atomic_load_n(&peer->comm_channel, __ATOMIC_ACQUIRE);
+        if (!ch) { // Lazily connect; if another sender got there first, use its handle
+            cortez_options_t join_opts = {.create_policy = CORTEZ_JOIN_ONLY};
+            cortez_ch_t* joined = cortez_join(peer->info.inbox_channel_name, &join_opts);
+            if (joined) {
+                if (__atomic_compare_exchange_n(&peer->comm_channel, &ch, joined, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                    ch = joined;
+                } else {
+                    cortez_leave(joined);
+                }
+            } else {
+                *err = CORTEZ_E_CHAN_NOT_FOUND;
+            }
+        }
+        if (ch) {
+            // Get a safe reference to the channel before unlocking
+            peer_ch = cortez_channel_ref(ch);
+        }
+    }
+    pthread_rwlock_unlock(&mesh->peer_lock);
+    return peer_ch;
+}
+
 int cortez_mesh_send(cortez_mesh_t* mesh, pid_t target_pid, uint16_t msg_type, const void* payload, uint32_t payload_size) {
     if (!mesh || target_pid <= 0) {
         set_mesh_error(mesh, CORTEZ_E_INVALID_ARG);
         return CORTEZ_E_INVALID_ARG;
     }
+
+    int result;
+    cortez_ch_t* peer_ch = peer_channel_ref(mesh, target_pid, &result);
+    if (peer_ch) {
+        result = cortez_write(peer_ch, msg_type, payload, payload_size);
+        cortez_leave(peer_ch); // Release our reference
+    } else {
+        set_mesh_error(mesh, result);
+    }
     
-    cortez_ch_t* peer_ch = NULL;
-    int result = CORTEZ_E_PEER_NOT_FOUND;
-
-    pthread_mutex_lock(&mesh->peer_list_mutex);
-    for (cortez_peer_t* peer = mesh->peer_list; peer != NULL; peer = peer->next) {
-        if (peer->info.pid == target_pid) {
-            if (!peer->comm_channel) {
-                cortez_options_t join_opts = {.create_policy = CORTEZ_JOIN_ONLY};
-                peer->comm_channel = cortez_join(peer->info.inbox_channel_name, &join_opts);
-            }
-            if (peer->comm_channel) {
-                peer_ch = cortez_channel_ref(peer->comm_channel);
-            }
-            break;
-        }
+    return result;
+}
+
+int cortez_mesh_send_batch(cortez_mesh_t* mesh, pid_t target_pid, const cortez_batch_msg_t* msgs, size_t count) {
+    if (!mesh || target_pid <= 0) {
+        set_mesh_error(mesh, CORTEZ_E_INVALID_ARG);
+        return CORTEZ_E_INVALID_ARG;
     }
-    pthread_mutex_unlock(&mesh->peer_list_mutex);
 
+    int result;
+    cortez_ch_t* peer_ch = peer_channel_ref(mesh, target_pid, &result);
     if (peer_ch) {
-        result = cortez_write(peer_ch, msg_type, payload, payload_size);
+        result = cortez_write_batch(peer_ch, msgs, count);
         cortez_leave(peer_ch);
     } else {
         set_mesh_error(mesh, result);
     }
-    
     return result;
 }
 
@@ -937,16 +1417,15 @@ pid_t cortez_mesh_find_peer_by_name(cortez_mesh_t* mesh, const char* name) {
     pid_t found_pid = 0;
     size_t name_len = strlen(name);
 
-    pthread_mutex_lock(&mesh->peer_list_mutex);
-    for (cortez_peer_t* p = mesh->peer_list; p != NULL; p = p->next) {
-        // Match "name" against "name-12345"
-        if (strncmp(p->info.inbox_channel_name, name, name_len) == 0 &&
-            p->info.inbox_channel_name[name_len] == '-') {
+    // Peers register as "<name>-<pid>"; the newest one of that name wins
+    pthread_rwlock_rdlock(&mesh->peer_lock);
+    for (cortez_peer_t* p = mesh->peers_by_name[name_bucket(name, name_len)]; p != NULL; p = p->next_by_name) {
+        if (p->name_len == name_len && memcmp(p->info.inbox_channel_name, name, name_len) == 0) {
             found_pid = p->info.pid;
             break;
         }
     }
-    pthread_mutex_unlock(&mesh->peer_list_mutex);
+    pthread_rwlock_unlock(&mesh->peer_lock);
 
     if (found_pid) {
         return found_pid;
@@ -974,45 +1453,37 @@ pid_t cortez_mesh_find_peer_by_name(cortez_mesh_t* mesh, const char* name) {
 }
 
 
-cortez_write_handle_t* cortez_mesh_begin_send_zc(cortez_mesh_t* mesh, pid_t target_pid, uint32_t payload_size) {
-    if (!mesh || target_pid <= 0) {
+int cortez_mesh_begin_send_zc_into(cortez_mesh_t* mesh, pid_t target_pid, uint32_t payload_size,
+                                   cortez_write_handle_t* handle) {
+    if (!mesh || target_pid <= 0 || !handle) {
         set_mesh_error(mesh, CORTEZ_E_INVALID_ARG);
-        return NULL;
-    }
-
-    cortez_ch_t* peer_ch = NULL;
-    cortez_write_handle_t* handle = NULL;
-    int err = CORTEZ_E_PEER_NOT_FOUND;
-
-    pthread_mutex_lock(&mesh->peer_list_mutex);
-    for (cortez_peer_t* peer = mesh->peer_list; peer != NULL; peer = peer->next) {
-        if (peer->info.pid == target_pid) {
-            if (!peer->comm_channel) {
-                cortez_options_t join_opts = {.create_policy = CORTEZ_JOIN_ONLY};
-                peer->comm_channel = cortez_join(peer->info.inbox_channel_name, &join_opts);
-                if (!peer->comm_channel) {
-                    err = CORTEZ_E_CHAN_NOT_FOUND;
-                }
-            }
-             if (peer->comm_channel) {
-                peer_ch = cortez_channel_ref(peer->comm_channel);
-             }
-            break;
-        }
+        return CORTEZ_E_INVALID_ARG;
     }
-    pthread_mutex_unlock(&mesh->peer_list_mutex);
 
+    int err;
+    cortez_ch_t* peer_ch = peer_channel_ref(mesh, target_pid, &err);
     if (peer_ch) {
-        handle = cortez_begin_write_zc(peer_ch, payload_size);
-        if (!handle) {
-             err = cortez_get_last_error(peer_ch);
-             cortez_leave(peer_ch);
+        err = cortez_begin_write_zc_into(peer_ch, payload_size, handle);
+        if (err != CORTEZ_OK) {
+             cortez_leave(peer_ch); // Release ref on failure
         }
     }
     
-    if(!handle) {
-        set_mesh_error(mesh, err);
+    set_mesh_error(mesh, err);
+    return err;
+}
+
+cortez_write_handle_t* cortez_mesh_begin_send_zc(cortez_mesh_t* mesh, pid_t target_pid, uint32_t payload_size) {
+    cortez_write_handle_t* handle = malloc(sizeof(cortez_write_handle_t));
+    if (!handle) {
+        set_mesh_error(mesh, CORTEZ_E_NO_MEM);
+        return NULL;
+    }
+    if (cortez_mesh_begin_send_zc_into(mesh, target_pid, payload_size, handle) != CORTEZ_OK) {
+        free(handle);
+        return NULL;
     }
+    handle->heap = 1;
     return handle;
 }
 
@@ -1036,20 +1507,38 @@ cortez_msg_t* cortez_mesh_read(cortez_mesh_t* mesh, int timeout_ms) {
     return cortez_read(mesh->inbox_ch, timeout_ms);
 }
 
+int cortez_mesh_read_batch(cortez_mesh_t* mesh, cortez_msg_view_t* views, int max_views, int timeout_ms) {
+    if (!mesh) return CORTEZ_E_INVALID_ARG;
+    return cortez_read_batch(mesh->inbox_ch, views, max_views, timeout_ms);
+}
+
+int cortez_mesh_release_batch(cortez_mesh_t* mesh, const cortez_msg_view_t* views, int count) {
+    if (!mesh) return CORTEZ_E_INVALID_ARG;
+    return cortez_release_batch(mesh->inbox_ch, views, count);
+}
+
+int cortez_mesh_read_view(cortez_mesh_t* mesh, cortez_msg_view_t* view, int timeout_ms) {
+    if (!mesh) return CORTEZ_E_INVALID_ARG;
+    return cortez_read_view(mesh->inbox_ch, view, timeout_ms);
+}
+
 void cortez_mesh_list_peers(cortez_mesh_t* mesh) {
     if (!mesh) return;
-    pthread_mutex_lock(&mesh->peer_list_mutex);
+    pthread_rwlock_rdlock(&mesh->peer_lock);
     printf("--- Active Peers (My PID: %d) ---\n", mesh->self_info.pid);
-    if (!mesh->peer_list) {
-        printf("  (no other peers found)\n");
+    size_t listed = 0;
+    for (size_t b = 0; b < PEER_BUCKETS; b++) {
+        for (cortez_peer_t* p = mesh->peers_by_pid[b]; p != NULL; p = p->next_by_pid, listed++) {
+            char process_name[64];
+            get_process_name_by_pid(p->info.pid, process_name, sizeof(process_name));
+            printf("  - PID: %d, Name: %s, Inbox: %s\n", p->info.pid, process_name, p->info.inbox_channel_name);
+        }
     }
-    for (cortez_peer_t* p = mesh->peer_list; p != NULL; p = p->next) {
-        char process_name[64];
-        get_process_name_by_pid(p->info.pid, process_name, sizeof(process_name));
-        printf("  - PID: %d, Name: %s, Inbox: %s\n", p->info.pid, process_name, p->info.inbox_channel_name);
+    if (listed == 0) {
+        printf("  (no other peers found)\n");
     }
     printf("----------------------------------\n");
-    pthread_mutex_unlock(&mesh->peer_list_mutex);
+    pthread_rwlock_unlock(&mesh->peer_lock);
 }
 
 pid_t cortez_mesh_get_pid(cortez_mesh_t* mesh) {
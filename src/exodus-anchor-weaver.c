@@ -28,16 +28,21 @@
 #include <math.h>
 #include <stdint.h>
 #include <sys/mman.h>
+#include <pthread.h>
+#include <ctype.h>
 
 #include "cortez_ipc.h"
 #include "ctz-json.h"
+#include "exodus-journal.h"
+#include "exodus-diff.h"
+#include "exodus-index.h"
+#include "exodus-graph.h"
 
 // --- Forward Declarations ---
 static char* read_object(const char* hash, size_t* uncompressed_size);
 static int find_file_in_tree(const char* current_tree_hash, const char* path_to_find, 
                              char* blob_hash_out, mode_t* mode_out, 
                              double* entropy_out, char* type_out);
-static void free_lcs_matrix(int** matrix, int rows);
 
 
 #ifndef PATH_MAX
@@ -56,19 +61,14 @@ static void free_lcs_matrix(int** matrix, int rows);
 // The fixed block size (like rsync/git). 4KB is a good balance.
 #define DELTA_BLOCK_SIZE 4096 
 
-// A prime for the Adler-32 rolling hash
-#define ADLER_MOD 65521
-
-// The number of buckets in our hash map. A prime number is good.
-#define HASH_MAP_BUCKETS 16381
-
 #define IN_MEMORY_FILE_LIMIT (512 * 1024 * 1024)
 
 #define ZLIB_CHUNK_SIZE 16384
 
 #define DECONSTRUCT_THRESHOLD (5LL * 1024 * 1024 * 1024)
 
-// --- Structs for LINE-BASED DIFF (for 'diff' command) ---
+// --- Structs for LINE-BASED PATCHING (legacy DELTA-LCS objects) ---
+// The 'diff' command itself uses exodus-diff.
 
 // Represents one line in a text file
 typedef struct TextLine {
@@ -77,14 +77,6 @@ typedef struct TextLine {
     struct TextLine* next;
 } TextLine;
 
-// Represents a single diff operation
-typedef enum { DIFF_ADD, DIFF_DEL, DIFF_SAME } DiffOpType;
-typedef struct DiffOp {
-    DiffOpType type;
-    char* content;
-    struct DiffOp* next;
-} DiffOp;
-
 // --- Structs for BYTE-LEVEL DELTA (for Storage) ---
 
 /**
@@ -187,12 +179,12 @@ static ManifestData* read_mobj_object(const char* hash_hex);
 #define SIG0(x) (ROTRIGHT(x,7) ^ ROTRIGHT(x,18) ^ ((x) >> 3))
 #define SIG1(x) (ROTRIGHT(x,17) ^ ROTRIGHT(x,19) ^ ((x) >> 10))
 // --- NEW: SBDS Deconstruction (CDC) Defines ---
-#define CDC_WINDOW_SIZE 4096      // The rolling hash window size
-#define CDC_MIN_BLOCK   2048      // 2KB
+#define CDC_MIN_BLOCK   2048        // 2KB, no cut before this
+#define CDC_AVG_BLOCK   8192        // 8KB, where the strict mask hands over to the loose one
 #define CDC_MAX_BLOCK   (64 * 1024) // 64KB
-#define CDC_TARGET_BITS 13        // Avg block size = 2^13 = 8KB
-#define CDC_MASK        ((1 << CDC_TARGET_BITS) - 1)
-#define CDC_TARGET      CDC_MASK
+#define CDC_MASK_STRICT 0xFFFE000000000000ULL // Top 15 bits: cut chance 2^-15 below the average
+#define CDC_MASK_LOOSE  0xFFE0000000000000ULL // Top 11 bits: cut chance 2^-11 above it
+#define CDC_BATCH_BLOCKS 1024       // Blocks handed to a worker at once
 static const uint32_t k[64] = {
 	0x428a2f98,0x71374491,0xb5c0fbcf,0xe9b5dba5,0x3956c25b,0x59f111f1,0x923f82a4,0xab1c5ed5,
 	0xd807aa98,0x12835b01,0x243185be,0x550c7dc3,0x72be5d74,0x80deb1fe,0x9bdc06a7,0xc19bf174,
@@ -232,8 +224,15 @@ static void sha256_init(SHA256_CTX *ctx) {
 	ctx->state[7] = 0x5be0cd19;
 }
 static void sha256_update(SHA256_CTX *ctx, const uint8_t data[], size_t len) {
-	uint32_t i;
+	size_t i;
 	for (i=0; i < len; ++i) {
+		// Whole blocks are transformed in place instead of being copied
+		while (ctx->datalen == 0 && len - i >= 64) {
+			sha256_transform(ctx,data + i);
+			DBL_INT_ADD(ctx->bitlen,ctx->bitlen,512);
+			i += 64;
+		}
+		if (i == len) break;
 		ctx->data[ctx->datalen] = data[i];
 		ctx->datalen++;
 		if (ctx->datalen == 64) {
@@ -279,6 +278,83 @@ static void sha256_final(SHA256_CTX *ctx, uint8_t hash[]) {
 }
 // --- END SHA-256 ---
 
+// --- XXH64 (Embedded) ---
+// Strong hash for delta block matching only; object identity stays SHA-256.
+// Values never leave the process, so host byte order does not matter.
+
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+static inline uint64_t xxh_rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+static inline uint64_t xxh_read64(const uint8_t* p) { uint64_t v; memcpy(&v, p, 8); return v; }
+static inline uint32_t xxh_read32(const uint8_t* p) { uint32_t v; memcpy(&v, p, 4); return v; }
+
+static inline uint64_t xxh64_round(uint64_t acc, uint64_t input) {
+    acc += input * XXH_PRIME64_2;
+    acc = xxh_rotl64(acc, 31);
+    return acc * XXH_PRIME64_1;
+}
+
+static inline uint64_t xxh64_merge(uint64_t acc, uint64_t val) {
+    acc ^= xxh64_round(0, val);
+    return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+static uint64_t xxh64(const void* data, size_t len, uint64_t seed) {
+    const uint8_t* p = data;
+    const uint8_t* end = p + len;
+    uint64_t h;
+
+    if (len >= 32) {
+        const uint8_t* limit = end - 32;
+        uint64_t v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+        uint64_t v2 = seed + XXH_PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - XXH_PRIME64_1;
+        do {
+            v1 = xxh64_round(v1, xxh_read64(p)); p += 8;
+            v2 = xxh64_round(v2, xxh_read64(p)); p += 8;
+            v3 = xxh64_round(v3, xxh_read64(p)); p += 8;
+            v4 = xxh64_round(v4, xxh_read64(p)); p += 8;
+        } while (p <= limit);
+        h = xxh_rotl64(v1, 1) + xxh_rotl64(v2, 7) + xxh_rotl64(v3, 12) + xxh_rotl64(v4, 18);
+        h = xxh64_merge(h, v1);
+        h = xxh64_merge(h, v2);
+        h = xxh64_merge(h, v3);
+        h = xxh64_merge(h, v4);
+    } else {
+        h = seed + XXH_PRIME64_5;
+    }
+    h += (uint64_t)len;
+
+    while (p + 8 <= end) {
+        h ^= xxh64_round(0, xxh_read64(p));
+        h = xxh_rotl64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t)xxh_read32(p) * XXH_PRIME64_1;
+        h = xxh_rotl64(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p) * XXH_PRIME64_5;
+        h = xxh_rotl64(h, 11) * XXH_PRIME64_1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+// --- END XXH64 ---
+
 // For building tree objects in memory
 typedef struct TreeEntry {
     char name[NAME_MAX + 1];
@@ -305,6 +381,9 @@ static char g_bblk_objects_dir[PATH_MAX] = {0}; // NEW: For .bblk files
 static char g_mobj_objects_dir[PATH_MAX] = {0}; // NEW: For .mobj files
 static char g_unlink_root_path[PATH_MAX] = {0}; // <-- THIS WAS MISSING
 static IgnoreEntry* g_ignore_list_head = NULL;
+static exodus_index* g_commit_index = NULL;  // Stat cache of the node being committed
+static size_t g_index_reused = 0;
+static size_t g_index_hashed = 0;
 
 typedef struct DeltaOp {
     char op;            // 'C' (Copy) or 'I' (Insert)
@@ -331,9 +410,11 @@ static void free_delta_op_list(DeltaOp* head) {
 void log_msg(const char* format, ...) {
     va_list args;
     va_start(args, format);
+    flockfile(stderr); // Commit workers log too; keep lines whole
     fprintf(stderr, "[Snapshot] ");
     vfprintf(stderr, format, args);
     fprintf(stderr, "\n");
+    funlockfile(stderr);
     va_end(args);
 }
 
@@ -542,6 +623,183 @@ static void get_mobj_object_path(const char* hash_hex, char* path_buf) {
 
 // --- END SBDS Path Helpers ---
 
+// --- Packfiles ---
+// `exodus repack` moves loose objects into .log/objects/pack/pack-<id>.pack,
+// which stores each object's loose-file bytes unchanged, one after another.
+// The matching .idx is mmap'ed and searched in place:
+//
+//   PackIndexHeader                    magic, entry count, pack size
+//   uint32_t fanout[256]               entries whose first hash byte <= i
+//   PackIndexEntry[count]              sorted by (hash, kind)
+//
+// Readers look in the packs first and fall back to loose files, so objects
+// written after a repack are found as before.
+
+#define PACK_MAGIC "EXPACK01"
+#define PACK_INDEX_MAGIC "EXPIDX01"
+#define PACK_MAGIC_LEN 8
+
+typedef enum {
+    OBJ_KIND_LOOSE = 0,     // objects/ab/cdef...
+    OBJ_KIND_BBLK = 1,      // objects/b/ab/cdef....bblk
+    OBJ_KIND_MOBJ = 2       // objects/m/ab/cdef....mobj
+} ObjectKind;
+
+typedef struct PackIndexHeader {
+    char magic[PACK_MAGIC_LEN];
+    uint32_t count;
+    uint32_t reserved;
+    uint64_t pack_size;
+} PackIndexHeader;
+
+typedef struct PackIndexEntry {
+    uint8_t hash[SHA256_BLOCK_SIZE];
+    uint64_t offset;
+    uint64_t length;
+    uint8_t kind;
+    uint8_t reserved[7];
+} PackIndexEntry;
+
+_Static_assert(sizeof(PackIndexEntry) == 56, "PackIndexEntry must stay 56 bytes");
+
+typedef struct PackFile {
+    const uint8_t* idx_map;
+    size_t idx_size;
+    const uint8_t* pack_map;
+    size_t pack_size;
+    uint32_t count;
+    const uint32_t* fanout;
+    const PackIndexEntry* entries;
+    char idx_path[PATH_MAX];
+    char pack_path[PATH_MAX];
+    struct PackFile* next;
+} PackFile;
+
+static PackFile* g_packs = NULL;
+static pthread_once_t g_packs_once = PTHREAD_ONCE_INIT;
+
+static int hex_decode_hash(const char* hex, uint8_t* raw) {
+    for (int i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        int hi = hex[i * 2], lo = hex[i * 2 + 1];
+        hi = (hi >= '0' && hi <= '9') ? hi - '0' : (hi >= 'a' && hi <= 'f') ? hi - 'a' + 10 : -1;
+        lo = (lo >= '0' && lo <= '9') ? lo - '0' : (lo >= 'a' && lo <= 'f') ? lo - 'a' + 10 : -1;
+        if (hi < 0 || lo < 0) return -1;
+        raw[i] = (uint8_t)((hi << 4) | lo);
+    }
+    return 0;
+}
+
+static const uint8_t* map_whole_file(const char* path, size_t* size_out) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) { close(fd); return NULL; }
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+    *size_out = (size_t)st.st_size;
+    return map;
+}
+
+static void unmap_pack(PackFile* pack) {
+    if (pack->idx_map) munmap((void*)pack->idx_map, pack->idx_size);
+    if (pack->pack_map) munmap((void*)pack->pack_map, pack->pack_size);
+    free(pack);
+}
+
+static PackFile* open_pack(const char* idx_path) {
+    PackFile* pack = calloc(1, sizeof(PackFile));
+    if (!pack) return NULL;
+    snprintf(pack->idx_path, sizeof(pack->idx_path), "%s", idx_path);
+    snprintf(pack->pack_path, sizeof(pack->pack_path), "%.*s.pack", (int)(strlen(idx_path) - 4), idx_path);
+
+    pack->idx_map = map_whole_file(pack->idx_path, &pack->idx_size);
+    pack->pack_map = map_whole_file(pack->pack_path, &pack->pack_size);
+    if (!pack->idx_map || !pack->pack_map) { unmap_pack(pack); return NULL; }
+
+    PackIndexHeader hdr;
+    size_t table_offset = sizeof(hdr) + 256 * sizeof(uint32_t);
+    if (pack->idx_size < table_offset) { unmap_pack(pack); return NULL; }
+    memcpy(&hdr, pack->idx_map, sizeof(hdr));
+    if (memcmp(hdr.magic, PACK_INDEX_MAGIC, PACK_MAGIC_LEN) != 0 ||
+        hdr.pack_size != pack->pack_size ||
+        pack->idx_size != table_offset + (size_t)hdr.count * sizeof(PackIndexEntry) ||
+        memcmp(pack->pack_map, PACK_MAGIC, PACK_MAGIC_LEN) != 0) {
+        log_msg("Ignoring corrupt pack index %s", idx_path);
+        unmap_pack(pack);
+        return NULL;
+    }
+    pack->count = hdr.count;
+    pack->fanout = (const uint32_t*)(pack->idx_map + sizeof(hdr));
+    pack->entries = (const PackIndexEntry*)(pack->idx_map + table_offset);
+    return pack;
+}
+
+static void load_packs(void) {
+    char pack_dir[PATH_MAX];
+    if (snprintf(pack_dir, sizeof(pack_dir), "%s/pack", g_objects_dir) >= (int)sizeof(pack_dir)) return;
+    DIR* dir = opendir(pack_dir);
+    if (!dir) return;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        if (len < 5 || strncmp(entry->d_name, "pack-", 5) != 0 || strcmp(entry->d_name + len - 4, ".idx") != 0) continue;
+        char idx_path[PATH_MAX];
+        if (snprintf(idx_path, sizeof(idx_path), "%s/%s", pack_dir, entry->d_name) >= (int)sizeof(idx_path)) continue;
+        PackFile* pack = open_pack(idx_path);
+        if (!pack) continue;
+        pack->next = g_packs;
+        g_packs = pack;
+    }
+    closedir(dir);
+}
+
+static int pack_entry_cmp(const uint8_t* hash, uint8_t kind, const PackIndexEntry* e) {
+    int c = memcmp(hash, e->hash, SHA256_BLOCK_SIZE);
+    if (c) return c;
+    return (int)kind - (int)e->kind;
+}
+
+// Finds an object in the packs. The returned bytes stay mapped for the process lifetime.
+static const uint8_t* pack_find(ObjectKind kind, const char* hash_hex, size_t* len_out) {
+    pthread_once(&g_packs_once, load_packs);
+    if (!g_packs) return NULL;
+    uint8_t raw[SHA256_BLOCK_SIZE];
+    if (strlen(hash_hex) < HASH_LEN || hex_decode_hash(hash_hex, raw) != 0) return NULL;
+
+    for (PackFile* pack = g_packs; pack; pack = pack->next) {
+        uint32_t lo = raw[0] ? pack->fanout[raw[0] - 1] : 0;
+        uint32_t hi = pack->fanout[raw[0]];
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            int c = pack_entry_cmp(raw, (uint8_t)kind, &pack->entries[mid]);
+            if (c == 0) {
+                const PackIndexEntry* e = &pack->entries[mid];
+                if (e->offset + e->length > pack->pack_size) return NULL;
+                *len_out = e->length;
+                return pack->pack_map + e->offset;
+            }
+            if (c < 0) hi = mid; else lo = mid + 1;
+        }
+    }
+    return NULL;
+}
+
+// Opens an object for reading, from a pack or from its loose file.
+static FILE* open_object_file(ObjectKind kind, const char* hash_hex, const char* obj_path) {
+    size_t len;
+    const uint8_t* data = pack_find(kind, hash_hex, &len);
+    if (data) return fmemopen((void*)data, len, "rb");
+    return fopen(obj_path, "rb");
+}
+
+static int object_exists(ObjectKind kind, const char* hash_hex, const char* obj_path) {
+    size_t len;
+    if (pack_find(kind, hash_hex, &len)) return 1;
+    struct stat st;
+    return stat(obj_path, &st) == 0;
+}
+
 static double calculate_entropy(const char* content, size_t size) {
     if (size == 0) return 0.0;
     long counts[256] = {0};
@@ -675,18 +933,23 @@ static double calculate_entropy_stream(const char* fpath, size_t size) {
 static int write_blob_object_stream(const char* hash, const char* fpath) {
     char obj_path[PATH_MAX];
     get_object_path(hash, obj_path);
-    struct stat st;
-    if (stat(obj_path, &st) == 0) return 0; // Already exists
+    if (object_exists(OBJ_KIND_LOOSE, hash, obj_path)) return 0; // Already exists
 
     char obj_dir[PATH_MAX];
     strncpy(obj_dir, obj_path, sizeof(obj_dir));
     *strrchr(obj_dir, '/') = '\0';
     if (mkdir(obj_dir, 0755) != 0 && errno != EEXIST) return -1;
 
+    // Stream into a per-thread temp file and rename it into place, so parallel
+    // writers of the same object never interleave and a crash never leaves a
+    // truncated object behind.
+    char tmp_path[PATH_MAX + 32];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%lx.tmp", obj_path, (unsigned long)pthread_self());
+
     FILE* fin = fopen(fpath, "rb");
     if (!fin) return -1;
     
-    FILE* fout = fopen(obj_path, "wb");
+    FILE* fout = fopen(tmp_path, "wb");
     if (!fout) { fclose(fin); return -1; }
 
     int ret, flush;
@@ -699,7 +962,7 @@ static int write_blob_object_stream(const char* hash, const char* fpath) {
     strm.zfree = Z_NULL;
     strm.opaque = Z_NULL;
     ret = deflateInit(&strm, Z_DEFAULT_COMPRESSION);
-    if (ret != Z_OK) { fclose(fin); fclose(fout); return ret; }
+    if (ret != Z_OK) goto fail;
 
     // 1. Compress and write header first
     const char* header = "BLOB\0";
@@ -712,10 +975,10 @@ static int write_blob_object_stream(const char* hash, const char* fpath) {
         strm.avail_out = ZLIB_CHUNK_SIZE;
         strm.next_out = out;
         ret = deflate(&strm, Z_NO_FLUSH); // Process header
-        if (ret == Z_STREAM_ERROR) { (void)deflateEnd(&strm); fclose(fin); fclose(fout); return ret; }
+        if (ret == Z_STREAM_ERROR) { (void)deflateEnd(&strm); goto fail; }
         have = ZLIB_CHUNK_SIZE - strm.avail_out;
         if (fwrite(out, 1, have, fout) != have || ferror(fout)) {
-            (void)deflateEnd(&strm); fclose(fin); fclose(fout); return Z_ERRNO;
+            (void)deflateEnd(&strm); ret = Z_ERRNO; goto fail;
         }
     } while (strm.avail_out == 0);
     
@@ -723,7 +986,7 @@ static int write_blob_object_stream(const char* hash, const char* fpath) {
     do {
         strm.avail_in = fread(in, 1, ZLIB_CHUNK_SIZE, fin);
         if (ferror(fin)) {
-            (void)deflateEnd(&strm); fclose(fin); fclose(fout); return Z_ERRNO;
+            (void)deflateEnd(&strm); ret = Z_ERRNO; goto fail;
         }
         flush = feof(fin) ? Z_FINISH : Z_NO_FLUSH;
         strm.next_in = in;
@@ -732,10 +995,10 @@ static int write_blob_object_stream(const char* hash, const char* fpath) {
             strm.avail_out = ZLIB_CHUNK_SIZE;
             strm.next_out = out;
             ret = deflate(&strm, flush);
-            if (ret == Z_STREAM_ERROR) { (void)deflateEnd(&strm); fclose(fin); fclose(fout); return ret; }
+            if (ret == Z_STREAM_ERROR) { (void)deflateEnd(&strm); goto fail; }
             have = ZLIB_CHUNK_SIZE - strm.avail_out;
             if (fwrite(out, 1, have, fout) != have || ferror(fout)) {
-                (void)deflateEnd(&strm); fclose(fin); fclose(fout); return Z_ERRNO;
+                (void)deflateEnd(&strm); ret = Z_ERRNO; goto fail;
             }
         } while (strm.avail_out == 0);
 
@@ -743,8 +1006,17 @@ static int write_blob_object_stream(const char* hash, const char* fpath) {
 
     (void)deflateEnd(&strm);
     fclose(fin);
-    fclose(fout);
+    if (fclose(fout) != 0 || rename(tmp_path, obj_path) != 0) {
+        unlink(tmp_path);
+        return Z_ERRNO;
+    }
     return Z_OK;
+
+fail:
+    fclose(fin);
+    fclose(fout);
+    unlink(tmp_path);
+    return ret;
 }
 
 // --- NEW: Anchor-Weave Path Helpers ---
@@ -801,15 +1073,7 @@ static void free_tree_list(TreeEntry* head) {
     }
 }
 
-static void free_lcs_matrix(int** matrix, int rows) {
-    if (!matrix) return;
-    for (int i = 0; i < rows; i++) {
-        free(matrix[i]);
-    }
-    free(matrix);
-}
-
-// --- ENGINE 1: Line-Based Diff (for 'diff' command) ---
+// --- ENGINE 1: Line-Based Patching (legacy DELTA-LCS objects) ---
 
 static void free_lines(TextLine* head) {
     while (head) {
@@ -820,15 +1084,6 @@ static void free_lines(TextLine* head) {
     }
 }
 
-static void free_diff_ops(DiffOp* head) {
-    while (head) {
-        DiffOp* next = head->next;
-        free(head->content);
-        free(head);
-        head = next;
-    }
-}
-
 // Splits a file's content into a linked list of lines
 static TextLine* split_content_to_lines(const char* content, size_t size, int* line_count_out) {
     *line_count_out = 0;
@@ -858,65 +1113,6 @@ static TextLine* split_content_to_lines(const char* content, size_t size, int* l
     return head;
 }
 
-// Generates a diff op list from two line lists (LCS)
-static DiffOp* generate_diff(TextLine* lines1, int count1, TextLine* lines2, int count2) {
-    TextLine** arr1 = malloc(count1 * sizeof(TextLine*));
-    TextLine** arr2 = malloc(count2 * sizeof(TextLine*));
-    if (!arr1 || !arr2) { if (arr1) free(arr1); if (arr2) free(arr2); return NULL; }
-    TextLine* l = lines1;
-    for (int i = 0; i < count1; i++) { arr1[i] = l; l = l->next; }
-    l = lines2;
-    for (int i = 0; i < count2; i++) { arr2[i] = l; l = l->next; }
-
-    int** lcs = malloc((count1 + 1) * sizeof(int*));
-    if (!lcs) { free(arr1); free(arr2); return NULL; }
-    for (int i = 0; i <= count1; i++) {
-        lcs[i] = calloc((count2 + 1), sizeof(int));
-        if (!lcs[i]) { free_lcs_matrix(lcs, i); free(arr1); free(arr2); return NULL; }
-    }
-
-    for (int i = 1; i <= count1; i++) {
-        for (int j = 1; j <= count2; j++) {
-            if (arr1[i - 1]->len == arr2[j - 1]->len && 
-                strcmp(arr1[i - 1]->line, arr2[j - 1]->line) == 0) {
-                lcs[i][j] = lcs[i - 1][j - 1] + 1;
-            } else {
-                lcs[i][j] = (lcs[i - 1][j] > lcs[i][j - 1]) ? lcs[i - 1][j] : lcs[i][j - 1];
-            }
-        }
-    }
-
-    DiffOp* head = NULL;
-    int i = count1, j = count2;
-    while (i > 0 || j > 0) {
-        DiffOp* op = malloc(sizeof(DiffOp));
-        if (!op) { free_diff_ops(head); break; }
-        if (i > 0 && j > 0 && arr1[i-1]->len == arr2[j-1]->len &&
-            strcmp(arr1[i-1]->line, arr2[j-1]->line) == 0) {
-            op->type = DIFF_SAME;
-            op->content = strdup(arr1[i - 1]->line);
-            i--; j--;
-        } else if (j > 0 && (i == 0 || lcs[i][j - 1] >= lcs[i - 1][j])) {
-            op->type = DIFF_ADD;
-            op->content = strdup(arr2[j - 1]->line);
-            j--;
-        } else if (i > 0 && (j == 0 || lcs[i][j - 1] < lcs[i - 1][j])) {
-            op->type = DIFF_DEL;
-            op->content = strdup(arr1[i - 1]->line);
-            i--;
-        }
-        if (!op->content) { free(op); break; } // strdup failed
-        op->next = head;
-        head = op;
-    }
-
-    free_lcs_matrix(lcs, count1 + 1);
-    free(arr1);
-    free(arr2);
-    return head;
-}
-
-
 static TextLine* patch_lines(TextLine* base_head, const char* script, size_t script_size) {
     TextLine* new_head = NULL;
     TextLine* new_tail = NULL;
@@ -1055,39 +1251,6 @@ static int append_delta_insert(DeltaScript* script, const char* data, size_t len
     return 0;
 }
 
-static uint32_t adler32_checksum(const char* data, size_t len) {
-    uint32_t a = 1, b = 0;
-    for (size_t i = 0; i < len; i++) {
-        a = (a + (uint8_t)data[i]) % ADLER_MOD;
-        b = (b + a) % ADLER_MOD;
-    }
-    return (b << 16) | a;
-}
-
-/**
- * @brief Efficiently updates a rolling Adler-32 checksum.
- *
- * @param sum      The previous checksum.
- * @param out_byte The byte leaving the window.
- * @param in_byte  The byte entering the window.
- * @param len      The window length (BLOCK_SIZE).
- * @return The new checksum for the updated window.
- */
-static uint32_t adler32_roll(uint32_t sum, uint8_t out_byte, uint8_t in_byte, size_t len) {
-    uint32_t a = sum & 0xFFFF;
-    uint32_t b = sum >> 16;
-    
-    // Remove the 'out' byte
-    a = (a - out_byte + ADLER_MOD) % ADLER_MOD;
-    b = (b - (len * out_byte) + ADLER_MOD * (len + 1)) % ADLER_MOD;
-    
-    // Add the 'in' byte
-    a = (a + in_byte) % ADLER_MOD;
-    b = (b + a) % ADLER_MOD;
-
-    return (b << 16) | a;
-}
-
 /**
  * @brief Helper to get the raw 32-byte SHA-256 for a buffer.
  * (We use this for strong comparison, not the hex string).
@@ -1099,172 +1262,314 @@ static void sha256_buffer(const uint8_t* data, size_t len, uint8_t hash_out[SHA2
     sha256_final(&ctx, hash_out);
 }
 
-// --- Simple Hash Map for Signatures ---
+// --- Block signatures ---
+// Every DELTA_BLOCK_SIZE block of the base is indexed by its rolling weak
+// checksum and its XXH64. The scan rolls the weak checksum over the new file
+// one byte at a time; a bitmap keyed by the weak checksum rejects almost
+// every offset before the table is probed, and the strong hash is computed
+// only when a block with the same weak checksum exists.
+
+#define DELTA_INSERT_MAX (64 * 1024)            // Longest INSERT the scan holds back
+#define DELTA_STREAM_WINDOW (4 * 1024 * 1024)   // Read buffer for streamed inputs
+#define DELTA_SPILL_BYTES (1024 * 1024)         // Script bytes kept before compressing them
 
 typedef struct BlockSignature {
-    uint8_t strong_hash[SHA256_BLOCK_SIZE];
-    size_t offset;
-    struct BlockSignature* next; // For hash collisions
+    uint64_t strong;
+    uint64_t offset;
+    uint32_t weak;
+    uint32_t used;
 } BlockSignature;
 
 typedef struct SignatureMap {
-    BlockSignature* buckets[HASH_MAP_BUCKETS];
+    BlockSignature* slots;      // Open addressing, linear probing
+    size_t mask;
+    size_t count;
+    uint64_t* filter;           // One bit per (mixed) weak checksum value
+    size_t filter_mask;
 } SignatureMap;
 
-static SignatureMap* map_create() {
-    SignatureMap* map = calloc(1, sizeof(SignatureMap));
-    return map;
+// rsync's rolling checksum: s1 is the byte sum, s2 the sum of the running
+// s1 values, both mod 2^16. Unlike Adler-32 it rolls without a modulus.
+static uint32_t weak_checksum(const uint8_t* data, size_t len) {
+    uint32_t s1 = 0, s2 = 0;
+    for (size_t i = 0; i < len; i++) {
+        s1 += data[i];
+        s2 += s1;
+    }
+    return ((s2 & 0xFFFF) << 16) | (s1 & 0xFFFF);
 }
 
-static void map_insert(SignatureMap* map, uint32_t weak_hash, const uint8_t* strong_hash, size_t offset) {
-    uint32_t bucket_index = weak_hash % HASH_MAP_BUCKETS;
+static inline uint32_t weak_roll(uint32_t sum, uint8_t out_byte, uint8_t in_byte, size_t len) {
+    uint32_t s1 = (sum & 0xFFFF) - out_byte + in_byte;
+    uint32_t s2 = (sum >> 16) - (uint32_t)(len * out_byte) + s1;
+    return ((s2 & 0xFFFF) << 16) | (s1 & 0xFFFF);
+}
 
-    // Create new signature entry
-    BlockSignature* sig = malloc(sizeof(BlockSignature));
-    if (!sig) return;
-    memcpy(sig->strong_hash, strong_hash, SHA256_BLOCK_SIZE);
-    sig->offset = offset;
-    
-    // Add to the front of the linked list for this bucket
-    sig->next = map->buckets[bucket_index];
-    map->buckets[bucket_index] = sig;
+static inline uint32_t weak_mix(uint32_t weak) {
+    weak ^= weak >> 16;
+    weak *= 0x85EBCA6Bu;
+    weak ^= weak >> 13;
+    weak *= 0xC2B2AE35u;
+    weak ^= weak >> 16;
+    return weak;
 }
 
-static long map_find(SignatureMap* map, uint32_t weak_hash, const uint8_t* strong_hash) {
-    uint32_t bucket_index = weak_hash % HASH_MAP_BUCKETS;
-    
-    // Iterate through the linked list for this bucket
-    for (BlockSignature* sig = map->buckets[bucket_index]; sig; sig = sig->next) {
-        // Strong hash check (memcmp is 0 on match)
-        if (memcmp(sig->strong_hash, strong_hash, SHA256_BLOCK_SIZE) == 0) {
-            return (long)sig->offset; // Found!
-        }
+static int map_init(SignatureMap* map, size_t expected_blocks) {
+    size_t slots = 1024;
+    while (slots < expected_blocks * 2) slots <<= 1;
+    map->slots = calloc(slots, sizeof(BlockSignature));
+    map->filter = calloc(slots / 8, sizeof(uint64_t));   // 8 filter bits per slot
+    if (!map->slots || !map->filter) {
+        free(map->slots);
+        free(map->filter);
+        return -1;
     }
-    return -1; // Not found
+    map->mask = slots - 1;
+    map->count = 0;
+    map->filter_mask = slots * 8 - 1;
+    return 0;
 }
 
 static void map_free(SignatureMap* map) {
-    if (!map) return;
-    for (int i = 0; i < HASH_MAP_BUCKETS; i++) {
-        BlockSignature* sig = map->buckets[i];
-        while (sig) {
-            BlockSignature* next = sig->next;
-            free(sig);
-            sig = next;
+    free(map->slots);
+    free(map->filter);
+    *map = (SignatureMap){0};
+}
+
+static void map_place(SignatureMap* map, const BlockSignature* sig) {
+    uint32_t mixed = weak_mix(sig->weak);
+    size_t i = mixed & map->mask;
+    while (map->slots[i].used) i = (i + 1) & map->mask;
+    map->slots[i] = *sig;
+    map->filter[(mixed & map->filter_mask) >> 6] |= 1ULL << (mixed & 63);
+    map->count++;
+}
+
+static int map_insert(SignatureMap* map, uint32_t weak, uint64_t strong, uint64_t offset) {
+    uint32_t mixed = weak_mix(weak);
+    for (size_t i = mixed & map->mask; map->slots[i].used; i = (i + 1) & map->mask) {
+        if (map->slots[i].weak == weak && map->slots[i].strong == strong) return 0; // Keep the first copy
+    }
+
+    if ((map->count + 1) * 2 > map->mask + 1) {
+        SignatureMap grown;
+        if (map_init(&grown, (map->mask + 1)) != 0) return -1;
+        for (size_t i = 0; i <= map->mask; i++) {
+            if (map->slots[i].used) map_place(&grown, &map->slots[i]);
+        }
+        map_free(map);
+        *map = grown;
+    }
+
+    BlockSignature sig = { .strong = strong, .offset = offset, .weak = weak, .used = 1 };
+    map_place(map, &sig);
+    return 0;
+}
+
+/**
+ * @brief Looks up the block at window. Returns its base offset, or -1.
+ */
+static long map_find(const SignatureMap* map, uint32_t weak, const uint8_t* window) {
+    uint32_t mixed = weak_mix(weak);
+    if (!(map->filter[(mixed & map->filter_mask) >> 6] & (1ULL << (mixed & 63)))) return -1;
+
+    int have_strong = 0;
+    uint64_t strong = 0;
+    for (size_t i = mixed & map->mask; map->slots[i].used; i = (i + 1) & map->mask) {
+        if (map->slots[i].weak != weak) continue;
+        if (!have_strong) {
+            strong = xxh64(window, DELTA_BLOCK_SIZE, 0);
+            have_strong = 1;
+        }
+        if (map->slots[i].strong == strong) return (long)map->slots[i].offset;
+    }
+    return -1;
+}
+
+static int map_add_block(SignatureMap* map, const uint8_t* block, uint64_t offset) {
+    return map_insert(map, weak_checksum(block, DELTA_BLOCK_SIZE), xxh64(block, DELTA_BLOCK_SIZE, 0), offset);
+}
+
+// --- Delta scan ---
+
+/**
+ * @brief The new file, either fully in memory or read through a window.
+ */
+typedef struct DeltaInput {
+    FILE* file;             // NULL when data holds the whole input
+    const uint8_t* data;    // Input bytes [start, start + len)
+    uint8_t* buf;           // Window buffer (streaming only)
+    size_t start;
+    size_t len;
+    size_t total;
+} DeltaInput;
+
+// Makes input bytes [from, to) addressable. from never moves backwards.
+static int delta_input_ensure(DeltaInput* in, size_t from, size_t to) {
+    if (to <= in->start + in->len) return 0;
+    if (!in->file) return -1;
+
+    size_t drop = from - in->start;
+    memmove(in->buf, in->buf + drop, in->len - drop);
+    in->start = from;
+    in->len -= drop;
+    while (in->start + in->len < to) {
+        size_t n = fread(in->buf + in->len, 1, DELTA_STREAM_WINDOW - in->len, in->file);
+        if (n == 0) return -1; // File shrank under us
+        in->len += n;
+    }
+    return 0;
+}
+
+static inline const uint8_t* delta_input_at(const DeltaInput* in, size_t pos) {
+    return in->data + (pos - in->start);
+}
+
+/**
+ * @brief Destination of a streamed delta script: compressed straight into
+ * the object file instead of being held in memory.
+ */
+typedef struct DeltaSpill {
+    z_stream strm;
+    FILE* out;
+    size_t flushed;         // Script bytes already compressed
+} DeltaSpill;
+
+static int delta_spill_write(DeltaSpill* spill, const void* data, size_t len, int flush) {
+    unsigned char out[ZLIB_CHUNK_SIZE];
+    spill->strm.next_in = (Bytef*)data;
+    spill->strm.avail_in = (uInt)len;
+    do {
+        spill->strm.avail_out = ZLIB_CHUNK_SIZE;
+        spill->strm.next_out = out;
+        if (deflate(&spill->strm, flush) == Z_STREAM_ERROR) return -1;
+        size_t have = ZLIB_CHUNK_SIZE - spill->strm.avail_out;
+        if (fwrite(out, 1, have, spill->out) != have) return -1;
+    } while (spill->strm.avail_out == 0);
+    return 0;
+}
+
+// Returns 1 once the script passed limit, -1 on error.
+static int delta_script_check(DeltaScript* script, DeltaSpill* spill, size_t limit) {
+    size_t emitted = script->size + (spill ? spill->flushed : 0);
+    if (emitted > limit) return 1;
+    if (spill && script->size >= DELTA_SPILL_BYTES) {
+        if (delta_spill_write(spill, script->buffer, script->size, Z_NO_FLUSH) != 0) return -1;
+        spill->flushed += script->size;
+        script->size = 0;
+    }
+    return 0;
+}
+
+/**
+ * @brief Scans the new input against the base's signatures.
+ *
+ * Adjacent block copies are merged into one COPY. When old_content is
+ * known, a strong-hash match is confirmed byte for byte as well.
+ * Returns 0 on success, 1 when the script would exceed limit, -1 on error.
+ */
+static int delta_scan(const SignatureMap* map, const char* old_content, DeltaInput* in,
+                      DeltaScript* script, DeltaSpill* spill, size_t limit)
+{
+    size_t i = 0;                   // Window start
+    size_t literal = 0;             // First byte not yet covered by an op
+    size_t copy_offset = 0, copy_len = 0;
+    uint32_t weak = 0;
+    int reseed = 1;
+    int rc;
+
+    while (i + DELTA_BLOCK_SIZE <= in->total) {
+        if (delta_input_ensure(in, literal, i + DELTA_BLOCK_SIZE) != 0) return -1;
+        const uint8_t* window = delta_input_at(in, i);
+
+        if (reseed) {
+            weak = weak_checksum(window, DELTA_BLOCK_SIZE);
+            reseed = 0;
+        } else {
+            weak = weak_roll(weak, window[-1], window[DELTA_BLOCK_SIZE - 1], DELTA_BLOCK_SIZE);
+        }
+
+        long match = map_find(map, weak, window);
+        if (match >= 0 && old_content && memcmp(old_content + match, window, DELTA_BLOCK_SIZE) != 0) {
+            match = -1;
+        }
+
+        if (match < 0) {
+            i++;
+            if (i - literal < DELTA_INSERT_MAX) continue;
+            // Long unmatched run: emit it now so the window can move on.
+            if (append_delta_copy(script, copy_offset, copy_len) != 0) return -1;
+            copy_len = 0;
+            if (append_delta_insert(script, (const char*)delta_input_at(in, literal), i - literal) != 0) return -1;
+            literal = i;
+            reseed = 1;
+        } else {
+            if (i > literal) {
+                if (append_delta_copy(script, copy_offset, copy_len) != 0) return -1;
+                copy_len = 0;
+                if (append_delta_insert(script, (const char*)delta_input_at(in, literal), i - literal) != 0) return -1;
+            }
+            if (copy_len > 0 && copy_offset + copy_len == (size_t)match) {
+                copy_len += DELTA_BLOCK_SIZE;
+            } else {
+                if (append_delta_copy(script, copy_offset, copy_len) != 0) return -1;
+                copy_offset = (size_t)match;
+                copy_len = DELTA_BLOCK_SIZE;
+            }
+            i += DELTA_BLOCK_SIZE;
+            literal = i;
+            reseed = 1;
         }
+        if ((rc = delta_script_check(script, spill, limit)) != 0) return rc;
     }
-    free(map);
+
+    // Tail shorter than a block
+    if (delta_input_ensure(in, literal, in->total) != 0) return -1;
+    if (append_delta_copy(script, copy_offset, copy_len) != 0) return -1;
+    if (append_delta_insert(script, (const char*)delta_input_at(in, literal), in->total - literal) != 0) return -1;
+    return delta_script_check(script, spill, limit);
 }
 
+/**
+ * @brief Builds a delta script turning old_content into new_content.
+ * Returns 0 on success, 1 when the script would exceed limit bytes
+ * (not worth storing), -1 on error.
+ */
 static int generate_byte_delta_script(
     const char* old_content, size_t old_size,
     const char* new_content, size_t new_size,
-    DeltaScript* script_out) 
+    size_t limit, DeltaScript* script_out) 
 {
     // --- 0. Handle edge cases ---
     if (old_size == 0 || new_size == 0) {
         return -1; // Cannot delta, fallback to BLOB
     }
 
-    // --- 1. SIGNATURE phase: Build hash map from old_content ---
+    // --- 1. SIGNATURE phase: index the base's blocks ---
     log_msg("  > Building signature map for base file (%.1fMB)", (double)old_size / (1024.0*1024.0));
-    SignatureMap* map = map_create();
-    if (!map) return -1;
-    
+    SignatureMap map;
+    if (map_init(&map, old_size / DELTA_BLOCK_SIZE) != 0) return -1;
     for (size_t offset = 0; (offset + DELTA_BLOCK_SIZE) <= old_size; offset += DELTA_BLOCK_SIZE) {
-        const char* block = old_content + offset;
-        
-        // Calculate weak (Adler-32) and strong (SHA-256) hashes
-        uint32_t weak_hash = adler32_checksum(block, DELTA_BLOCK_SIZE);
-        uint8_t strong_hash[SHA256_BLOCK_SIZE];
-        sha256_buffer((const uint8_t*)block, DELTA_BLOCK_SIZE, strong_hash);
-
-        // Store in map
-        map_insert(map, weak_hash, strong_hash, offset);
+        if (map_add_block(&map, (const uint8_t*)old_content + offset, offset) != 0) { map_free(&map); return -1; }
     }
 
-    // --- 2. DELTA phase: Scan new_content with rolling hash ---
+    // --- 2. DELTA phase: scan new_content with the rolling checksum ---
     log_msg("  > Scanning new file (%.1fMB) for deltas...", (double)new_size / (1024.0*1024.0));
-    
     free(script_out->buffer); // Clear any old data
     *script_out = (DeltaScript){0}; // Re-init
 
-    size_t i = 0; // Current position in new_content
-    size_t last_match_end = 0; // End of the last match
-    uint32_t rolling_hash = 0;
-
-    while (i + DELTA_BLOCK_SIZE <= new_size) {
-        
-        const char* window = new_content + i;
-        
-        // --- Calculate weak hash (either full or rolled) ---
-        if (i == 0) {
-            rolling_hash = adler32_checksum(window, DELTA_BLOCK_SIZE);
-        } else {
-            rolling_hash = adler32_roll(
-                rolling_hash, 
-                (uint8_t)new_content[i - 1], 
-                (uint8_t)new_content[i + DELTA_BLOCK_SIZE - 1],
-                DELTA_BLOCK_SIZE
-            );
-        }
-
-        // --- Check for a match in the map ---
-        long match_offset = -1;
-        if (map) {
-            // Calculate strong hash *only* if we have a weak hit
-            uint8_t strong_hash[SHA256_BLOCK_SIZE];
-            sha256_buffer((const uint8_t*)window, DELTA_BLOCK_SIZE, strong_hash);
-            
-            // This does the weak-hash-bucket-lookup + strong-hash-compare
-            match_offset = map_find(map, rolling_hash, strong_hash);
-        }
-
-        if (match_offset != -1) {
-            // --- MATCH FOUND ---
-            
-            // 1. Emit an INSERT for any pending data before this match
-            size_t insert_len = i - last_match_end;
-            if (insert_len > 0) {
-                if (append_delta_insert(script_out, new_content + last_match_end, insert_len) != 0) {
-                    goto error_cleanup;
-                }
-            }
-
-            // 2. Emit a COPY op for this block
-            if (append_delta_copy(script_out, (size_t)match_offset, DELTA_BLOCK_SIZE) != 0) {
-                goto error_cleanup;
-            }
-
-            // 3. Jump our pointers forward
-            i += DELTA_BLOCK_SIZE;
-            last_match_end = i;
-
-        } else {
-            // --- NO MATCH ---
-            // Just advance the window by one byte
-            i++;
-        }
-    }
+    DeltaInput in = { .data = (const uint8_t*)new_content, .len = new_size, .total = new_size };
+    int rc = delta_scan(&map, old_content, &in, script_out, NULL, limit);
+    map_free(&map);
 
-    // --- 3. CLEANUP phase: Insert any remaining data ---
-    size_t remaining_len = new_size - last_match_end;
-    if (remaining_len > 0) {
-        if (append_delta_insert(script_out, new_content + last_match_end, remaining_len) != 0) {
-            goto error_cleanup;
-        }
+    if (rc != 0) {
+        if (rc < 0) log_msg("  > Error generating delta script. Aborting.");
+        free(script_out->buffer);
+        *script_out = (DeltaScript){0};
+        return rc;
     }
-
     log_msg("  > Delta script generated (size: %.1fKB)", (double)script_out->size / 1024.0);
-    map_free(map);
-    return 0; // Success!
-
-error_cleanup:
-    log_msg("  > Error generating delta script. Aborting.");
-    map_free(map);
-    free(script_out->buffer);
-    *script_out = (DeltaScript){0};
-    return -1; // Indicate failure
+    return 0;
 }
 
 
@@ -1283,22 +1588,24 @@ static char* patch_from_byte_delta(
         if (op == 'C') {
             // --- Handle COPY ---
             if (ptr + sizeof(size_t) * 2 > end) { free(out.buffer); return NULL; } // Malformed
-            size_t offset = *(size_t*)ptr;
+            size_t offset, len;
+            memcpy(&offset, ptr, sizeof(size_t)); // Script fields are unaligned
             ptr += sizeof(size_t);
-            size_t len = *(size_t*)ptr;
+            memcpy(&len, ptr, sizeof(size_t));
             ptr += sizeof(size_t);
             
-            if (offset + len > old_size) { free(out.buffer); return NULL; } // Out of bounds
+            if (offset > old_size || len > old_size - offset) { free(out.buffer); return NULL; } // Out of bounds
             
             if (append_delta_data(&out, old_content + offset, len) != 0) { free(out.buffer); return NULL; }
 
         } else if (op == 'I') {
             // --- Handle INSERT ---
             if (ptr + sizeof(size_t) > end) { free(out.buffer); return NULL; } // Malformed
-            size_t len = *(size_t*)ptr;
+            size_t len;
+            memcpy(&len, ptr, sizeof(size_t));
             ptr += sizeof(size_t);
             
-            if (ptr + len > end) { free(out.buffer); return NULL; } // Malformed
+            if (len > (size_t)(end - ptr)) { free(out.buffer); return NULL; } // Malformed
             
             if (append_delta_data(&out, ptr, len) != 0) { free(out.buffer); return NULL; }
             ptr += len;
@@ -1325,16 +1632,140 @@ static char* patch_from_byte_delta(
  * @brief Compress and write a FULL BLOB object
  * Format: "BLOB\0"[data]
  */
+// --- Object writer stage ---
+// During a parallel commit, compressed objects are handed to one writer
+// thread through a queue bounded by COMMIT_WRITE_BUDGET bytes, so workers
+// keep hashing while the disk catches up. Outside a commit (or when
+// running on one thread) objects are written directly.
+
+#define COMMIT_WRITE_BUDGET (64LL * 1024 * 1024)
+
+typedef struct PendingWrite {
+    Bytef* data;
+    size_t len;
+    struct PendingWrite* next;
+    char path[];
+} PendingWrite;
+
+typedef struct ObjectWriter {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;            // Writes queued or closing
+    pthread_cond_t space_cond;      // Queued bytes went down
+    PendingWrite* head;
+    PendingWrite* tail;
+    long long queued_bytes;
+    int running;
+    int closing;
+    int failed;
+    pthread_t thread;
+} ObjectWriter;
+
+static ObjectWriter g_writer = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+    .space_cond = PTHREAD_COND_INITIALIZER
+};
+
+// Writes through a temp file + rename, so readers never see a partial
+// object and two writers of the same object cannot interleave.
+static int write_object_file(const char* obj_path, const void* data, size_t len) {
+    char obj_dir[PATH_MAX];
+    strncpy(obj_dir, obj_path, sizeof(obj_dir) - 1);
+    obj_dir[sizeof(obj_dir) - 1] = '\0';
+    char* slash = strrchr(obj_dir, '/');
+    if (slash) *slash = '\0';
+    if (mkdir(obj_dir, 0755) != 0 && errno != EEXIST) return -1;
+
+    char tmp_path[PATH_MAX + 32];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%lx.tmp", obj_path, (unsigned long)pthread_self());
+    FILE* f = fopen(tmp_path, "wb");
+    if (!f) return -1;
+    int rc = (len == 0 || fwrite(data, 1, len, f) == len) ? 0 : -1;
+    if (fclose(f) != 0) rc = -1;
+    if (rc != 0 || rename(tmp_path, obj_path) != 0) {
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+static void* object_writer_func(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&g_writer.mutex);
+    for (;;) {
+        while (!g_writer.head && !g_writer.closing) pthread_cond_wait(&g_writer.cond, &g_writer.mutex);
+        PendingWrite* w = g_writer.head;
+        if (!w) break;
+        g_writer.head = w->next;
+        if (!g_writer.head) g_writer.tail = NULL;
+        pthread_mutex_unlock(&g_writer.mutex);
+
+        int rc = write_object_file(w->path, w->data, w->len);
+        if (rc != 0) log_msg("Failed to write object %s: %s", w->path, strerror(errno));
+
+        pthread_mutex_lock(&g_writer.mutex);
+        if (rc != 0) g_writer.failed = 1;
+        g_writer.queued_bytes -= (long long)w->len;
+        pthread_cond_broadcast(&g_writer.space_cond);
+        free(w->data);
+        free(w);
+    }
+    pthread_mutex_unlock(&g_writer.mutex);
+    return NULL;
+}
+
+static int start_object_writer(void) {
+    g_writer.head = g_writer.tail = NULL;
+    g_writer.queued_bytes = 0;
+    g_writer.closing = 0;
+    g_writer.failed = 0;
+    if (pthread_create(&g_writer.thread, NULL, object_writer_func, NULL) != 0) return -1;
+    g_writer.running = 1;
+    return 0;
+}
+
+// Drains the queue and stops the writer. Returns -1 if any write failed.
+static int stop_object_writer(void) {
+    if (!g_writer.running) return 0;
+    pthread_mutex_lock(&g_writer.mutex);
+    g_writer.closing = 1;
+    pthread_cond_broadcast(&g_writer.cond);
+    pthread_mutex_unlock(&g_writer.mutex);
+    pthread_join(g_writer.thread, NULL);
+    g_writer.running = 0;
+    return g_writer.failed ? -1 : 0;
+}
+
+// Stores a compressed object; takes ownership of data.
+static int store_object(const char* obj_path, Bytef* data, size_t len) {
+    PendingWrite* w = g_writer.running ? malloc(sizeof(PendingWrite) + strlen(obj_path) + 1) : NULL;
+    if (!w) {
+        int rc = write_object_file(obj_path, data, len);
+        free(data);
+        return rc;
+    }
+    strcpy(w->path, obj_path);
+    w->data = data;
+    w->len = len;
+    w->next = NULL;
+
+    pthread_mutex_lock(&g_writer.mutex);
+    // An object larger than the budget still goes through, just alone
+    while (g_writer.queued_bytes > 0 && g_writer.queued_bytes + (long long)len > COMMIT_WRITE_BUDGET) {
+        pthread_cond_wait(&g_writer.space_cond, &g_writer.mutex);
+    }
+    if (g_writer.tail) g_writer.tail->next = w; else g_writer.head = w;
+    g_writer.tail = w;
+    g_writer.queued_bytes += (long long)len;
+    pthread_cond_signal(&g_writer.cond);
+    pthread_mutex_unlock(&g_writer.mutex);
+    return 0;
+}
+
 static int write_blob_object(const char* hash, const char* content, size_t content_size) {
     char obj_path[PATH_MAX];
     get_object_path(hash, obj_path);
-    struct stat st;
-    if (stat(obj_path, &st) == 0) return 0; 
-    
-    char obj_dir[PATH_MAX];
-    strncpy(obj_dir, obj_path, sizeof(obj_dir));
-    *strrchr(obj_dir, '/') = '\0';
-    if (mkdir(obj_dir, 0755) != 0 && errno != EEXIST) return -1;
+    if (object_exists(OBJ_KIND_LOOSE, hash, obj_path)) return 0; 
     
     size_t header_len = 5; // "BLOB\0"
     size_t total_uncomp_size = header_len + content_size;
@@ -1352,12 +1783,7 @@ static int write_blob_object(const char* hash, const char* content, size_t conte
     free(uncompressed_buf);
     if (z_result != Z_OK) { free(compressed_buf); return -1; }
 
-    FILE* f = fopen(obj_path, "wb");
-    if (!f) { free(compressed_buf); return -1; }
-    fwrite(compressed_buf, 1, compressed_size, f);
-    fclose(f);
-    free(compressed_buf);
-    return 0;
+    return store_object(obj_path, compressed_buf, compressed_size);
 }
 
 /**
@@ -1367,13 +1793,7 @@ static int write_blob_object(const char* hash, const char* content, size_t conte
 static int write_byte_delta_object(const char* hash, const char* base_hash, const char* delta_script, size_t delta_size) {
     char obj_path[PATH_MAX];
     get_object_path(hash, obj_path);
-    struct stat st;
-    if (stat(obj_path, &st) == 0) return 0;
-
-    char obj_dir[PATH_MAX];
-    strncpy(obj_dir, obj_path, sizeof(obj_dir));
-    *strrchr(obj_dir, '/') = '\0';
-    if (mkdir(obj_dir, 0755) != 0 && errno != EEXIST) return -1;
+    if (object_exists(OBJ_KIND_LOOSE, hash, obj_path)) return 0;
 
     size_t header_len = 11 + HASH_LEN + 1; // "DELTA-BYTE\0" + "hash" + "\0"
     size_t total_uncomp_size = header_len + delta_size;
@@ -1392,28 +1812,337 @@ static int write_byte_delta_object(const char* hash, const char* base_hash, cons
     free(uncompressed_buf);
     if (z_result != Z_OK) { free(compressed_buf); return -1; }
 
-    FILE* f = fopen(obj_path, "wb");
-    if (!f) { free(compressed_buf); return -1; }
-    fwrite(compressed_buf, 1, compressed_size, f);
-    fclose(f);
-    free(compressed_buf);
-    return 0;
+    return store_object(obj_path, compressed_buf, compressed_size);
 }
 
-static char* read_object(const char* hash, size_t* uncompressed_size) {
+// --- Streamed deltas for large files ---
+// Files over IN_MEMORY_FILE_LIMIT never sit in memory whole: the base's
+// signatures are built while inflating it, the new file is scanned through
+// a DELTA_STREAM_WINDOW buffer, and the script is compressed into the object
+// file as it is produced. The base must be a full BLOB; if the parent
+// version is itself a delta, its own base is used instead, which keeps
+// large-file chains one link deep.
+
+typedef struct ObjectStream {
+    FILE* f;
+    z_stream strm;
+    int at_end;
+    unsigned char in[ZLIB_CHUNK_SIZE];
+} ObjectStream;
+
+static int object_stream_open(ObjectStream* s, const char* hash) {
     char obj_path[PATH_MAX];
     get_object_path(hash, obj_path);
+    memset(&s->strm, 0, sizeof(s->strm));
+    s->at_end = 0;
+    s->f = open_object_file(OBJ_KIND_LOOSE, hash, obj_path);
+    if (!s->f) return -1;
+    if (inflateInit(&s->strm) != Z_OK) { fclose(s->f); return -1; }
+    return 0;
+}
 
-    FILE* f = fopen(obj_path, "rb");
-    if (!f) return NULL;
-
-    fseek(f, 0, SEEK_END);
-    long compressed_size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    if (compressed_size <= 0) { fclose(f); return NULL; }
+// Reads up to len bytes; short only at the end of the object. -1 on error.
+static ssize_t object_stream_read(ObjectStream* s, void* buf, size_t len) {
+    s->strm.next_out = buf;
+    s->strm.avail_out = (uInt)len;
+    while (s->strm.avail_out > 0 && !s->at_end) {
+        if (s->strm.avail_in == 0) {
+            s->strm.avail_in = (uInt)fread(s->in, 1, sizeof(s->in), s->f);
+            s->strm.next_in = s->in;
+            if (s->strm.avail_in == 0) return -1; // Truncated object
+        }
+        int ret = inflate(&s->strm, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END) s->at_end = 1;
+        else if (ret != Z_OK) return -1;
+    }
+    return (ssize_t)(len - s->strm.avail_out);
+}
 
-    Bytef* compressed_buf = malloc(compressed_size);
-    if (!compressed_buf) { fclose(f); return NULL; }
+static void object_stream_close(ObjectStream* s) {
+    inflateEnd(&s->strm);
+    fclose(s->f);
+}
+
+/**
+ * @brief Opens the full BLOB to delta against, positioned after "BLOB\0".
+ * base_hash is replaced by the blob actually used.
+ */
+static int open_delta_base_stream(ObjectStream* s, char* base_hash) {
+    for (int hop = 0; hop < 2; hop++) {
+        if (object_stream_open(s, base_hash) != 0) return -1;
+        char header[11 + HASH_STR_LEN];
+        ssize_t n = object_stream_read(s, header, 5);
+        if (n == 5 && memcmp(header, "BLOB\0", 5) == 0) return 0;
+        if (n == 5 && object_stream_read(s, header + 5, sizeof(header) - 5) == (ssize_t)(sizeof(header) - 5) &&
+            memcmp(header, "DELTA-BYTE\0", 11) == 0) {
+            object_stream_close(s);
+            memcpy(base_hash, header + 11, HASH_LEN);
+            base_hash[HASH_LEN] = '\0';
+            continue;
+        }
+        object_stream_close(s);
+        return -1;
+    }
+    return -1;
+}
+
+/**
+ * @brief Writes a DELTA-BYTE object for a large file without loading it.
+ * Returns 0 when written, 1 when no usable delta exists (store a full
+ * blob instead), -1 on error.
+ */
+static int write_byte_delta_object_stream(const char* hash, const char* parent_hash, const char* fpath,
+                                          size_t fsize, size_t* delta_size_out)
+{
+    char base_hash[HASH_STR_LEN];
+    memcpy(base_hash, parent_hash, HASH_STR_LEN);
+
+    // --- 1. Signatures of the base, block by block ---
+    ObjectStream base;
+    if (open_delta_base_stream(&base, base_hash) != 0) return 1;
+
+    SignatureMap map;
+    uint8_t* block = malloc(DELTA_BLOCK_SIZE);
+    if (!block || map_init(&map, fsize / DELTA_BLOCK_SIZE) != 0) {
+        free(block);
+        object_stream_close(&base);
+        return -1;
+    }
+    uint64_t offset = 0;
+    ssize_t n;
+    while ((n = object_stream_read(&base, block, DELTA_BLOCK_SIZE)) == DELTA_BLOCK_SIZE) {
+        if (map_add_block(&map, block, offset) != 0) { n = -1; break; }
+        offset += DELTA_BLOCK_SIZE;
+    }
+    object_stream_close(&base);
+    free(block);
+    if (n < 0 || map.count == 0) {
+        map_free(&map);
+        return n < 0 ? -1 : 1;
+    }
+
+    // --- 2. Scan the file into a compressed object ---
+    char obj_path[PATH_MAX];
+    get_object_path(hash, obj_path);
+    char obj_dir[PATH_MAX];
+    strncpy(obj_dir, obj_path, sizeof(obj_dir) - 1);
+    obj_dir[sizeof(obj_dir) - 1] = '\0';
+    *strrchr(obj_dir, '/') = '\0';
+    if (mkdir(obj_dir, 0755) != 0 && errno != EEXIST) { map_free(&map); return -1; }
+
+    char tmp_path[PATH_MAX + 32];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%lx.tmp", obj_path, (unsigned long)pthread_self());
+
+    DeltaInput in = { .total = fsize };
+    DeltaSpill spill = { .flushed = 0 };
+    DeltaScript script = {0};
+    int rc = -1, z_ready = 0;
+
+    in.file = fopen(fpath, "rb");
+    in.buf = malloc(DELTA_STREAM_WINDOW);
+    in.data = in.buf;
+    spill.out = fopen(tmp_path, "wb");
+    if (!in.file || !in.buf || !spill.out) goto done;
+    if (deflateInit(&spill.strm, Z_DEFAULT_COMPRESSION) != Z_OK) goto done;
+    z_ready = 1;
+
+    char header[11 + HASH_STR_LEN];
+    memcpy(header, "DELTA-BYTE\0", 11);
+    memcpy(header + 11, base_hash, HASH_STR_LEN);
+    if (delta_spill_write(&spill, header, sizeof(header), Z_NO_FLUSH) != 0) goto done;
+
+    rc = delta_scan(&map, NULL, &in, &script, &spill, (size_t)(fsize * 0.75));
+    if (rc == 0) {
+        if (delta_spill_write(&spill, script.buffer, script.size, Z_FINISH) != 0) rc = -1;
+        *delta_size_out = spill.flushed + script.size;
+    }
+
+done:
+    map_free(&map);
+    free(script.buffer);
+    free(in.buf);
+    if (in.file) fclose(in.file);
+    if (z_ready) deflateEnd(&spill.strm);
+    if (spill.out && fclose(spill.out) != 0 && rc == 0) rc = -1;
+    if (rc == 0 && rename(tmp_path, obj_path) != 0) rc = -1;
+    if (rc != 0 && spill.out) unlink(tmp_path);
+    return rc;
+}
+
+// --- Delta chains and the object cache ---
+// A DELTA-BYTE object names its base, and each commit deltas against the
+// parent version, so without a bound reading version N of a file would
+// inflate and patch N objects. Writers therefore store a full BLOB once the
+// chain would grow past DELTA_MAX_DEPTH links or once patching the whole
+// chain would cost more than DELTA_CHAIN_COST_FACTOR times the file itself.
+//
+// Reads resolve a chain iteratively and keep reconstructed objects in a
+// process-wide LRU (EXODUS_OBJECT_CACHE_MB, default 64), so rebuild, diff and
+// log stop re-reading the same trees and delta bases. Objects are addressed
+// by content hash, so an entry never goes stale.
+
+#define DELTA_MAX_DEPTH 16
+#define DELTA_CHAIN_COST_FACTOR 2
+#define DELTA_CHAIN_LIMIT 100000            // Guards against corrupt or cyclic chains
+#define OBJECT_CACHE_DEFAULT_MB 64
+#define OBJECT_CACHE_BUCKETS 4096
+
+typedef struct ObjectCacheEntry {
+    struct ObjectCacheEntry* hash_next;
+    struct ObjectCacheEntry* lru_prev;      // Towards most recently used
+    struct ObjectCacheEntry* lru_next;
+    char hash[HASH_STR_LEN];
+    char* data;                             // NUL-terminated like read_object() output
+    size_t size;
+    int depth;                              // Delta links below this object
+    size_t cost;                            // Script bytes patched to rebuild it
+} ObjectCacheEntry;
+
+typedef struct ObjectCache {
+    pthread_mutex_t mutex;
+    ObjectCacheEntry* buckets[OBJECT_CACHE_BUCKETS];
+    ObjectCacheEntry* lru_head;
+    ObjectCacheEntry* lru_tail;
+    size_t bytes;
+    size_t budget;                          // 0 until initialised
+    size_t hits;
+    size_t misses;
+} ObjectCache;
+
+static ObjectCache g_object_cache = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+static pthread_once_t g_object_cache_once = PTHREAD_ONCE_INIT;
+
+static void object_cache_init(void) {
+    size_t mb = OBJECT_CACHE_DEFAULT_MB;
+    const char* env = getenv("EXODUS_OBJECT_CACHE_MB");
+    if (env && *env) {
+        char* end;
+        unsigned long v = strtoul(env, &end, 10);
+        if (*end == '\0') mb = v;
+    }
+    g_object_cache.budget = mb * 1024 * 1024;
+}
+
+static unsigned object_cache_bucket(const char* hash) {
+    uint32_t h = 2166136261u;
+    for (const char* p = hash; *p; p++) { h ^= (uint8_t)*p; h *= 16777619u; }
+    return h % OBJECT_CACHE_BUCKETS;
+}
+
+static void object_cache_unlink_lru(ObjectCacheEntry* e) {
+    if (e->lru_prev) e->lru_prev->lru_next = e->lru_next; else g_object_cache.lru_head = e->lru_next;
+    if (e->lru_next) e->lru_next->lru_prev = e->lru_prev; else g_object_cache.lru_tail = e->lru_prev;
+    e->lru_prev = e->lru_next = NULL;
+}
+
+static void object_cache_push_front(ObjectCacheEntry* e) {
+    e->lru_next = g_object_cache.lru_head;
+    if (g_object_cache.lru_head) g_object_cache.lru_head->lru_prev = e;
+    g_object_cache.lru_head = e;
+    if (!g_object_cache.lru_tail) g_object_cache.lru_tail = e;
+}
+
+static ObjectCacheEntry* object_cache_find_locked(const char* hash) {
+    for (ObjectCacheEntry* e = g_object_cache.buckets[object_cache_bucket(hash)]; e; e = e->hash_next) {
+        if (strcmp(e->hash, hash) == 0) return e;
+    }
+    return NULL;
+}
+
+// Returns a private copy of a cached object, or NULL on a miss.
+static char* object_cache_get(const char* hash, size_t* size_out, int* depth_out, size_t* cost_out) {
+    pthread_once(&g_object_cache_once, object_cache_init);
+    if (g_object_cache.budget == 0) return NULL;
+
+    char* copy = NULL;
+    pthread_mutex_lock(&g_object_cache.mutex);
+    ObjectCacheEntry* e = object_cache_find_locked(hash);
+    if (e) {
+        copy = malloc(e->size + 1);
+        if (copy) {
+            memcpy(copy, e->data, e->size + 1);
+            *size_out = e->size;
+            *depth_out = e->depth;
+            *cost_out = e->cost;
+            object_cache_unlink_lru(e);
+            object_cache_push_front(e);
+        }
+    }
+    if (copy) g_object_cache.hits++; else g_object_cache.misses++;
+    pthread_mutex_unlock(&g_object_cache.mutex);
+    return copy;
+}
+
+static void object_cache_put(const char* hash, const char* data, size_t size, int depth, size_t cost) {
+    pthread_once(&g_object_cache_once, object_cache_init);
+    // One huge blob must not flush everything else.
+    if (g_object_cache.budget == 0 || size > g_object_cache.budget / 4) return;
+
+    ObjectCacheEntry* e = malloc(sizeof(ObjectCacheEntry));
+    if (!e) return;
+    e->data = malloc(size + 1);
+    if (!e->data) { free(e); return; }
+    memcpy(e->data, data, size);
+    e->data[size] = '\0';
+    memcpy(e->hash, hash, HASH_STR_LEN);
+    e->size = size;
+    e->depth = depth;
+    e->cost = cost;
+    e->lru_prev = e->lru_next = NULL;
+
+    unsigned bucket = object_cache_bucket(hash);
+    ObjectCacheEntry* evicted = NULL;
+
+    pthread_mutex_lock(&g_object_cache.mutex);
+    if (object_cache_find_locked(hash)) {
+        pthread_mutex_unlock(&g_object_cache.mutex); // Another reader got there first
+        free(e->data);
+        free(e);
+        return;
+    }
+    e->hash_next = g_object_cache.buckets[bucket];
+    g_object_cache.buckets[bucket] = e;
+    object_cache_push_front(e);
+    g_object_cache.bytes += size;
+
+    while (g_object_cache.bytes > g_object_cache.budget && g_object_cache.lru_tail != e) {
+        ObjectCacheEntry* victim = g_object_cache.lru_tail;
+        object_cache_unlink_lru(victim);
+        ObjectCacheEntry** link = &g_object_cache.buckets[object_cache_bucket(victim->hash)];
+        while (*link != victim) link = &(*link)->hash_next;
+        *link = victim->hash_next;
+        g_object_cache.bytes -= victim->size;
+        victim->hash_next = evicted;
+        evicted = victim;
+    }
+    pthread_mutex_unlock(&g_object_cache.mutex);
+
+    while (evicted) {
+        ObjectCacheEntry* next = evicted->hash_next;
+        free(evicted->data);
+        free(evicted);
+        evicted = next;
+    }
+}
+
+/**
+ * @brief Reads and inflates a loose-namespace object without interpreting it.
+ * The buffer is NUL-terminated; *len_out excludes the terminator.
+ */
+static Bytef* inflate_object(const char* hash, size_t* len_out) {
+    char obj_path[PATH_MAX];
+    get_object_path(hash, obj_path);
+
+    FILE* f = open_object_file(OBJ_KIND_LOOSE, hash, obj_path);
+    if (!f) return NULL;
+
+    fseek(f, 0, SEEK_END);
+    long compressed_size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (compressed_size <= 0) { fclose(f); return NULL; }
+
+    Bytef* compressed_buf = malloc(compressed_size);
+    if (!compressed_buf) { fclose(f); return NULL; }
 
     if (fread(compressed_buf, 1, compressed_size, f) != (size_t)compressed_size) {
         fclose(f); free(compressed_buf); return NULL;
@@ -1452,98 +2181,509 @@ static char* read_object(const char* hash, size_t* uncompressed_size) {
     
     // Null-terminate the uncompressed buffer for safe string ops
     uncompressed_buf[uncomp_len_guess] = '\0';
+    *len_out = uncomp_len_guess;
+    return uncompressed_buf;
+}
 
-    // --- Check the object format header ---
-    if (uncomp_len_guess >= 5 && memcmp(uncompressed_buf, "BLOB\0", 5) == 0) {
-        // --- This is a FULL OBJECT (BLOB) ---
-        size_t header_len = 5;
-        *uncompressed_size = uncomp_len_guess - header_len;
+/**
+ * @brief Patches a deprecated DELTA-LCS object (line-based) onto its base.
+ */
+static char* read_legacy_lcs_delta(const char* hash, Bytef* raw, size_t raw_len, size_t* uncompressed_size) {
+    log_msg("Warning: Reading deprecated DELTA-LCS object %s. Please re-commit to upgrade.", hash);
 
-        char* final_content = malloc(*uncompressed_size + 1);
-        if (final_content) {
-            memcpy(final_content, uncompressed_buf + header_len, *uncompressed_size);
-            final_content[*uncompressed_size] = '\0';
+    char base_hash[HASH_STR_LEN];
+    size_t header_len = 10 + HASH_LEN + 1; // "DELTA-LCS\0" + "hash" + "\0"
+    
+    memcpy(base_hash, raw + 10, HASH_LEN);
+    base_hash[HASH_LEN] = '\0';
+    
+    char* delta_script = (char*)raw + header_len;
+    size_t delta_size = raw_len - header_len;
+
+    size_t base_size;
+    char* base_content = read_object(base_hash, &base_size);
+    if (!base_content) {
+        log_msg("Failed to read base object %s to reconstruct deprecated delta %s", base_hash, hash);
+        return NULL;
+    }
+
+    // --- Reconstruct by patching (using line-based logic) ---
+    int base_line_count;
+    TextLine* base_lines = split_content_to_lines(base_content, base_size, &base_line_count);
+    TextLine* new_lines = patch_lines(base_lines, delta_script, delta_size);
+    char* final_content = reconstruct_content_from_lines(new_lines, uncompressed_size);
+    
+    free(base_content);
+    free_lines(base_lines);
+    free_lines(new_lines);
+    return final_content;
+}
+
+typedef struct DeltaLink {
+    char hash[HASH_STR_LEN];
+    Bytef* raw;                 // Inflated DELTA-BYTE object
+    size_t raw_len;
+} DeltaLink;
+
+/**
+ * @brief Reads an object, resolving delta chains without recursion.
+ *
+ * Walks base links until it reaches a BLOB (or any other self-contained
+ * object) or an object that is already cached, then applies the delta
+ * scripts from the bottom up. depth_out/cost_out (optional) report the
+ * chain below the returned object: its number of delta links and the total
+ * script bytes patched. Returns malloc'd, NUL-terminated content.
+ */
+static char* read_object_chain(const char* hash, size_t* uncompressed_size, int* depth_out, size_t* cost_out) {
+    const size_t delta_header_len = 11 + HASH_LEN + 1; // "DELTA-BYTE\0" + "hash" + "\0"
+    int depth = 0;
+    size_t cost = 0;
+    size_t size = 0;
+
+    char* content = object_cache_get(hash, &size, &depth, &cost);
+    if (content) {
+        *uncompressed_size = size;
+        if (depth_out) *depth_out = depth;
+        if (cost_out) *cost_out = cost;
+        return content;
+    }
+
+    DeltaLink* links = NULL;
+    size_t link_count = 0, link_cap = 0;
+    char current[HASH_STR_LEN];
+    memcpy(current, hash, HASH_STR_LEN);
+    int base_from_cache = 0;
+
+    // --- 1. Walk down to something self-contained ---
+    while (!content) {
+        size_t raw_len;
+        Bytef* raw = inflate_object(current, &raw_len);
+        if (!raw) {
+            if (link_count > 0) {
+                log_msg("Failed to read base object %s to reconstruct delta %s", current, links[link_count - 1].hash);
+            }
+            goto fail;
         }
-        free(uncompressed_buf);
-        return final_content;
 
-    } else if (uncomp_len_guess > 77 && memcmp(uncompressed_buf, "DELTA-BYTE\0", 11) == 0) {
-        // --- This is a DELTA-BYTE OBJECT ---
-        char base_hash[HASH_STR_LEN];
-        size_t header_len = 11 + HASH_LEN + 1; // "DELTA-BYTE\0" + "hash" + "\0"
-        
-        memcpy(base_hash, uncompressed_buf + 11, HASH_LEN);
-        base_hash[HASH_LEN] = '\0';
-        
-        char* delta_script = (char*)uncompressed_buf + header_len;
-        size_t delta_size = uncomp_len_guess - header_len;
+        if (raw_len >= 5 && memcmp(raw, "BLOB\0", 5) == 0) {
+            // --- FULL OBJECT (BLOB) ---
+            size = raw_len - 5;
+            memmove(raw, raw + 5, size + 1); // Keeps the NUL terminator
+            content = (char*)raw;
+        } else if (raw_len > 77 && memcmp(raw, "DELTA-BYTE\0", 11) == 0) {
+            // --- DELTA-BYTE: remember the script, continue with the base ---
+            if (link_count == DELTA_CHAIN_LIMIT) {
+                log_msg("Delta chain of %s is longer than %d links. Refusing to follow it.", hash, DELTA_CHAIN_LIMIT);
+                free(raw);
+                goto fail;
+            }
+            if (link_count == link_cap) {
+                size_t new_cap = link_cap ? link_cap * 2 : 8;
+                DeltaLink* grown = realloc(links, new_cap * sizeof(DeltaLink));
+                if (!grown) { free(raw); goto fail; }
+                links = grown;
+                link_cap = new_cap;
+            }
+            DeltaLink* link = &links[link_count++];
+            memcpy(link->hash, current, HASH_STR_LEN);
+            link->raw = raw;
+            link->raw_len = raw_len;
+
+            memcpy(current, raw + 11, HASH_LEN);
+            current[HASH_LEN] = '\0';
+
+            content = object_cache_get(current, &size, &depth, &cost);
+            if (content) base_from_cache = 1;
+        } else if (raw_len > 72 && memcmp(raw, "DELTA-LCS\0", 10) == 0) {
+            content = read_legacy_lcs_delta(current, raw, raw_len, &size);
+            free(raw);
+            if (!content) goto fail;
+            // Unknown depth: make the next commit of this file store a full blob.
+            depth = DELTA_MAX_DEPTH;
+        } else {
+            log_msg("Unknown or corrupt object format in %s", current);
+            free(raw);
+            goto fail;
+        }
+    }
+
+    // Trees, commits and the bottom of every chain are what later reads share.
+    if (!base_from_cache) object_cache_put(current, content, size, depth, cost);
 
-        // --- RECURSIVE CALL ---
-        size_t base_size;
-        char* base_content = read_object(base_hash, &base_size);
-        if (!base_content) {
-            log_msg("Failed to read base object %s to reconstruct delta %s", base_hash, hash);
-            free(uncompressed_buf); return NULL;
+    // --- 2. Patch back up towards the requested object ---
+    while (link_count > 0) {
+        DeltaLink* link = &links[--link_count];
+        const char* script = (const char*)link->raw + delta_header_len;
+        size_t script_size = link->raw_len - delta_header_len;
+
+        size_t patched_size;
+        char* patched = patch_from_byte_delta(content, size, script, script_size, &patched_size);
+        free(content);
+        free(link->raw);
+        if (!patched) {
+            log_msg("Failed to patch delta object %s", link->hash);
+            content = NULL;
+            goto fail;
         }
+        content = patched;
+        size = patched_size;
+        depth++;
+        cost += script_size;
+    }
+    free(links);
 
-        // --- Reconstruct by patching ---
-        char* final_content = patch_from_byte_delta(base_content, base_size, delta_script, delta_size, uncompressed_size);
-        
-        // Cleanup
-        free(base_content);
-        free(uncompressed_buf);
+    if (strcmp(current, hash) != 0) object_cache_put(hash, content, size, depth, cost);
 
-        if (!final_content) {
-            log_msg("Failed to patch delta object %s", hash);
-            return NULL;
+    *uncompressed_size = size;
+    if (depth_out) *depth_out = depth;
+    if (cost_out) *cost_out = cost;
+    return content;
+
+fail:
+    free(content);
+    for (size_t i = 0; i < link_count; i++) free(links[i].raw);
+    free(links);
+    return NULL;
+}
+
+static char* read_object(const char* hash, size_t* uncompressed_size) {
+    return read_object_chain(hash, uncompressed_size, NULL, NULL);
+}
+
+// --- Tree objects ---
+// Trees are stored as BLOB objects whose payload is
+//
+//   TreeHeader                         "EXTREE01", entry count, pool size
+//   TreeRecord[count]                  sorted by name (strcmp order)
+//   char pool[pool_size]               NUL-terminated names and authors
+//
+// Records are fixed width and carry raw hashes, so a name is found by
+// binary search on the mapped payload. Text trees written before this
+// format ("%o %c %s E:%.4f U:%s\t%s" lines) are converted on load, so
+// every reader sees the same records.
+//
+// Loaded trees are kept in a per-process cache keyed by tree hash. Commits
+// look up every parent directory there instead of re-reading the parent
+// commit's trees from the root for each file.
+
+#define TREE_MAGIC "EXTREE01"
+#define TREE_MAGIC_LEN 8
+#define TREE_CACHE_BUCKETS 1024
+#define TREE_CACHE_MAX_BYTES (32 * 1024 * 1024)
+
+typedef struct TreeHeader {
+    char magic[TREE_MAGIC_LEN];
+    uint32_t count;
+    uint32_t pool_size;
+} TreeHeader;
+
+typedef struct TreeRecord {
+    uint8_t hash[SHA256_BLOCK_SIZE];
+    double entropy;             // Rounded to 4 decimals like the text format
+    uint32_t mode;              // Permission bits only
+    uint32_t name_offset;       // Into the pool
+    uint32_t author_offset;
+    char type;                  // 'B', 'T', 'L' or 'M'
+    uint8_t reserved[3];
+} TreeRecord;
+
+_Static_assert(sizeof(TreeRecord) == 56, "TreeRecord must stay 56 bytes");
+
+typedef struct Tree {
+    int refs;
+    char hash[HASH_STR_LEN];
+    uint32_t count;
+    const TreeRecord* records;
+    const char* pool;
+    char* data;                 // Owns the payload
+    size_t size;
+    struct Tree* cache_next;
+} Tree;
+
+typedef struct TreeCache {
+    pthread_mutex_t mutex;
+    Tree* buckets[TREE_CACHE_BUCKETS];
+    size_t bytes;
+} TreeCache;
+
+static TreeCache g_tree_cache = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+static int tree_entry_name_cmp(const void* a, const void* b) {
+    return strcmp((*(TreeEntry* const*)a)->name, (*(TreeEntry* const*)b)->name);
+}
+
+/**
+ * @brief Serializes entries with a type into the binary tree format.
+ * The list itself is left untouched. Returns 0 on success, -1 when out of memory.
+ */
+static int tree_encode(TreeEntry* head, char** out, size_t* out_size) {
+    size_t count = 0, pool_size = 0;
+    for (TreeEntry* e = head; e; e = e->next) {
+        if (!e->type) continue;
+        count++;
+        pool_size += strlen(e->name) + 1 + strlen(e->author[0] ? e->author : "unknown") + 1;
+    }
+
+    TreeEntry** sorted = malloc((count ? count : 1) * sizeof(TreeEntry*));
+    size_t size = sizeof(TreeHeader) + count * sizeof(TreeRecord) + pool_size;
+    char* buf = calloc(1, size);
+    if (!sorted || !buf) { free(sorted); free(buf); return -1; }
+
+    size_t n = 0;
+    for (TreeEntry* e = head; e; e = e->next) if (e->type) sorted[n++] = e;
+    qsort(sorted, count, sizeof(TreeEntry*), tree_entry_name_cmp);
+
+    TreeHeader* header = (TreeHeader*)buf;
+    memcpy(header->magic, TREE_MAGIC, TREE_MAGIC_LEN);
+    header->count = (uint32_t)count;
+
+    TreeRecord* records = (TreeRecord*)(buf + sizeof(TreeHeader));
+    char* pool = (char*)(records + count);
+    size_t used = 0;
+    for (size_t i = 0; i < count; i++) {
+        TreeEntry* e = sorted[i];
+        TreeRecord* r = &records[i];
+        if (hex_decode_hash(e->hash, r->hash) != 0) { free(sorted); free(buf); return -1; }
+        r->entropy = round(e->entropy * 10000.0) / 10000.0;
+        r->mode = e->mode & 07777;
+        r->type = e->type;
+
+        const char* author = e->author[0] ? e->author : "unknown";
+        if (i > 0 && strcmp(author, pool + records[i - 1].author_offset) == 0) {
+            r->author_offset = records[i - 1].author_offset; // Runs of one author share a string
+        } else {
+            r->author_offset = (uint32_t)used;
+            size_t len = strlen(author) + 1;
+            memcpy(pool + used, author, len);
+            used += len;
         }
-        
-        return final_content;
-        
-    } else {
-        // --- THIS IS THE IMPLEMENTED FALLBACK ---
-        if (uncomp_len_guess > 72 && memcmp(uncompressed_buf, "DELTA-LCS\0", 10) == 0) {
-            log_msg("Warning: Reading deprecated DELTA-LCS object %s. Please re-commit to upgrade.", hash);
-            
-            // --- BEGIN: DEPRECATED DELTA-LCS PATCH LOGIC ---
-            char base_hash[HASH_STR_LEN];
-            size_t header_len = 10 + HASH_LEN + 1; // "DELTA-LCS\0" + "hash" + "\0"
-            
-            memcpy(base_hash, uncompressed_buf + 10, HASH_LEN);
-            base_hash[HASH_LEN] = '\0';
-            
-            char* delta_script = (char*)uncompressed_buf + header_len;
-            size_t delta_size = uncomp_len_guess - header_len;
-
-            // --- RECURSIVE CALL ---
-            size_t base_size;
-            char* base_content = read_object(base_hash, &base_size);
-            if (!base_content) {
-                log_msg("Failed to read base object %s to reconstruct deprecated delta %s", base_hash, hash);
-                free(uncompressed_buf); 
-                return NULL;
-            }
+        r->name_offset = (uint32_t)used;
+        size_t len = strlen(e->name) + 1;
+        memcpy(pool + used, e->name, len);
+        used += len;
+    }
+    header->pool_size = (uint32_t)used;
+    free(sorted);
 
-            // --- Reconstruct by patching (using line-based logic) ---
-            int base_line_count;
-            TextLine* base_lines = split_content_to_lines(base_content, base_size, &base_line_count);
-            TextLine* new_lines = patch_lines(base_lines, delta_script, delta_size);
-            char* final_content = reconstruct_content_from_lines(new_lines, uncompressed_size);
-            
-            // Cleanup
-            free(base_content);
-            free_lines(base_lines);
-            free_lines(new_lines);
-            free(uncompressed_buf);
+    *out = buf;
+    *out_size = sizeof(TreeHeader) + count * sizeof(TreeRecord) + used;
+    return 0;
+}
 
-            return final_content;
-            // --- END: DEPRECATED DELTA-LCS PATCH LOGIC ---
+// Parses a tree written in the old text format into a TreeEntry list.
+static TreeEntry* parse_legacy_tree(char* content, size_t size) {
+    TreeEntry* head = NULL;
+    TreeEntry* tail = NULL;
+    char* line = content;
+    while (line < content + size) {
+        char* next_line = strchr(line, '\n');
+        if (next_line) *next_line = '\0';
+        else if (strlen(line) == 0) break;
+        TreeEntry* e = calloc(1, sizeof(TreeEntry));
+        if (!e) { free_tree_list(head); return NULL; }
+        if (sscanf(line, "%o %c %64s E:%lf U:%127[^\t]\t%255[^\n]", 
+                   &e->mode, &e->type, e->hash, &e->entropy, e->author, e->name) != 6) {
+            if (sscanf(line, "%o %c %64s E:%lf\t%255[^\n]", 
+                       &e->mode, &e->type, e->hash, &e->entropy, e->name) != 5) {
+                free(e); if (next_line) line = next_line + 1; else break; continue;
+            }
+            e->author[0] = '\0';
         }
+        if (tail) tail->next = e; else head = e;
+        tail = e;
+        if (next_line) line = next_line + 1; else break;
+    }
+    return head;
+}
 
-        log_msg("Unknown or corrupt object format in %s", hash);
-        free(uncompressed_buf);
+// Takes ownership of data. Returns NULL if it is not a valid tree.
+static Tree* tree_from_payload(const char* hash, char* data, size_t size) {
+    if (size < sizeof(TreeHeader) || memcmp(data, TREE_MAGIC, TREE_MAGIC_LEN) != 0) {
+        // --- Legacy text tree: convert it once ---
+        TreeEntry* entries = parse_legacy_tree(data, size);
+        free(data);
+        data = NULL;
+        if (tree_encode(entries, &data, &size) != 0) { free_tree_list(entries); return NULL; }
+        free_tree_list(entries);
+    }
+
+    const TreeHeader* header = (const TreeHeader*)data;
+    size_t records_size = (size_t)header->count * sizeof(TreeRecord);
+    if (size - sizeof(TreeHeader) < records_size ||
+        size - sizeof(TreeHeader) - records_size != header->pool_size ||
+        (header->pool_size > 0 && data[size - 1] != '\0')) {
+        log_msg("Corrupt tree object %s", hash);
+        free(data);
         return NULL;
     }
+    const TreeRecord* records = (const TreeRecord*)(data + sizeof(TreeHeader));
+    for (uint32_t i = 0; i < header->count; i++) {
+        if (records[i].name_offset >= header->pool_size || records[i].author_offset >= header->pool_size) {
+            log_msg("Corrupt tree object %s", hash);
+            free(data);
+            return NULL;
+        }
+    }
+
+    Tree* tree = calloc(1, sizeof(Tree));
+    if (!tree) { free(data); return NULL; }
+    tree->refs = 1;
+    memcpy(tree->hash, hash, HASH_STR_LEN);
+    tree->count = header->count;
+    tree->records = records;
+    tree->pool = (const char*)(records + header->count);
+    tree->data = data;
+    tree->size = size;
+    return tree;
+}
+
+static void tree_release(Tree* tree) {
+    if (tree && __atomic_sub_fetch(&tree->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        free(tree->data);
+        free(tree);
+    }
+}
+
+/**
+ * @brief Returns the tree with this hash, with a reference the caller
+ * drops with tree_release(). NULL if it cannot be read.
+ */
+static Tree* load_tree(const char* hash) {
+    unsigned bucket = object_cache_bucket(hash) % TREE_CACHE_BUCKETS;
+
+    pthread_mutex_lock(&g_tree_cache.mutex);
+    for (Tree* t = g_tree_cache.buckets[bucket]; t; t = t->cache_next) {
+        if (strcmp(t->hash, hash) == 0) {
+            __atomic_add_fetch(&t->refs, 1, __ATOMIC_RELAXED);
+            pthread_mutex_unlock(&g_tree_cache.mutex);
+            return t;
+        }
+    }
+    pthread_mutex_unlock(&g_tree_cache.mutex);
+
+    size_t size;
+    char* data = read_object(hash, &size);
+    if (!data) return NULL;
+    Tree* tree = tree_from_payload(hash, data, size);
+    if (!tree) return NULL;
+
+    pthread_mutex_lock(&g_tree_cache.mutex);
+    for (Tree* t = g_tree_cache.buckets[bucket]; t; t = t->cache_next) {
+        if (strcmp(t->hash, hash) == 0) { // Another thread loaded it meanwhile
+            __atomic_add_fetch(&t->refs, 1, __ATOMIC_RELAXED);
+            pthread_mutex_unlock(&g_tree_cache.mutex);
+            tree_release(tree);
+            return t;
+        }
+    }
+    if (g_tree_cache.bytes + tree->size > TREE_CACHE_MAX_BYTES) {
+        // Full: start over. Trees still in use live on through their references.
+        for (int i = 0; i < TREE_CACHE_BUCKETS; i++) {
+            Tree* t = g_tree_cache.buckets[i];
+            while (t) {
+                Tree* next = t->cache_next;
+                tree_release(t);
+                t = next;
+            }
+            g_tree_cache.buckets[i] = NULL;
+        }
+        g_tree_cache.bytes = 0;
+    }
+    tree->refs++; // The cache's reference
+    tree->cache_next = g_tree_cache.buckets[bucket];
+    g_tree_cache.buckets[bucket] = tree;
+    g_tree_cache.bytes += tree->size;
+    pthread_mutex_unlock(&g_tree_cache.mutex);
+    return tree;
+}
+
+static inline const char* tree_record_name(const Tree* tree, const TreeRecord* r) {
+    return tree->pool + r->name_offset;
+}
+
+static inline const char* tree_record_author(const Tree* tree, const TreeRecord* r) {
+    return tree->pool + r->author_offset;
+}
+
+static void tree_record_hash(const TreeRecord* r, char* hash_out) {
+    static const char hex[] = "0123456789abcdef";
+    for (int i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        hash_out[i * 2] = hex[r->hash[i] >> 4];
+        hash_out[i * 2 + 1] = hex[r->hash[i] & 0xF];
+    }
+    hash_out[HASH_LEN] = '\0';
+}
+
+// Binary search for a direct child. NULL if absent.
+static const TreeRecord* tree_find(const Tree* tree, const char* name) {
+    size_t lo = 0, hi = tree->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(name, tree_record_name(tree, &tree->records[mid]));
+        if (cmp == 0) return &tree->records[mid];
+        if (cmp < 0) hi = mid; else lo = mid + 1;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Looks up a direct child of a tree by name, of any type.
+ * Returns 0 when found, -1 otherwise. Outputs may be NULL.
+ */
+static int find_tree_entry(const char* tree_hash, const char* name, char* hash_out,
+                           mode_t* mode_out, double* entropy_out, char* type_out)
+{
+    Tree* tree = load_tree(tree_hash);
+    if (!tree) {
+        log_msg("Error: Failed to read tree object: %s", tree_hash);
+        return -1;
+    }
+    const TreeRecord* r = tree_find(tree, name);
+    if (r) {
+        if (hash_out) tree_record_hash(r, hash_out);
+        if (mode_out) *mode_out = r->mode;
+        if (entropy_out) *entropy_out = r->entropy;
+        if (type_out) *type_out = r->type;
+    }
+    tree_release(tree);
+    return r ? 0 : -1;
+}
+
+/**
+ * @brief Copies a tree's records into a TreeEntry list (in name order).
+ * Returns 0 on success (*out is NULL for an empty tree), -1 on error.
+ */
+static int load_tree_entries(const char* tree_hash, TreeEntry** out) {
+    *out = NULL;
+    Tree* tree = load_tree(tree_hash);
+    if (!tree) return -1;
+    TreeEntry* tail = NULL;
+    for (uint32_t i = 0; i < tree->count; i++) {
+        TreeEntry* e = calloc(1, sizeof(TreeEntry));
+        if (!e) { free_tree_list(*out); *out = NULL; tree_release(tree); return -1; }
+        const TreeRecord* r = &tree->records[i];
+        snprintf(e->name, sizeof(e->name), "%s", tree_record_name(tree, r));
+        snprintf(e->author, sizeof(e->author), "%s", tree_record_author(tree, r));
+        tree_record_hash(r, e->hash);
+        e->mode = r->mode;
+        e->type = r->type;
+        e->entropy = r->entropy;
+        if (tail) tail->next = e; else *out = e;
+        tail = e;
+    }
+    tree_release(tree);
+    return 0;
+}
+
+// Serializes a directory's entries (skipping files that failed) into a tree object.
+static int write_tree_object(TreeEntry* head, char* tree_hash_out) {
+    char* payload;
+    size_t size;
+    if (tree_encode(head, &payload, &size) != 0) return -1;
+    get_buffer_hash(payload, size, tree_hash_out);
+    int rc = write_blob_object(tree_hash_out, payload, size); // Trees are BLOBs
+    free(payload);
+    return rc;
 }
 
 
@@ -1564,8 +2704,7 @@ static int write_bblk_object(const char* hash_hex, const char* block_data, size_
     if (obj_path[0] == '\0') return -1;
 
     // Check if file already exists
-    struct stat st;
-    if (stat(obj_path, &st) == 0) {
+    if (object_exists(OBJ_KIND_BBLK, hash_hex, obj_path)) {
         return 0; // Already exists
     }
 
@@ -1577,7 +2716,10 @@ static int write_bblk_object(const char* hash_hex, const char* block_data, size_
     data_size_with_padding += padding_needed;
     // --- End Padding Calculation ---
 
-    FILE* f = fopen(obj_path, "wb");
+    // Deconstruction workers can write the same block at once; each writes its own temp file
+    char tmp_path[PATH_MAX + 32];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%lx.tmp", obj_path, (unsigned long)pthread_self());
+    FILE* f = fopen(tmp_path, "wb");
     if (!f) {
         log_msg("Failed to open .bblk for writing: %s", obj_path);
         return -1;
@@ -1593,19 +2735,19 @@ static int write_bblk_object(const char* hash_hex, const char* block_data, size_
     };
     if (fwrite(&header, sizeof(EBOFv4Header), 1, f) != 1) {
         log_msg("Failed to write EBOFv4Header to %s", obj_path);
-        fclose(f); return -1;
+        fclose(f); unlink(tmp_path); return -1;
     }
 
     // 2. Write Binary Block Header
     if (fwrite(bblk_header, sizeof(BinaryBlockHeader), 1, f) != 1) {
         log_msg("Failed to write BinaryBlockHeader to %s", obj_path);
-        fclose(f); return -1;
+        fclose(f); unlink(tmp_path); return -1;
     }
 
     // 3. Write Data
     if (data_len > 0 && fwrite(block_data, data_len, 1, f) != 1) {
         log_msg("Failed to write block data to %s", obj_path);
-        fclose(f); return -1;
+        fclose(f); unlink(tmp_path); return -1;
     }
 
     // 4. Write 8-byte alignment padding
@@ -1613,11 +2755,15 @@ static int write_bblk_object(const char* hash_hex, const char* block_data, size_
         static const char zero_padding[8] = {0}; // A buffer of null bytes
         if (fwrite(zero_padding, 1, padding_needed, f) != padding_needed) {
             log_msg("Failed to write alignment padding to %s", obj_path);
-            fclose(f); return -1;
+            fclose(f); unlink(tmp_path); return -1;
         }
     }
     
-    fclose(f);
+    if (fclose(f) != 0 || rename(tmp_path, obj_path) != 0) {
+        log_msg("Failed to write .bblk: %s", obj_path);
+        unlink(tmp_path);
+        return -1;
+    }
     return 0;
 }
 
@@ -1628,7 +2774,7 @@ static char* read_bblk_object(const char* hash_hex, size_t* data_len_out,
     get_bblk_object_path(hash_hex, obj_path);
     if (obj_path[0] == '\0') return NULL;
 
-    FILE* f = fopen(obj_path, "rb");
+    FILE* f = open_object_file(OBJ_KIND_BBLK, hash_hex, obj_path);
     if (!f) return NULL; // Don't log, this is a fast path
 
     // 1. Read and verify EBOF v4 Header
@@ -1751,8 +2897,7 @@ static int write_mobj_object(const ManifestData* manifest, char* hash_hex_out) {
     get_mobj_object_path(hash_hex_out, obj_path);
     if (obj_path[0] == '\0') goto error;
 
-    struct stat st;
-    if (stat(obj_path, &st) == 0) {
+    if (object_exists(OBJ_KIND_MOBJ, hash_hex_out, obj_path)) {
         free(payload_buf.buffer);
         return 0; // Already exists
     }
@@ -1790,6 +2935,256 @@ error:
     return -1;
 }
 
+// --- Content-defined chunking ---
+// Boundaries come from a gear hash, h = (h << 1) + gear[byte] (FastCDC). The
+// top bits of h only depend on the last 64 bytes, so cuts fall back into
+// place right after an edit. The cutter runs ahead on the calling thread and
+// hands batches of blocks to workers, which hash, checksum and write them.
+
+static uint64_t g_cdc_gear[256];
+static pthread_once_t g_cdc_gear_once = PTHREAD_ONCE_INIT;
+
+// The table decides every boundary: changing it changes every block hash.
+static void cdc_init_gear(void) {
+    uint64_t x = 0x45584f4455534344ULL; // "EXODUSCD"
+    for (int i = 0; i < 256; i++) {
+        uint64_t z = (x += 0x9e3779b97f4a7c15ULL); // splitmix64
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        g_cdc_gear[i] = z ^ (z >> 31);
+    }
+}
+
+// Returns the length of the block starting at data.
+static size_t cdc_next_cut(const uint8_t* data, size_t len) {
+    if (len <= CDC_MIN_BLOCK) return len;
+    size_t normal = len < CDC_AVG_BLOCK ? len : CDC_AVG_BLOCK;
+    size_t end = len < CDC_MAX_BLOCK ? len : CDC_MAX_BLOCK;
+    uint64_t h = 0;
+    size_t i = CDC_MIN_BLOCK;
+    for (; i < normal; i++) {
+        h = (h << 1) + g_cdc_gear[data[i]];
+        if (!(h & CDC_MASK_STRICT)) return i + 1;
+    }
+    for (; i < end; i++) {
+        h = (h << 1) + g_cdc_gear[data[i]];
+        if (!(h & CDC_MASK_LOOSE)) return i + 1;
+    }
+    return end;
+}
+
+// Open-addressed lookups into the parent manifest's blocks, by hash and by offset.
+typedef struct OldBlockIndex {
+    const ManifestBlockEntry* blocks;
+    uint32_t* by_hash;          // Block numbers, UINT32_MAX when empty
+    uint32_t* by_offset;
+    int bits;
+} OldBlockIndex;
+
+static size_t old_block_slot(uint64_t key, int bits) {
+    return (size_t)((key * 0x9e3779b97f4a7c15ULL) >> (64 - bits));
+}
+
+static uint64_t old_block_hash_key(const uint8_t* hash_raw) {
+    uint64_t key;
+    memcpy(&key, hash_raw, sizeof(key));
+    return key;
+}
+
+static int old_block_index_init(OldBlockIndex* index, const ManifestData* manifest) {
+    int bits = 4;
+    while (((size_t)1 << bits) < (size_t)manifest->block_count * 2) bits++;
+    size_t slots = (size_t)1 << bits;
+    index->blocks = manifest->blocks;
+    index->bits = bits;
+    index->by_hash = malloc(slots * sizeof(uint32_t));
+    index->by_offset = malloc(slots * sizeof(uint32_t));
+    if (!index->by_hash || !index->by_offset) {
+        free(index->by_hash);
+        free(index->by_offset);
+        return -1;
+    }
+    memset(index->by_hash, 0xFF, slots * sizeof(uint32_t));
+    memset(index->by_offset, 0xFF, slots * sizeof(uint32_t));
+    size_t mask = slots - 1;
+    for (uint32_t i = 0; i < manifest->block_count; i++) {
+        size_t s = old_block_slot(old_block_hash_key(manifest->blocks[i].block_hash), bits);
+        while (index->by_hash[s] != UINT32_MAX) s = (s + 1) & mask;
+        index->by_hash[s] = i;
+        s = old_block_slot(manifest->blocks[i].offset, bits);
+        while (index->by_offset[s] != UINT32_MAX) s = (s + 1) & mask;
+        index->by_offset[s] = i;
+    }
+    return 0;
+}
+
+static void old_block_index_free(OldBlockIndex* index) {
+    free(index->by_hash);
+    free(index->by_offset);
+}
+
+static int old_block_has_hash(const OldBlockIndex* index, const uint8_t* hash_raw) {
+    size_t mask = ((size_t)1 << index->bits) - 1;
+    for (size_t s = old_block_slot(old_block_hash_key(hash_raw), index->bits);
+         index->by_hash[s] != UINT32_MAX; s = (s + 1) & mask) {
+        if (memcmp(index->blocks[index->by_hash[s]].block_hash, hash_raw, 32) == 0) return 1;
+    }
+    return 0;
+}
+
+// The first old block (in manifest order) that started at offset, or NULL.
+static const ManifestBlockEntry* old_block_at(const OldBlockIndex* index, uint64_t offset) {
+    size_t mask = ((size_t)1 << index->bits) - 1;
+    const ManifestBlockEntry* found = NULL;
+    for (size_t s = old_block_slot(offset, index->bits);
+         index->by_offset[s] != UINT32_MAX; s = (s + 1) & mask) {
+        const ManifestBlockEntry* e = &index->blocks[index->by_offset[s]];
+        if (e->offset == offset && (!found || e < found)) found = e;
+    }
+    return found;
+}
+
+typedef struct CdcBatch {
+    size_t count;
+    double entropy_sum;
+    size_t linked;              // Blocks that got a parent block
+    int failed;
+    int done;
+    struct CdcBatch* queue_next;
+    struct CdcBatch* order_next;
+    ManifestBlockEntry blocks[CDC_BATCH_BLOCKS]; // offset/length from the cutter, hash from the worker
+} CdcBatch;
+
+typedef struct CdcPool {
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;   // Batch queued or closing
+    pthread_cond_t done_cond;   // Batch finished
+    CdcBatch* head;
+    CdcBatch* tail;
+    int in_flight;              // Queued or being processed
+    int closing;
+    const char* file_data;
+    const OldBlockIndex* old_index;
+    int thread_count;
+    pthread_t* threads;
+} CdcPool;
+
+static int commit_workers_from_env(void);
+
+static void cdc_process_batch(CdcPool* pool, CdcBatch* batch) {
+    for (size_t i = 0; i < batch->count && !batch->failed; i++) {
+        ManifestBlockEntry* e = &batch->blocks[i];
+        const char* block_data = pool->file_data + e->offset;
+        size_t block_len = (size_t)e->length;
+        char hash_hex[HASH_STR_LEN];
+
+        sha256_buffer((const uint8_t*)block_data, block_len, e->block_hash);
+        hex_encode(e->block_hash, SHA256_BLOCK_SIZE, hash_hex);
+
+        double entropy = calculate_entropy(block_data, block_len);
+        batch->entropy_sum += entropy;
+
+        BinaryBlockHeader bblk_header = {0}; // Zeros parent_block_hash by default
+        bblk_header.entropy_score = (float)entropy;
+        bblk_header.original_offset = e->offset;
+        bblk_header.original_length = block_len;
+        bblk_header.crc32_checksum = crc32(0L, (const Bytef*)block_data, block_len);
+
+        // A block the parent already had needs no link; a new one is linked
+        // to whatever the parent stored at the same offset (its "level").
+        if (pool->old_index && !old_block_has_hash(pool->old_index, e->block_hash)) {
+            const ManifestBlockEntry* old = old_block_at(pool->old_index, e->offset);
+            if (old) {
+                memcpy(bblk_header.parent_block_hash, old->block_hash, 32);
+                batch->linked++;
+            }
+        }
+
+        if (write_bblk_object(hash_hex, block_data, block_len, &bblk_header) != 0) {
+            log_msg("Failed to write binary block: %s", hash_hex);
+            batch->failed = 1;
+        }
+    }
+}
+
+static void* cdc_worker_func(void* arg) {
+    CdcPool* pool = arg;
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (!pool->head && !pool->closing) pthread_cond_wait(&pool->work_cond, &pool->mutex);
+        CdcBatch* batch = pool->head;
+        if (!batch) break;
+        pool->head = batch->queue_next;
+        if (!pool->head) pool->tail = NULL;
+        pthread_mutex_unlock(&pool->mutex);
+
+        cdc_process_batch(pool, batch);
+
+        pthread_mutex_lock(&pool->mutex);
+        batch->done = 1;
+        pool->in_flight--;
+        pthread_cond_broadcast(&pool->done_cond);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+static void cdc_pool_start(CdcPool* pool, const char* file_data, const OldBlockIndex* old_index) {
+    memset(pool, 0, sizeof(*pool));
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+    pool->file_data = file_data;
+    pool->old_index = old_index;
+
+    int workers = commit_workers_from_env();
+    if (workers <= 1) return;
+    pool->threads = malloc(sizeof(pthread_t) * (size_t)workers);
+    if (!pool->threads) return;
+    for (int i = 0; i < workers; i++) {
+        if (pthread_create(&pool->threads[i], NULL, cdc_worker_func, pool) != 0) break;
+        pool->thread_count++;
+    }
+}
+
+// Queues a batch, waiting while every worker has two; without workers it runs here.
+static void cdc_pool_submit(CdcPool* pool, CdcBatch* batch) {
+    if (pool->thread_count == 0) {
+        cdc_process_batch(pool, batch);
+        batch->done = 1;
+        return;
+    }
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->in_flight >= pool->thread_count * 2) pthread_cond_wait(&pool->done_cond, &pool->mutex);
+    batch->queue_next = NULL;
+    if (pool->tail) pool->tail->queue_next = batch; else pool->head = batch;
+    pool->tail = batch;
+    pool->in_flight++;
+    pthread_cond_signal(&pool->work_cond);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+static int cdc_batch_done(CdcPool* pool, CdcBatch* batch, int wait) {
+    if (pool->thread_count == 0) return 1;
+    pthread_mutex_lock(&pool->mutex);
+    while (wait && !batch->done) pthread_cond_wait(&pool->done_cond, &pool->mutex);
+    int done = batch->done;
+    pthread_mutex_unlock(&pool->mutex);
+    return done;
+}
+
+static void cdc_pool_stop(CdcPool* pool) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->closing = 1;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->mutex);
+    for (int i = 0; i < pool->thread_count; i++) pthread_join(pool->threads[i], NULL);
+    free(pool->threads);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_mutex_destroy(&pool->mutex);
+}
+
 static int deconstruct_file(const char* fpath, size_t fsize, uint32_t file_mode, 
                             const char* relative_path, char* manifest_hash_out, 
                             float* entropy_mean_out, const char* old_manifest_hash)
@@ -1808,10 +3203,16 @@ static int deconstruct_file(const char* fpath, size_t fsize, uint32_t file_mode,
     }
 
     ManifestData* old_manifest = NULL;
+    OldBlockIndex old_index;
     if (old_manifest_hash) {
-    old_manifest = read_mobj_object(old_manifest_hash);
-    if (old_manifest) {
-        log_msg("  > Comparing against %u blocks from parent manifest.", old_manifest->block_count);
+        old_manifest = read_mobj_object(old_manifest_hash);
+        if (old_manifest && old_block_index_init(&old_index, old_manifest) != 0) {
+            log_msg("Warning: Out of memory indexing the parent manifest. Blocks get no parent links.");
+            free_manifest_data(old_manifest);
+            old_manifest = NULL;
+        }
+        if (old_manifest) {
+            log_msg("  > Comparing against %u blocks from parent manifest.", old_manifest->block_count);
         }
     }
 
@@ -1819,6 +3220,7 @@ static int deconstruct_file(const char* fpath, size_t fsize, uint32_t file_mode,
     int fd = open(fpath, O_RDONLY);
     if (fd == -1) {
         log_msg("Failed to open file for mmap: %s", fpath);
+        if (old_manifest) { old_block_index_free(&old_index); free_manifest_data(old_manifest); }
         return -1;
     }
     
@@ -1827,134 +3229,90 @@ static int deconstruct_file(const char* fpath, size_t fsize, uint32_t file_mode,
     
     if (file_data == MAP_FAILED) {
         log_msg("Failed to mmap file: %s", fpath);
+        if (old_manifest) { old_block_index_free(&old_index); free_manifest_data(old_manifest); }
         return -1;
     }
+    madvise((void*)file_data, fsize, MADV_SEQUENTIAL);
 
-    // --- 3. Scan file and find content-defined boundaries ---
+    // --- 3. Cut the file into blocks; workers hash and write them ---
     log_msg("  > Deconstructing %s (%.1fMB)...", relative_path, (double)fsize / (1024.0*1024.0));
-    
-    ManifestBlockList block_list = {0};
-    uint32_t rolling_hash = 0;
-    size_t block_start = 0;
-    double total_entropy_sum = 0.0;
-
-    // We scan byte by byte
-    for (size_t scan_pos = 0; scan_pos < fsize; scan_pos++) {
-        size_t current_block_len = (scan_pos - block_start) + 1;
-        
-        // We can't calculate a hash until we have a full window
-        if (current_block_len < CDC_WINDOW_SIZE) {
-            // But if it's the end of the file, we must take what we have
-            if (scan_pos == fsize - 1) {
-                goto found_boundary; // Force final block
-            }
-            continue; // Not enough data for a hash yet
-        }
-        
-        // --- Calculate/Roll the hash ---
-        if (current_block_len == CDC_WINDOW_SIZE) {
-            // Calculate full hash for the first window of this block
-            rolling_hash = adler32_checksum(file_data + block_start, CDC_WINDOW_SIZE);
-        } else {
-            // Roll the hash forward
-            rolling_hash = adler32_roll(
-                rolling_hash,
-                (uint8_t)file_data[scan_pos - CDC_WINDOW_SIZE],
-                (uint8_t)file_data[scan_pos],
-                CDC_WINDOW_SIZE
-            );
-        }
-
-        // --- Check for a boundary ---
-        int at_min_size = (current_block_len >= CDC_MIN_BLOCK);
-        int at_target   = (rolling_hash & CDC_MASK) == CDC_TARGET;
-        int at_max_size = (current_block_len == CDC_MAX_BLOCK);
-        int at_eof      = (scan_pos == fsize - 1);
-
-if (at_eof || at_max_size || (at_min_size && at_target)) {
-    found_boundary:; // Label for goto
-        size_t block_len = current_block_len;
-        const char* block_data = file_data + block_start;
-        uint64_t block_offset = (uint64_t)block_start;
-
-        // --- 4. Process the block ---
-        uint8_t hash_raw[SHA256_BLOCK_SIZE];
-        char hash_hex[HASH_STR_LEN];
+    pthread_once(&g_cdc_gear_once, cdc_init_gear);
 
-        sha256_buffer((const uint8_t*)block_data, block_len, hash_raw);
-        hex_encode(hash_raw, SHA256_BLOCK_SIZE, hash_hex);
+    CdcPool pool;
+    cdc_pool_start(&pool, file_data, old_manifest ? &old_index : NULL);
 
-        double entropy = calculate_entropy(block_data, block_len);
-        total_entropy_sum += entropy;
-
-        // Populate the .bblk header
-        BinaryBlockHeader bblk_header = {0}; // Zeros parent_block_hash by default
-        bblk_header.entropy_score = (float)entropy;
-        bblk_header.original_offset = block_offset;
-        bblk_header.original_length = block_len;
-        bblk_header.crc32_checksum = crc32(0L, (const Bytef*)block_data, block_len);
-
-        //Find parent block hash (This is your "level" logic) ---
-        if (old_manifest) {
-            int hash_found_in_old = 0;
-            // Check if this *exact block* already existed (content-addressing)
-            // If so, it's not "new" and doesn't need a parent link.
-            for (uint32_t i = 0; i < old_manifest->block_count; i++) {
-                if (memcmp(old_manifest->blocks[i].block_hash, hash_raw, 32) == 0) {
-                    hash_found_in_old = 1;
-                    break;
-                }
+    ManifestBlockList block_list = {0};
+    double total_entropy_sum = 0.0;
+    size_t linked = 0;
+    int failed = 0;
+    CdcBatch* first = NULL; // Submitted but not yet in block_list, in file order
+    CdcBatch* last = NULL;
+    size_t pos = 0;
+
+    while (!failed && (pos < fsize || first)) {
+        if (pos < fsize) {
+            CdcBatch* batch = malloc(sizeof(CdcBatch));
+            if (!batch) {
+                log_msg("Failed to allocate memory for a block batch");
+                failed = 1;
+                break;
             }
-
-            // If it's a new or modified block, find what it replaces
-            if (!hash_found_in_old) {
-                // Find a block in the old manifest that started at the *same offset*
-                for (uint32_t i = 0; i < old_manifest->block_count; i++) {
-                    if (old_manifest->blocks[i].offset == block_offset) {
-
-                        // We link this new block's header to the old block's hash.
-                        memcpy(bblk_header.parent_block_hash, old_manifest->blocks[i].block_hash, 32);
-
-                        // This log message shows the "level" link being created
-                        char parent_hash_hex[HASH_STR_LEN];
-                        hex_encode(old_manifest->blocks[i].block_hash, 32, parent_hash_hex);
-                        log_msg("    > Block %s (New) replaces %s (Old/Level1) at offset %llu",
-                                hash_hex, parent_hash_hex, (unsigned long long)block_offset);
-                        break;
-                    }
-                }
+            batch->count = 0;
+            batch->entropy_sum = 0.0;
+            batch->linked = 0;
+            batch->failed = 0;
+            batch->done = 0;
+            batch->order_next = NULL;
+            while (batch->count < CDC_BATCH_BLOCKS && pos < fsize) {
+                size_t len = cdc_next_cut((const uint8_t*)file_data + pos, fsize - pos);
+                batch->blocks[batch->count].offset = pos;
+                batch->blocks[batch->count].length = len;
+                batch->count++;
+                pos += len;
             }
+            if (last) last->order_next = batch; else first = batch;
+            last = batch;
+            cdc_pool_submit(&pool, batch);
         }
 
-
-        // Write the .bblk object to disk.
-        // It's saved at its hash location, *with* the parent hash inside it.
-        if (write_bblk_object(hash_hex, block_data, block_len, &bblk_header) != 0) {
-            log_msg("Failed to write binary block: %s", hash_hex);
-            munmap((void*)file_data, fsize);
-            free(block_list.blocks);
-            if (old_manifest) free_manifest_data(old_manifest);
-            return -1;
-        }
-
-        // Add this block to our in-memory manifest list
-        if (append_manifest_block(&block_list, hash_raw, block_offset, block_len) != 0) {
-            munmap((void*)file_data, fsize);
-            free(block_list.blocks);
-            if (old_manifest) free_manifest_data(old_manifest);
-            return -1;
+        // Move finished batches into the manifest, in file order. Once the
+        // whole file is cut, wait for the rest.
+        while (first && cdc_batch_done(&pool, first, pos >= fsize)) {
+            CdcBatch* batch = first;
+            first = batch->order_next;
+            if (!first) last = NULL;
+            if (batch->failed) failed = 1;
+            total_entropy_sum += batch->entropy_sum;
+            linked += batch->linked;
+            for (size_t i = 0; i < batch->count && !failed; i++) {
+                const ManifestBlockEntry* e = &batch->blocks[i];
+                if (append_manifest_block(&block_list, e->block_hash, e->offset, e->length) != 0) failed = 1;
+            }
+            free(batch);
+            if (failed) break;
         }
+    }
 
-        // Start the next block
-        block_start = scan_pos + 1;
-        rolling_hash = 0;
+    cdc_pool_stop(&pool);
+    while (first) {
+        CdcBatch* next = first->order_next;
+        free(first);
+        first = next;
     }
-}
-    
-    // --- 5. Cleanup mmap ---
+
+    // --- 4. Cleanup mmap ---
     munmap((void*)file_data, fsize);
+    if (old_manifest) {
+        if (linked > 0) log_msg("  > %zu new blocks linked to the parent blocks they replace.", linked);
+        old_block_index_free(&old_index);
+        free_manifest_data(old_manifest);
+    }
+    if (failed) {
+        free(block_list.blocks);
+        return -1;
+    }
 
-    // --- 6. Create and write the final manifest object ---
+    // --- 5. Create and write the final manifest object ---
     ManifestData manifest = {0};
     manifest.file_path = (char*)relative_path; // This is safe, life-cycle is OK
     manifest.file_mode = file_mode;
@@ -1965,13 +3323,9 @@ if (at_eof || at_max_size || (at_min_size && at_target)) {
 
     int result = write_mobj_object(&manifest, manifest_hash_out);
 
-    if (old_manifest) {
-        free_manifest_data(old_manifest);
-    }
-
     *entropy_mean_out = manifest.entropy_mean;
     
-    // --- 7. Final cleanup ---
+    // --- 6. Final cleanup ---
     free(block_list.blocks); // The blocks array is now owned by the manifest
     
     if (result == 0) {
@@ -1986,7 +3340,7 @@ static ManifestData* read_mobj_object(const char* hash_hex) {
     get_mobj_object_path(hash_hex, obj_path);
     if (obj_path[0] == '\0') return NULL;
 
-    FILE* f = fopen(obj_path, "rb");
+    FILE* f = open_object_file(OBJ_KIND_MOBJ, hash_hex, obj_path);
     if (!f) return NULL; // Don't log, fast path
 
     // 1. Read and verify EBOF v4 Header
@@ -2049,98 +3403,485 @@ static ManifestData* read_mobj_object(const char* hash_hex) {
     return manifest;
 }
 
-static int reconstruct_file_from_manifest(const ManifestData* manifest, const char* dest_path) {
-    // --- 1. Verify Manifest Integrity ---
+// --- Parallel restore ---
+// Rebuild and checkout walk trees on the calling thread: directories are
+// created and stale entries removed in tree order, and every file to write
+// is queued. A worker writes the file into a hidden temp file next to its
+// target and renames it into place, so nothing ever sees half a file.
+// Manifests are split into runs of blocks that any worker can take; a run
+// pwrite()s each block at its offset, and whoever finishes a file's last
+// run renames it. The file is preallocated up front, and all-zero blocks
+// are never written: their ranges are punched back out as holes.
+//
+// Directory modes are applied after the last file is written, deepest
+// first, so a read-only directory does not lock out its own files.
+
+#define RESTORE_RUN_BLOCKS 256          // Manifest blocks per work item
+#define RESTORE_QUEUE_MAX 1024          // Queued files before the walker waits
+#define RESTORE_COPY_CHUNK (1024 * 1024)
+
+typedef struct RestoreFile {
+    const ManifestData* manifest;
+    ManifestData* owned;                // Freed with the file, or NULL
+    int fd;
+    int failed;
+    int pending;                        // Unfinished runs + the splitter
+    char tmp_path[PATH_MAX];
+    char dest_path[];
+} RestoreFile;
+
+typedef struct RestoreJob {
+    char type;                          // 'B', 'L', 'M', or 'R' (a run of a manifest)
+    mode_t mode;
+    RestoreFile* file;                  // 'R' only
+    uint32_t first_block;
+    uint32_t block_count;
+    struct RestoreJob* next;
+    char hash[HASH_STR_LEN];
+    char dest_path[];
+} RestoreJob;
+
+typedef struct RestoreDir {
+    mode_t mode;
+    struct RestoreDir* next;
+    char path[];
+} RestoreDir;
+
+typedef struct RestorePool {
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;           // Jobs queued or closing
+    pthread_cond_t space_cond;          // Walker queue shrank
+    RestoreJob* head;
+    RestoreJob* tail;
+    size_t depth;                       // Files queued by the walker
+    int closing;
+    int failed;
+    int thread_count;
+    pthread_t* threads;
+    RestoreDir* dirs;                   // Walker only; newest (deepest) first
+} RestorePool;
+
+static RestorePool g_restore_pool = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .work_cond = PTHREAD_COND_INITIALIZER,
+    .space_cond = PTHREAD_COND_INITIALIZER
+};
+
+static void restore_fail(void) {
+    pthread_mutex_lock(&g_restore_pool.mutex);
+    g_restore_pool.failed = 1;
+    pthread_mutex_unlock(&g_restore_pool.mutex);
+}
+
+static int pwrite_all(int fd, const char* buf, size_t len, off_t offset) {
+    while (len > 0) {
+        ssize_t w = pwrite(fd, buf, len, offset);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += w;
+        len -= (size_t)w;
+        offset += w;
+    }
+    return 0;
+}
+
+static int is_zero_block(const char* data, size_t len) {
+    static const char zeros[4096];
+    while (len > 0) {
+        size_t n = len < sizeof(zeros) ? len : sizeof(zeros);
+        if (memcmp(data, zeros, n) != 0) return 0;
+        data += n;
+        len -= n;
+    }
+    return 1;
+}
+
+// Names a hidden temp file in dest_path's directory.
+static void restore_temp_name(const char* dest_path, char* tmp_path, size_t size) {
+    static unsigned long counter = 0;
+    unsigned long n = __atomic_add_fetch(&counter, 1, __ATOMIC_RELAXED);
+    const char* slash = strrchr(dest_path, '/');
+    if (slash) snprintf(tmp_path, size, "%.*s/.exodus-restore-%ld-%lu", (int)(slash - dest_path), dest_path, (long)getpid(), n);
+    else snprintf(tmp_path, size, ".exodus-restore-%ld-%lu", (long)getpid(), n);
+}
+
+static int restore_open_temp(const char* dest_path, char* tmp_path, size_t size) {
+    restore_temp_name(dest_path, tmp_path, size);
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0) log_msg("Failed to create temp file for '%s': %s", dest_path, strerror(errno));
+    return fd;
+}
+
+// Sets the mode, closes fd and renames the temp file over dest_path.
+static int restore_commit_temp(int fd, const char* tmp_path, const char* dest_path, mode_t mode, int ok) {
+    if (ok && fchmod(fd, mode & 07777) != 0) {
+        log_msg("Warning: Failed to chmod '%s': %s", dest_path, strerror(errno));
+    }
+    if (close(fd) != 0) ok = 0;
+    if (ok && rename(tmp_path, dest_path) != 0) {
+        log_msg("Failed to move restored file into place at '%s': %s", dest_path, strerror(errno));
+        ok = 0;
+    }
+    if (!ok) unlink(tmp_path);
+    return ok ? 0 : -1;
+}
+
+static int restore_blob(const char* hash, mode_t mode, const char* dest_path) {
+    char tmp_path[PATH_MAX];
+    int fd = restore_open_temp(dest_path, tmp_path, sizeof(tmp_path));
+    if (fd < 0) return -1;
+
+    // Full blobs are inflated straight into the file; deltas are rebuilt in memory
+    int ok = 0;
+    ObjectStream s;
+    if (object_stream_open(&s, hash) == 0) {
+        char header[5];
+        if (object_stream_read(&s, header, 5) == 5 && memcmp(header, "BLOB\0", 5) == 0) {
+            char* buf = malloc(RESTORE_COPY_CHUNK);
+            ok = buf != NULL;
+            off_t offset = 0;
+            ssize_t n;
+            while (ok && (n = object_stream_read(&s, buf, RESTORE_COPY_CHUNK)) != 0) {
+                if (n < 0 || pwrite_all(fd, buf, (size_t)n, offset) != 0) ok = 0;
+                offset += n;
+            }
+            free(buf);
+            object_stream_close(&s);
+            return restore_commit_temp(fd, tmp_path, dest_path, mode, ok);
+        }
+        object_stream_close(&s);
+    }
+
+    size_t size;
+    char* content = read_object(hash, &size);
+    if (content) {
+        ok = pwrite_all(fd, content, size, 0) == 0;
+        free(content);
+    }
+    return restore_commit_temp(fd, tmp_path, dest_path, mode, ok);
+}
+
+// Links are made under a temp name too, so an updated link replaces the old one.
+static int restore_link(const char* hash, const char* dest_path) {
+    size_t target_size;
+    char* target = read_object(hash, &target_size);
+    if (!target) return -1;
+    target[target_size] = '\0'; // read_object should do this, but for safety
+
+    char tmp_path[PATH_MAX];
+    restore_temp_name(dest_path, tmp_path, sizeof(tmp_path));
+    int rc = symlink(target, tmp_path);
+    free(target);
+    if (rc == 0 && rename(tmp_path, dest_path) != 0) {
+        unlink(tmp_path);
+        rc = -1;
+    }
+    if (rc != 0) log_msg("Failed to create symlink '%s': %s", dest_path, strerror(errno));
+    return rc;
+}
+
+// Drops one reference; the last one renames the file into place. Returns -1
+// if this call finished a file that failed.
+static int restore_file_release(RestoreFile* file) {
+    if (__atomic_sub_fetch(&file->pending, 1, __ATOMIC_ACQ_REL) != 0) return 0;
+    int failed = __atomic_load_n(&file->failed, __ATOMIC_ACQUIRE);
+    int rc = restore_commit_temp(file->fd, file->tmp_path, file->dest_path, file->manifest->file_mode, !failed);
+    if (rc != 0) log_msg("Error: Failed to reconstruct %s", file->dest_path);
+    if (file->owned) free_manifest_data(file->owned);
+    free(file);
+    return rc;
+}
+
+static int restore_run(RestoreFile* file, uint32_t first, uint32_t count) {
+    const ManifestData* manifest = file->manifest;
+    for (uint32_t i = first; i < first + count && !__atomic_load_n(&file->failed, __ATOMIC_RELAXED); i++) {
+        const ManifestBlockEntry* entry = &manifest->blocks[i];
+        char hash_hex[HASH_STR_LEN];
+        hex_encode(entry->block_hash, 32, hash_hex);
+
+        if (entry->offset > manifest->total_size || entry->length > manifest->total_size - entry->offset) {
+            log_msg("Error: Block %s lies outside %s", hash_hex, file->dest_path);
+            __atomic_store_n(&file->failed, 1, __ATOMIC_RELEASE);
+            break;
+        }
+
+        size_t block_data_len = 0;
+        // read_bblk_object verifies the CRC32
+        char* block_data = read_bblk_object(hash_hex, &block_data_len, NULL);
+        if (!block_data || block_data_len != entry->length) {
+            log_msg("Error: Failed to read block %s or length mismatch (expected %llu, got %zu)",
+                    hash_hex, (unsigned long long)entry->length, block_data_len);
+            free(block_data);
+            __atomic_store_n(&file->failed, 1, __ATOMIC_RELEASE);
+            break;
+        }
+
+        int rc = 0;
+        if (is_zero_block(block_data, block_data_len)) {
+            // Already reads as zeros; just hand the preallocated space back
+            fallocate(file->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)entry->offset, (off_t)block_data_len);
+        } else {
+            rc = pwrite_all(file->fd, block_data, block_data_len, (off_t)entry->offset);
+        }
+        free(block_data);
+        if (rc != 0) {
+            log_msg("Error: Write failed for block %s in %s: %s", hash_hex, file->dest_path, strerror(errno));
+            __atomic_store_n(&file->failed, 1, __ATOMIC_RELEASE);
+            break;
+        }
+    }
+    return restore_file_release(file);
+}
+
+static int verify_manifest_signature(const ManifestData* manifest) {
     // (This checks the *list* of blocks, not the file content)
     uint8_t computed_sig[SHA256_BLOCK_SIZE];
-    size_t blocks_size = sizeof(ManifestBlockEntry) * manifest->block_count;
-    
     if (manifest->block_count > 0) {
-        sha256_buffer((const uint8_t*)manifest->blocks, blocks_size, computed_sig);
+        sha256_buffer((const uint8_t*)manifest->blocks, sizeof(ManifestBlockEntry) * manifest->block_count, computed_sig);
     } else {
         memset(computed_sig, 0, SHA256_BLOCK_SIZE);
     }
-    
     // We compare the first 32 bytes of the 64-byte signature field
     if (memcmp(manifest->file_signature, computed_sig, SHA256_BLOCK_SIZE) != 0) {
         log_msg("Error: MANIFEST CORRUPTION detected for %s", manifest->file_path);
         log_msg("  > Manifest signature does not match block list. File may be tampered.");
         return -1;
     }
-    // --- End Integrity Check ---
+    return 0;
+}
 
-    // --- 2. Reconstruct File ---
-    if (manifest->block_count == 0) {
-        // Handle zero-byte file
-        FILE* f_empty = fopen(dest_path, "wb");
-        if (!f_empty) {
-            log_msg("Failed to create empty file at %s", dest_path);
-            return -1;
-        }
-        fclose(f_empty);
-        chmod(dest_path, manifest->file_mode);
-        return 0;
+static void restore_push(RestoreJob* job, int from_walker);
+
+/**
+ * @brief Reassembles a manifest into dest_path. With workers running (and
+ * owned set, so the manifest outlives this call) the runs are queued and
+ * this returns at once; otherwise they run here.
+ */
+static int restore_manifest(const ManifestData* manifest, ManifestData* owned, const char* dest_path) {
+    if (verify_manifest_signature(manifest) != 0) {
+        if (owned) free_manifest_data(owned);
+        return -1;
     }
 
-    FILE* f = fopen(dest_path, "wb");
-    if (!f) {
-        log_msg("Failed to open destination file for reconstruction: %s", dest_path);
+    RestoreFile* file = calloc(1, sizeof(RestoreFile) + strlen(dest_path) + 1);
+    if (!file) {
+        if (owned) free_manifest_data(owned);
+        return -1;
+    }
+    strcpy(file->dest_path, dest_path);
+    file->manifest = manifest;
+    file->owned = owned;
+    file->fd = restore_open_temp(dest_path, file->tmp_path, sizeof(file->tmp_path));
+    if (file->fd < 0) {
+        if (owned) free_manifest_data(owned);
+        free(file);
         return -1;
     }
 
-    log_msg("  > Reassembling %s from %u blocks...", manifest->file_path, manifest->block_count);
+    if (manifest->total_size > 0) {
+        // Reserve the whole file at once (unsupported filesystems just skip it)
+        if (ftruncate(file->fd, (off_t)manifest->total_size) != 0 ||
+            (fallocate(file->fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)manifest->total_size) != 0 &&
+             errno != EOPNOTSUPP && errno != ENOSYS)) {
+            log_msg("Error: Could not allocate %s: %s", dest_path, strerror(errno));
+            file->failed = 1;
+        }
+        log_msg("  > Reassembling %s from %u blocks...", manifest->file_path, manifest->block_count);
+    }
+
+    int queue = owned && g_restore_pool.thread_count > 0;
+    uint32_t runs = (manifest->block_count + RESTORE_RUN_BLOCKS - 1) / RESTORE_RUN_BLOCKS;
+    file->pending = (int)runs + 1;
+    int rc = 0;
+    for (uint32_t r = 0; r < runs; r++) {
+        uint32_t first = r * RESTORE_RUN_BLOCKS;
+        uint32_t count = manifest->block_count - first < RESTORE_RUN_BLOCKS ? manifest->block_count - first : RESTORE_RUN_BLOCKS;
+        RestoreJob* job = queue ? calloc(1, sizeof(RestoreJob) + 1) : NULL;
+        if (!job) {
+            if (restore_run(file, first, count) != 0) rc = -1;
+            continue;
+        }
+        job->type = 'R';
+        job->file = file;
+        job->first_block = first;
+        job->block_count = count;
+        restore_push(job, 0);
+    }
+    // Whoever drops the last reference (here when nothing was queued) renames the file
+    if (restore_file_release(file) != 0) rc = -1;
+    return rc;
+}
 
-    for (uint32_t i = 0; i < manifest->block_count; i++) {
-        ManifestBlockEntry* entry = &manifest->blocks[i];
-        
-        char hash_hex[HASH_STR_LEN];
-        hex_encode(entry->block_hash, 32, hash_hex);
-        
-        size_t block_data_len = 0;
-        // The read_bblk_object function now internally verifies the CRC32
-        char* block_data = read_bblk_object(hash_hex, &block_data_len, NULL); 
-        
-        if (!block_data || block_data_len != entry->length) {
-            log_msg("Error: Failed to read block %s or length mismatch (expected %llu, got %zu)", 
-                    hash_hex, (unsigned long long)entry->length, block_data_len);
-            if (block_data) free(block_data);
-            fclose(f);
-            remove(dest_path); // Delete partial file
-            return -1;
+static int reconstruct_file_from_manifest(const ManifestData* manifest, const char* dest_path) {
+    return restore_manifest(manifest, NULL, dest_path);
+}
+
+static int run_restore_job(RestoreJob* job) {
+    int rc = 0;
+    switch (job->type) {
+        case 'B':
+            rc = restore_blob(job->hash, job->mode, job->dest_path);
+            break;
+        case 'L':
+            rc = restore_link(job->hash, job->dest_path);
+            break;
+        case 'M': {
+            ManifestData* manifest = read_mobj_object(job->hash);
+            if (!manifest) {
+                log_msg("Error: Failed to read manifest object %s", job->hash);
+                rc = -1;
+            } else if (restore_manifest(manifest, manifest, job->dest_path) != 0) {
+                log_msg("Error: Failed to reconstruct file from manifest %s", job->hash);
+                rc = -1;
+            }
+            break;
         }
+        case 'R':
+            rc = restore_run(job->file, job->first_block, job->block_count);
+            break;
+        default:
+            log_msg("Error: Unknown type '%c' for unpack: %s", job->type, job->dest_path);
+            rc = -1;
+    }
+    return rc;
+}
 
-        // Seek to the correct offset and write the block
-        if (fseek(f, entry->offset, SEEK_SET) != 0) {
-            log_msg("Error: fseek failed for offset %llu in %s", (unsigned long long)entry->offset, dest_path);
-            free(block_data);
-            fclose(f);
-            remove(dest_path);
-            return -1;
+static void* restore_worker_func(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&g_restore_pool.mutex);
+    for (;;) {
+        while (!g_restore_pool.head && !g_restore_pool.closing) {
+            pthread_cond_wait(&g_restore_pool.work_cond, &g_restore_pool.mutex);
+        }
+        RestoreJob* job = g_restore_pool.head;
+        if (!job) break;
+        g_restore_pool.head = job->next;
+        if (!g_restore_pool.head) g_restore_pool.tail = NULL;
+        if (job->type != 'R') {
+            g_restore_pool.depth--;
+            pthread_cond_signal(&g_restore_pool.space_cond);
         }
+        pthread_mutex_unlock(&g_restore_pool.mutex);
+
+        if (run_restore_job(job) != 0) restore_fail();
+        free(job);
+
+        pthread_mutex_lock(&g_restore_pool.mutex);
+    }
+    pthread_mutex_unlock(&g_restore_pool.mutex);
+    return NULL;
+}
+
+// Runs of a manifest go to the front, so a started file finishes before new ones start.
+static void restore_push(RestoreJob* job, int from_walker) {
+    pthread_mutex_lock(&g_restore_pool.mutex);
+    if (from_walker) {
+        while (g_restore_pool.depth >= RESTORE_QUEUE_MAX) {
+            pthread_cond_wait(&g_restore_pool.space_cond, &g_restore_pool.mutex);
+        }
+        g_restore_pool.depth++;
+        job->next = NULL;
+        if (g_restore_pool.tail) g_restore_pool.tail->next = job; else g_restore_pool.head = job;
+        g_restore_pool.tail = job;
+    } else {
+        job->next = g_restore_pool.head;
+        g_restore_pool.head = job;
+        if (!g_restore_pool.tail) g_restore_pool.tail = job;
+    }
+    pthread_cond_signal(&g_restore_pool.work_cond);
+    pthread_mutex_unlock(&g_restore_pool.mutex);
+}
+
+/**
+ * @brief Restores one tree entry ('B', 'L' or 'M') to dest_path. Queued when
+ * the restore pool runs (errors then surface in stop_restore_pool()),
+ * otherwise done here.
+ * @return 0 on success (or once queued), -1 on failure.
+ */
+static int unpack_file_entry(const char* hash, char type, mode_t mode, const char* dest_path) {
+    RestoreJob* job = malloc(sizeof(RestoreJob) + strlen(dest_path) + 1);
+    if (!job) return -1;
+    job->type = type;
+    job->mode = mode;
+    job->file = NULL;
+    strncpy(job->hash, hash, HASH_STR_LEN - 1);
+    job->hash[HASH_STR_LEN - 1] = '\0';
+    strcpy(job->dest_path, dest_path);
+
+    if (g_restore_pool.thread_count == 0) {
+        int rc = run_restore_job(job);
+        free(job);
+        return rc;
+    }
+    restore_push(job, 1);
+    return 0;
+}
+
+// Applies a directory's mode once every file below it is written.
+static void restore_dir_mode(const char* path, mode_t mode) {
+    if (g_restore_pool.thread_count == 0) {
+        chmod(path, mode);
+        return;
+    }
+    RestoreDir* d = malloc(sizeof(RestoreDir) + strlen(path) + 1);
+    if (!d) {
+        chmod(path, mode);
+        return;
+    }
+    d->mode = mode;
+    strcpy(d->path, path);
+    d->next = g_restore_pool.dirs;
+    g_restore_pool.dirs = d;
+}
 
-        if (fwrite(block_data, 1, block_data_len, f) != block_data_len) {
-            log_msg("Error: fwrite failed for block %s in %s", hash_hex, dest_path);
-            free(block_data);
-            fclose(f);
-            remove(dest_path);
-            return -1;
-        }
-        
-        free(block_data);
+static void start_restore_pool(void) {
+    g_restore_pool.head = g_restore_pool.tail = NULL;
+    g_restore_pool.depth = 0;
+    g_restore_pool.closing = 0;
+    g_restore_pool.failed = 0;
+    g_restore_pool.thread_count = 0;
+    g_restore_pool.dirs = NULL;
+
+    int workers = commit_workers_from_env();
+    if (workers <= 1) return;
+    g_restore_pool.threads = malloc(sizeof(pthread_t) * (size_t)workers);
+    if (!g_restore_pool.threads) return;
+    for (int i = 0; i < workers; i++) {
+        if (pthread_create(&g_restore_pool.threads[i], NULL, restore_worker_func, NULL) != 0) break;
+        g_restore_pool.thread_count++;
     }
-    
-    fclose(f);
-    
-    // Set final file permissions
-    chmod(dest_path, manifest->file_mode);
+}
 
-    return 0;
+// Waits for every queued file, then applies directory modes. Returns -1 if anything failed.
+static int stop_restore_pool(void) {
+    pthread_mutex_lock(&g_restore_pool.mutex);
+    g_restore_pool.closing = 1;
+    pthread_cond_broadcast(&g_restore_pool.work_cond);
+    pthread_mutex_unlock(&g_restore_pool.mutex);
+    for (int i = 0; i < g_restore_pool.thread_count; i++) pthread_join(g_restore_pool.threads[i], NULL);
+    free(g_restore_pool.threads);
+    g_restore_pool.threads = NULL;
+    g_restore_pool.thread_count = 0;
+
+    while (g_restore_pool.dirs) {
+        RestoreDir* d = g_restore_pool.dirs;
+        g_restore_pool.dirs = d->next;
+        chmod(d->path, d->mode);
+        free(d);
+    }
+    return g_restore_pool.failed ? -1 : 0;
 }
 
+// parent_tree_hash is the tree of the file's directory in the parent commit.
 static int hash_and_write_blob(const char* fpath, const char* parent_tree_hash, 
                                const char* relative_path, char* hash_out, 
                                double* entropy_out, char* type_out) // <-- ADDED type_out
 {
+    const char* file_name = strrchr(relative_path, '/');
+    file_name = file_name ? file_name + 1 : relative_path;
+
     // 1. Get file size first
     struct stat st_fsize;
     if (stat(fpath, &st_fsize) != 0) {
@@ -2171,7 +3912,7 @@ static int hash_and_write_blob(const char* fpath, const char* parent_tree_hash,
             double old_entropy;
             char old_type = 0;
             // Check the parent tree for this same file path
-            if (find_file_in_tree(parent_tree_hash, relative_path, old_hash, &old_mode, &old_entropy, &old_type) == 0) {
+            if (find_tree_entry(parent_tree_hash, file_name, old_hash, &old_mode, &old_entropy, &old_type) == 0) {
                 if (old_type == 'M') {
                     // This file was a manifest in the parent. Use it to find block parents.
                     strncpy(old_manifest_hash, old_hash, HASH_STR_LEN);
@@ -2210,15 +3951,32 @@ static int hash_and_write_blob(const char* fpath, const char* parent_tree_hash,
         // 4. Check if this exact object already exists
         char obj_path[PATH_MAX];
         get_object_path(hash_out, obj_path);
-        struct stat st_obj;
-        if (stat(obj_path, &st_obj) == 0) {
+        if (object_exists(OBJ_KIND_LOOSE, hash_out, obj_path)) {
             return 0; // Success, object already exists
         }
 
-        // 5. Write blob by streaming
-        // We explicitly DO NOT attempt delta compression on large files.
+        // 5. Try a streamed delta against the parent version
+        char old_hash[HASH_STR_LEN];
+        mode_t old_mode;
+        double old_entropy;
+        char old_type = 0;
+        if (parent_tree_hash &&
+            find_tree_entry(parent_tree_hash, file_name, old_hash, &old_mode, &old_entropy, &old_type) == 0 &&
+            old_type == 'B')
+        {
+            size_t delta_size = 0;
+            int rc = write_byte_delta_object_stream(hash_out, old_hash, fpath, streamed_size, &delta_size);
+            if (rc == 0) {
+                log_msg("  > DELTA (Stream): %s (%.1fMB -> %.1fMB) E:%.4f", relative_path,
+                        (double)streamed_size / (1024.0*1024.0), (double)delta_size / (1024.0*1024.0), *entropy_out);
+                return 0;
+            }
+            if (rc < 0) log_msg("  > Streamed delta failed for %s. Storing full blob.", relative_path);
+        }
+
+        // 6. Write blob by streaming
         log_msg("  > BLOB (Stream): %s (%.1fMB) E:%.4f", 
-                relative_path, (double)streamed_size/1024.0, *entropy_out);
+                relative_path, (double)streamed_size/(1024.0*1024.0), *entropy_out);
         
         if (write_blob_object_stream(hash_out, fpath) != 0) {
             log_msg("  > FAILED to stream-write large blob: %s", hash_out);
@@ -2251,8 +4009,7 @@ static int hash_and_write_blob(const char* fpath, const char* parent_tree_hash,
         // 3. Check if this exact object already exists
         char obj_path[PATH_MAX];
         get_object_path(hash_out, obj_path);
-        struct stat st_obj;
-        if (stat(obj_path, &st_obj) == 0) {
+        if (object_exists(OBJ_KIND_LOOSE, hash_out, obj_path)) {
             free(new_content);
             return 0; // Success, object already exists
         }
@@ -2264,29 +4021,40 @@ static int hash_and_write_blob(const char* fpath, const char* parent_tree_hash,
         char old_type = 0; // <-- Check the parent's type
         char* old_content = NULL;
         size_t old_size = 0;
+        int old_depth = 0;
+        size_t old_cost = 0;
 
         if (parent_tree_hash && 
-            find_file_in_tree(parent_tree_hash, relative_path, old_hash, &old_mode, &old_entropy, &old_type) == 0) 
+            find_tree_entry(parent_tree_hash, file_name, old_hash, &old_mode, &old_entropy, &old_type) == 0) 
         {
             // --- MODIFIED: ONLY read object if it's a BLOB or LINK. 
             // Do NOT try to read a MANIFEST ('M') for delta.
             if (old_type == 'B' || old_type == 'L') {
-                old_content = read_object(old_hash, &old_size);
+                old_content = read_object_chain(old_hash, &old_size, &old_depth, &old_cost);
             } else if (old_type == 'M') {
                 log_msg("  > Parent file '%s' is a manifest. Storing new version as full blob.", relative_path);
             }
         }
+
+        // A full blob restarts the chain once it is as long as we allow.
+        if (old_content && old_depth + 1 > DELTA_MAX_DEPTH) {
+            log_msg("  > Delta chain of '%s' reached depth %d. Storing a full blob.", relative_path, old_depth);
+            free(old_content);
+            old_content = NULL;
+        }
         
         // 6. Try to compute a BYTE-LEVEL delta
         if (old_content && old_size > 0) {
             
             DeltaScript script = {0};
             
-            // generate_byte_delta_script returns -1 if files are too big or on error
-            if (generate_byte_delta_script(old_content, old_size, new_content, fsize, &script) == 0) {
+            // generate_byte_delta_script gives up once the script passes the 75% rule
+            if (generate_byte_delta_script(old_content, old_size, new_content, fsize,
+                                           (size_t)(fsize * 0.75), &script) == 0) {
                 
-                // --- Delta Decision Logic (75% rule) ---
-                if (script.buffer && script.size > 0 && script.size < (fsize * 0.75)) {
+                // --- Delta Decision Logic (75% rule, bounded chain cost) ---
+                if (script.buffer && script.size > 0 && script.size < (fsize * 0.75) &&
+                    old_cost + script.size <= (size_t)fsize * DELTA_CHAIN_COST_FACTOR) {
                     log_msg("  > DELTA: %s (%.1fKB -> %.1fKB) E:%.4f", 
                             relative_path, (double)fsize/1024.0, (double)script.size/1024.0, *entropy_out);
                     
@@ -2314,18 +4082,241 @@ static int hash_and_write_blob(const char* fpath, const char* parent_tree_hash,
 
 
 
-// Recursively builds tree objects bottom-up
-static char* build_tree_recursive(const char* current_path, const char* parent_tree_hash, 
-                                  ctz_json_value* history_json, char* tree_hash_out) 
-{
-    DIR* dir = opendir(current_path);
-    if (!dir) {
+// --- Parallel commit pipeline ---
+// The walker (the committing thread) lists directories in readdir order and
+// queues every regular file the index cannot answer. Workers hash, delta and
+// compress the queued files and hand objects to the writer stage. Each
+// directory counts its unfinished children; whichever thread finishes the
+// last one writes the directory's tree object and releases its parent, so
+// trees are still built bottom-up and their content does not depend on
+// which worker finished first.
+
+#define COMMIT_WORKERS_MAX 64
+#define COMMIT_QUEUE_MAX 4096                               // Queued files before the walker waits
+#define COMMIT_MEMORY_BUDGET (2LL * 1024 * 1024 * 1024)     // File bytes workers may hold in memory
+
+typedef struct CommitDir {
+    struct CommitDir* parent;
+    TreeEntry* entry_in_parent;     // NULL for the root
+    char* hash_out;                 // Root only
+    TreeEntry* head;
+    TreeEntry* tail;
+    int pending;                    // Queued files + unfinished subdirectories + the walker
+    int has_parent_tree;
+    char parent_tree_hash[HASH_STR_LEN];
+} CommitDir;
+
+typedef struct CommitJob {
+    CommitDir* dir;
+    TreeEntry* entry;
+    off_t size;
+    struct stat st;
+    struct CommitJob* next;
+    char full_path[];
+} CommitJob;
+
+typedef struct CommitPool {
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;       // Jobs queued or closing
+    pthread_cond_t space_cond;      // Queue shrank
+    pthread_cond_t memory_cond;     // Memory budget released
+    pthread_cond_t done_cond;       // Root tree written
+    CommitJob* head;
+    CommitJob* tail;
+    size_t depth;
+    long long memory_in_use;
+    int closing;
+    int failed;
+    int root_done;
+    int thread_count;
+    pthread_t threads[COMMIT_WORKERS_MAX];
+} CommitPool;
+
+static CommitPool g_commit_pool = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .work_cond = PTHREAD_COND_INITIALIZER,
+    .space_cond = PTHREAD_COND_INITIALIZER,
+    .memory_cond = PTHREAD_COND_INITIALIZER,
+    .done_cond = PTHREAD_COND_INITIALIZER
+};
+
+static pthread_mutex_t g_index_mutex = PTHREAD_MUTEX_INITIALIZER; // Guards g_commit_index
+
+static void commit_fail(void) {
+    pthread_mutex_lock(&g_commit_pool.mutex);
+    g_commit_pool.failed = 1;
+    pthread_mutex_unlock(&g_commit_pool.mutex);
+}
+
+// Drops one reference on dir. The last one writes its tree and moves up.
+static void commit_dir_release(CommitDir* dir) {
+    while (dir && __atomic_sub_fetch(&dir->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+        CommitDir* parent = dir->parent;
+        char* hash_out = dir->entry_in_parent ? dir->entry_in_parent->hash : dir->hash_out;
+        if (write_tree_object(dir->head, hash_out) != 0) {
+            log_msg("Failed to write tree object.");
+            commit_fail();
+        }
+        free_tree_list(dir->head);
+        free(dir);
+        if (!parent) {
+            pthread_mutex_lock(&g_commit_pool.mutex);
+            g_commit_pool.root_done = 1;
+            pthread_cond_broadcast(&g_commit_pool.done_cond);
+            pthread_mutex_unlock(&g_commit_pool.mutex);
+        }
+        dir = parent;
+    }
+}
+
+// Files below IN_MEMORY_FILE_LIMIT are read whole, next to their parent version.
+static long long commit_job_memory(off_t size) {
+    if (size > IN_MEMORY_FILE_LIMIT) return 0; // Streamed or deconstructed
+    long long need = (long long)size * 2;
+    return need > COMMIT_MEMORY_BUDGET ? COMMIT_MEMORY_BUDGET : need;
+}
+
+static void run_commit_job(CommitJob* job) {
+    long long memory = commit_job_memory(job->size);
+    if (memory) {
+        pthread_mutex_lock(&g_commit_pool.mutex);
+        while (g_commit_pool.memory_in_use > 0 && g_commit_pool.memory_in_use + memory > COMMIT_MEMORY_BUDGET) {
+            pthread_cond_wait(&g_commit_pool.memory_cond, &g_commit_pool.mutex);
+        }
+        g_commit_pool.memory_in_use += memory;
+        pthread_mutex_unlock(&g_commit_pool.mutex);
+    }
+
+    const char* relative_path = job->full_path + strlen(g_node_root_path);
+    if (*relative_path == '/') relative_path++;
+    TreeEntry* entry = job->entry;
+    char object_type = 'B';
+    int rc = hash_and_write_blob(job->full_path, job->dir->has_parent_tree ? job->dir->parent_tree_hash : NULL,
+                                 relative_path, entry->hash, &entry->entropy, &object_type);
+
+    if (memory) {
+        pthread_mutex_lock(&g_commit_pool.mutex);
+        g_commit_pool.memory_in_use -= memory;
+        pthread_cond_broadcast(&g_commit_pool.memory_cond);
+        pthread_mutex_unlock(&g_commit_pool.mutex);
+    }
+
+    if (rc != 0) {
+        log_msg("Failed to hash/write blob: %s", job->full_path);
+        // type stays 0: left out of the tree, as before
+    } else {
+        entry->type = object_type; // 'B' (Blob) or 'M' (Manifest)
+
+        // st is from before the read, so a write during hashing shows up next time
+        exodus_index_object cached;
+        cached.type = object_type;
+        memcpy(cached.hash, entry->hash, HASH_STR_LEN);
+        cached.entropy = entry->entropy;
+        pthread_mutex_lock(&g_index_mutex);
+        g_index_hashed++;
+        if (exodus_index_record(g_commit_index, relative_path, &job->st, &cached) != 0) {
+            log_msg("Warning: Out of memory recording '%s' in the index.", relative_path);
+        }
+        pthread_mutex_unlock(&g_index_mutex);
+    }
+
+    commit_dir_release(job->dir);
+    free(job);
+}
+
+static void* commit_worker_func(void* arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&g_commit_pool.mutex);
+        while (!g_commit_pool.head && !g_commit_pool.closing) {
+            pthread_cond_wait(&g_commit_pool.work_cond, &g_commit_pool.mutex);
+        }
+        CommitJob* job = g_commit_pool.head;
+        if (!job) {
+            pthread_mutex_unlock(&g_commit_pool.mutex);
+            break;
+        }
+        g_commit_pool.head = job->next;
+        if (!g_commit_pool.head) g_commit_pool.tail = NULL;
+        g_commit_pool.depth--;
+        pthread_cond_signal(&g_commit_pool.space_cond);
+        pthread_mutex_unlock(&g_commit_pool.mutex);
+
+        run_commit_job(job);
+    }
+    return NULL;
+}
+
+// Queues a file, or hashes it right away when there are no workers.
+static void submit_commit_job(CommitJob* job) {
+    if (g_commit_pool.thread_count == 0) {
+        run_commit_job(job);
+        return;
+    }
+    pthread_mutex_lock(&g_commit_pool.mutex);
+    while (g_commit_pool.depth >= COMMIT_QUEUE_MAX) {
+        pthread_cond_wait(&g_commit_pool.space_cond, &g_commit_pool.mutex);
+    }
+    job->next = NULL;
+    if (g_commit_pool.tail) g_commit_pool.tail->next = job; else g_commit_pool.head = job;
+    g_commit_pool.tail = job;
+    g_commit_pool.depth++;
+    pthread_cond_signal(&g_commit_pool.work_cond);
+    pthread_mutex_unlock(&g_commit_pool.mutex);
+}
+
+// EXODUS_COMMIT_THREADS overrides the CPU count; 1 hashes on the walker alone.
+static int commit_workers_from_env(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    const char* env = getenv("EXODUS_COMMIT_THREADS");
+    if (env && *env) {
+        char* end = NULL;
+        long v = strtol(env, &end, 10);
+        if (end != env && *end == '\0' && v >= 1) n = v;
+        else log_msg("Ignoring invalid EXODUS_COMMIT_THREADS='%s'", env);
+    }
+    if (n < 1) n = 1;
+    if (n > COMMIT_WORKERS_MAX) n = COMMIT_WORKERS_MAX;
+    return (int)n;
+}
+
+static void start_commit_pool(int workers) {
+    g_commit_pool.head = g_commit_pool.tail = NULL;
+    g_commit_pool.depth = 0;
+    g_commit_pool.memory_in_use = 0;
+    g_commit_pool.closing = 0;
+    g_commit_pool.failed = 0;
+    g_commit_pool.root_done = 0;
+    g_commit_pool.thread_count = 0;
+    if (workers <= 1) return;
+
+    for (int i = 0; i < workers; i++) {
+        if (pthread_create(&g_commit_pool.threads[i], NULL, commit_worker_func, NULL) != 0) break;
+        g_commit_pool.thread_count++;
+    }
+    if (g_commit_pool.thread_count > 0 && start_object_writer() != 0) {
+        log_msg("Warning: Could not start the object writer. Workers write objects themselves.");
+    }
+}
+
+static void stop_commit_pool(void) {
+    pthread_mutex_lock(&g_commit_pool.mutex);
+    g_commit_pool.closing = 1;
+    pthread_cond_broadcast(&g_commit_pool.work_cond);
+    pthread_mutex_unlock(&g_commit_pool.mutex);
+    for (int i = 0; i < g_commit_pool.thread_count; i++) pthread_join(g_commit_pool.threads[i], NULL);
+    g_commit_pool.thread_count = 0;
+    if (stop_object_writer() != 0) commit_fail();
+}
+
+// Lists one directory into dir, queueing its files and walking its subdirectories.
+static int walk_commit_dir(const char* current_path, ctz_json_value* history_json, CommitDir* dir) {
+    DIR* d = opendir(current_path);
+    if (!d) {
         log_msg("Failed to open dir for tree build: %s", current_path);
-        return NULL;
+        return -1;
     }
 
-    TreeEntry* head = NULL;
-    TreeEntry* tail = NULL;
     struct dirent* entry;
 
     const char* relative_path_dir = current_path + strlen(g_node_root_path);
@@ -2334,7 +4325,7 @@ static char* build_tree_recursive(const char* current_path, const char* parent_t
         log_msg("Processing dir: %s", relative_path_dir);
     }
 
-    while ((entry = readdir(dir)) != NULL) {
+    while ((entry = readdir(d)) != NULL) {
         if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
 
         char full_path[PATH_MAX];
@@ -2350,49 +4341,69 @@ static char* build_tree_recursive(const char* current_path, const char* parent_t
         if (lstat(full_path, &st) == -1) continue;
 
         TreeEntry* new_entry = calloc(1, sizeof(TreeEntry));
-        if (!new_entry) goto error_cleanup;
+        if (!new_entry) { closedir(d); return -1; }
         snprintf(new_entry->name, sizeof(new_entry->name), "%s", entry->d_name);
+        new_entry->mode = st.st_mode;
 
         if (S_ISDIR(st.st_mode)) {
             new_entry->type = 'T';
-            new_entry->mode = st.st_mode;
             new_entry->entropy = 0.0;
             strncpy(new_entry->author, "n/a", sizeof(new_entry->author) - 1);
+
+            CommitDir* child = calloc(1, sizeof(CommitDir));
+            if (!child) { free(new_entry); closedir(d); return -1; }
+            child->parent = dir;
+            child->entry_in_parent = new_entry;
+            child->pending = 1;
             
-            char parent_subdir_hash[HASH_STR_LEN] = {0};
-            mode_t parent_subdir_mode;
-            double parent_subdir_entropy;
-            
-            // --- MODIFIED: Pass NULL for type_out ---
-            if (parent_tree_hash) {
-                find_file_in_tree(parent_tree_hash, relative_path_entry, parent_subdir_hash, &parent_subdir_mode, &parent_subdir_entropy, NULL);
-            }
-            if (build_tree_recursive(full_path, parent_subdir_hash[0] ? parent_subdir_hash : NULL, history_json, new_entry->hash) == NULL) {
-                free(new_entry);
-                goto error_cleanup; 
+            char parent_subdir_type = 0;
+            if (dir->has_parent_tree &&
+                find_tree_entry(dir->parent_tree_hash, entry->d_name, child->parent_tree_hash,
+                                NULL, NULL, &parent_subdir_type) == 0 && parent_subdir_type == 'T') {
+                child->has_parent_tree = 1;
             }
+
+            // The child holds a reference on dir until its own tree is written
+            __atomic_add_fetch(&dir->pending, 1, __ATOMIC_RELAXED);
+            if (dir->tail) dir->tail->next = new_entry; else dir->head = new_entry;
+            dir->tail = new_entry;
+
+            int rc = walk_commit_dir(full_path, history_json, child);
+            commit_dir_release(child);
+            if (rc != 0) { closedir(d); return -1; }
+            continue;
         } else if (S_ISREG(st.st_mode)) {
-            // --- MODIFIED: Handle 'B' vs 'M' type from hash_and_write_blob ---
-            new_entry->mode = st.st_mode;
             const char* user = find_user_for_file(history_json, relative_path_entry);
             strncpy(new_entry->author, user, sizeof(new_entry->author) - 1);
             
-            char object_type = 'B'; // Default to blob
-            
-            if (hash_and_write_blob(full_path, parent_tree_hash, relative_path_entry, 
-                                    new_entry->hash, &new_entry->entropy, &object_type) != 0) // <-- MODIFIED CALL
-            {
-                log_msg("Failed to hash/write blob: %s", full_path);
-                free(new_entry);
+            // Unchanged since the last commit: reuse its object without reading the file
+            exodus_index_object cached;
+            pthread_mutex_lock(&g_index_mutex); // Workers may be growing the index
+            int unchanged = exodus_index_lookup(g_commit_index, relative_path_entry, &st, &cached);
+            pthread_mutex_unlock(&g_index_mutex);
+            if (unchanged) {
+                memcpy(new_entry->hash, cached.hash, HASH_STR_LEN);
+                new_entry->entropy = cached.entropy;
+                new_entry->type = cached.type;
+                g_index_reused++;
+            } else {
+                CommitJob* job = malloc(sizeof(CommitJob) + strlen(full_path) + 1);
+                if (!job) { free(new_entry); closedir(d); return -1; }
+                strcpy(job->full_path, full_path);
+                job->dir = dir;
+                job->entry = new_entry;
+                job->size = st.st_size;
+                job->st = st;
+                job->next = NULL;
+                // type is set by the worker; link first so the tree keeps readdir order
+                if (dir->tail) dir->tail->next = new_entry; else dir->head = new_entry;
+                dir->tail = new_entry;
+                __atomic_add_fetch(&dir->pending, 1, __ATOMIC_RELAXED);
+                submit_commit_job(job);
                 continue;
             }
-            
-            new_entry->type = object_type; // Set type to 'B' (Blob) or 'M' (Manifest)
-            // --- END MODIFICATION ---
-            
         } else if (S_ISLNK(st.st_mode)) {
             new_entry->type = 'L';
-            new_entry->mode = st.st_mode;
             const char* user = find_user_for_file(history_json, relative_path_entry);
             strncpy(new_entry->author, user, sizeof(new_entry->author) - 1);
             char target[PATH_MAX];
@@ -2406,59 +4417,172 @@ static char* build_tree_recursive(const char* current_path, const char* parent_t
             free(new_entry);
             continue;
         }
-        if (tail) tail->next = new_entry; else head = new_entry;
-        tail = new_entry;
+        if (dir->tail) dir->tail->next = new_entry; else dir->head = new_entry;
+        dir->tail = new_entry;
     }
-    closedir(dir);
+    closedir(d);
+    return 0;
+}
 
-    // ... (rest of the function is unchanged) ...
-    size_t tree_content_size = 0;
-    TreeEntry* current = head;
-    while (current) {
-        tree_content_size += snprintf(NULL, 0, "%o %c %s E:%.4f U:%s\t%s\n",
-                                      current->mode & 07777,
-                                      current->type, current->hash, 
-                                      current->entropy,
-                                      current->author[0] ? current->author : "unknown",
-                                      current->name);
-        current = current->next;
-    }
-    if (tree_content_size == 0) tree_content_size = 1; 
-    
-    char* tree_content = malloc(tree_content_size + 1);
-    if (!tree_content) goto error_cleanup;
-    char* ptr = tree_content;
-    current = head;
-    while (current) {
-        ptr += sprintf(ptr, "%o %c %s E:%.4f U:%s\t%s\n",
-                       current->mode & 07777, current->type, current->hash, 
-                       current->entropy,
-                       current->author[0] ? current->author : "unknown",
-                       current->name);
-        current = current->next;
-    }
-    *ptr = '\0'; 
-    if (tree_content_size == 1 && *tree_content == '\0') {
-        tree_content_size = 0; // Handle empty directory case
+// Builds and writes every tree object of the node; tree_hash_out receives the root.
+static char* build_commit_tree(const char* root_path, const char* parent_tree_hash, 
+                               ctz_json_value* history_json, char* tree_hash_out) 
+{
+    CommitDir* root = calloc(1, sizeof(CommitDir));
+    if (!root) return NULL;
+    root->hash_out = tree_hash_out;
+    root->pending = 1;
+    if (parent_tree_hash) {
+        snprintf(root->parent_tree_hash, sizeof(root->parent_tree_hash), "%s", parent_tree_hash);
+        root->has_parent_tree = 1;
     }
 
-    get_buffer_hash(tree_content, tree_content_size, tree_hash_out);
-    write_blob_object(tree_hash_out, tree_content, tree_content_size); 
+    int workers = commit_workers_from_env();
+    start_commit_pool(workers);
+    log_msg("Hashing with %d worker thread(s).", g_commit_pool.thread_count ? g_commit_pool.thread_count : 1);
 
-    free(tree_content);
-    free_tree_list(head);
-    return tree_hash_out; // Success
+    int rc = walk_commit_dir(root_path, history_json, root);
+    commit_dir_release(root); // The walker's reference
 
-error_cleanup:
-    if (dir) closedir(dir); 
-    free_tree_list(head);
-    return NULL; // Indicate error
+    pthread_mutex_lock(&g_commit_pool.mutex);
+    while (!g_commit_pool.root_done) pthread_cond_wait(&g_commit_pool.done_cond, &g_commit_pool.mutex);
+    pthread_mutex_unlock(&g_commit_pool.mutex);
+    stop_commit_pool();
+
+    if (rc != 0 || g_commit_pool.failed) return NULL;
+    return tree_hash_out;
+}
+
+
+// --- Commit graph ---
+// A commit object is parsed once, when it first shows up. Tag lookups, the
+// log and versions.json read parents, tags and times from the graph.
+
+static exodus_graph* g_commit_graph = NULL;
+
+static exodus_graph* commit_graph(const char* node_path) {
+    if (!g_commit_graph) {
+        g_commit_graph = exodus_graph_load(node_path);
+        if (!g_commit_graph) log_msg("Error: Out of memory loading the commit graph.");
+    }
+    return g_commit_graph;
+}
+
+/**
+ * @brief Parses a commit object's header lines and the first line of its message.
+ * @param buffer_out Receives the object; info->tag and info->author point into it.
+ * @return 0 on success, -1 if the object cannot be read.
+ */
+static int read_commit_info(const char* hash, exodus_graph_commit* info, char** buffer_out) {
+    size_t size;
+    char* content = read_object(hash, &size);
+    if (!content) return -1;
+
+    memset(info, 0, sizeof(*info));
+    strncpy(info->hash, hash, HASH_LEN);
+    info->tag = "";
+    info->author = "";
+
+    char* line = content;
+    char* end = content + size;
+    while (line < end) {
+        char* nl = memchr(line, '\n', (size_t)(end - line));
+        if (nl == line) { // Blank line: the message follows
+            char* msg = nl + 1;
+            char* msg_end = msg < end ? memchr(msg, '\n', (size_t)(end - msg)) : NULL;
+            if (msg_end) *msg_end = '\0';
+            if (msg < end) info->tag = msg;
+            break;
+        }
+        if (nl) *nl = '\0';
+
+        if (strcmp(line, "type: T-COMMIT") == 0) {
+            info->type = 'T';
+        } else if (strcmp(line, "type: S-COMMIT") == 0) {
+            info->type = 'S';
+        } else if (strncmp(line, "tree ", 5) == 0) {
+            sscanf(line, "tree %64s", info->tree);
+        } else if (strncmp(line, "parent ", 7) == 0) {
+            sscanf(line, "parent %64s", info->parent);
+        } else if (strncmp(line, "anchor ", 7) == 0) {
+            sscanf(line, "anchor %64s", info->anchor);
+        } else if (strncmp(line, "promoted ", 9) == 0) {
+            sscanf(line, "promoted %64s", info->promoted);
+        } else if (strncmp(line, "author ", 7) == 0) {
+            char* date_start = strstr(line, "> ");
+            if (date_start) {
+                date_start[1] = '\0'; // Keep "name <uid@exodus>"
+                info->author = line + 7;
+                info->timestamp = atoll(date_start + 2);
+            }
+        }
+        if (!nl) break;
+        line = nl + 1;
+    }
+
+    *buffer_out = content;
+    return 0;
 }
 
+typedef struct PendingCommit {
+    exodus_graph_commit info;
+    char* buffer;
+} PendingCommit;
+
+/**
+ * @brief Returns a commit from the graph, first adding it and every ancestor the
+ * graph does not know yet (e.g. history written before the graph existed).
+ * @return The commit, or NULL on error.
+ */
+static const exodus_graph_commit* commit_graph_ensure(const char* node_path, const char* hash) {
+    exodus_graph* graph = commit_graph(node_path);
+    if (!graph || hash[0] == '\0') return NULL;
+    const exodus_graph_commit* known = exodus_graph_lookup(graph, hash);
+    if (known) return known;
+
+    // Walk back to the first known commit, then add the chain oldest first
+    PendingCommit* pending = NULL;
+    size_t count = 0, capacity = 0;
+    int rc = 0;
+    char next[HASH_STR_LEN];
+    snprintf(next, sizeof(next), "%s", hash);
+    while (next[0] != '\0' && !exodus_graph_lookup(graph, next)) {
+        if (count == capacity) {
+            size_t new_cap = capacity ? capacity * 2 : 16;
+            PendingCommit* grown = realloc(pending, new_cap * sizeof(PendingCommit));
+            if (!grown) { rc = -1; break; }
+            pending = grown;
+            capacity = new_cap;
+        }
+        if (read_commit_info(next, &pending[count].info, &pending[count].buffer) != 0) {
+            log_msg("Error: Failed to read commit object %s.", next);
+            rc = -1;
+            break;
+        }
+        snprintf(next, sizeof(next), "%s", pending[count].info.parent);
+        count++;
+    }
+    for (size_t i = count; i > 0 && rc == 0; i--) {
+        if (exodus_graph_add(graph, &pending[i - 1].info) != 0) {
+            log_msg("Error: Could not add commit %s to the commit graph.", pending[i - 1].info.hash);
+            rc = -1;
+        }
+    }
+    for (size_t i = 0; i < count; i++) free(pending[i].buffer);
+    free(pending);
+
+    if (rc == 0 && count > 0) {
+        if (count > 1) log_msg("Commit graph: added %zu commits.", count);
+        if (exodus_graph_save(graph, node_path) != 0) {
+            log_msg("Warning: Could not save the commit graph. It will be rebuilt next time.");
+        }
+    }
+    return rc == 0 ? exodus_graph_lookup(graph, hash) : NULL;
+}
 
 /**
- * @brief Finds a commit hash by walking the history of the active subsection
- * and matching the commit message (tag).
+ * @brief Finds the newest commit in the history of the active subsection
+ * whose message (tag) matches.
  * @param node_path Path to the node.
  * @param version_tag The commit message to search for, or "LATEST_HEAD".
  * @param commit_hash_out Output buffer for the found commit hash.
@@ -2480,45 +4604,18 @@ static int find_commit_hash_by_tag(const char* node_path, const char* version_ta
         return 0;
     }
 
-    // Walk the history
-    int depth = 0;
-    while (current_commit_hash[0] != '\0' && depth < 2000) { // 2000-commit safety limit
-        size_t commit_size;
-        char* commit_content = read_object(current_commit_hash, &commit_size);
-        if (!commit_content) {
-            log_msg("Error: Failed to read commit object %s while searching for tag.", current_commit_hash);
-            return -1;
-        }
-
-        // Find the commit message (it's after the two \n\n)
-        char* msg_start = strstr(commit_content, "\n\n");
-        if (msg_start) {
-            msg_start += 2; // Skip the \n\n
-            char* msg_end = strchr(msg_start, '\n');
-            if (msg_end) *msg_end = '\0'; // Temporarily terminate message
-
-            if (strcmp(msg_start, version_tag) == 0) {
-                // FOUND!
-                strncpy(commit_hash_out, current_commit_hash, HASH_STR_LEN);
-                free(commit_content);
-                return 0;
-            }
-        }
-
-        // Not found, find the parent and continue
-        char* parent_line = strstr(commit_content, "parent ");
-        if (parent_line) {
-            sscanf(parent_line, "parent %64s", current_commit_hash);
-        } else {
-            current_commit_hash[0] = '\0'; // End of history
-        }
-
-        free(commit_content);
-        depth++;
+    const exodus_graph_commit* found = NULL;
+    if (current_commit_hash[0] != '\0') {
+        const exodus_graph_commit* head = commit_graph_ensure(node_path, current_commit_hash);
+        if (!head) return -1;
+        found = exodus_graph_find_tag(g_commit_graph, head, version_tag);
     }
-
-    log_msg("Error: Could not find tag '%s' in history of subsection '%s'.", version_tag, g_current_subsection);
-    return -1;
+    if (!found) {
+        log_msg("Error: Could not find tag '%s' in history of subsection '%s'.", version_tag, g_current_subsection);
+        return -1;
+    }
+    strncpy(commit_hash_out, found->hash, HASH_STR_LEN);
+    return 0;
 }
 
 
@@ -2625,87 +4722,32 @@ static void generate_versions_json(const char* node_path) {
         return;
     }
 
+    const exodus_graph_commit* commit = commit_graph_ensure(node_path, current_commit_hash);
+    if (!commit) {
+        log_msg("Error: Could not load the history of '%s', skipping versions.json.", g_current_subsection);
+        return;
+    }
+
     ctz_json_value* root_array = ctz_json_new_array();
     if (!root_array) return;
 
-    int depth = 0;
-    while (current_commit_hash[0] != '\0' && depth < 2000) { // Safety limit
-        size_t commit_size;
-        char* commit_content = read_object(current_commit_hash, &commit_size);
-        if (!commit_content) break;
-
+    for (; commit; commit = exodus_graph_parent(g_commit_graph, commit)) {
         ctz_json_value* commit_obj = ctz_json_new_object();
-        ctz_json_object_set_value(commit_obj, "commit_hash", ctz_json_new_string(current_commit_hash));
-
-        // --- Extract data from commit object ---
-        char* line_start = commit_content;
-        char* line_end;
-        char parent_hash[HASH_STR_LEN] = {0};
-        int header_done = 0;
-
-        while (line_start && line_start < (commit_content + commit_size)) {
-            if (header_done) {
-                // --- This is the message body ---
-                if (line_start[0] == '\0') break; // End of content
-                
-                char* msg_end = strchr(line_start, '\n');
-                if (msg_end) *msg_end = '\0'; // Remove trailing newline
-                
-                ctz_json_object_set_value(commit_obj, "version_tag", ctz_json_new_string(line_start));
-                
-                if (msg_end) *msg_end = '\n'; // Restore (though not strictly needed)
-                break; // Message found, stop parsing
-            }
-            
-            line_end = strchr(line_start, '\n');
-            if (!line_end) break; // End of buffer
-                
-            if (line_start == line_end) {
-                // This is the empty line "\n" separator
-                header_done = 1;
-                line_start = line_end + 1;
-                continue;
-            }
-
-            *line_end = '\0'; // Temporarily terminate line
-            
-            if (strncmp(line_start, "type: ", 6) == 0) {
-                ctz_json_object_set_value(commit_obj, "type", ctz_json_new_string(line_start + 6));
-            } else if (strncmp(line_start, "tree ", 5) == 0) {
-                ctz_json_object_set_value(commit_obj, "tree", ctz_json_new_string(line_start + 5));
-            } else if (strncmp(line_start, "parent ", 7) == 0) {
-                strncpy(parent_hash, line_start + 7, HASH_LEN);
-                ctz_json_object_set_value(commit_obj, "parent", ctz_json_new_string(parent_hash));
-            } else if (strncmp(line_start, "anchor ", 7) == 0) {
-                ctz_json_object_set_value(commit_obj, "anchor", ctz_json_new_string(line_start + 7));
-            } else if (strncmp(line_start, "promoted ", 9) == 0) {
-                ctz_json_object_set_value(commit_obj, "promoted_commit", ctz_json_new_string(line_start + 9));
-            } else if (strncmp(line_start, "author ", 7) == 0) {
-                char* date_start = strstr(line_start, "> ");
-                if (date_start) {
-                    date_start += 2;
-                    char* date_end_ptr = strstr(date_start, " +");
-                    if (date_end_ptr) *date_end_ptr = '\0';
-                    long long ts = atoll(date_start);
-                    ctz_json_object_set_value(commit_obj, "timestamp", ctz_json_new_number((double)ts));
-                }
-            }
-            
-            *line_end = '\n'; // Restore newline
-            line_start = line_end + 1;
+        ctz_json_object_set_value(commit_obj, "commit_hash", ctz_json_new_string(commit->hash));
+        if (commit->type) {
+            ctz_json_object_set_value(commit_obj, "type", ctz_json_new_string(commit->type == 'S' ? "S-COMMIT" : "T-COMMIT"));
         }
-        
-        ctz_json_array_push_value(root_array, commit_obj);
-        
-        // --- Move to next commit ---
-        if (parent_hash[0] != '\0') {
-            strncpy(current_commit_hash, parent_hash, HASH_STR_LEN);
-        } else {
-            current_commit_hash[0] = '\0'; // End of chain
+        if (commit->tree[0]) ctz_json_object_set_value(commit_obj, "tree", ctz_json_new_string(commit->tree));
+        if (commit->parent[0]) ctz_json_object_set_value(commit_obj, "parent", ctz_json_new_string(commit->parent));
+        if (commit->anchor[0]) ctz_json_object_set_value(commit_obj, "anchor", ctz_json_new_string(commit->anchor));
+        if (commit->promoted[0]) {
+            ctz_json_object_set_value(commit_obj, "promoted_commit", ctz_json_new_string(commit->promoted));
         }
-        
-        free(commit_content);
-        depth++;
+        if (commit->author[0]) {
+            ctz_json_object_set_value(commit_obj, "timestamp", ctz_json_new_number((double)commit->timestamp));
+        }
+        ctz_json_object_set_value(commit_obj, "version_tag", ctz_json_new_string(commit->tag));
+        ctz_json_array_push_value(root_array, commit_obj);
     }
 
     // Write the JSON file
@@ -2728,79 +4770,44 @@ static int find_file_in_tree(const char* current_tree_hash, const char* path_to_
 {
     if (type_out) *type_out = 0; // Default to not found
 
-    size_t tree_size;
-    char* tree_content = read_object(current_tree_hash, &tree_size);
-    if (!tree_content) {
-        log_msg("Error: Failed to read tree object: %s", current_tree_hash);
-        return -1;
-    }
-
-    const char* separator = strchr(path_to_find, '/');
-    char component[NAME_MAX + 1];
-    const char* remainder = NULL;
-
-    if (separator) {
-        size_t len = separator - path_to_find;
-        if (len > NAME_MAX) len = NAME_MAX;
-        strncpy(component, path_to_find, len);
-        component[len] = '\0';
-        remainder = separator + 1;
-    } else {
-        snprintf(component, sizeof(component), "%s", path_to_find);
-        remainder = NULL;
-    }
-
-    char* line = tree_content;
-    char* next_line;
-    int found = -1;
-
-    while (line < tree_content + tree_size) {
-        next_line = strchr(line, '\n');
-        if (next_line) *next_line = '\0';
-        else if (strlen(line) == 0) break; // end of content
-
-        mode_t mode;
-        char type;
-        char hash[HASH_STR_LEN];
-        double entropy;
-        char name[NAME_MAX + 1] = {0};
-        char author_buf[128];
+    char tree_hash[HASH_STR_LEN];
+    strncpy(tree_hash, current_tree_hash, HASH_STR_LEN - 1);
+    tree_hash[HASH_STR_LEN - 1] = '\0';
+    const char* component = path_to_find;
 
-        if (sscanf(line, "%o %c %64s E:%lf U:%127[^\t]\t%[^\n]", 
-                   &mode, &type, hash, &entropy, author_buf, name) != 6) 
-        {
-            if (sscanf(line, "%o %c %64s E:%lf\t%[^\n]", 
-                       &mode, &type, hash, &entropy, name) != 5) 
-            {
-                if (next_line) line = next_line + 1; else break;
-                continue;
-            }
+    for (;;) {
+        Tree* tree = load_tree(tree_hash);
+        if (!tree) {
+            log_msg("Error: Failed to read tree object: %s", tree_hash);
+            return -1;
         }
 
-        if (strcmp(name, component) == 0) {
-            if (remainder && type == 'T') {
-                found = find_file_in_tree(hash, remainder, blob_hash_out, mode_out, entropy_out, type_out);
-            } 
-            // --- MODIFIED: Recognize 'M' (Manifest) as a file-like type ---
-            else if (!remainder && (type == 'B' || type == 'L' || type == 'M')) {
-                strncpy(blob_hash_out, hash, HASH_STR_LEN);
-                *mode_out = mode;
-                *entropy_out = entropy;
-                if (type_out) *type_out = type; // Pass back the type
-                found = 0;
-            }
-            break; 
+        const char* separator = strchr(component, '/');
+        char name[NAME_MAX + 1];
+        size_t len = separator ? (size_t)(separator - component) : strlen(component);
+        if (len > NAME_MAX) len = NAME_MAX;
+        memcpy(name, component, len);
+        name[len] = '\0';
+
+        const TreeRecord* r = tree_find(tree, name);
+        if (r && separator && r->type == 'T') {
+            tree_record_hash(r, tree_hash);
+            tree_release(tree);
+            component = separator + 1;
+            continue;
         }
-
-        if (next_line) {
-            line = next_line + 1;
-        } else {
-            break;
+        // --- MODIFIED: Recognize 'M' (Manifest) as a file-like type ---
+        int found = -1;
+        if (r && !separator && (r->type == 'B' || r->type == 'L' || r->type == 'M')) {
+            tree_record_hash(r, blob_hash_out);
+            *mode_out = r->mode;
+            *entropy_out = r->entropy;
+            if (type_out) *type_out = r->type; // Pass back the type
+            found = 0;
         }
+        tree_release(tree);
+        return found;
     }
-
-    free(tree_content);
-    return found;
 }
 
 
@@ -2821,110 +4828,64 @@ static void print_file_diff(const char* blob1_hash, const char* blob2_hash) {
         return;
     }
 
-    int count1, count2;
-    TextLine* lines1 = split_content_to_lines(content1, size1, &count1);
-    TextLine* lines2 = split_content_to_lines(content2, size2, &count2);
-    free(content1); // Free original buffers
-    free(content2);
+    // Lines are split in place, so the buffers stay alive until the end
+    exodus_diff_line* lines1 = NULL;
+    exodus_diff_line* lines2 = NULL;
+    int count1 = exodus_diff_split_lines(content1, size1, &lines1);
+    int count2 = exodus_diff_split_lines(content2, size2, &lines2);
+    exodus_diff_result diffs;
 
-    if (!lines1 && !lines2) { // Both empty or failed
+    if (count1 < 0 || count2 < 0 || (count1 == 0 && count2 == 0) ||
+        exodus_diff_compute(lines1, count1, lines2, count2, 0, &diffs) != 0) {
+        free(lines1);
+        free(lines2);
+        free(content1);
+        free(content2);
         return;
     }
-
-    DiffOp* diffs = generate_diff(lines1, count1, lines2, count2);
     
     int added = 0, deleted = 0, same = 0;
-    for (DiffOp* op = diffs; op; op = op->next) {
-        if (op->type == DIFF_ADD) {
-            log_msg_diff("%s+  %s%s", C_GREEN, op->content, C_RESET);
+    for (size_t k = 0; k < diffs.op_count; k++) {
+        const exodus_diff_op* op = &diffs.ops[k];
+        if (op->type == EXODUS_DIFF_ADD) {
+            log_msg_diff("%s+  %s%s", C_GREEN, lines2[op->new_index].data, C_RESET);
             added++;
-        } else if (op->type == DIFF_DEL) {
-            log_msg_diff("%s-  %s%s", C_RED, op->content, C_RESET);
+        } else if (op->type == EXODUS_DIFF_DEL) {
+            log_msg_diff("%s-  %s%s", C_RED, lines1[op->old_index].data, C_RESET);
             deleted++;
         } else {
             same++;
-            log_msg_diff("   %s", op->content);
+            log_msg_diff("   %s", lines1[op->old_index].data);
         }
     }
 
-
-    if (added == 0 && deleted == 0 && same > 0) {
-         log_msg_diff("    %s(Files are identical)%s", C_CYAN, C_RESET);
-    }
-    
-    free_lines(lines1);
-    free_lines(lines2);
-    free_diff_ops(diffs);
-}
-
-static void diff_trees(const char* tree1_hash, const char* tree2_hash, const char* current_path) {
-    if (strcmp(tree1_hash, tree2_hash) == 0) return;
-
-    size_t size1, size2;
-    // Tree objects are always full BLOBs
-    char* content1 = read_object(tree1_hash, &size1);
-    char* content2 = read_object(tree2_hash, &size2);
-    if (!content1 || !content2) {
-        if(content1) free(content1);
-        if(content2) free(content2);
-        return;
-    }
-
-    TreeEntry* list1 = NULL;
-    TreeEntry* list2 = NULL;
-    TreeEntry* tail = NULL;
-
-    // Parse tree 1
-    char* line = content1;
-    while (line < content1 + size1) {
-        char* next_line = strchr(line, '\n');
-        if (next_line) *next_line = '\0';
-        else if (strlen(line) == 0) break;
-        TreeEntry* e = calloc(1, sizeof(TreeEntry));
-        if (!e) break;
-        if (sscanf(line, "%o %c %64s E:%lf U:%127[^\t]\t%[^\n]", 
-                   &e->mode, &e->type, e->hash, &e->entropy, e->author, e->name) != 6) {
-            if (sscanf(line, "%o %c %64s E:%lf\t%[^\n]", 
-                       &e->mode, &e->type, e->hash, &e->entropy, e->name) != 5) {
-                free(e); if (next_line) line = next_line + 1; else break; continue;
-            }
-            e->author[0] = '\0';
-        }
-        if (tail) tail->next = e; else list1 = e;
-        tail = e;
-        if (next_line) line = next_line + 1; else break;
-    }
-    
-    // Parse tree 2
-    tail = NULL;
-    line = content2;
-    while (line < content2 + size2) {
-        char* next_line = strchr(line, '\n');
-        if (next_line) *next_line = '\0';
-        else if (strlen(line) == 0) break;
-        TreeEntry* e = calloc(1, sizeof(TreeEntry));
-        if (!e) break;
-        if (sscanf(line, "%o %c %64s E:%lf U:%127[^\t]\t%[^\n]", 
-                   &e->mode, &e->type, e->hash, &e->entropy, e->author, e->name) != 6) {
-             if (sscanf(line, "%o %c %64s E:%lf\t%[^\n]", 
-                       &e->mode, &e->type, e->hash, &e->entropy, e->name) != 5) {
-                free(e); if (next_line) line = next_line + 1; else break; continue;
-            }
-            e->author[0] = '\0';
-        }
-        if (tail) tail->next = e; else list2 = e;
-        tail = e;
-        if (next_line) line = next_line + 1; else break;
+
+    if (added == 0 && deleted == 0 && same > 0) {
+         log_msg_diff("    %s(Files are identical)%s", C_CYAN, C_RESET);
     }
+    
+    exodus_diff_result_free(&diffs);
+    free(lines1);
+    free(lines2);
     free(content1);
     free(content2);
+}
+
+static void diff_trees(const char* tree1_hash, const char* tree2_hash, const char* current_path) {
+    if (strcmp(tree1_hash, tree2_hash) == 0) return;
 
-    // Compare lists
+    TreeEntry* list1 = NULL;
+    TreeEntry* list2 = NULL;
+    if (load_tree_entries(tree1_hash, &list1) != 0 || load_tree_entries(tree2_hash, &list2) != 0) {
+        free_tree_list(list1);
+        return;
+    }
+
+    // Compare lists (both are in name order)
+    TreeEntry* cursor = list2;
     for (TreeEntry* p1 = list1; p1; p1 = p1->next) {
-        TreeEntry* p2 = NULL;
-        for (p2 = list2; p2; p2 = p2->next) {
-            if (strcmp(p1->name, p2->name) == 0) break;
-        }
+        while (cursor && strcmp(cursor->name, p1->name) < 0) cursor = cursor->next;
+        TreeEntry* p2 = (cursor && strcmp(cursor->name, p1->name) == 0) ? cursor : NULL;
 
         char full_path[PATH_MAX];
         snprintf(full_path, sizeof(full_path), "%s%s", current_path, p1->name);
@@ -2989,51 +4950,32 @@ typedef struct MergeEntry {
 static MergeEntry* parse_tree_for_merge(const char* tree_hash, char type_char) {
     if (!tree_hash || tree_hash[0] == '\0') return NULL;
     
-    size_t tree_size;
-    char* tree_content = read_object(tree_hash, &tree_size);
-    if (!tree_content) return NULL;
+    Tree* tree = load_tree(tree_hash);
+    if (!tree) return NULL;
 
     MergeEntry* head = NULL;
-    char* line = tree_content;
-    while (line < tree_content + tree_size) {
-        char* next_line = strchr(line, '\n');
-        if (next_line) *next_line = '\0';
-        else if (strlen(line) == 0) break;
-
+    for (uint32_t i = 0; i < tree->count; i++) {
+        const TreeRecord* r = &tree->records[i];
         MergeEntry* e = calloc(1, sizeof(MergeEntry));
         if (!e) break;
-
-        char hash[HASH_STR_LEN];
-        char type;
-        mode_t mode;
-        double entropy;
-        char author[128];
-        
-        if (sscanf(line, "%o %c %64s E:%lf U:%127[^\t]\t%[^\n]", 
-                   &mode, &type, hash, &entropy, author, e->name) != 6) {
-            if (sscanf(line, "%o %c %64s E:%lf\t%[^\n]", 
-                       &mode, &type, hash, &entropy, e->name) != 5) {
-                free(e); if (next_line) line = next_line + 1; else break; continue;
-            }
-            author[0] = '\0';
-        }
+        snprintf(e->name, sizeof(e->name), "%s", tree_record_name(tree, r));
 
         if (type_char == 'b') {
-            e->type_b = type;
-            strncpy(e->hash_b, hash, HASH_STR_LEN);
+            e->type_b = r->type; tree_record_hash(r, e->hash_b);
         } else if (type_char == 'o') {
-            e->type_o = type; strncpy(e->hash_o, hash, HASH_STR_LEN);
-            e->mode_o = mode; e->ent_o = entropy; strncpy(e->auth_o, author, 127);
+            e->type_o = r->type; tree_record_hash(r, e->hash_o);
+            e->mode_o = r->mode; e->ent_o = r->entropy;
+            snprintf(e->auth_o, sizeof(e->auth_o), "%s", tree_record_author(tree, r));
         } else if (type_char == 't') {
-            e->type_t = type; strncpy(e->hash_t, hash, HASH_STR_LEN);
-            e->mode_t = mode; e->ent_t = entropy; strncpy(e->auth_t, author, 127);
+            e->type_t = r->type; tree_record_hash(r, e->hash_t);
+            e->mode_t = r->mode; e->ent_t = r->entropy;
+            snprintf(e->auth_t, sizeof(e->auth_t), "%s", tree_record_author(tree, r));
         }
         
         e->next = head;
         head = e;
-        if (next_line) line = next_line + 1; else break;
     }
-    free(tree_content);
+    tree_release(tree);
     return head; // Note: This list is in reverse alphabetical order
 }
 
@@ -3197,40 +5139,10 @@ static int merge_trees(const char* base_tree_hash, const char* ours_tree_hash,
     }
 
     // 5. Serialize the new tree list and write the object
-    size_t tree_content_size = 0;
-    TreeEntry* current = new_tree_head;
-    while (current) {
-        tree_content_size += snprintf(NULL, 0, "%o %c %s E:%.4f U:%s\t%s\n",
-                                      current->mode & 07777,
-                                      current->type, current->hash, 
-                                      current->entropy,
-                                      current->author[0] ? current->author : "unknown",
-                                      current->name);
-        current = current->next;
-    }
-    if (tree_content_size == 0) tree_content_size = 1; 
-    
-    char* tree_content = malloc(tree_content_size + 1);
-    if (!tree_content) { free_tree_list(new_tree_head); return -1; }
-    char* ptr = tree_content;
-    current = new_tree_head;
-    while (current) {
-        ptr += sprintf(ptr, "%o %c %s E:%.4f U:%s\t%s\n",
-                       current->mode & 07777, current->type, current->hash, 
-                       current->entropy,
-                       current->author[0] ? current->author : "unknown",
-                       current->name);
-        current = current->next;
-    }
-    *ptr = '\0'; 
-    if (tree_content_size == 1 && *tree_content == '\0') {
-        tree_content_size = 0; // Handle empty directory case
-    }
-
-    get_buffer_hash(tree_content, tree_content_size, merged_tree_hash_out);
-    write_blob_object(merged_tree_hash_out, tree_content, tree_content_size); // Trees are BLOBs
-
-    free(tree_content);
+    if (write_tree_object(new_tree_head, merged_tree_hash_out) != 0) {
+        free_tree_list(new_tree_head);
+        return -1;
+    }
     free_tree_list(new_tree_head);
     
     log_msg("--- Merge Succeeded. New Tree: %s ---", merged_tree_hash_out);
@@ -3380,6 +5292,9 @@ static void execute_promote_job(const char* node_path, const char* subsection_na
 
     // Update TRUNK_HEAD
     write_string_to_file(trunk_head_file, new_commit_hash);
+    if (!commit_graph_ensure(node_path, new_commit_hash)) {
+        log_msg("Warning: Could not record commit %s in the commit graph.", new_commit_hash);
+    }
     
     if (strcmp(delete_flag, "--delete") == 0) {
         log_msg("Promotion successful. Deleting subsection file: %s", subsec_head_file);
@@ -3438,25 +5353,29 @@ static void execute_commit_job(const char* node_name, const char* node_path, con
     get_parent_commit_data(node_path, parent_commit_hash, parent_tree_hash, anchor_hash);
     // --- END NEW ---
 
-    char history_file_path[PATH_MAX];
-    snprintf(history_file_path, sizeof(history_file_path), "%s/.log/history.json", node_path);
-    
-    char error_buf[256];
-    ctz_json_value* history_json = ctz_json_load_file(history_file_path, error_buf, sizeof(error_buf));
+    ctz_json_value* history_json = exodus_journal_load_history(node_path);
     if (!history_json) {
         log_msg("Warning: Could not load history.json. Per-file author metadata will be 'unknown'.");
     }
 
     log_msg("Hashing node for subsection '%s'...", g_current_subsection);
     strncpy(g_node_root_path, node_path, sizeof(g_node_root_path)-1);
+
+    g_commit_index = exodus_index_load(node_path);
+    g_index_reused = g_index_hashed = 0;
+    if (!g_commit_index) {
+        log_msg("Warning: Could not load the index. Hashing every file.");
+    }
  
     char root_tree_hash[HASH_STR_LEN];
-    if (build_tree_recursive(node_path, parent_tree_hash[0] ? parent_tree_hash : NULL, history_json, root_tree_hash) == NULL) {
+    if (build_commit_tree(node_path, parent_tree_hash[0] ? parent_tree_hash : NULL, history_json, root_tree_hash) == NULL) {
         log_msg("Error: Failed to build root tree.");
         g_node_root_path[0] = '\0'; free_ignore_list();
         if (history_json) ctz_json_free(history_json);
+        exodus_index_free(g_commit_index); g_commit_index = NULL;
         return; 
     }
+    log_msg("Index: %zu files unchanged, %zu hashed.", g_index_reused, g_index_hashed);
 
     if (history_json) {
         ctz_json_free(history_json);
@@ -3486,7 +5405,8 @@ static void execute_commit_job(const char* node_name, const char* node_path, con
          log_msg("Creating S-COMMIT for subsection '%s'...", g_current_subsection);
         if (anchor_hash[0] == '\0') {
             log_msg("Error: Cannot create S-COMMIT. Invalid anchor data (TRUNK_HEAD is empty?).");
-            g_node_root_path[0] = '\0'; free_ignore_list(); return;
+            g_node_root_path[0] = '\0'; free_ignore_list();
+            exodus_index_free(g_commit_index); g_commit_index = NULL; return;
         }
 
         char* parent_s_commit_hash = NULL;
@@ -3519,20 +5439,25 @@ static void execute_commit_job(const char* node_name, const char* node_path, con
     get_buffer_hash(commit_content, content_len, new_commit_hash);
     if (write_blob_object(new_commit_hash, commit_content, content_len) != 0) { // Commits are BLOBs
         log_msg("Error: Failed to write commit object.");
-        g_node_root_path[0] = '\0'; free_ignore_list(); return;
+        g_node_root_path[0] = '\0'; free_ignore_list();
+        exodus_index_free(g_commit_index); g_commit_index = NULL; return;
     }
 
     log_msg("Updating references for '%s'...", g_current_subsection);
     write_string_to_file(active_head_file, new_commit_hash); // Writes to the correct HEAD file
+    if (!commit_graph_ensure(node_path, new_commit_hash)) {
+        log_msg("Warning: Could not record commit %s in the commit graph.", new_commit_hash);
+    }
+
+    if (g_commit_index && exodus_index_save(g_commit_index, node_path) != 0) {
+        log_msg("Warning: Could not save the index. The next commit will rehash more files.");
+    }
+    exodus_index_free(g_commit_index);
+    g_commit_index = NULL;
     
     log_msg("Clearing node activity log (history.json)...");
-    snprintf(history_file_path, sizeof(history_file_path), "%s/.log/history.json", node_path);
-    FILE* f = fopen(history_file_path, "w");
-    if (f) {
-        fprintf(f, "[]\n"); 
-        fclose(f);
-    } else {
-        log_msg("Warning: Could not clear history.json at %s", history_file_path);
+    if (exodus_journal_reset(node_path) != 0) {
+        log_msg("Warning: Could not clear history of node at %s", node_path);
     }
 
     generate_versions_json(node_path);
@@ -3553,35 +5478,19 @@ static int unlink_cb(const char *fpath, const struct stat *sb, int typeflag, str
 }
 
 static int unpack_tree_recursive(const char* tree_hash, const char* current_dest_path) {
-    size_t tree_size;
-    char* tree_content = read_object(tree_hash, &tree_size);
-    if (!tree_content) {
+    Tree* tree = load_tree(tree_hash);
+    if (!tree) {
         log_msg("Failed to read tree object: %s", tree_hash);
         return -1;
     }
 
-    char* line = tree_content;
-    char* next_line;
-    while (line < tree_content + tree_size) {
-        next_line = strchr(line, '\n');
-        if (next_line) *next_line = '\0';
-        else if (strlen(line) == 0) break;
-
-        mode_t mode;
-        char type;
+    for (uint32_t i = 0; i < tree->count; i++) {
+        const TreeRecord* r = &tree->records[i];
+        mode_t mode = r->mode;
+        char type = r->type;
         char hash[HASH_STR_LEN];
-        double entropy;
-        char name[NAME_MAX + 1] = {0};
-        char author_buf[128];
-
-        if (sscanf(line, "%o %c %64s E:%lf U:%127[^\t]\t%[^\n]", 
-                   &mode, &type, hash, &entropy, author_buf, name) != 6) {
-            if (sscanf(line, "%o %c %64s E:%lf\t%[^\n]", 
-                       &mode, &type, hash, &entropy, name) != 5) {
-                if (next_line) line = next_line + 1; else break;
-                continue;
-            }
-        }
+        tree_record_hash(r, hash);
+        const char* name = tree_record_name(tree, r);
 
         char entry_dest_path[PATH_MAX];
         snprintf(entry_dest_path, sizeof(entry_dest_path), "%s/%s", current_dest_path, name);
@@ -3595,7 +5504,7 @@ static int unpack_tree_recursive(const char* tree_hash, const char* current_dest
                     log_msg("Failed to create dir '%s': %s", entry_dest_path, strerror(errno));
                 } else {
                     if (unpack_tree_recursive(hash, entry_dest_path) != 0) {
-                        free(tree_content); return -1;
+                        tree_release(tree); return -1;
                     }
                     if (chmod(entry_dest_path, mode) != 0) {
                          log_msg("Failed to chmod dir '%s': %s", entry_dest_path, strerror(errno));
@@ -3645,53 +5554,8 @@ static int unpack_tree_recursive(const char* tree_hash, const char* current_dest
                 break;
             // --- END NEW ---
         }
-        if (next_line) line = next_line + 1; else break;
-    }
-    free(tree_content);
-    return 0;
-}
-
-static int unpack_file_entry(const char* hash, char type, mode_t mode, const char* dest_path) {
-    switch (type) {
-        case 'B': {
-            size_t blob_size;
-            char* blob_content = read_object(hash, &blob_size);
-            if (!blob_content) return -1;
-            FILE* f_blob = fopen(dest_path, "wb");
-            if (!f_blob) { free(blob_content); return -1; }
-            fwrite(blob_content, 1, blob_size, f_blob);
-            fclose(f_blob);
-            free(blob_content);
-            chmod(dest_path, mode);
-            break;
-        }
-        case 'L': {
-            size_t target_size;
-            char* target_content = read_object(hash, &target_size);
-            if (!target_content) return -1;
-            target_content[target_size] = '\0'; // read_object should do this, but for safety
-            symlink(target_content, dest_path);
-            free(target_content);
-            break;
-        }
-        case 'M': {
-            ManifestData* manifest = read_mobj_object(hash);
-            if (!manifest) {
-                log_msg("Error: Failed to read manifest object %s", hash);
-                return -1;
-            }
-            if (reconstruct_file_from_manifest(manifest, dest_path) != 0) {
-                log_msg("Error: Failed to reconstruct file from manifest %s", hash);
-                free_manifest_data(manifest);
-                return -1;
-            }
-            free_manifest_data(manifest);
-            break;
-        }
-        default:
-            log_msg("Error: Unknown type '%c' for unpack: %s", type, dest_path);
-            return -1;
     }
+    tree_release(tree);
     return 0;
 }
 
@@ -3745,7 +5609,7 @@ static int apply_tree_diff(const char* old_tree_hash, const char* new_tree_hash,
                     log_msg("Failed to create dir '%s': %s", full_path, strerror(errno));
                 } else {
                     apply_tree_diff(NULL, me->hash_t, full_path); // Recurse to populate
-                    chmod(full_path, me->mode_t);
+                    restore_dir_mode(full_path, me->mode_t);
                 }
             } else {
                 unpack_file_entry(me->hash_t, me->type_t, me->mode_t, full_path);
@@ -3776,7 +5640,7 @@ static int apply_tree_diff(const char* old_tree_hash, const char* new_tree_hash,
                     mkdir(full_path, me->mode_t | 0700);
                 }
                 apply_tree_diff(me->hash_o, me->hash_t, full_path); // Recurse
-                chmod(full_path, me->mode_t);
+                restore_dir_mode(full_path, me->mode_t);
             } else {
                 unpack_file_entry(me->hash_t, me->type_t, me->mode_t, full_path);
             }
@@ -3871,9 +5735,13 @@ static void execute_rebuild_job(const char* node_name, const char* node_path, co
     // --- 3. Apply the diff ---
     strncpy(g_node_root_path, node_path, sizeof(g_node_root_path)-1);
     
+    start_restore_pool();
     apply_tree_diff(old_tree_hash[0] ? old_tree_hash : NULL, 
                     new_tree_hash[0] ? new_tree_hash : NULL, 
                     node_path);
+    if (stop_restore_pool() != 0) {
+        log_msg("Warning: Some files could not be restored; see the errors above.");
+    }
     
     g_node_root_path[0] = '\0';
     
@@ -3931,50 +5799,20 @@ static void execute_checkout_job(const char* node_name, const char* node_path, c
         free(dir_copy);
     }
 
-    //Handle 'M' type
-    if (object_type == 'M') {
-        //Reconstruct from Manifest
-        log_msg("Restoring manifest: %s", file_path);
-        ManifestData* manifest = read_mobj_object(object_hash);
-        if (!manifest) {
-            log_msg("Error: Failed to read manifest object %s", object_hash);
-            return;
-        }
-        if (reconstruct_file_from_manifest(manifest, dest_path) != 0) {
-            log_msg("Error: Failed to reconstruct file from manifest %s", object_hash);
-        } else {
-             log_msg("Successfully restored '%s' to version '%s'.", file_path, version_tag);
-        }
-        free_manifest_data(manifest);
-        
-    } else if (object_type == 'B' || object_type == 'L') {
-        // --- Handle Blob or Link (Old logic) ---
-        size_t blob_size;
-        char* blob_content = read_object(object_hash, &blob_size);
-        if (!blob_content) {
-            log_msg("Error: Failed to read blob object %s for file %s", object_hash, file_path);
-            return;
-        }
+    if (object_type != 'M' && object_type != 'B' && object_type != 'L') {
+        log_msg("Error: Unknown object type '%c' found for file '%s'.", object_type, file_path);
+        return;
+    }
+    if (object_type == 'M') log_msg("Restoring manifest: %s", file_path);
 
-        if (object_type == 'B') {
-            FILE* f = fopen(dest_path, "wb");
-            if (!f) {
-                log_msg("Error: Failed to open destination file '%s': %s", dest_path, strerror(errno));
-                free(blob_content);
-                return;
-            }
-            fwrite(blob_content, 1, blob_size, f);
-            fclose(f);
-            chmod(dest_path, file_mode);
-        } else { // object_type == 'L'
-            blob_content[blob_size] = '\0'; // Ensure null-terminated
-            symlink(blob_content, dest_path);
-        }
-        
-        free(blob_content);
-        log_msg("Successfully restored '%s' to version '%s'.", file_path, version_tag);
+    // A manifest's blocks are reassembled by the restore pool
+    start_restore_pool();
+    int rc = unpack_file_entry(object_hash, object_type, file_mode, dest_path);
+    if (stop_restore_pool() != 0) rc = -1;
+    if (rc != 0) {
+        log_msg("Error: Failed to restore '%s' from object %s", file_path, object_hash);
     } else {
-        log_msg("Error: Unknown object type '%c' found for file '%s'.", object_type, file_path);
+        log_msg("Successfully restored '%s' to version '%s'.", file_path, version_tag);
     }
 }
 
@@ -3982,81 +5820,39 @@ static void execute_log_job(const char* node_path) {
     char active_head_file[PATH_MAX];
     get_active_head_file(node_path, active_head_file, sizeof(active_head_file));
 
-    char current_commit_hash[HASH_STR_LEN];
-    if (read_string_from_file(active_head_file, current_commit_hash, sizeof(current_commit_hash)) != 0 || current_commit_hash[0] == '\0') {
+    char head_hash[HASH_STR_LEN];
+    if (read_string_from_file(active_head_file, head_hash, sizeof(head_hash)) != 0 || head_hash[0] == '\0') {
         log_msg("No commits found for subsection '%s'.", g_current_subsection);
         return;
     }
 
-    char head_hash[HASH_STR_LEN];
-    strncpy(head_hash, current_commit_hash, HASH_STR_LEN);
-
-    int depth = 0;
-    while (current_commit_hash[0] != '\0' && depth < 2000) { // Safety limit
-        size_t commit_size;
-        char* commit_content = read_object(current_commit_hash, &commit_size);
-        if (!commit_content) {
-            log_msg("Error: Failed to read commit object %s.", current_commit_hash);
-            break;
-        }
+    const exodus_graph_commit* commit = commit_graph_ensure(node_path, head_hash);
+    if (!commit) {
+        log_msg("Error: Could not load the history of '%s'.", g_current_subsection);
+        return;
+    }
 
-        // --- Find the commit tag/message first ---
-        char commit_tag[PATH_MAX] = "[no message]";
-        char* msg_start = strstr(commit_content, "\n\n");
-        if (msg_start) {
-            msg_start += 2; // Skip \n\n
-            char* msg_end = strchr(msg_start, '\n');
-            if (msg_end) {
-                size_t msg_len = msg_end - msg_start;
-                if (msg_len > PATH_MAX - 1) msg_len = PATH_MAX - 1;
-                strncpy(commit_tag, msg_start, msg_len);
-                commit_tag[msg_len] = '\0';
-            } else {
-                // No newline at end of message
-                strncpy(commit_tag, msg_start, sizeof(commit_tag) - 1);
-            }
-        }
+    for (; commit; commit = exodus_graph_parent(g_commit_graph, commit)) {
+        const char* commit_tag = commit->tag[0] ? commit->tag : "[no message]";
 
         // --- Print Formatted Log Entry ---
-        if (strcmp(current_commit_hash, head_hash) == 0) {
-            log_msg_diff(C_YELLOW "commit %s (HEAD -> %s)" C_RESET, current_commit_hash, g_current_subsection);
+        if (strcmp(commit->hash, head_hash) == 0) {
+            log_msg_diff(C_YELLOW "commit %s (HEAD -> %s)" C_RESET, commit->hash, g_current_subsection);
         } else {
-            log_msg_diff(C_YELLOW "commit %s" C_RESET, current_commit_hash);
+            log_msg_diff(C_YELLOW "commit %s" C_RESET, commit->hash);
         }
 
         log_msg_diff("Commit Version: %s", commit_tag);
 
-        char* author_line = strstr(commit_content, "author ");
-        if (author_line) {
-            char* date_start = strstr(author_line, "> ");
-            if(date_start) {
-                // Print Author: <name> <email>
-                log_msg_diff("Author: %.*s>", (int)(date_start - author_line - 7 + 1), author_line + 7);
-                
-                // Print Date: <timestamp> (<formatted_date>)
-                date_start += 2; // Skip "> "
-                char* date_end = strstr(date_start, " +");
-                if(date_end) *date_end = '\0';
-                long long ts = atoll(date_start);
-                char time_buf[100];
-                strftime(time_buf, sizeof(time_buf), "%a %b %d %T %Y", localtime((time_t*)&ts));
-                log_msg_diff("Date:   %lld (%s)", ts, time_buf); 
-            }
+        if (commit->author[0]) {
+            log_msg_diff("Author: %s", commit->author);
+            time_t ts = (time_t)commit->timestamp;
+            char time_buf[100];
+            strftime(time_buf, sizeof(time_buf), "%a %b %d %T %Y", localtime(&ts));
+            log_msg_diff("Date:   %lld (%s)", (long long)commit->timestamp, time_buf);
         }
 
         log_msg_diff("\n    %s\n", commit_tag);
-        //End print
-
-        //Find the *next* parent
-        char* parent_line = strstr(commit_content, "parent ");
-        if (parent_line) {
-            sscanf(parent_line, "parent %64s", current_commit_hash);
-        } else {
-            current_commit_hash[0] = '\0'; //end of history
-        }
-
-        free(commit_content);
-        depth++;
     }
 }
 
@@ -4130,6 +5926,695 @@ static void execute_diff_job(const char* node_name, const char* node_path, const
     diff_trees(tree1_hash, tree2_hash, "");
 }
 
+/**
+ * @brief Writes a file's content as of the active HEAD commit to dest_path.
+ * Used by the cloud daemon to recover diff bases it evicted from its cache.
+ * dest_path is only created when the file exists in HEAD.
+ */
+static void execute_cat_head_job(const char* node_path, const char* file_path, const char* dest_path) {
+    char active_head_file[PATH_MAX];
+    get_active_head_file(node_path, active_head_file, sizeof(active_head_file));
+
+    char commit_hash[HASH_STR_LEN] = {0};
+    if (read_string_from_file(active_head_file, commit_hash, sizeof(commit_hash)) != 0 || commit_hash[0] == '\0') {
+        log_msg("No HEAD commit for subsection '%s'.", g_current_subsection);
+        return;
+    }
+
+    size_t commit_size;
+    char* commit_content = read_object(commit_hash, &commit_size);
+    if (!commit_content) {
+        log_msg("Error: Failed to read commit object: %s", commit_hash);
+        return;
+    }
+    char root_tree_hash[HASH_STR_LEN];
+    char* ptr = strstr(commit_content, "tree ");
+    if (!ptr || sscanf(ptr, "tree %64s", root_tree_hash) != 1) {
+        log_msg("Error: Corrupt commit object '%s'.", commit_hash);
+        free(commit_content);
+        return;
+    }
+    free(commit_content);
+
+    char object_hash[HASH_STR_LEN];
+    mode_t file_mode;
+    double file_entropy;
+    char object_type = 0;
+    if (find_file_in_tree(root_tree_hash, file_path, object_hash, &file_mode, &file_entropy, &object_type) != 0) {
+        return; // Not in HEAD; nothing to write
+    }
+
+    if (object_type == 'B' || object_type == 'M') {
+        if (unpack_file_entry(object_hash, object_type, 0600, dest_path) != 0) {
+            log_msg("Error: Failed to read '%s' from HEAD.", file_path);
+            unlink(dest_path);
+        }
+    }
+}
+
+typedef struct RepackObject {
+    PackIndexEntry entry;       // offset/length are filled in when written
+    const uint8_t* packed;      // Source bytes in an existing pack, or NULL
+    char* loose_path;           // Source loose file, or NULL
+} RepackObject;
+
+typedef struct RepackList {
+    RepackObject* items;
+    size_t count;
+    size_t capacity;
+} RepackList;
+
+static RepackObject* repack_push(RepackList* list) {
+    if (list->count == list->capacity) {
+        size_t new_capacity = list->capacity ? list->capacity * 2 : 1024;
+        RepackObject* items = realloc(list->items, new_capacity * sizeof(RepackObject));
+        if (!items) return NULL;
+        list->items = items;
+        list->capacity = new_capacity;
+    }
+    RepackObject* obj = &list->items[list->count++];
+    memset(obj, 0, sizeof(*obj));
+    return obj;
+}
+
+// Collects loose objects stored as <base>/<2 hex>/<62 hex><suffix>.
+static int repack_scan_loose(RepackList* list, const char* base, ObjectKind kind, const char* suffix) {
+    DIR* top = opendir(base);
+    if (!top) return 0;
+    size_t suffix_len = strlen(suffix);
+    struct dirent* fan;
+    while ((fan = readdir(top)) != NULL) {
+        if (strlen(fan->d_name) != 2 || !isxdigit((unsigned char)fan->d_name[0]) || !isxdigit((unsigned char)fan->d_name[1])) continue;
+        char fan_path[PATH_MAX];
+        snprintf(fan_path, sizeof(fan_path), "%s/%s", base, fan->d_name);
+        DIR* d = opendir(fan_path);
+        if (!d) continue;
+        struct dirent* entry;
+        while ((entry = readdir(d)) != NULL) {
+            size_t len = strlen(entry->d_name);
+            if (len != HASH_LEN - 2 + suffix_len || strcmp(entry->d_name + HASH_LEN - 2, suffix) != 0) continue;
+            char hash_hex[HASH_STR_LEN];
+            snprintf(hash_hex, sizeof(hash_hex), "%s%.*s", fan->d_name, HASH_LEN - 2, entry->d_name);
+
+            RepackObject* obj = repack_push(list);
+            if (!obj) { closedir(d); closedir(top); return -1; }
+            if (hex_decode_hash(hash_hex, obj->entry.hash) != 0) { list->count--; continue; }
+            obj->entry.kind = (uint8_t)kind;
+            char path[PATH_MAX];
+            if (snprintf(path, sizeof(path), "%s/%s", fan_path, entry->d_name) >= (int)sizeof(path)) {
+                log_msg("Error: Object path too long under %s", fan_path);
+                list->count--; closedir(d); closedir(top); return -1;
+            }
+            obj->loose_path = strdup(path);
+            if (!obj->loose_path) { list->count--; closedir(d); closedir(top); return -1; }
+        }
+        closedir(d);
+    }
+    closedir(top);
+    return 0;
+}
+
+static int repack_object_cmp(const void* a, const void* b) {
+    const RepackObject* x = a;
+    const RepackObject* y = b;
+    int c = memcmp(x->entry.hash, y->entry.hash, SHA256_BLOCK_SIZE);
+    if (c) return c;
+    if (x->entry.kind != y->entry.kind) return (int)x->entry.kind - (int)y->entry.kind;
+    // Packed copies first, so duplicates keep the already-packed bytes
+    return (x->packed == NULL) - (y->packed == NULL);
+}
+
+static int write_all_fd(int fd, const void* buf, size_t len) {
+    const char* p = buf;
+    while (len > 0) {
+        ssize_t w = write(fd, p, len);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += w;
+        len -= (size_t)w;
+    }
+    return 0;
+}
+
+static int copy_loose_object(int out_fd, const char* path, uint64_t* len_out) {
+    int in_fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (in_fd < 0) return -1;
+    char buf[1 << 16];
+    uint64_t total = 0;
+    for (;;) {
+        ssize_t r = read(in_fd, buf, sizeof(buf));
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) { close(in_fd); return -1; }
+        if (r == 0) break;
+        if (write_all_fd(out_fd, buf, (size_t)r) != 0) { close(in_fd); return -1; }
+        total += (uint64_t)r;
+    }
+    close(in_fd);
+    *len_out = total;
+    return 0;
+}
+
+/**
+ * @brief Consolidates every loose object and existing pack of the node into
+ * one new pack, then removes what it replaced. With keep set, only objects
+ * it accepts are packed: the rest of the old packs is dropped and the rest
+ * of the loose objects is left alone. Must not run concurrently with a
+ * commit on the same node.
+ * @return 0 on success (or nothing to do), -1 on error.
+ */
+static int repack_objects(int (*keep)(const PackIndexEntry* e, void* ctx), void* ctx) {
+    pthread_once(&g_packs_once, load_packs);
+
+    int rc = -1;
+    RepackList list = {0};
+    size_t old_pack_count = 0, dropped = 0;
+    for (PackFile* pack = g_packs; pack; pack = pack->next) {
+        old_pack_count++;
+        for (uint32_t i = 0; i < pack->count; i++) {
+            const PackIndexEntry* e = &pack->entries[i];
+            if (e->offset + e->length > pack->pack_size) continue;
+            if (keep && !keep(e, ctx)) { dropped++; continue; }
+            RepackObject* obj = repack_push(&list);
+            if (!obj) { log_msg("Error: Out of memory listing packed objects."); goto cleanup; }
+            obj->entry = *e;
+            obj->packed = pack->pack_map + e->offset;
+        }
+    }
+    size_t packed_count = list.count;
+
+    if (repack_scan_loose(&list, g_objects_dir, OBJ_KIND_LOOSE, "") != 0 ||
+        repack_scan_loose(&list, g_bblk_objects_dir, OBJ_KIND_BBLK, ".bblk") != 0 ||
+        repack_scan_loose(&list, g_mobj_objects_dir, OBJ_KIND_MOBJ, ".mobj") != 0) {
+        log_msg("Error: Out of memory listing loose objects.");
+        goto cleanup;
+    }
+    if (keep) {
+        size_t kept = packed_count;
+        for (size_t i = packed_count; i < list.count; i++) {
+            if (keep(&list.items[i].entry, ctx)) list.items[kept++] = list.items[i];
+            else free(list.items[i].loose_path);
+        }
+        list.count = kept;
+    }
+    size_t loose_count = list.count - packed_count;
+    if (loose_count == 0 && old_pack_count <= 1 && dropped == 0) {
+        log_msg("Nothing to repack (%zu packed objects, no loose objects).", packed_count);
+        rc = 0;
+        goto cleanup;
+    }
+    log_msg("Repacking %zu loose objects and %zu packs...", loose_count, old_pack_count);
+
+    qsort(list.items, list.count, sizeof(RepackObject), repack_object_cmp);
+
+    char pack_dir[PATH_MAX], tmp_pack[PATH_MAX], tmp_idx[PATH_MAX];
+    // Every pack path is pack_dir plus a short name; fail rather than write to a truncated one
+    if (snprintf(pack_dir, sizeof(pack_dir), "%s/pack", g_objects_dir) >= (int)sizeof(pack_dir) ||
+        snprintf(tmp_pack, sizeof(tmp_pack), "%s/tmp-%d.pack", pack_dir, (int)getpid()) >= (int)sizeof(tmp_pack) ||
+        snprintf(tmp_idx, sizeof(tmp_idx), "%s/tmp-%d.idx", pack_dir, (int)getpid()) >= (int)sizeof(tmp_idx)) {
+        log_msg("Error: Pack directory path too long: %s/pack", g_objects_dir);
+        goto cleanup;
+    }
+    if (mkdir(pack_dir, 0755) != 0 && errno != EEXIST) {
+        log_msg("Error: Could not create %s: %s", pack_dir, strerror(errno));
+        goto cleanup;
+    }
+
+    int pack_fd = open(tmp_pack, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (pack_fd < 0) { log_msg("Error: Could not create %s: %s", tmp_pack, strerror(errno)); goto cleanup; }
+
+    // Write unique objects in index order; entries[] collects the index table
+    PackIndexEntry* entries = malloc((list.count ? list.count : 1) * sizeof(PackIndexEntry));
+    uint32_t fanout[256] = {0};
+    uint32_t unique = 0;
+    uint64_t offset = PACK_MAGIC_LEN;
+    int failed = !entries || write_all_fd(pack_fd, PACK_MAGIC, PACK_MAGIC_LEN) != 0;
+    SHA256_CTX id_ctx;
+    sha256_init(&id_ctx);
+    for (size_t i = 0; i < list.count && !failed; i++) {
+        RepackObject* obj = &list.items[i];
+        if (unique && memcmp(entries[unique - 1].hash, obj->entry.hash, SHA256_BLOCK_SIZE) == 0 &&
+            entries[unique - 1].kind == obj->entry.kind) {
+            continue; // Duplicate; its loose file is still removed below
+        }
+        uint64_t len = obj->entry.length;
+        if (obj->packed) {
+            failed = write_all_fd(pack_fd, obj->packed, (size_t)len) != 0;
+        } else if (copy_loose_object(pack_fd, obj->loose_path, &len) != 0) {
+            log_msg("Error: Could not copy %s: %s", obj->loose_path, strerror(errno));
+            failed = 1;
+        }
+        PackIndexEntry* e = &entries[unique++];
+        memset(e, 0, sizeof(*e));
+        memcpy(e->hash, obj->entry.hash, SHA256_BLOCK_SIZE);
+        e->kind = obj->entry.kind;
+        e->offset = offset;
+        e->length = len;
+        offset += len;
+        fanout[e->hash[0]]++;
+        sha256_update(&id_ctx, e->hash, SHA256_BLOCK_SIZE);
+        sha256_update(&id_ctx, &e->kind, 1);
+    }
+    if (!failed && fsync(pack_fd) != 0) failed = 1;
+    if (close(pack_fd) != 0) failed = 1;
+    if (failed) {
+        log_msg("Error: Failed to write pack: %s", strerror(errno));
+        free(entries); unlink(tmp_pack);
+        goto cleanup;
+    }
+    for (int i = 1; i < 256; i++) fanout[i] += fanout[i - 1];
+
+    PackIndexHeader hdr;
+    memcpy(hdr.magic, PACK_INDEX_MAGIC, PACK_MAGIC_LEN);
+    hdr.count = unique;
+    hdr.reserved = 0;
+    hdr.pack_size = offset;
+    int idx_fd = open(tmp_idx, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    failed = idx_fd < 0 ||
+             write_all_fd(idx_fd, &hdr, sizeof(hdr)) != 0 ||
+             write_all_fd(idx_fd, fanout, sizeof(fanout)) != 0 ||
+             write_all_fd(idx_fd, entries, (size_t)unique * sizeof(PackIndexEntry)) != 0 ||
+             fsync(idx_fd) != 0;
+    if (idx_fd >= 0 && close(idx_fd) != 0) failed = 1;
+    free(entries);
+    if (failed) {
+        log_msg("Error: Failed to write pack index: %s", strerror(errno));
+        unlink(tmp_idx); unlink(tmp_pack);
+        goto cleanup;
+    }
+
+    uint8_t id_raw[SHA256_BLOCK_SIZE];
+    char id_hex[HASH_STR_LEN];
+    sha256_final(&id_ctx, id_raw);
+    hex_encode(id_raw, SHA256_BLOCK_SIZE, id_hex);
+    char new_pack[PATH_MAX], new_idx[PATH_MAX];
+    if (snprintf(new_pack, sizeof(new_pack), "%s/pack-%s.pack", pack_dir, id_hex) >= (int)sizeof(new_pack) ||
+        snprintf(new_idx, sizeof(new_idx), "%s/pack-%s.idx", pack_dir, id_hex) >= (int)sizeof(new_idx)) {
+        log_msg("Error: Pack path too long under %s", pack_dir);
+        unlink(tmp_idx); unlink(tmp_pack);
+        goto cleanup;
+    }
+    // The pack goes first: an index is only visible once its pack is in place
+    if (rename(tmp_pack, new_pack) != 0 || rename(tmp_idx, new_idx) != 0) {
+        log_msg("Error: Failed to install pack: %s", strerror(errno));
+        unlink(tmp_idx); unlink(tmp_pack);
+        goto cleanup;
+    }
+
+    // Everything is in the new pack now; drop what it replaces
+    for (PackFile* pack = g_packs; pack; pack = pack->next) {
+        if (strcmp(pack->idx_path, new_idx) == 0) continue;
+        unlink(pack->idx_path);
+        unlink(pack->pack_path);
+    }
+    for (size_t i = 0; i < list.count; i++) {
+        if (!list.items[i].loose_path) continue;
+        unlink(list.items[i].loose_path);
+        char* slash = strrchr(list.items[i].loose_path, '/');
+        if (slash) { *slash = '\0'; rmdir(list.items[i].loose_path); } // Only succeeds once empty
+    }
+    log_msg("Repack complete: %u objects, %.1fMB in pack-%s.", unique, (double)offset / (1024.0 * 1024.0), id_hex);
+    rc = 0;
+
+cleanup:
+    for (size_t i = 0; i < list.count; i++) free(list.items[i].loose_path);
+    free(list.items);
+    return rc;
+}
+
+static void execute_repack_job(const char* node_path) {
+    (void)node_path;
+    repack_objects(NULL, NULL);
+}
+
+// --- Garbage collection ---
+// `exodus gc` deletes objects that nothing can reach any more: commits of
+// removed subsections, abandoned S-COMMIT chains, and the trees, blobs,
+// manifests and blocks only they used.
+//
+// The mark phase starts at TRUNK_HEAD, every subsection head, and every
+// object the stat index can still hand to a commit. Workers follow commits
+// (parent, anchor, promoted, tree), trees, manifests (blocks) and the base
+// of every delta. Any object that cannot be read aborts the run before
+// anything is deleted.
+//
+// Unreachable loose objects are unlinked unless they were written in the last
+// GC_PRUNE_GRACE_SECONDS (a commit that has not moved its head yet). If
+// packs hold unreachable objects, they are repacked with only the reachable
+// ones. Like repack, gc must not run at the same time as a commit on the node.
+
+#define GC_PRUNE_GRACE_SECONDS (60 * 60)
+#define GC_MARKS_MIN_CAPACITY 4096
+
+// What an object was reached as. An object is visited once per role, so a
+// tree that is also some delta's base still has its entries marked.
+#define GC_ROLE_DATA 1      // Blob, link or delta base: only its own delta base matters
+#define GC_ROLE_TREE 2
+#define GC_ROLE_COMMIT 4
+#define GC_ROLE_MANIFEST 8
+#define GC_ROLE_BLOCK 16
+
+typedef struct GcMark {
+    uint8_t hash[SHA256_BLOCK_SIZE];
+    uint8_t kind;               // ObjectKind
+    uint8_t roles;              // GC_ROLE_* seen so far; 0 = empty slot
+} GcMark;
+
+typedef struct GcWork {
+    char hash[HASH_STR_LEN];
+    uint8_t role;
+} GcWork;
+
+typedef struct GcState {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;        // Work pushed, or the walk finished
+    GcMark* marks;              // Open addressing, power-of-two capacity
+    size_t mark_capacity;
+    size_t mark_count;
+    GcWork* stack;
+    size_t stack_count;
+    size_t stack_capacity;
+    int active;                 // Workers visiting an object
+    int failed;
+} GcState;
+
+static uint8_t gc_role_kind(uint8_t role) {
+    if (role == GC_ROLE_MANIFEST) return OBJ_KIND_MOBJ;
+    if (role == GC_ROLE_BLOCK) return OBJ_KIND_BBLK;
+    return OBJ_KIND_LOOSE;
+}
+
+static size_t gc_mark_slot(const GcMark* marks, size_t capacity, const uint8_t* hash, uint8_t kind) {
+    uint64_t h;
+    memcpy(&h, hash, sizeof(h));
+    size_t i = (size_t)(h ^ kind) & (capacity - 1);
+    while (marks[i].roles && (marks[i].kind != kind || memcmp(marks[i].hash, hash, SHA256_BLOCK_SIZE) != 0)) {
+        i = (i + 1) & (capacity - 1);
+    }
+    return i;
+}
+
+static int gc_marks_grow(GcState* gc) {
+    size_t capacity = gc->mark_capacity ? gc->mark_capacity * 2 : GC_MARKS_MIN_CAPACITY;
+    GcMark* marks = calloc(capacity, sizeof(GcMark));
+    if (!marks) return -1;
+    for (size_t i = 0; i < gc->mark_capacity; i++) {
+        if (!gc->marks[i].roles) continue;
+        marks[gc_mark_slot(marks, capacity, gc->marks[i].hash, gc->marks[i].kind)] = gc->marks[i];
+    }
+    free(gc->marks);
+    gc->marks = marks;
+    gc->mark_capacity = capacity;
+    return 0;
+}
+
+// Only once the walk is over (no locking).
+static int gc_is_marked(const GcState* gc, const uint8_t* hash, uint8_t kind) {
+    if (!gc->mark_capacity) return 0;
+    return gc->marks[gc_mark_slot(gc->marks, gc->mark_capacity, hash, kind)].roles != 0;
+}
+
+// Marks an object in a role and queues it for a visit the first time.
+static void gc_push(GcState* gc, const char* hash_hex, uint8_t role) {
+    uint8_t raw[SHA256_BLOCK_SIZE];
+    if (strlen(hash_hex) != HASH_LEN || hex_decode_hash(hash_hex, raw) != 0) {
+        log_msg("Error: Malformed object reference '%s'.", hash_hex);
+        pthread_mutex_lock(&gc->mutex);
+        gc->failed = 1;
+        pthread_cond_broadcast(&gc->cond);
+        pthread_mutex_unlock(&gc->mutex);
+        return;
+    }
+    uint8_t kind = gc_role_kind(role);
+
+    pthread_mutex_lock(&gc->mutex);
+    if ((gc->mark_count + 1) * 2 > gc->mark_capacity && gc_marks_grow(gc) != 0) goto oom;
+    GcMark* m = &gc->marks[gc_mark_slot(gc->marks, gc->mark_capacity, raw, kind)];
+    if (m->roles & role) {
+        pthread_mutex_unlock(&gc->mutex);
+        return;
+    }
+    if (!m->roles) {
+        memcpy(m->hash, raw, SHA256_BLOCK_SIZE);
+        m->kind = kind;
+        gc->mark_count++;
+    }
+    m->roles |= role;
+
+    if (role != GC_ROLE_BLOCK) { // Blocks reference nothing
+        if (gc->stack_count == gc->stack_capacity) {
+            size_t capacity = gc->stack_capacity ? gc->stack_capacity * 2 : 1024;
+            GcWork* stack = realloc(gc->stack, capacity * sizeof(GcWork));
+            if (!stack) goto oom;
+            gc->stack = stack;
+            gc->stack_capacity = capacity;
+        }
+        GcWork* w = &gc->stack[gc->stack_count++];
+        memcpy(w->hash, hash_hex, HASH_STR_LEN);
+        w->role = role;
+        pthread_cond_signal(&gc->cond);
+    }
+    pthread_mutex_unlock(&gc->mutex);
+    return;
+
+oom:
+    log_msg("Error: Out of memory marking reachable objects.");
+    gc->failed = 1;
+    pthread_cond_broadcast(&gc->cond);
+    pthread_mutex_unlock(&gc->mutex);
+}
+
+// Marks the base of a delta object. Only the object's header is inflated.
+static int gc_visit_delta_base(GcState* gc, const char* hash) {
+    ObjectStream s;
+    if (object_stream_open(&s, hash) != 0) return -1;
+    char header[11 + HASH_LEN];
+    ssize_t n = object_stream_read(&s, header, sizeof(header));
+    object_stream_close(&s);
+    if (n < 0) return -1;
+
+    char base[HASH_STR_LEN];
+    if (n >= 11 + HASH_LEN && memcmp(header, "DELTA-BYTE\0", 11) == 0) {
+        memcpy(base, header + 11, HASH_LEN);
+    } else if (n >= 10 + HASH_LEN && memcmp(header, "DELTA-LCS\0", 10) == 0) {
+        memcpy(base, header + 10, HASH_LEN);
+    } else {
+        return 0;
+    }
+    base[HASH_LEN] = '\0';
+    gc_push(gc, base, GC_ROLE_DATA);
+    return 0;
+}
+
+static int gc_visit(GcState* gc, const GcWork* w) {
+    if (w->role == GC_ROLE_MANIFEST) {
+        ManifestData* manifest = read_mobj_object(w->hash);
+        if (!manifest) return -1;
+        for (uint32_t i = 0; i < manifest->block_count; i++) {
+            char block_hex[HASH_STR_LEN];
+            hex_encode(manifest->blocks[i].block_hash, SHA256_BLOCK_SIZE, block_hex);
+            gc_push(gc, block_hex, GC_ROLE_BLOCK);
+        }
+        free_manifest_data(manifest);
+        return 0;
+    }
+
+    if (gc_visit_delta_base(gc, w->hash) != 0) return -1;
+
+    if (w->role == GC_ROLE_COMMIT) {
+        exodus_graph_commit info;
+        char* buffer;
+        if (read_commit_info(w->hash, &info, &buffer) != 0) return -1;
+        if (info.tree[0]) gc_push(gc, info.tree, GC_ROLE_TREE);
+        if (info.parent[0]) gc_push(gc, info.parent, GC_ROLE_COMMIT);
+        if (info.anchor[0]) gc_push(gc, info.anchor, GC_ROLE_COMMIT);
+        if (info.promoted[0]) gc_push(gc, info.promoted, GC_ROLE_COMMIT);
+        free(buffer);
+    } else if (w->role == GC_ROLE_TREE) {
+        Tree* tree = load_tree(w->hash);
+        if (!tree) return -1;
+        for (uint32_t i = 0; i < tree->count; i++) {
+            const TreeRecord* r = &tree->records[i];
+            char child[HASH_STR_LEN];
+            tree_record_hash(r, child);
+            gc_push(gc, child, r->type == 'T' ? GC_ROLE_TREE : r->type == 'M' ? GC_ROLE_MANIFEST : GC_ROLE_DATA);
+        }
+        tree_release(tree);
+    }
+    return 0;
+}
+
+static void* gc_mark_worker(void* arg) {
+    GcState* gc = arg;
+    pthread_mutex_lock(&gc->mutex);
+    while (!gc->failed) {
+        if (gc->stack_count == 0) {
+            if (gc->active == 0) break; // Nothing queued and nobody can queue more
+            pthread_cond_wait(&gc->cond, &gc->mutex);
+            continue;
+        }
+        GcWork w = gc->stack[--gc->stack_count];
+        gc->active++;
+        pthread_mutex_unlock(&gc->mutex);
+
+        int rc = gc_visit(gc, &w);
+
+        pthread_mutex_lock(&gc->mutex);
+        gc->active--;
+        if (rc != 0) {
+            log_msg("Error: Failed to read object %s.", w.hash);
+            gc->failed = 1;
+        }
+    }
+    pthread_cond_broadcast(&gc->cond);
+    pthread_mutex_unlock(&gc->mutex);
+    return NULL;
+}
+
+static int gc_mark_index_object(const exodus_index_object* obj, void* ctx) {
+    gc_push(ctx, obj->hash, obj->type == 'M' ? GC_ROLE_MANIFEST : GC_ROLE_DATA);
+    return 0;
+}
+
+// Queues every head commit and the stat index. Returns the number of heads.
+static size_t gc_mark_roots(GcState* gc, const char* node_path) {
+    size_t heads = 0;
+    char head_file[PATH_MAX], head_hash[HASH_STR_LEN];
+    get_trunk_head_file(node_path, head_file, sizeof(head_file));
+    if (read_string_from_file(head_file, head_hash, sizeof(head_hash)) == 0 && head_hash[0]) {
+        gc_push(gc, head_hash, GC_ROLE_COMMIT);
+        heads++;
+    }
+
+    char subs_dir[PATH_MAX];
+    get_subsections_dir(node_path, subs_dir, sizeof(subs_dir));
+    DIR* dir = opendir(subs_dir);
+    if (dir) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            size_t len = strlen(entry->d_name);
+            if (len <= 7 || strcmp(entry->d_name + len - 7, ".subsec") != 0) continue;
+            // A head we cannot read would leave its history unmarked and swept
+            if (snprintf(head_file, sizeof(head_file), "%s/%s", subs_dir, entry->d_name) >= (int)sizeof(head_file)) {
+                log_msg("Error: Subsection head path too long: %s/%s", subs_dir, entry->d_name);
+                gc->failed = 1;
+                continue;
+            }
+            if (read_string_from_file(head_file, head_hash, sizeof(head_hash)) == 0 && head_hash[0]) {
+                gc_push(gc, head_hash, GC_ROLE_COMMIT);
+                heads++;
+            }
+        }
+        closedir(dir);
+    }
+
+    exodus_index* index = exodus_index_load(node_path);
+    exodus_index_for_each_object(index, gc_mark_index_object, gc);
+    exodus_index_free(index);
+    return heads;
+}
+
+static int gc_keep_packed(const PackIndexEntry* e, void* ctx) {
+    return gc_is_marked(ctx, e->hash, e->kind);
+}
+
+/**
+ * @brief Deletes the node's unreachable objects, or with dry_run only
+ * reports what they take up.
+ */
+static void execute_gc_job(const char* node_path, int dry_run) {
+    GcState gc = { .mutex = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+    RepackList loose = {0};
+
+    // --- 1. Mark everything reachable ---
+    size_t heads = gc_mark_roots(&gc, node_path);
+    if (heads == 0 && !gc.failed) {
+        log_msg("No commits found on any subsection. Nothing to collect.");
+        goto cleanup;
+    }
+    int workers = commit_workers_from_env();
+    pthread_t threads[COMMIT_WORKERS_MAX];
+    int started = 0;
+    for (int i = 1; i < workers; i++) {
+        if (pthread_create(&threads[started], NULL, gc_mark_worker, &gc) != 0) break;
+        started++;
+    }
+    gc_mark_worker(&gc);
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    if (gc.failed) {
+        log_msg("Error: Could not walk the history of the node. Nothing was deleted.");
+        goto cleanup;
+    }
+    log_msg("Marked %zu reachable objects from %zu heads.", gc.mark_count, heads);
+
+    // --- 2. Sweep loose objects ---
+    if (repack_scan_loose(&loose, g_objects_dir, OBJ_KIND_LOOSE, "") != 0 ||
+        repack_scan_loose(&loose, g_bblk_objects_dir, OBJ_KIND_BBLK, ".bblk") != 0 ||
+        repack_scan_loose(&loose, g_mobj_objects_dir, OBJ_KIND_MOBJ, ".mobj") != 0) {
+        log_msg("Error: Out of memory listing loose objects.");
+        goto cleanup;
+    }
+    time_t cutoff = time(NULL) - GC_PRUNE_GRACE_SECONDS;
+    size_t loose_garbage = 0, recent = 0;
+    uint64_t loose_bytes = 0;
+    for (size_t i = 0; i < loose.count; i++) {
+        RepackObject* obj = &loose.items[i];
+        if (gc_is_marked(&gc, obj->entry.hash, obj->entry.kind)) continue;
+        struct stat st;
+        if (lstat(obj->loose_path, &st) != 0) continue;
+        if (st.st_mtime > cutoff) {
+            recent++;
+            continue;
+        }
+        loose_garbage++;
+        loose_bytes += (uint64_t)st.st_size;
+        if (dry_run) continue;
+        if (unlink(obj->loose_path) != 0) {
+            log_msg("Warning: Could not remove %s: %s", obj->loose_path, strerror(errno));
+            continue;
+        }
+        char* slash = strrchr(obj->loose_path, '/');
+        if (slash) { *slash = '\0'; rmdir(obj->loose_path); } // Only succeeds once empty
+    }
+
+    // --- 3. Packed objects go with a repack ---
+    pthread_once(&g_packs_once, load_packs);
+    size_t packed_garbage = 0;
+    uint64_t packed_bytes = 0;
+    for (PackFile* pack = g_packs; pack; pack = pack->next) {
+        for (uint32_t i = 0; i < pack->count; i++) {
+            if (gc_is_marked(&gc, pack->entries[i].hash, pack->entries[i].kind)) continue;
+            packed_garbage++;
+            packed_bytes += pack->entries[i].length;
+        }
+    }
+
+    if (dry_run) {
+        log_msg("Dry run: %zu unreachable loose objects (%.1fMB) and %zu packed objects (%.1fMB) can be reclaimed.",
+                loose_garbage, (double)loose_bytes / (1024.0 * 1024.0),
+                packed_garbage, (double)packed_bytes / (1024.0 * 1024.0));
+    } else {
+        if (packed_garbage > 0 && repack_objects(gc_keep_packed, &gc) != 0) {
+            log_msg("Error: Repack failed; unreachable packed objects were kept.");
+            packed_garbage = 0;
+            packed_bytes = 0;
+        }
+        log_msg("Removed %zu unreachable loose objects (%.1fMB) and %zu packed objects (%.1fMB).",
+                loose_garbage, (double)loose_bytes / (1024.0 * 1024.0),
+                packed_garbage, (double)packed_bytes / (1024.0 * 1024.0));
+    }
+    if (recent > 0) {
+        log_msg("Kept %zu unreachable objects written in the last %d minutes.", recent, GC_PRUNE_GRACE_SECONDS / 60);
+    }
+
+cleanup:
+    for (size_t i = 0; i < loose.count; i++) free(loose.items[i].loose_path);
+    free(loose.items);
+    free(gc.marks);
+    free(gc.stack);
+}
+
 int main(int argc, char *argv[]) {
     log_msg("exodus_snapshot starting...");
 
@@ -4224,6 +6709,18 @@ int main(int argc, char *argv[]) {
             log_msg("Command: %s, Node: %s, Sub: %s, Version: %s, File: %s", command, node_name, g_current_subsection, arg1, arg2);
             execute_checkout_job(node_name, node_path, arg1, arg2); // arg1=version, arg2=file
         }
+    } else if (strcmp(command, "cat-head") == 0) {
+        if (!arg1 || !arg2) {
+            log_msg("Received malformed IPC data for 'cat-head'.");
+        } else {
+            execute_cat_head_job(node_path, arg1, arg2); // arg1=file, arg2=destination
+        }
+    } else if (strcmp(command, "repack") == 0) {
+        log_msg("Command: %s, Node: %s", command, node_name);
+        execute_repack_job(node_path);
+    } else if (strcmp(command, "gc") == 0) {
+        log_msg("Command: %s, Node: %s, Mode: %s", command, node_name, arg1 ? arg1 : "--prune");
+        execute_gc_job(node_path, arg1 && strcmp(arg1, "--dry-run") == 0);
     }else if (strcmp(command, "log") == 0) {
     log_msg("Command: %s, Node: %s, Sub: %s", command, node_name, g_current_subsection);
     execute_log_job(node_path);
@@ -4231,6 +6728,12 @@ int main(int argc, char *argv[]) {
         log_msg("Unknown command: %s", command ? command : "NULL");
     }
 
+    if (g_object_cache.hits + g_object_cache.misses > 0) {
+        log_msg("Object cache: %zu hits, %zu misses.", g_object_cache.hits, g_object_cache.misses);
+    }
+
+    exodus_graph_free(g_commit_graph);
+    g_commit_graph = NULL;
     cortez_ipc_free_data(data_head);
     log_msg("exodus_snapshot finished.");
     return 0;
@@ -8,6 +8,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <signal.h>
+#include <setjmp.h>
 #include <ctype.h>
 #include <stddef.h>
 #include <ctype.h>
@@ -24,10 +25,19 @@
 #include <stdint.h>  
 #include <sys/uio.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <poll.h>
+#include <fnmatch.h>
+#include <zlib.h>
 
 #include "cortez-mesh.h"
 #include "exodus-common.h"
 #include "ctz-json.h"
+#include "exodus-journal.h"
+#include "exodus-diff.h"
+#include "exodus-index.h"
+#include "cortez_ipc.h"
 
 
 
@@ -42,22 +52,56 @@
 
 typedef struct WatchedNode WatchedNode;
 
-// Maps a watch descriptor (wd) to a path and its parent node
+// Maps a watch descriptor (wd) to a path and its parent node.
+// Entries live in an open-addressed table keyed by wd and are also linked
+// into their node's watches list, so a node can drop its watches directly.
+// dir_fd is an O_PATH handle on the directory, used to fstatat() event names
+// without walking the full path again; -1 past the fd budget or if it could
+// not be opened, in which case the path is used.
 typedef struct WatchDescriptorMap {
     int wd;
+    int dir_fd;
     char path[PATH_MAX];
     WatchedNode* parent_node;
-    struct WatchDescriptorMap* next;
+    struct WatchDescriptorMap* node_prev;
+    struct WatchDescriptorMap* node_next;
 } WatchDescriptorMap;
 
-// Caches file content to detect changes for detailed logging
+#define WD_TABLE_MIN_CAPACITY 256
+#define WATCH_DIR_FD_MAX 65536      // O_PATH fds kept for watched directories, at most
+#define WATCH_FD_HEADROOM 1024      // Descriptors always left free for files, pipes and the mesh
+
+// Content-addressed, possibly zlib-compressed file content.
+// Identical files share one blob.
+typedef struct FileBlob {
+    uint64_t hash;            // FNV-1a of the raw content
+    size_t raw_len;
+    size_t stored_len;
+    int compressed;
+    int refcount;
+    unsigned char* data;
+    struct FileBlob* next;    // Blob hash chain
+} FileBlob;
+
+// Caches file content to detect changes for detailed logging.
+// Entries are hashed by path. Entries holding a blob sit on an LRU list and
+// lose the blob (but keep their slot) when the cache exceeds its budget.
+// Evicted entries move to a list of their own and the oldest are dropped
+// once their paths outgrow FILE_CACHE_EVICTED_SHARE.
 typedef struct FileCache {
-    char path[PATH_MAX];
-    char* content;
-    struct FileCache* next;
-    time_t last_processed_time;
+    char* path;
+    uint64_t path_hash;
+    FileBlob* blob;           // NULL when evicted
+    struct FileCache* next;   // Path hash chain
+    struct FileCache* lru_prev; // On the LRU list, or the evicted list without a blob
+    struct FileCache* lru_next;
 } FileCache;
 
+#define FILE_CACHE_DEFAULT_MB 256
+#define FILE_CACHE_MIN_BUCKETS 1024
+#define FILE_CACHE_COMPRESS_MIN 256 // Smaller contents are stored raw
+#define FILE_CACHE_EVICTED_SHARE 8 // Evicted entries may hold 1/8 of the budget
+
 // Represents a single file system event in a node's history
 typedef enum {
     EV_CREATED,
@@ -83,20 +127,42 @@ typedef struct FilterEntry {
     struct FilterEntry* next;
 } FilterEntry;
 
-typedef struct DiffChange {
-    char op; 
-    int line_num;
-    const char* content;
-    struct DiffChange* next;
-    int matched;
-} DiffChange;
-
-typedef struct MovedChange {
-    int from_line;
-    int to_line;
-    const char* content;
-    struct MovedChange* next;
-} MovedChange;
+// One file or directory in a node's contents index (mirrors contents.json)
+typedef struct ContentsEntry {
+    char* rel_path;
+    const char* name;                   // Basename, points into rel_path
+    int is_dir;
+    uint64_t hash;
+    struct ContentsEntry* hash_next;
+    struct ContentsEntry* parent;
+    struct ContentsEntry* first_child;  // Children in discovery order
+    struct ContentsEntry* last_child;
+    struct ContentsEntry* prev_sibling;
+    struct ContentsEntry* next_sibling;
+    struct NameGroup* group;            // Entries sharing this basename, across all nodes
+    struct ContentsEntry* name_prev;
+    struct ContentsEntry* name_next;
+    WatchedNode* node;
+} ContentsEntry;
+
+// One distinct basename in the global lookup index
+typedef struct NameGroup {
+    char* name;
+    uint64_t hash;
+    ContentsEntry* entries;
+    struct NameGroup* next;             // Hash chain
+} NameGroup;
+
+typedef struct {
+    ContentsEntry root;                 // The node directory itself
+    WatchedNode* node;
+    ContentsEntry** buckets;
+    size_t bucket_count;
+    size_t count;
+    int dirty;                          // contents.json needs rewriting
+} ContentsIndex;
+
+struct PendingEvent;
 
 // Represents a directory being watched by the daemon
 struct WatchedNode {
@@ -114,6 +180,13 @@ struct WatchedNode {
     WatchedNode* next;
     TimeFormat time_format;
     FilterEntry* filter_list_head;
+    WatchDescriptorMap* watches_head; // Guarded by wd_map_mutex
+    int coalesce_ms;                  // Event coalescing window
+    struct PendingEvent* pending_head; // Guarded by pending_event_mutex
+    struct PendingEvent* pending_tail;
+    size_t pending_count;
+    int64_t pending_since_ms;
+    ContentsIndex contents;           // Guarded by contents_mutex
 };
 
 typedef struct PendingMove {
@@ -122,12 +195,91 @@ typedef struct PendingMove {
     WatchedNode* from_node;
     time_t timestamp;
     char user[64];
+    int is_dir;
     struct PendingMove* next;
 } PendingMove;
 
+// An event waiting in its node's coalescing window
+typedef struct PendingEvent {
+    EventType type;
+    int is_dir;
+    int dropped;                // Cancelled by a later event (create + delete)
+    int indexed;                // Reachable through pending_event_buckets
+    char* name;
+    char* from_name;            // EV_MOVED only
+    char* details;
+    char user[64];
+    WatchedNode* node;
+    uint64_t hash;
+    struct PendingEvent* next;  // Node queue, arrival order
+    struct PendingEvent* hash_next;
+} PendingEvent;
+
+// A mesh request copied out of the inbox, waiting for a worker
+typedef struct CloudRequest {
+    uint16_t msg_type;
+    pid_t sender_pid;
+    uint32_t size;              // Bytes in data: request id + request body
+    struct CloudRequest* next;
+    char data[];
+} CloudRequest;
+
+typedef struct {
+    const char* name;
+    CloudRequest* head;
+    CloudRequest* tail;
+    size_t depth;
+    int closing;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t* threads;
+    int thread_count;
+} RequestQueue;
+
+enum { REQUEST_QUEUE_QUERY, REQUEST_QUEUE_CONTROL, REQUEST_QUEUE_COUNT };
+
+// A modification whose diff base fell out of the file cache. The base is
+// read back from the node's HEAD snapshot on the diff base worker.
+typedef struct DiffBaseJob {
+    WatchedNode* node;                  // NULL once the node is removed
+    char node_name[MAX_NODE_NAME_LEN];  // Copies, so the lookup needs no lock
+    char node_path[PATH_MAX];
+    char user[64];
+    char* full_path;
+    char* old_content;                  // New content of an earlier queued change to the file, or NULL
+    char* new_content;
+    struct DiffBaseJob* next;
+} DiffBaseJob;
+
+typedef struct {
+    DiffBaseJob* head;
+    DiffBaseJob* tail;
+    DiffBaseJob* running;               // Being looked up; node is cleared by discard_node_events
+    size_t depth;
+    int closing;
+    int started;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} DiffBaseQueue;
+
+#define REQUEST_WORKERS_DEFAULT 4
+#define REQUEST_WORKERS_MAX 64
+
+#define COALESCE_DEFAULT_MS 500
+#define COALESCE_MAX_PENDING 8192   // Flush a node early past this many events
+#define COALESCE_POLL_MS 100
+#define PENDING_EVENT_BUCKETS 4096
+#define CONTENTS_MIN_BUCKETS 256
+#define LOOKUP_PAGE_DEFAULT 256        // Results per MSG_LOOKUP_RESPONSE unless the client asks otherwise
+#define LOOKUP_PAGE_MAX 4096
+#define LOOKUP_PAGE_BYTES (64 * 1024)
+#define LOOKUP_CACHE_SLOTS 8           // Sorted lookups kept for their later pages
+#define DIFF_BASE_QUEUE_MAX 64         // Evicted diff bases waiting for a snapshot lookup
+
 // --- Global Variables ---
 
-static char* file_content = NULL;
+static const char* file_content = NULL;    // Read-only mapping of the uploaded file (not NUL-terminated)
 static size_t file_size = 0;
 static char last_uploaded_file_path[PATH_MAX] = {0};
 static pid_t guardian_daemon_pid = 0;
@@ -136,14 +288,46 @@ static pid_t g_signal_daemon_pid = 0;
  
 
 static PendingMove* pending_move_head = NULL;
-static WatchDescriptorMap* wd_map_head = NULL;
-static FileCache* file_cache_head = NULL;
+static WatchDescriptorMap** wd_table = NULL;   // Open-addressed, capacity is a power of two
+static size_t wd_table_capacity = 0;
+static size_t wd_table_count = 0;               // Live entries
+static size_t wd_table_used = 0;                // Live entries + tombstones
+static size_t wd_dir_fd_count = 0;              // Open dir_fds, guarded by wd_map_mutex
+static size_t wd_dir_fd_budget = 0;             // Set by raise_fd_limit()
+static WatchDescriptorMap wd_table_tombstone_entry;
+#define WD_TOMBSTONE (&wd_table_tombstone_entry)
+static FileCache** file_cache_buckets = NULL;
+static size_t file_cache_bucket_count = 0;
+static size_t file_cache_entry_count = 0;
+static FileBlob** file_blob_buckets = NULL;
+static size_t file_blob_bucket_count = 0;
+static size_t file_blob_count = 0;
+static FileCache* file_cache_lru_head = NULL; // Most recently used
+static FileCache* file_cache_lru_tail = NULL;
+static size_t file_cache_bytes = 0;           // Bytes held by blobs
+static FileCache* file_cache_evicted_head = NULL; // Most recently evicted
+static FileCache* file_cache_evicted_tail = NULL;
+static size_t file_cache_evicted_bytes = 0;   // Bytes held by evicted entries
+static size_t file_cache_budget = (size_t)FILE_CACHE_DEFAULT_MB * 1024 * 1024;
 static WatchedNode* watched_nodes_head = NULL;
 
 static pthread_mutex_t wd_map_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t file_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t node_list_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_rwlock_t node_list_lock;    // Writer-preferring, see init_node_list_lock()
+static pthread_mutex_t history_mutex = PTHREAD_MUTEX_INITIALIZER;   // Guards every node's history_head
 static pthread_mutex_t pending_move_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t pending_event_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t flush_mutex = PTHREAD_MUTEX_INITIALIZER;    // Held while a batch is applied
+static pthread_mutex_t contents_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static PendingEvent* pending_event_buckets[PENDING_EVENT_BUCKETS];
+static NameGroup** name_index_buckets = NULL;   // basename -> entries, guarded by contents_mutex
+static size_t name_index_bucket_count = 0;
+static size_t name_index_group_count = 0;
+static uint64_t name_index_generation = 0;      // Bumped whenever an entry joins or leaves the index
+static RequestQueue request_queues[REQUEST_QUEUE_COUNT];
+static cortez_mesh_t* g_mesh = NULL;
+static DiffBaseQueue diff_base_queue = { .mutex = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
 
 
 static char config_file_path[PATH_MAX] = {0};
@@ -155,7 +339,6 @@ int get_executable_dir(char* buffer, size_t size);
 void load_nodes();
 void save_nodes();
 void* watcher_thread_func(void* arg);
-void recursive_scan_dir(const char* base_path, ctz_json_value* json_array);
 void add_watches_recursively(WatchedNode* node, const char* base_path);
 void remove_all_watches_for_node(WatchedNode* node);
 void handle_file_modification(WatchedNode* node, const char* full_path, const char* user);
@@ -299,61 +482,6 @@ static int secure_file_delete(const char *path) {
     return 0; // Success
 }
 
-static int split_lines(char* content_copy, char*** lines_array_out) {
-    if (!content_copy) {
-        *lines_array_out = NULL;
-        return 0;
-    }
-
-    int line_count = 0;
-    
-    for (char* p = content_copy; *p; p++) {
-        if (*p == '\n') {
-            line_count++;
-        }
-    }
-    // Account for the last line if the file doesn't end with \n
-    if (content_copy[0] != '\0' && (line_count == 0 || content_copy[strlen(content_copy) - 1] != '\n')) {
-         line_count++;
-    }
-
-    if (line_count == 0) {
-        *lines_array_out = NULL;
-        return 0;
-    }
-
-    // 2. Allocate the array
-    *lines_array_out = malloc(line_count * sizeof(char*));
-    if (!*lines_array_out) return 0;
-    
-    int current_line = 0;
-    char* line_start = content_copy;
-    
-    // Always add the first line (even if the file is just "hello")
-    (*lines_array_out)[current_line++] = line_start;
-
-    // Iterate and manually split the string
-    for (char* p = content_copy; *p; p++) {
-        if (*p == '\n') {
-            *p = '\0'; // Terminate the current line string
-
-            if (current_line < line_count) {
-                (*lines_array_out)[current_line++] = p + 1;
-            }
-        }
-    }
-    
-    return current_line;
-}
-
-static void free_lcs_matrix(int** matrix, int rows) {
-    if (!matrix) return;
-    for (int i = 0; i < rows; i++) {
-        free(matrix[i]);
-    }
-    free(matrix);
-}
-
 static unsigned char* base64_decode(const char* data, size_t input_length, size_t* output_length) {
     static const int b64_inv_table[] = { 
         -1,-1,-1,-1, -1,-1,-1,-1, -1,-1,-1,-1, -1,-1,-1,-1,
@@ -512,14 +640,6 @@ static int get_user_from_path(const char* path, char* user_buf, size_t buf_size,
     return 0; // Success
 }
 
-static uid_t get_uid_for_path(const char* path) {
-    struct stat st;
-    if (stat(path, &st) == 0) {
-        return st.st_uid;
-    }
-    return (uid_t)-1; // Error
-}
-
 static void get_username_from_uid(uid_t uid, char* buf, size_t buf_size) {
     // Default to a fallback name
     snprintf(buf, buf_size, "%d", (int)uid);
@@ -567,15 +687,145 @@ static void get_username_from_uid(uid_t uid, char* buf, size_t buf_size) {
     }
 }
 
+// uid -> name cache for the watcher thread (the only user, so no lock).
+// It is dropped whenever /etc/passwd changes, checked once per event batch.
+#define UID_CACHE_SIZE 64
+
+typedef struct {
+    uid_t uid;
+    int used;
+    char name[64];
+} UidCacheEntry;
+
+static UidCacheEntry uid_cache[UID_CACHE_SIZE];
+static size_t uid_cache_count = 0;
+static struct timespec uid_cache_passwd_mtime;
+static ino_t uid_cache_passwd_ino;
+
+// Per-batch syscall accounting, printed when EXODUS_WATCHER_STATS is set.
+// stats counts fstatat/stat calls on event paths; reused counts events whose
+// owner was already known from an earlier event in the same batch.
+typedef struct {
+    size_t events;
+    size_t stats;
+    size_t reused;
+    size_t passwd_checks;
+    size_t passwd_scans;
+    int last_wd;
+    char last_name[NAME_MAX + 1];
+    uid_t last_uid;
+    int last_dir_wd;
+    uid_t last_dir_uid;
+} WatcherBatch;
+
+static void watcher_batch_begin(WatcherBatch* batch) {
+    memset(batch, 0, sizeof(*batch));
+    batch->last_wd = -1;
+    batch->last_dir_wd = -1;
+}
+
+static void uid_cache_revalidate(WatcherBatch* batch) {
+    struct stat st;
+    batch->passwd_checks++;
+    if (stat("/etc/passwd", &st) != 0) return;
+    if (st.st_mtim.tv_sec == uid_cache_passwd_mtime.tv_sec &&
+        st.st_mtim.tv_nsec == uid_cache_passwd_mtime.tv_nsec &&
+        st.st_ino == uid_cache_passwd_ino) return;
+    // Also covers the first call; editors replace the file, hence the inode
+    memset(uid_cache, 0, sizeof(uid_cache));
+    uid_cache_count = 0;
+    uid_cache_passwd_mtime = st.st_mtim;
+    uid_cache_passwd_ino = st.st_ino;
+}
+
+static void uid_cache_lookup(uid_t uid, char* buf, size_t buf_size, WatcherBatch* batch) {
+    size_t mask = UID_CACHE_SIZE - 1;
+    size_t i = ((size_t)uid * 0x9E3779B1u) & mask;
+    while (uid_cache[i].used) {
+        if (uid_cache[i].uid == uid) {
+            snprintf(buf, buf_size, "%s", uid_cache[i].name);
+            return;
+        }
+        i = (i + 1) & mask;
+    }
+
+    get_username_from_uid(uid, buf, buf_size);
+    batch->passwd_scans++;
+
+    // Keep the table at most half full; a full reset is fine for a cache this small
+    if ((uid_cache_count + 1) * 2 > UID_CACHE_SIZE) {
+        memset(uid_cache, 0, sizeof(uid_cache));
+        uid_cache_count = 0;
+        i = ((size_t)uid * 0x9E3779B1u) & mask;
+    }
+    uid_cache[i].used = 1;
+    uid_cache[i].uid = uid;
+    snprintf(uid_cache[i].name, sizeof(uid_cache[i].name), "%s", buf);
+    uid_cache_count++;
+}
+
+// Owner of an event's file, or of its directory once the file is gone.
+// Stats relative to the watch's directory fd, so the caller must hold
+// wd_map_mutex to keep the fd open. Repeated events on the same name (or
+// the same directory) within a batch reuse the previous answer.
+static uid_t watcher_event_uid_locked(const WatchDescriptorMap* watch, const struct inotify_event* event,
+                                      WatcherBatch* batch) {
+    struct stat st;
+    if (event->mask & (IN_CREATE | IN_MOVED_TO | IN_MODIFY)) {
+        if (batch->last_wd == watch->wd && strcmp(batch->last_name, event->name) == 0) {
+            batch->reused++;
+            return batch->last_uid;
+        }
+        int rc;
+        if (watch->dir_fd >= 0) {
+            rc = fstatat(watch->dir_fd, event->name, &st, 0);
+        } else {
+            char full_path[PATH_MAX];
+            snprintf(full_path, sizeof(full_path), "%s/%s", watch->path, event->name);
+            rc = stat(full_path, &st);
+        }
+        batch->stats++;
+        uid_t uid = rc == 0 ? st.st_uid : (uid_t)-1;
+        batch->last_wd = watch->wd;
+        snprintf(batch->last_name, sizeof(batch->last_name), "%s", event->name);
+        batch->last_uid = uid;
+        return uid;
+    }
+    if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+        if (batch->last_dir_wd == watch->wd) {
+            batch->reused++;
+            return batch->last_dir_uid;
+        }
+        int rc = watch->dir_fd >= 0 ? fstat(watch->dir_fd, &st) : stat(watch->path, &st);
+        batch->stats++;
+        uid_t uid = rc == 0 ? st.st_uid : (uid_t)-1;
+        batch->last_dir_wd = watch->wd;
+        batch->last_dir_uid = uid;
+        return uid;
+    }
+    return (uid_t)-1;
+}
+
+static void watcher_batch_report(const WatcherBatch* batch) {
+    if (batch->events == 0) return;
+    // poll + read, plus the per-event stats and passwd checks/scans
+    size_t syscalls = 2 + batch->stats + batch->passwd_checks + batch->passwd_scans;
+    printf("[Watcher] Batch: %zu events, %zu stats (%zu reused), %zu passwd scans, %.2f syscalls/event\n",
+           batch->events, batch->stats, batch->reused, batch->passwd_scans,
+           (double)syscalls / (double)batch->events);
+}
+
 static void write_to_handle_and_commit(cortez_mesh_t* mesh, pid_t target_pid, uint16_t msg_type, const void* data, size_t size) {
     int sent_ok = 0;
     for (int i = 0; i < 5; i++) { // Retry 5 times
-        cortez_write_handle_t* h = cortez_mesh_begin_send_zc(mesh, target_pid, size);
-        if (h) {
-            write_to_handle(h, data, size); // Use your existing helper
-            cortez_mesh_commit_send_zc(h, msg_type);
-            sent_ok = 1;
-            break;
+        cortez_write_handle_t h;
+        if (cortez_mesh_begin_send_zc_into(mesh, target_pid, size, &h) == CORTEZ_OK) {
+            write_to_handle(&h, data, size); // Use your existing helper
+            // A stale commit drops the message; send it again
+            if (cortez_mesh_commit_send_zc(&h, msg_type) == CORTEZ_OK) {
+                sent_ok = 1;
+                break;
+            }
         }
         usleep(100000); // Wait 100ms
     }
@@ -585,16 +835,16 @@ static void write_to_handle_and_commit(cortez_mesh_t* mesh, pid_t target_pid, ui
 }
 
 WatchedNode* find_node_by_name_locked(const char* name) {
-    pthread_mutex_lock(&node_list_mutex);
+    pthread_rwlock_rdlock(&node_list_lock);
     for (WatchedNode* n = watched_nodes_head; n; n = n->next) {
         if (strcmp(n->name, name) == 0) {
             // Found it
-            pthread_mutex_unlock(&node_list_mutex);
+            pthread_rwlock_unlock(&node_list_lock);
             return n;
         }
     }
     // Not found
-    pthread_mutex_unlock(&node_list_mutex);
+    pthread_rwlock_unlock(&node_list_lock);
     return NULL;
 }
 
@@ -752,13 +1002,6 @@ int recursive_copy(const char* src, const char* dest) {
     return 0;
 }
 
-static void get_real_time_string(char* buf, size_t size) {
-    time_t now = time(NULL);
-    struct tm local_time;
-    localtime_r(&now, &local_time);
-    strftime(buf, size, "%Y-%m-%d %H:%M:%S", &local_time);
-}
-
 static void free_filter_list(FilterEntry* head) {
     FilterEntry* current = head;
     while (current) {
@@ -785,38 +1028,6 @@ static int is_file_filtered(const char* filename, FilterEntry* filter_list_head)
     return 0; // No match
 }
 
-// Generates the contents.json file for a given node
-void generate_node_contents_json(WatchedNode* node) {
-    if (!node) return;
-
-    char contents_file_path[PATH_MAX];
-    snprintf(contents_file_path, sizeof(contents_file_path), "%s/.log/contents.json", node->path);
-
-    ctz_json_value* root_array = ctz_json_new_array();
-    if (!root_array) {
-        fprintf(stderr, "[Cloud] Failed to create JSON array for node '%s'\n", node->name);
-        return;
-    }
-
-    recursive_scan_dir(node->path, root_array);
-
-    char* json_string = ctz_json_stringify(root_array, 1); // Pretty print
-    if (json_string) {
-        FILE* f = fopen(contents_file_path, "w");
-        if (f) {
-            fprintf(f, "%s", json_string);
-            fclose(f);
-        } else {
-            fprintf(stderr, "[Cloud] Failed to write to %s\n", contents_file_path);
-        }
-        free(json_string);
-    }
-    
-    ctz_json_free(root_array);
-    printf("[Cloud] Re-indexed contents for node '%s'.\n", node->name);
-}
-
-
 char* read_file_content(const char* path) {
     FILE* f = fopen(path, "rb");
     if (!f) return NULL;
@@ -848,316 +1059,1109 @@ char* read_file_content(const char* path) {
 }
 
 
-void update_file_cache(const char* path, const char* content) {
-    pthread_mutex_lock(&file_cache_mutex);
-    FileCache* current = file_cache_head;
-    while (current) {
-        if (strcmp(current->path, path) == 0) {
-            // Found existing entry, update it
-            free(current->content);
-            current->content = content ? strdup(content) : NULL;
-            current->last_processed_time = time(NULL);
-            // If content is null, this effectively removes the cached data
-            pthread_mutex_unlock(&file_cache_mutex);
-            return;
-        }
-        current = current->next;
+// --- File content cache (helpers ending in _locked need file_cache_mutex) ---
+
+static uint64_t fnv1a64(const void* data, size_t len) {
+    const unsigned char* p = data;
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
     }
+    return h;
+}
 
-    // Not found, add a new entry if content is not null
-    if (content) {
-        FileCache* new_entry = malloc(sizeof(FileCache));
-        if (new_entry) {
-            strncpy(new_entry->path, path, sizeof(new_entry->path) - 1);
-            new_entry->path[sizeof(new_entry->path) - 1] = '\0';
-            new_entry->content = strdup(content);
-            new_entry->last_processed_time = time(NULL); // <-- ADD THIS LINE
-            new_entry->next = file_cache_head;
-            file_cache_head = new_entry;
+// Reads EXODUS_FILE_CACHE_MB once; the cache is unbounded if it is set to 0.
+static void file_cache_init_budget(void) {
+    const char* env = getenv("EXODUS_FILE_CACHE_MB");
+    if (env && *env) {
+        char* end = NULL;
+        unsigned long long mb = strtoull(env, &end, 10);
+        if (end && *end == '\0') {
+            file_cache_budget = mb ? (size_t)(mb * 1024 * 1024) : SIZE_MAX;
         }
     }
-    pthread_mutex_unlock(&file_cache_mutex);
+    if (file_cache_budget == SIZE_MAX) printf("[Cloud] File cache budget: unlimited\n");
+    else printf("[Cloud] File cache budget: %zu MB\n", file_cache_budget / (1024 * 1024));
 }
 
-
-void add_watches_recursively(WatchedNode* node, const char* base_path) {
-    DIR* dir = opendir(base_path);
-    if (!dir) {
-        fprintf(stderr, "[Watcher] Could not open directory for watching: %s\n", base_path);
-        return;
+static int file_cache_grow_locked(void) {
+    size_t new_count = file_cache_bucket_count ? file_cache_bucket_count * 2 : FILE_CACHE_MIN_BUCKETS;
+    FileCache** nb = calloc(new_count, sizeof(FileCache*));
+    if (!nb) return -1;
+    for (size_t i = 0; i < file_cache_bucket_count; i++) {
+        FileCache* e = file_cache_buckets[i];
+        while (e) {
+            FileCache* next = e->next;
+            size_t b = e->path_hash & (new_count - 1);
+            e->next = nb[b];
+            nb[b] = e;
+            e = next;
+        }
     }
+    free(file_cache_buckets);
+    file_cache_buckets = nb;
+    file_cache_bucket_count = new_count;
+    return 0;
+}
 
-    // Add a watch for the current directory itself
-    int wd = inotify_add_watch(inotify_fd, base_path, IN_CREATE | IN_DELETE | IN_MODIFY | IN_MOVED_FROM | IN_MOVED_TO);
-    if (wd == -1) {
-        fprintf(stderr, "[Watcher] Failed to watch %s: %s\n", base_path, strerror(errno));
-        closedir(dir);
-        return;
+static int file_blob_grow_locked(void) {
+    size_t new_count = file_blob_bucket_count ? file_blob_bucket_count * 2 : FILE_CACHE_MIN_BUCKETS;
+    FileBlob** nb = calloc(new_count, sizeof(FileBlob*));
+    if (!nb) return -1;
+    for (size_t i = 0; i < file_blob_bucket_count; i++) {
+        FileBlob* b = file_blob_buckets[i];
+        while (b) {
+            FileBlob* next = b->next;
+            size_t idx = b->hash & (new_count - 1);
+            b->next = nb[idx];
+            nb[idx] = b;
+            b = next;
+        }
     }
+    free(file_blob_buckets);
+    file_blob_buckets = nb;
+    file_blob_bucket_count = new_count;
+    return 0;
+}
 
-    // Add the new watch descriptor to our map
-    WatchDescriptorMap* new_map_entry = malloc(sizeof(WatchDescriptorMap));
-    if (new_map_entry) {
-        new_map_entry->wd = wd;
-        strncpy(new_map_entry->path, base_path, sizeof(new_map_entry->path) - 1);
-        new_map_entry->parent_node = node;
-        
-        pthread_mutex_lock(&wd_map_mutex);
-        new_map_entry->next = wd_map_head;
-        wd_map_head = new_map_entry;
-        pthread_mutex_unlock(&wd_map_mutex);
-    } else {
-        inotify_rm_watch(inotify_fd, wd); // Cleanup on malloc failure
+static FileCache* file_cache_find_locked(const char* path, uint64_t path_hash) {
+    if (!file_cache_buckets) return NULL;
+    for (FileCache* e = file_cache_buckets[path_hash & (file_cache_bucket_count - 1)]; e; e = e->next) {
+        if (e->path_hash == path_hash && strcmp(e->path, path) == 0) return e;
     }
-    
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != NULL) {
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0 || strcmp(entry->d_name, ".log") == 0) continue;
+    return NULL;
+}
 
-        char full_path[PATH_MAX];
-        snprintf(full_path, sizeof(full_path), "%s/%s", base_path, entry->d_name);
+static void file_cache_list_unlink_locked(FileCache** head, FileCache** tail, FileCache* e) {
+    if (e->lru_prev) e->lru_prev->lru_next = e->lru_next;
+    else if (*head == e) *head = e->lru_next;
+    if (e->lru_next) e->lru_next->lru_prev = e->lru_prev;
+    else if (*tail == e) *tail = e->lru_prev;
+    e->lru_prev = e->lru_next = NULL;
+}
 
-        struct stat st;
-        if (stat(full_path, &st) == 0) {
-            if (S_ISDIR(st.st_mode)) {
-                // It's a directory, recurse into it
-                add_watches_recursively(node, full_path);
-            } else if (S_ISREG(st.st_mode)) {
-                // It's a regular file, cache its initial content for diffing
-                char* content = read_file_content(full_path);
-                if (content) {
-                    update_file_cache(full_path, content);
-                    free(content);
-                }
-            }
-        }
-    }
-    closedir(dir);
+static void file_cache_list_push_locked(FileCache** head, FileCache** tail, FileCache* e) {
+    e->lru_prev = NULL;
+    e->lru_next = *head;
+    if (*head) (*head)->lru_prev = e;
+    *head = e;
+    if (!*tail) *tail = e;
 }
 
+static void file_cache_lru_unlink_locked(FileCache* e) {
+    file_cache_list_unlink_locked(&file_cache_lru_head, &file_cache_lru_tail, e);
+}
 
+static void file_cache_lru_push_locked(FileCache* e) {
+    file_cache_list_push_locked(&file_cache_lru_head, &file_cache_lru_tail, e);
+}
 
-void remove_all_watches_for_node(WatchedNode* node) {
-    // Remove all watch descriptors from inotify and our map
-    pthread_mutex_lock(&wd_map_mutex);
-    WatchDescriptorMap** pptr = &wd_map_head;
-    while (*pptr) {
-        WatchDescriptorMap* entry = *pptr;
-        if (entry->parent_node == node) {
-            inotify_rm_watch(inotify_fd, entry->wd);
-            *pptr = entry->next; // Unlink from list
-            free(entry);
+static size_t file_cache_entry_cost(const FileCache* e) {
+    return sizeof(FileCache) + strlen(e->path) + 1;
+}
+
+static void file_blob_release_locked(FileBlob* blob) {
+    if (!blob || --blob->refcount > 0) return;
+    FileBlob** pptr = &file_blob_buckets[blob->hash & (file_blob_bucket_count - 1)];
+    while (*pptr && *pptr != blob) pptr = &(*pptr)->next;
+    if (*pptr) *pptr = blob->next;
+    file_cache_bytes -= sizeof(FileBlob) + blob->stored_len;
+    file_blob_count--;
+    free(blob->data);
+    free(blob);
+}
+
+// Builds an unshared blob holding content. Compression runs here, before
+// the caller takes file_cache_mutex.
+static FileBlob* file_blob_new(const char* content, size_t len) {
+    FileBlob* b = malloc(sizeof(FileBlob));
+    if (!b) return NULL;
+
+    unsigned char* stored = NULL;
+    size_t stored_len = len;
+    int compressed = 0;
+    if (len >= FILE_CACHE_COMPRESS_MIN) {
+        uLongf bound = compressBound(len);
+        stored = malloc(bound);
+        if (stored && compress2(stored, &bound, (const Bytef*)content, len, Z_BEST_SPEED) == Z_OK && bound < len) {
+            stored_len = bound;
+            compressed = 1;
+            unsigned char* shrunk = realloc(stored, stored_len);
+            if (shrunk) stored = shrunk;
         } else {
-            pptr = &(*pptr)->next;
+            free(stored);
+            stored = NULL;
         }
     }
-    pthread_mutex_unlock(&wd_map_mutex);
+    if (!compressed) {
+        stored = malloc(len ? len : 1);
+        if (!stored) { free(b); return NULL; }
+        memcpy(stored, content, len);
+    }
 
-    // Clear this node's files from the content cache
-    pthread_mutex_lock(&file_cache_mutex);
-    FileCache** cache_pptr = &file_cache_head;
-    while (*cache_pptr) {
-        FileCache* entry = *cache_pptr;
-        if (strncmp(entry->path, node->path, strlen(node->path)) == 0) {
-            *cache_pptr = entry->next; // Unlink from list
-            free(entry->content);
-            free(entry);
-        } else {
-            cache_pptr = &(*cache_pptr)->next;
+    b->hash = fnv1a64(content, len);
+    b->raw_len = len;
+    b->stored_len = stored_len;
+    b->compressed = compressed;
+    b->refcount = 1;
+    b->data = stored;
+    b->next = NULL;
+    return b;
+}
+
+static void file_blob_free(FileBlob* b) {
+    if (!b) return;
+    free(b->data);
+    free(b);
+}
+
+// Takes fresh from file_blob_new() and returns a referenced blob with its
+// content, which is an identical one already cached if there is one.
+static FileBlob* file_blob_intern_locked(FileBlob* fresh) {
+    if (file_blob_buckets) {
+        for (FileBlob* b = file_blob_buckets[fresh->hash & (file_blob_bucket_count - 1)]; b; b = b->next) {
+            // Compression is deterministic, so equal contents have equal stored bytes
+            if (b->hash == fresh->hash && b->raw_len == fresh->raw_len && b->compressed == fresh->compressed &&
+                b->stored_len == fresh->stored_len && memcmp(b->data, fresh->data, fresh->stored_len) == 0) {
+                b->refcount++;
+                file_blob_free(fresh);
+                return b;
+            }
         }
     }
-    pthread_mutex_unlock(&file_cache_mutex);
+
+    if (file_blob_count + 1 > file_blob_bucket_count && file_blob_grow_locked() != 0) {
+        file_blob_free(fresh);
+        return NULL;
+    }
+
+    size_t idx = fresh->hash & (file_blob_bucket_count - 1);
+    fresh->next = file_blob_buckets[idx];
+    file_blob_buckets[idx] = fresh;
+    file_blob_count++;
+    file_cache_bytes += sizeof(FileBlob) + fresh->stored_len;
+    return fresh;
+}
+
+static char* file_blob_content(const FileBlob* b) {
+    char* out = malloc(b->raw_len + 1);
+    if (!out) return NULL;
+    if (b->compressed) {
+        uLongf out_len = b->raw_len;
+        if (uncompress((Bytef*)out, &out_len, b->data, b->stored_len) != Z_OK || out_len != b->raw_len) {
+            free(out);
+            return NULL;
+        }
+    } else {
+        memcpy(out, b->data, b->raw_len);
+    }
+    out[b->raw_len] = '\0';
+    return out;
 }
 
+// Takes the entry off its list and drops its blob, leaving it on no list.
+static void file_cache_detach_locked(FileCache* e) {
+    if (e->blob) {
+        file_cache_lru_unlink_locked(e);
+        file_blob_release_locked(e->blob);
+        e->blob = NULL;
+    } else {
+        file_cache_list_unlink_locked(&file_cache_evicted_head, &file_cache_evicted_tail, e);
+        file_cache_evicted_bytes -= file_cache_entry_cost(e);
+    }
+}
 
-void handle_file_modification(WatchedNode* node, const char* full_path, const char* user) {
+// Gives a detached entry its blob, or files it as evicted without one.
+static void file_cache_attach_locked(FileCache* e, FileBlob* blob) {
+    e->blob = blob;
+    if (blob) {
+        file_cache_lru_push_locked(e);
+    } else {
+        file_cache_list_push_locked(&file_cache_evicted_head, &file_cache_evicted_tail, e);
+        file_cache_evicted_bytes += file_cache_entry_cost(e);
+    }
+}
 
-    const int DEBOUNCE_SECONDS = 2; // Cooldown window
-    time_t now = time(NULL);
+static void file_cache_remove_entry_locked(FileCache* entry) {
+    FileCache** pptr = &file_cache_buckets[entry->path_hash & (file_cache_bucket_count - 1)];
+    while (*pptr && *pptr != entry) pptr = &(*pptr)->next;
+    if (*pptr) *pptr = entry->next;
+    file_cache_detach_locked(entry);
+    file_cache_entry_count--;
+    free(entry->path);
+    free(entry);
+}
 
-    pthread_mutex_lock(&file_cache_mutex);
-    for (FileCache* current = file_cache_head; current; current = current->next) {
-        if (strcmp(current->path, full_path) == 0) {
-            if (now < current->last_processed_time + DEBOUNCE_SECONDS) {
-                pthread_mutex_unlock(&file_cache_mutex);
-                return; 
-            }
-            break; 
+// Drops blobs from least recently used entries until the cache fits its budget.
+// Evicted entries keep their path so a later modify knows to ask the snapshot,
+// until they outgrow their share and the oldest are forgotten; a modify to a
+// forgotten path is logged without a diff.
+static void file_cache_evict_locked(const FileCache* keep) {
+    FileCache* e = file_cache_lru_tail;
+    while (file_cache_bytes > file_cache_budget && e) {
+        FileCache* prev = e->lru_prev;
+        if (e != keep) {
+            file_cache_detach_locked(e);
+            file_cache_attach_locked(e, NULL);
         }
+        e = prev;
     }
-    pthread_mutex_unlock(&file_cache_mutex);
 
-    char* new_content = read_file_content(full_path);
-    if (!new_content) return; 
+    e = file_cache_evicted_tail;
+    while (file_cache_evicted_bytes > file_cache_budget / FILE_CACHE_EVICTED_SHARE && e) {
+        FileCache* prev = e->lru_prev;
+        if (e != keep) file_cache_remove_entry_locked(e);
+        e = prev;
+    }
+}
 
-    char* old_content = NULL;
-    
+static FileCache* file_cache_get_or_add_locked(const char* path, uint64_t path_hash) {
+    FileCache* entry = file_cache_find_locked(path, path_hash);
+    if (entry) return entry;
+    if (file_cache_entry_count + 1 > file_cache_bucket_count && file_cache_grow_locked() != 0) return NULL;
+
+    entry = calloc(1, sizeof(FileCache));
+    if (!entry) return NULL;
+    entry->path = strdup(path);
+    if (!entry->path) { free(entry); return NULL; }
+    entry->path_hash = path_hash;
+    size_t idx = path_hash & (file_cache_bucket_count - 1);
+    entry->next = file_cache_buckets[idx];
+    file_cache_buckets[idx] = entry;
+    file_cache_entry_count++;
+    file_cache_attach_locked(entry, NULL);
+    return entry;
+}
+
+void update_file_cache(const char* path, const char* content) {
+    uint64_t path_hash = fnv1a64(path, strlen(path));
+    // Compress before taking the lock; only the dedupe and insert need it
+    FileBlob* fresh = content ? file_blob_new(content, strlen(content)) : NULL;
     pthread_mutex_lock(&file_cache_mutex);
-    for (FileCache* current = file_cache_head; current; current = current->next) {
-        if (strcmp(current->path, full_path) == 0) {
-            old_content = current->content ? strdup(current->content) : NULL;
-            break;
-        }
-    }
-    pthread_mutex_unlock(&file_cache_mutex);
 
-    const char* relative_path = full_path + strlen(node->path) + 1;
-    if (!old_content) {
-        add_event_to_node(node, EV_MODIFIED, relative_path, user, NULL);
-        update_file_cache(full_path, new_content);
-        free(new_content);
+    if (!content) {
+        // Content is gone (deleted or filtered): forget the path
+        FileCache* entry = file_cache_find_locked(path, path_hash);
+        if (entry) file_cache_remove_entry_locked(entry);
+        pthread_mutex_unlock(&file_cache_mutex);
         return;
     }
-    
-    ctz_json_value* changes_obj = ctz_json_new_object();
-    ctz_json_value* added_array = ctz_json_new_array();
-    ctz_json_value* removed_array = ctz_json_new_array();
-    ctz_json_value* moved_array = ctz_json_new_array();
 
-    char* old_copy = strdup(old_content);
-    char* new_copy = strdup(new_content);
-    
-    char** old_lines = NULL;
-    char** new_lines = NULL;
+    FileCache* entry = file_cache_get_or_add_locked(path, path_hash);
+    if (entry) {
+        FileBlob* blob = fresh ? file_blob_intern_locked(fresh) : NULL;
+        fresh = NULL;
+        file_cache_detach_locked(entry);
+        file_cache_attach_locked(entry, blob);
+        file_cache_evict_locked(entry);
+    }
+    pthread_mutex_unlock(&file_cache_mutex);
+    file_blob_free(fresh);
+}
 
-    int old_count = split_lines(old_copy, &old_lines);
-    int new_count = split_lines(new_copy, &new_lines);
+// Registers a path without reading it, as if its content had been evicted.
+// Used while indexing once the cache is already full.
+static void file_cache_note_path(const char* path) {
+    uint64_t path_hash = fnv1a64(path, strlen(path));
+    pthread_mutex_lock(&file_cache_mutex);
+    if (file_cache_get_or_add_locked(path, path_hash)) file_cache_evict_locked(NULL);
+    pthread_mutex_unlock(&file_cache_mutex);
+}
 
-    // 1. Allocate and fill the LCS dynamic programming matrix
-    int** lcs_matrix = malloc((old_count + 1) * sizeof(int*));
-    if (!lcs_matrix) { /* handle malloc failure */ }
-    
-    for (int i = 0; i <= old_count; i++) {
-        lcs_matrix[i] = calloc((new_count + 1), sizeof(int));
-        if (!lcs_matrix[i]) { /* handle malloc failure */ }
-    }
+static int file_cache_is_full(void) {
+    pthread_mutex_lock(&file_cache_mutex);
+    int full = file_cache_bytes >= file_cache_budget;
+    pthread_mutex_unlock(&file_cache_mutex);
+    return full;
+}
 
-    for (int i = 1; i <= old_count; i++) {
-        for (int j = 1; j <= new_count; j++) {
-            if (strcmp(old_lines[i - 1], new_lines[j - 1]) == 0) {
-                lcs_matrix[i][j] = lcs_matrix[i - 1][j - 1] + 1;
-            } else {
-                int above = lcs_matrix[i - 1][j];
-                int left = lcs_matrix[i][j - 1];
-                lcs_matrix[i][j] = (above > left) ? above : left;
+// Drops every cached entry under node_path.
+static void file_cache_remove_tree(const char* node_path) {
+    size_t plen = strlen(node_path);
+    pthread_mutex_lock(&file_cache_mutex);
+    for (size_t i = 0; i < file_cache_bucket_count; i++) {
+        FileCache* e = file_cache_buckets[i];
+        while (e) {
+            FileCache* next = e->next;
+            if (strncmp(e->path, node_path, plen) == 0 && e->path[plen] == '/') {
+                file_cache_remove_entry_locked(e);
             }
+            e = next;
         }
     }
+    pthread_mutex_unlock(&file_cache_mutex);
+}
 
+// Reads the file's content as of the node's last snapshot through
+// exodus_snapshot, or returns NULL if HEAD does not have it. Used when the
+// cached copy was evicted. It forks exodus_snapshot and cortez_ipc_send
+// names its tunnel after our pid, so only the diff base worker calls it.
+static char* read_snapshot_content(const char* node_name, const char* node_path, const char* relative_path) {
+    char subsection[MAX_NODE_NAME_LEN] = "master";
+    char subsec_file[PATH_MAX];
+    snprintf(subsec_file, sizeof(subsec_file), "%s/.log/CURRENT_SUBSECTION", node_path);
+    FILE* sf = fopen(subsec_file, "r");
+    if (sf) {
+        if (fgets(subsection, sizeof(subsection), sf)) subsection[strcspn(subsection, "\n")] = '\0';
+        if (subsection[0] == '\0') strcpy(subsection, "master");
+        fclose(sf);
+    }
+
+    char tmp_dir[] = "/tmp/exodus-cache-XXXXXX";
+    if (!mkdtemp(tmp_dir)) return NULL;
+    char dest_path[PATH_MAX];
+    snprintf(dest_path, sizeof(dest_path), "%s/content", tmp_dir);
+
+    char snapshot_exe[PATH_MAX];
+    snprintf(snapshot_exe, sizeof(snapshot_exe), "%s/exodus_snapshot", g_exe_dir);
+
+    char* content = NULL;
+    if (cortez_ipc_send(snapshot_exe,
+                        CORTEZ_TYPE_STRING, "cat-head",
+                        CORTEZ_TYPE_STRING, node_name,
+                        CORTEZ_TYPE_STRING, node_path,
+                        CORTEZ_TYPE_STRING, subsection,
+                        CORTEZ_TYPE_STRING, relative_path,
+                        CORTEZ_TYPE_STRING, dest_path,
+                        0) == 0) {
+        content = read_file_content(dest_path);
+    }
+    unlink(dest_path);
+    rmdir(tmp_dir);
+    return content;
+}
 
-    DiffChange* added_list_head = NULL;
-    DiffChange* removed_list_head = NULL;
-    int i = old_count;
-    int j = new_count;
-    while (i > 0 || j > 0) {
-        if (i > 0 && j > 0 && strcmp(old_lines[i - 1], new_lines[j - 1]) == 0) {
-            i--;
-            j--;
-        } else if (j > 0 && (i == 0 || lcs_matrix[i][j - 1] >= lcs_matrix[i - 1][j])) {
-            // Added line (from new)
-            DiffChange* change = malloc(sizeof(DiffChange));
-            change->op = 'a';
-            change->line_num = j;
-            change->content = new_lines[j - 1];
-            change->matched = 0; // --- NEW ---
-            change->next = added_list_head; // --- MODIFIED ---
-            added_list_head = change; // --- MODIFIED ---
-            j--;
-        } else if (i > 0 && (j == 0 || lcs_matrix[i][j - 1] < lcs_matrix[i - 1][j])) {
-            // Removed line (from old)
-            DiffChange* change = malloc(sizeof(DiffChange));
-            change->op = 'd';
-            change->line_num = i;
-            change->content = old_lines[i - 1];
-            change->matched = 0; // --- NEW ---
-            change->next = removed_list_head; // --- MODIFIED ---
-            removed_list_head = change; // --- MODIFIED ---
-            i--;
-        }
-    }
-
-    MovedChange* moved_list_head = NULL;
-
-    // Iterate over all removed lines
-    for (DiffChange* r_node = removed_list_head; r_node; r_node = r_node->next) {
-        if (r_node->matched) continue; // Already matched as part of a move
-
-        // Try to find a matching added line
-        for (DiffChange* a_node = added_list_head; a_node; a_node = a_node->next) {
-            if (a_node->matched) continue; // Already matched
-
-            if (strcmp(r_node->content, a_node->content) == 0) {
-                // We found a move!
-                MovedChange* move = malloc(sizeof(MovedChange));
-                move->from_line = r_node->line_num;
-                move->to_line = a_node->line_num;
-                move->content = r_node->content; // Content is the same
-                move->next = moved_list_head;
-                moved_list_head = move;
-
-                // Mark both nodes as matched so they aren't processed again
-                r_node->matched = 1;
-                a_node->matched = 1;
-
-                break; // Stop inner loop; this added line is now consumed
-            }
+
+// --- contents.json index (helpers ending in _locked need contents_mutex) ---
+
+static int name_index_grow_locked(void) {
+    size_t new_count = name_index_bucket_count ? name_index_bucket_count * 2 : CONTENTS_MIN_BUCKETS;
+    NameGroup** nb = calloc(new_count, sizeof(NameGroup*));
+    if (!nb) return -1;
+    for (size_t i = 0; i < name_index_bucket_count; i++) {
+        NameGroup* g = name_index_buckets[i];
+        while (g) {
+            NameGroup* next = g->next;
+            size_t b = g->hash & (new_count - 1);
+            g->next = nb[b];
+            nb[b] = g;
+            g = next;
         }
     }
+    free(name_index_buckets);
+    name_index_buckets = nb;
+    name_index_bucket_count = new_count;
+    return 0;
+}
 
+static NameGroup* name_index_find_locked(const char* name, uint64_t h) {
+    if (!name_index_buckets) return NULL;
+    for (NameGroup* g = name_index_buckets[h & (name_index_bucket_count - 1)]; g; g = g->next) {
+        if (g->hash == h && strcmp(g->name, name) == 0) return g;
+    }
+    return NULL;
+}
 
+static void name_index_link_locked(ContentsEntry* e) {
+    uint64_t h = fnv1a64(e->name, strlen(e->name));
+    NameGroup* g = name_index_find_locked(e->name, h);
+    if (!g) {
+        if (name_index_group_count + 1 > name_index_bucket_count && name_index_grow_locked() != 0) return;
+        g = calloc(1, sizeof(NameGroup));
+        if (!g) return;
+        g->name = strdup(e->name);
+        if (!g->name) { free(g); return; }
+        g->hash = h;
+        size_t b = h & (name_index_bucket_count - 1);
+        g->next = name_index_buckets[b];
+        name_index_buckets[b] = g;
+        name_index_group_count++;
+    }
+    e->group = g;
+    e->name_prev = NULL;
+    e->name_next = g->entries;
+    if (g->entries) g->entries->name_prev = e;
+    g->entries = e;
+    name_index_generation++;
+}
 
-    // 3. Convert the diff linked lists into the final JSON arrays
-    
-    MovedChange* current_move = moved_list_head;
-    while (current_move) {
-        ctz_json_value* change_obj = ctz_json_new_object();
-        ctz_json_object_set_value(change_obj, "from", ctz_json_new_number(current_move->from_line));
-        ctz_json_object_set_value(change_obj, "to", ctz_json_new_number(current_move->to_line));
-        ctz_json_object_set_value(change_obj, "content", ctz_json_new_string(current_move->content));
-        ctz_json_array_push_value(moved_array, change_obj);
-        
-        MovedChange* next = current_move->next;
-        free(current_move);
-        current_move = next;
+static void name_index_unlink_locked(ContentsEntry* e) {
+    NameGroup* g = e->group;
+    if (!g) return;
+    if (e->name_prev) e->name_prev->name_next = e->name_next;
+    else g->entries = e->name_next;
+    if (e->name_next) e->name_next->name_prev = e->name_prev;
+    e->group = NULL;
+    name_index_generation++;
+
+    if (!g->entries) {
+        NameGroup** pptr = &name_index_buckets[g->hash & (name_index_bucket_count - 1)];
+        while (*pptr && *pptr != g) pptr = &(*pptr)->next;
+        if (*pptr) *pptr = g->next;
+        name_index_group_count--;
+        free(g->name);
+        free(g);
     }
+}
 
+static ContentsEntry* contents_find_locked(ContentsIndex* idx, const char* rel, uint64_t h) {
+    if (!idx->buckets) return NULL;
+    for (ContentsEntry* e = idx->buckets[h & (idx->bucket_count - 1)]; e; e = e->hash_next) {
+        if (e->hash == h && strcmp(e->rel_path, rel) == 0) return e;
+    }
+    return NULL;
+}
 
-    DiffChange* current_change = added_list_head;
-    while (current_change) {
-        if (!current_change->matched) { // Check the flag
-            ctz_json_value* change_obj = ctz_json_new_object();
-            ctz_json_object_set_value(change_obj, "line", ctz_json_new_number(current_change->line_num));
-            ctz_json_object_set_value(change_obj, "content", ctz_json_new_string(current_change->content));
-            ctz_json_array_push_value(added_array, change_obj);
+static int contents_grow_locked(ContentsIndex* idx) {
+    size_t new_count = idx->bucket_count ? idx->bucket_count * 2 : CONTENTS_MIN_BUCKETS;
+    ContentsEntry** nb = calloc(new_count, sizeof(ContentsEntry*));
+    if (!nb) return -1;
+    for (size_t i = 0; i < idx->bucket_count; i++) {
+        ContentsEntry* e = idx->buckets[i];
+        while (e) {
+            ContentsEntry* next = e->hash_next;
+            size_t b = e->hash & (new_count - 1);
+            e->hash_next = nb[b];
+            nb[b] = e;
+            e = next;
         }
-        DiffChange* next = current_change->next;
-        free(current_change);
-        current_change = next;
     }
+    free(idx->buckets);
+    idx->buckets = nb;
+    idx->bucket_count = new_count;
+    return 0;
+}
 
+static void contents_free_subtree_locked(ContentsIndex* idx, ContentsEntry* e) {
+    ContentsEntry* child = e->first_child;
+    while (child) {
+        ContentsEntry* next = child->next_sibling;
+        contents_free_subtree_locked(idx, child);
+        child = next;
+    }
+    ContentsEntry** pptr = &idx->buckets[e->hash & (idx->bucket_count - 1)];
+    while (*pptr && *pptr != e) pptr = &(*pptr)->hash_next;
+    if (*pptr) *pptr = e->hash_next;
+    name_index_unlink_locked(e);
+    idx->count--;
+    free(e->rel_path);
+    free(e);
+}
 
-    current_change = removed_list_head;
-    while (current_change) {
-        if (!current_change->matched) { // Check the flag
-            ctz_json_value* change_obj = ctz_json_new_object();
-            ctz_json_object_set_value(change_obj, "line", ctz_json_new_number(current_change->line_num));
-            ctz_json_object_set_value(change_obj, "content", ctz_json_new_string(current_change->content));
-            ctz_json_array_push_value(removed_array, change_obj);
-        }
-        DiffChange* next = current_change->next;
-        free(current_change);
-        current_change = next;
+static void contents_remove_locked(ContentsIndex* idx, const char* rel) {
+    ContentsEntry* e = contents_find_locked(idx, rel, fnv1a64(rel, strlen(rel)));
+    if (!e) return;
+    ContentsEntry* parent = e->parent;
+    if (e->prev_sibling) e->prev_sibling->next_sibling = e->next_sibling;
+    else parent->first_child = e->next_sibling;
+    if (e->next_sibling) e->next_sibling->prev_sibling = e->prev_sibling;
+    else parent->last_child = e->prev_sibling;
+    contents_free_subtree_locked(idx, e);
+    idx->dirty = 1;
+}
+
+static void contents_clear_locked(ContentsIndex* idx) {
+    ContentsEntry* child = idx->root.first_child;
+    while (child) {
+        ContentsEntry* next = child->next_sibling;
+        contents_free_subtree_locked(idx, child);
+        child = next;
     }
+    idx->root.first_child = idx->root.last_child = NULL;
+    idx->dirty = 1;
+}
 
+// Adds rel (and any missing parent directories). Returns the entry.
+static ContentsEntry* contents_add_locked(ContentsIndex* idx, const char* rel, int is_dir) {
+    uint64_t h = fnv1a64(rel, strlen(rel));
+    ContentsEntry* e = contents_find_locked(idx, rel, h);
+    if (e) {
+        e->is_dir = is_dir;
+        return e;
+    }
+
+    ContentsEntry* parent = &idx->root;
+    const char* slash = strrchr(rel, '/');
+    if (slash) {
+        char parent_rel[PATH_MAX];
+        size_t plen = (size_t)(slash - rel);
+        if (plen >= sizeof(parent_rel)) return NULL;
+        memcpy(parent_rel, rel, plen);
+        parent_rel[plen] = '\0';
+        parent = contents_add_locked(idx, parent_rel, 1);
+        if (!parent) return NULL;
+    }
+
+    if (idx->count + 1 > idx->bucket_count && contents_grow_locked(idx) != 0) return NULL;
+    e = calloc(1, sizeof(ContentsEntry));
+    if (!e) return NULL;
+    e->rel_path = strdup(rel);
+    if (!e->rel_path) { free(e); return NULL; }
+    e->name = slash ? e->rel_path + (slash - rel) + 1 : e->rel_path;
+    e->is_dir = is_dir;
+    e->hash = h;
+    e->node = idx->node;
+    e->parent = parent;
+    e->prev_sibling = parent->last_child;
+    if (parent->last_child) parent->last_child->next_sibling = e;
+    else parent->first_child = e;
+    parent->last_child = e;
+
+    size_t b = h & (idx->bucket_count - 1);
+    e->hash_next = idx->buckets[b];
+    idx->buckets[b] = e;
+    idx->count++;
+    idx->dirty = 1;
+    name_index_link_locked(e);
+    return e;
+}
 
-    // 4. Clean up all allocations
-    free_lcs_matrix(lcs_matrix, old_count + 1);
-    free(old_lines);
-    free(new_lines);
-    free(old_copy);
-    free(new_copy);
+// Adds everything below dir_full; dir_rel is its path relative to the node ("" for the root).
+static void contents_scan_locked(ContentsIndex* idx, const char* dir_full, const char* dir_rel) {
+    DIR* dr = opendir(dir_full);
+    if (!dr) return;
+
+    struct dirent* de;
+    while ((de = readdir(dr)) != NULL) {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0 || strcmp(de->d_name, ".log") == 0) {
+            continue;
+        }
+        char full_path[PATH_MAX];
+        char rel_path[PATH_MAX];
+        snprintf(full_path, sizeof(full_path), "%s/%s", dir_full, de->d_name);
+        if (dir_rel[0]) snprintf(rel_path, sizeof(rel_path), "%s/%s", dir_rel, de->d_name);
+        else snprintf(rel_path, sizeof(rel_path), "%s", de->d_name);
+
+        struct stat st;
+        int is_dir = (stat(full_path, &st) == 0 && S_ISDIR(st.st_mode));
+        contents_add_locked(idx, rel_path, is_dir);
+        if (is_dir) contents_scan_locked(idx, full_path, rel_path);
+    }
+    closedir(dr);
+}
+
+// Brings the index in line with what is now on disk at rel (and below it).
+static void contents_refresh_path_locked(WatchedNode* node, const char* rel) {
+    char full_path[PATH_MAX];
+    snprintf(full_path, sizeof(full_path), "%s/%s", node->path, rel);
+    struct stat st;
+    if (stat(full_path, &st) != 0) {
+        contents_remove_locked(&node->contents, rel);
+        return;
+    }
+    int is_dir = S_ISDIR(st.st_mode);
+    ContentsEntry* existing = contents_find_locked(&node->contents, rel, fnv1a64(rel, strlen(rel)));
+    if (existing && existing->is_dir == is_dir && !is_dir) return;
+    if (existing) contents_remove_locked(&node->contents, rel);
+    contents_add_locked(&node->contents, rel, is_dir);
+    if (is_dir) contents_scan_locked(&node->contents, full_path, rel);
+}
+
+static void contents_apply_event_locked(WatchedNode* node, EventType type, const char* rel, const char* from_rel) {
+    node->contents.node = node;
+    switch (type) {
+        case EV_DELETED:
+            contents_remove_locked(&node->contents, rel);
+            break;
+        case EV_MOVED:
+            if (from_rel) contents_remove_locked(&node->contents, from_rel);
+            contents_refresh_path_locked(node, rel);
+            break;
+        case EV_CREATED:
+        case EV_MODIFIED:
+            contents_refresh_path_locked(node, rel);
+            break;
+    }
+}
+
+static void contents_to_json_locked(const WatchedNode* node, const ContentsEntry* dir, ctz_json_value* json_array) {
+    for (const ContentsEntry* e = dir->first_child; e; e = e->next_sibling) {
+        char full_path[PATH_MAX];
+        snprintf(full_path, sizeof(full_path), "%s/%s", node->path, e->rel_path);
+
+        ctz_json_value* item_obj = ctz_json_new_object();
+        ctz_json_object_set_value(item_obj, "name", ctz_json_new_string(e->name));
+        ctz_json_object_set_value(item_obj, "path", ctz_json_new_string(full_path));
+        ctz_json_array_push_value(json_array, item_obj);
+
+        if (e->first_child) contents_to_json_locked(node, e, json_array);
+    }
+}
+
+static void write_node_contents_json_locked(WatchedNode* node) {
+    char contents_file_path[PATH_MAX];
+    snprintf(contents_file_path, sizeof(contents_file_path), "%s/.log/contents.json", node->path);
+
+    ctz_json_value* root_array = ctz_json_new_array();
+    if (!root_array) {
+        fprintf(stderr, "[Cloud] Failed to create JSON array for node '%s'\n", node->name);
+        return;
+    }
+    contents_to_json_locked(node, &node->contents.root, root_array);
+
+    char* json_string = ctz_json_stringify(root_array, 1); // Pretty print
+    if (json_string) {
+        FILE* f = fopen(contents_file_path, "w");
+        if (f) {
+            fprintf(f, "%s", json_string);
+            fclose(f);
+            node->contents.dirty = 0;
+        } else {
+            fprintf(stderr, "[Cloud] Failed to write to %s\n", contents_file_path);
+        }
+        free(json_string);
+    }
+    ctz_json_free(root_array);
+}
 
+// Rebuilds the node's contents index from a full scan and rewrites contents.json.
+// Event batches keep it current afterwards (see flush_node_events).
+void generate_node_contents_json(WatchedNode* node) {
+    if (!node) return;
+    pthread_mutex_lock(&contents_mutex);
+    node->contents.node = node;
+    contents_clear_locked(&node->contents);
+    contents_scan_locked(&node->contents, node->path, "");
+    write_node_contents_json_locked(node);
+    pthread_mutex_unlock(&contents_mutex);
+    printf("[Cloud] Re-indexed contents for node '%s'.\n", node->name);
+}
+
+static int lookup_match_compare(const void* a, const void* b) {
+    const ContentsEntry* ea = *(const ContentsEntry* const*)a;
+    const ContentsEntry* eb = *(const ContentsEntry* const*)b;
+    int c = strcmp(ea->node->name, eb->node->name);
+    return c ? c : strcmp(ea->rel_path, eb->rel_path);
+}
+
+static int lookup_push_group(const NameGroup* g, const ContentsEntry*** matches, size_t* count, size_t* cap) {
+    for (const ContentsEntry* e = g->entries; e; e = e->name_next) {
+        if (*count == *cap) {
+            size_t new_cap = *cap ? *cap * 2 : 64;
+            const ContentsEntry** grown = realloc(*matches, new_cap * sizeof(ContentsEntry*));
+            if (!grown) return -1;
+            *matches = grown;
+            *cap = new_cap;
+        }
+        (*matches)[(*count)++] = e;
+    }
+    return 0;
+}
+
+// Collects every indexed item whose basename matches, sorted by node then path
+// so consecutive pages line up. Exact lookups touch one hash chain; prefix and
+// glob lookups walk the distinct basenames, not every file.
+static int lookup_collect_locked(const char* pattern, int mode, const ContentsEntry*** matches_out, size_t* count_out) {
+    const ContentsEntry** matches = NULL;
+    size_t count = 0, cap = 0;
+    int rc = 0;
+
+    if (mode == LOOKUP_EXACT) {
+        NameGroup* g = name_index_find_locked(pattern, fnv1a64(pattern, strlen(pattern)));
+        if (g) rc = lookup_push_group(g, &matches, &count, &cap);
+    } else {
+        size_t plen = strlen(pattern);
+        for (size_t i = 0; i < name_index_bucket_count && rc == 0; i++) {
+            for (NameGroup* g = name_index_buckets[i]; g && rc == 0; g = g->next) {
+                int hit = (mode == LOOKUP_PREFIX) ? strncmp(g->name, pattern, plen) == 0
+                                                  : fnmatch(pattern, g->name, 0) == 0;
+                if (hit) rc = lookup_push_group(g, &matches, &count, &cap);
+            }
+        }
+    }
+    if (rc != 0) {
+        free(matches);
+        return -1;
+    }
+    if (count > 1) qsort(matches, count, sizeof(ContentsEntry*), lookup_match_compare);
+    *matches_out = matches;
+    *count_out = count;
+    return 0;
+}
+
+// A sorted lookup result kept for its later pages. The entry pointers are
+// only valid while name_index_generation is unchanged, so a slot from an
+// older generation is never read. Guarded by contents_mutex.
+typedef struct {
+    char pattern[MAX_PATH_LEN];
+    int mode;
+    uint64_t generation;
+    uint64_t last_used;
+    const ContentsEntry** matches;
+    size_t count;
+} LookupCacheSlot;
+
+static LookupCacheSlot lookup_cache[LOOKUP_CACHE_SLOTS];
+static uint64_t lookup_cache_clock = 0;
+
+// Returns the sorted matches of a lookup, collected once per index
+// generation so paging through a large result does not sort it per page.
+// The array belongs to the cache.
+static int lookup_matches_locked(const char* pattern, int mode, const ContentsEntry* const** matches_out, size_t* count_out) {
+    LookupCacheSlot* victim = &lookup_cache[0];
+    for (int i = 0; i < LOOKUP_CACHE_SLOTS; i++) {
+        LookupCacheSlot* slot = &lookup_cache[i];
+        if (slot->generation != name_index_generation) slot->last_used = 0; // Stale, reuse it first
+        if (slot->last_used && slot->mode == mode && strcmp(slot->pattern, pattern) == 0) {
+            slot->last_used = ++lookup_cache_clock;
+            *matches_out = slot->matches;
+            *count_out = slot->count;
+            return 0;
+        }
+        if (slot->last_used < victim->last_used) victim = slot;
+    }
+
+    const ContentsEntry** matches = NULL;
+    size_t count = 0;
+    if (lookup_collect_locked(pattern, mode, &matches, &count) != 0) return -1;
+    free(victim->matches);
+    snprintf(victim->pattern, sizeof(victim->pattern), "%s", pattern);
+    victim->mode = mode;
+    victim->generation = name_index_generation;
+    victim->last_used = ++lookup_cache_clock;
+    victim->matches = matches;
+    victim->count = count;
+    *matches_out = matches;
+    *count_out = count;
+    return 0;
+}
+
+// Builds one MSG_LOOKUP_RESPONSE page. Returns a malloc'd payload.
+static lookup_resp_t* build_lookup_page(const lookup_req_t* req, size_t* size_out) {
+    uint32_t limit = req->limit ? req->limit : LOOKUP_PAGE_DEFAULT;
+    if (limit > LOOKUP_PAGE_MAX) limit = LOOKUP_PAGE_MAX;
+
+    lookup_resp_t* resp = malloc(sizeof(lookup_resp_t) + LOOKUP_PAGE_BYTES);
+    if (!resp) return NULL;
+    memset(resp, 0, sizeof(lookup_resp_t));
+    char* pos = resp->data;
+    char* end = resp->data + LOOKUP_PAGE_BYTES;
+
+    pthread_mutex_lock(&contents_mutex);
+    const ContentsEntry* const* matches = NULL;
+    size_t count = 0;
+    if (lookup_matches_locked(req->item_name, req->mode, &matches, &count) != 0) {
+        pthread_mutex_unlock(&contents_mutex);
+        free(resp);
+        return NULL;
+    }
+
+    size_t i = req->offset;
+    while (i < count && resp->item_count < limit) {
+        const ContentsEntry* e = matches[i];
+        size_t nlen = strlen(e->node->name) + 1;
+        size_t plen = strlen(e->node->path) + 1 + strlen(e->rel_path) + 1;
+        if ((size_t)(end - pos) < nlen + plen) break; // Next page
+        memcpy(pos, e->node->name, nlen);
+        pos += nlen;
+        pos += snprintf(pos, plen, "%s/%s", e->node->path, e->rel_path) + 1;
+        resp->item_count++;
+        i++;
+    }
+    pthread_mutex_unlock(&contents_mutex);
+
+    resp->total = (uint32_t)count;
+    resp->next_offset = (uint32_t)i;
+    resp->more = i < count;
+    *size_out = sizeof(lookup_resp_t) + (size_t)(pos - resp->data);
+    return resp;
+}
+
+static void free_node_contents(WatchedNode* node) {
+    pthread_mutex_lock(&contents_mutex);
+    contents_clear_locked(&node->contents);
+    free(node->contents.buckets);
+    node->contents.buckets = NULL;
+    node->contents.bucket_count = 0;
+    pthread_mutex_unlock(&contents_mutex);
+}
+
+
+// --- Watch descriptor table (all callers hold wd_map_mutex) ---
+
+static size_t wd_hash(int wd) {
+    uint32_t h = (uint32_t)wd;
+    h ^= h >> 16;
+    h *= 0x45d9f3bU;
+    h ^= h >> 16;
+    return (size_t)h;
+}
+
+static WatchDescriptorMap** wd_table_slot_locked(int wd) {
+    if (!wd_table) return NULL;
+    size_t mask = wd_table_capacity - 1;
+    for (size_t i = wd_hash(wd) & mask;; i = (i + 1) & mask) {
+        WatchDescriptorMap* e = wd_table[i];
+        if (!e) return NULL;
+        if (e != WD_TOMBSTONE && e->wd == wd) return &wd_table[i];
+    }
+}
+
+static WatchDescriptorMap* wd_table_find_locked(int wd) {
+    WatchDescriptorMap** slot = wd_table_slot_locked(wd);
+    return slot ? *slot : NULL;
+}
+
+static int wd_table_rehash_locked(size_t new_capacity) {
+    WatchDescriptorMap** new_table = calloc(new_capacity, sizeof(WatchDescriptorMap*));
+    if (!new_table) return -1;
+    size_t mask = new_capacity - 1;
+    for (size_t i = 0; i < wd_table_capacity; i++) {
+        WatchDescriptorMap* e = wd_table[i];
+        if (!e || e == WD_TOMBSTONE) continue;
+        size_t j = wd_hash(e->wd) & mask;
+        while (new_table[j]) j = (j + 1) & mask;
+        new_table[j] = e;
+    }
+    free(wd_table);
+    wd_table = new_table;
+    wd_table_capacity = new_capacity;
+    wd_table_used = wd_table_count;
+    return 0;
+}
+
+static void wd_node_unlink_locked(WatchDescriptorMap* entry) {
+    if (entry->node_prev) entry->node_prev->node_next = entry->node_next;
+    else if (entry->parent_node) entry->parent_node->watches_head = entry->node_next;
+    if (entry->node_next) entry->node_next->node_prev = entry->node_prev;
+    entry->node_prev = entry->node_next = NULL;
+}
+
+static void wd_node_link_locked(WatchDescriptorMap* entry, WatchedNode* node) {
+    entry->parent_node = node;
+    entry->node_prev = NULL;
+    entry->node_next = node->watches_head;
+    if (node->watches_head) node->watches_head->node_prev = entry;
+    node->watches_head = entry;
+}
+
+// Opens a watched directory's O_PATH fd unless the budget is spent.
+static int wd_open_dir_fd_locked(const char* path) {
+    if (wd_dir_fd_count >= wd_dir_fd_budget) return -1;
+    int fd = open(path, O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) wd_dir_fd_count++;
+    return fd;
+}
 
+static void wd_close_dir_fd_locked(WatchDescriptorMap* entry) {
+    if (entry->dir_fd < 0) return;
+    close(entry->dir_fd);
+    entry->dir_fd = -1;
+    wd_dir_fd_count--;
+}
+
+// Inserts or updates the entry for wd. inotify returns the existing wd when
+// a path is watched twice, so an existing entry is re-pointed instead.
+static int wd_table_put_locked(int wd, const char* path, WatchedNode* node) {
+    WatchDescriptorMap* entry = wd_table_find_locked(wd);
+    if (entry) {
+        if (entry->parent_node != node) {
+            wd_node_unlink_locked(entry);
+            wd_node_link_locked(entry, node);
+        }
+        if (strcmp(entry->path, path) != 0) {
+            strncpy(entry->path, path, sizeof(entry->path) - 1);
+            entry->path[sizeof(entry->path) - 1] = '\0';
+            wd_close_dir_fd_locked(entry);
+            entry->dir_fd = wd_open_dir_fd_locked(path);
+        }
+        return 0;
+    }
+
+    // Keep the load factor (tombstones included) at or below 1/2
+    if ((wd_table_used + 1) * 2 > wd_table_capacity) {
+        size_t new_capacity = wd_table_capacity ? wd_table_capacity : WD_TABLE_MIN_CAPACITY;
+        while ((wd_table_count + 1) * 2 > new_capacity) new_capacity *= 2;
+        if (wd_table_rehash_locked(new_capacity) != 0) return -1;
+    }
+
+    entry = malloc(sizeof(WatchDescriptorMap));
+    if (!entry) return -1;
+    entry->wd = wd;
+    strncpy(entry->path, path, sizeof(entry->path) - 1);
+    entry->path[sizeof(entry->path) - 1] = '\0';
+    entry->dir_fd = wd_open_dir_fd_locked(path);
+    wd_node_link_locked(entry, node);
+
+    size_t mask = wd_table_capacity - 1;
+    size_t i = wd_hash(wd) & mask;
+    while (wd_table[i] && wd_table[i] != WD_TOMBSTONE) i = (i + 1) & mask;
+    if (!wd_table[i]) wd_table_used++;
+    wd_table[i] = entry;
+    wd_table_count++;
+    return 0;
+}
+
+static void wd_table_remove_locked(int wd) {
+    WatchDescriptorMap** slot = wd_table_slot_locked(wd);
+    if (!slot) return;
+    WatchDescriptorMap* entry = *slot;
+    *slot = WD_TOMBSTONE;
+    wd_table_count--;
+    wd_node_unlink_locked(entry);
+    wd_close_dir_fd_locked(entry);
+    free(entry);
+}
+
+void add_watches_recursively(WatchedNode* node, const char* base_path) {
+    DIR* dir = opendir(base_path);
+    if (!dir) {
+        fprintf(stderr, "[Watcher] Could not open directory for watching: %s\n", base_path);
+        return;
+    }
+
+    // Add a watch for the current directory itself
+    int wd = inotify_add_watch(inotify_fd, base_path, IN_CREATE | IN_DELETE | IN_MODIFY | IN_MOVED_FROM | IN_MOVED_TO);
+    if (wd == -1) {
+        fprintf(stderr, "[Watcher] Failed to watch %s: %s\n", base_path, strerror(errno));
+        closedir(dir);
+        return;
+    }
+
+    // Add the new watch descriptor to our map
+    pthread_mutex_lock(&wd_map_mutex);
+    int put_rc = wd_table_put_locked(wd, base_path, node);
+    pthread_mutex_unlock(&wd_map_mutex);
+    if (put_rc != 0) {
+        inotify_rm_watch(inotify_fd, wd); // Cleanup on malloc failure
+    }
+    
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0 || strcmp(entry->d_name, ".log") == 0) continue;
+
+        char full_path[PATH_MAX];
+        snprintf(full_path, sizeof(full_path), "%s/%s", base_path, entry->d_name);
+
+        // d_type saves a stat per entry; symlinks and unknown types still need one
+        struct stat st;
+        int have_type = 0;
+        if (entry->d_type == DT_DIR) {
+            st.st_mode = S_IFDIR;
+            have_type = 1;
+        } else if (entry->d_type == DT_REG) {
+            st.st_mode = S_IFREG;
+            have_type = 1;
+        } else {
+            have_type = fstatat(dirfd(dir), entry->d_name, &st, 0) == 0;
+        }
+        if (have_type) {
+            if (S_ISDIR(st.st_mode)) {
+                // It's a directory, recurse into it
+                add_watches_recursively(node, full_path);
+            } else if (S_ISREG(st.st_mode)) {
+                // It's a regular file, cache its initial content for diffing.
+                // Once the cache is full, later files are diffed against the snapshot.
+                if (file_cache_is_full()) {
+                    file_cache_note_path(full_path);
+                } else {
+                    char* content = read_file_content(full_path);
+                    if (content) {
+                        update_file_cache(full_path, content);
+                        free(content);
+                    }
+                }
+            }
+        }
+    }
+    closedir(dir);
+}
+
+
+
+void remove_all_watches_for_node(WatchedNode* node) {
+    // Remove all watch descriptors from inotify and our map
+    pthread_mutex_lock(&wd_map_mutex);
+    while (node->watches_head) {
+        int wd = node->watches_head->wd;
+        inotify_rm_watch(inotify_fd, wd);
+        wd_table_remove_locked(wd);
+    }
+    pthread_mutex_unlock(&wd_map_mutex);
+
+    // Clear this node's files from the content cache
+    file_cache_remove_tree(node->path);
+}
+
+
+// Returns a copy of the cached content of full_path and marks it recently
+// used. *evicted is set when the path is known but its content was dropped.
+static char* file_cache_base(const char* full_path, int* evicted) {
+    uint64_t path_hash = fnv1a64(full_path, strlen(full_path));
+    char* content = NULL;
+    *evicted = 0;
+
+    pthread_mutex_lock(&file_cache_mutex);
+    FileCache* cached = file_cache_find_locked(full_path, path_hash);
+    if (cached) {
+        if (cached->blob) {
+            content = file_blob_content(cached->blob);
+            // Touch the entry so it is the last to be evicted
+            file_cache_lru_unlink_locked(cached);
+            file_cache_lru_push_locked(cached);
+        } else {
+            *evicted = 1;
+        }
+    }
+    pthread_mutex_unlock(&file_cache_mutex);
+    return content;
+}
+
+static int diff_base_enqueue(WatchedNode* node, const char* full_path, const char* user, char* new_content);
+
+// Records one EV_MODIFIED for the file, diffed against old_content when
+// there is one, and caches new_content as the next base if update_cache.
+static void record_file_modification(WatchedNode* node, const char* full_path, const char* user,
+                                     const char* old_content, const char* new_content, int update_cache) {
+    const char* relative_path = full_path + strlen(node->path) + 1;
+    if (!old_content) {
+        add_event_to_node(node, EV_MODIFIED, relative_path, user, NULL);
+        if (update_cache) update_file_cache(full_path, new_content);
+        return;
+    }
+    
+    ctz_json_value* changes_obj = ctz_json_new_object();
+    ctz_json_value* added_array = ctz_json_new_array();
+    ctz_json_value* removed_array = ctz_json_new_array();
+    ctz_json_value* moved_array = ctz_json_new_array();
+
+    char* old_copy = strdup(old_content);
+    char* new_copy = strdup(new_content);
+
+    exodus_diff_line* old_lines = NULL;
+    exodus_diff_line* new_lines = NULL;
+    int old_count = old_copy ? exodus_diff_split_lines(old_copy, strlen(old_copy), &old_lines) : -1;
+    int new_count = new_copy ? exodus_diff_split_lines(new_copy, strlen(new_copy), &new_lines) : -1;
+
+    exodus_diff_result diff;
+    if (old_count >= 0 && new_count >= 0 &&
+        exodus_diff_compute(old_lines, old_count, new_lines, new_count, EXODUS_DIFF_DETECT_MOVES, &diff) == 0) {
+        // Split lines are NUL-terminated in place, so .data can go straight into JSON
+        for (size_t k = 0; k < diff.move_count; k++) {
+            ctz_json_value* change_obj = ctz_json_new_object();
+            ctz_json_object_set_value(change_obj, "from", ctz_json_new_number(diff.moves[k].old_index + 1));
+            ctz_json_object_set_value(change_obj, "to", ctz_json_new_number(diff.moves[k].new_index + 1));
+            ctz_json_object_set_value(change_obj, "content", ctz_json_new_string(old_lines[diff.moves[k].old_index].data));
+            ctz_json_array_push_value(moved_array, change_obj);
+        }
+        for (size_t k = 0; k < diff.op_count; k++) {
+            const exodus_diff_op* op = &diff.ops[k];
+            if (op->type == EXODUS_DIFF_SAME || op->moved) continue;
+            int added = (op->type == EXODUS_DIFF_ADD);
+            int line = added ? op->new_index : op->old_index;
+            ctz_json_value* change_obj = ctz_json_new_object();
+            ctz_json_object_set_value(change_obj, "line", ctz_json_new_number(line + 1));
+            ctz_json_object_set_value(change_obj, "content", ctz_json_new_string(added ? new_lines[line].data : old_lines[line].data));
+            ctz_json_array_push_value(added ? added_array : removed_array, change_obj);
+        }
+        exodus_diff_result_free(&diff);
+    }
+
+    free(old_lines);
+    free(new_lines);
+    free(old_copy);
+    free(new_copy);
 
     char* details_json_string = NULL;
     
@@ -1179,42 +2183,171 @@ void handle_file_modification(WatchedNode* node, const char* full_path, const ch
     // Cleanup
     if (details_json_string) free(details_json_string);
     ctz_json_free(changes_obj);
-    free(old_content);
     
-    update_file_cache(full_path, new_content);
+    if (update_cache) update_file_cache(full_path, new_content);
+}
+
+// Diffs the file against its cached content and records one EV_MODIFIED.
+// Bursts of writes are already merged by the coalescing window. A base that
+// was evicted is looked up on the diff base worker, which records the event
+// once it has it.
+void handle_file_modification(WatchedNode* node, const char* full_path, const char* user) {
+    char* new_content = read_file_content(full_path);
+    if (!new_content) return; 
+
+    int evicted = 0;
+    char* old_content = file_cache_base(full_path, &evicted);
+    if (evicted && diff_base_enqueue(node, full_path, user, new_content) == 0) {
+        return; // The worker owns new_content now
+    }
+
+    // Queue full: record the change without a diff rather than stall the watcher
+    record_file_modification(node, full_path, user, old_content, new_content, 1);
+    free(old_content);
     free(new_content);
 }
 
-void recursive_scan_dir(const char* base_path, ctz_json_value* json_array) {
-    struct dirent* de;
-    DIR* dr = opendir(base_path);
+// --- Diff base worker ---
+// Runs the snapshot lookups for evicted diff bases one at a time, off the
+// watcher thread, so a burst of edits to evicted files does not turn into a
+// chain of exodus_snapshot runs that holds up inotify reads.
 
-    if (dr == NULL) {
-        // fprintf(stderr, "[Cloud] Could not open directory %s\n", base_path);
-        return;
+static void diff_base_job_free(DiffBaseJob* job) {
+    free(job->full_path);
+    free(job->old_content);
+    free(job->new_content);
+    free(job);
+}
+
+// Queues the lookup and takes ownership of new_content. Returns -1 when the
+// queue is full or the worker is not running.
+static int diff_base_enqueue(WatchedNode* node, const char* full_path, const char* user, char* new_content) {
+    DiffBaseQueue* q = &diff_base_queue;
+    DiffBaseJob* job = calloc(1, sizeof(DiffBaseJob));
+    if (!job || !(job->full_path = strdup(full_path))) {
+        free(job);
+        return -1;
     }
+    job->node = node;
+    memcpy(job->node_name, node->name, sizeof(job->node_name)); // Same sizes as the node's fields
+    memcpy(job->node_path, node->path, sizeof(job->node_path));
+    strncpy(job->user, user, sizeof(job->user) - 1);
 
-    while ((de = readdir(dr)) != NULL) {
-        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0 || strcmp(de->d_name, ".log") == 0) {
-            continue;
-        }
+    pthread_mutex_lock(&q->mutex);
+    if (!q->started || q->closing || q->depth >= DIFF_BASE_QUEUE_MAX) {
+        pthread_mutex_unlock(&q->mutex);
+        diff_base_job_free(job);
+        return -1;
+    }
+    // A change still waiting for its base is the base of this one
+    const DiffBaseJob* prev = (q->running && strcmp(q->running->full_path, full_path) == 0) ? q->running : NULL;
+    for (const DiffBaseJob* j = q->head; j; j = j->next) {
+        if (strcmp(j->full_path, full_path) == 0) prev = j;
+    }
+    if (prev && !(job->old_content = strdup(prev->new_content))) {
+        pthread_mutex_unlock(&q->mutex);
+        diff_base_job_free(job);
+        return -1;
+    }
+    job->new_content = new_content;
+    if (q->tail) q->tail->next = job;
+    else q->head = job;
+    q->tail = job;
+    q->depth++;
+    pthread_cond_signal(&q->cond);
+    pthread_mutex_unlock(&q->mutex);
+    return 0;
+}
 
-        char full_path[PATH_MAX];
-        snprintf(full_path, sizeof(full_path), "%s/%s", base_path, de->d_name);
-        
-        // Create a JSON object for this item
-        ctz_json_value* item_obj = ctz_json_new_object();
-        ctz_json_object_set_value(item_obj, "name", ctz_json_new_string(de->d_name));
-        ctz_json_object_set_value(item_obj, "path", ctz_json_new_string(full_path));
-        ctz_json_array_push_value(json_array, item_obj);
+static void* diff_base_worker_func(void* arg) {
+    DiffBaseQueue* q = arg;
+    for (;;) {
+        pthread_mutex_lock(&q->mutex);
+        while (!q->head && !q->closing) {
+            pthread_cond_wait(&q->cond, &q->mutex);
+        }
+        DiffBaseJob* job = q->head;
+        if (!job) { // Closing and drained
+            pthread_mutex_unlock(&q->mutex);
+            break;
+        }
+        q->head = job->next;
+        if (!q->head) q->tail = NULL;
+        q->depth--;
+        q->running = job;
+        int closing = q->closing;
+        pthread_mutex_unlock(&q->mutex);
+
+        // On shutdown the remaining changes are recorded without a diff
+        const char* relative_path = job->full_path + strlen(job->node_path) + 1;
+        char* old_content = job->old_content;
+        job->old_content = NULL;
+        if (!old_content && !closing) {
+            old_content = read_snapshot_content(job->node_name, job->node_path, relative_path);
+        }
 
-        struct stat st;
-        if (stat(full_path, &st) == 0 && S_ISDIR(st.st_mode)) {
-            recursive_scan_dir(full_path, json_array);
+        // Events are recorded under flush_mutex, like a batch from the watcher
+        pthread_mutex_lock(&flush_mutex);
+        pthread_mutex_lock(&q->mutex);
+        WatchedNode* node = job->node;
+        q->running = NULL;
+        pthread_mutex_unlock(&q->mutex);
+        if (node) {
+            // Cache this content unless a later create or move replaced the entry meanwhile
+            int evicted = 0;
+            char* cached = file_cache_base(job->full_path, &evicted);
+            int update_cache = evicted || (cached && old_content && strcmp(cached, old_content) == 0);
+            record_file_modification(node, job->full_path, job->user, old_content, job->new_content, update_cache);
+            free(cached);
         }
+        pthread_mutex_unlock(&flush_mutex);
+
+        free(old_content);
+        diff_base_job_free(job);
     }
+    return NULL;
+}
 
-    closedir(dr);
+static void start_diff_base_worker(void) {
+    DiffBaseQueue* q = &diff_base_queue;
+    if (pthread_create(&q->thread, NULL, diff_base_worker_func, q) != 0) {
+        fprintf(stderr, "[Cloud] Failed to start the diff base worker; evicted files are logged without diffs.\n");
+        return;
+    }
+    q->started = 1;
+}
+
+static void stop_diff_base_worker(void) {
+    DiffBaseQueue* q = &diff_base_queue;
+    if (!q->started) return;
+    pthread_mutex_lock(&q->mutex);
+    q->closing = 1;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->mutex);
+    pthread_join(q->thread, NULL);
+    q->started = 0;
+}
+
+// Drops the node's queued lookups and detaches the running one. The caller
+// holds flush_mutex, which the worker takes before touching the node.
+static void discard_node_diff_bases_locked(WatchedNode* node) {
+    DiffBaseQueue* q = &diff_base_queue;
+    pthread_mutex_lock(&q->mutex);
+    DiffBaseJob** pptr = &q->head;
+    q->tail = NULL;
+    while (*pptr) {
+        DiffBaseJob* job = *pptr;
+        if (job->node == node) {
+            *pptr = job->next;
+            q->depth--;
+            diff_base_job_free(job);
+        } else {
+            q->tail = job;
+            pptr = &job->next;
+        }
+    }
+    if (q->running && q->running->node == node) q->running->node = NULL;
+    pthread_mutex_unlock(&q->mutex);
 }
 
 // Smart path finder for pin.json
@@ -1236,21 +2369,17 @@ int get_pin_json_path(char* buffer, size_t size) {
 
 void write_to_handle(cortez_write_handle_t* h, const void* data, size_t size);
 
-// Simple in-memory word index (linked list)
-typedef struct WordOccurrence {
-    const char* sentence_start;
-    struct WordOccurrence* next;
-} WordOccurrence;
-
-typedef struct WordIndex {
-    char word[MAX_WORD_LEN];
-    int count;
-    WordOccurrence* occurrences; // Head of linked list of occurrences
-    struct WordIndex* next;
-} WordIndex;
 static volatile int keep_running = 1;
 
-static WordIndex* index_head = NULL;
+// Writers (node add/remove/attr changes) are rare and short; preferring them
+// keeps a steady stream of queries from starving them.
+static void init_node_list_lock(void) {
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&node_list_lock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+}
 
 void int_handler(int dummy) {
     (void)dummy;
@@ -1282,91 +2411,545 @@ int get_executable_dir(char* buffer, size_t size) {
     return 0;
 }
 
-void free_index() {
-    WordIndex* current = index_head;
-    while (current != NULL) {
-        WordIndex* next = current->next;
-        
-        WordOccurrence* occ = current->occurrences;
-        while (occ != NULL) {
-            WordOccurrence* next_occ = occ->next;
-            free(occ);
-            occ = next_occ;
-        }
-        
-        free(current);
-        current = next;
+// --- Word index for the uploaded file ---
+// One forward pass per chunk tokenizes, records sentence breaks and counts
+// words/lines/chars; large uploads are split at whitespace and the chunks are
+// indexed in parallel, then merged in file order. Everything lives in
+// per-chunk arenas that are dropped together. Only the control worker
+// touches the index, so it needs no lock.
+
+#define WORD_ARENA_BLOCK (256 * 1024)
+#define WORD_CHUNK_MIN (1024 * 1024)    // Don't split uploads smaller than this
+#define WORD_CHUNK_MAX_THREADS 16
+
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t used;
+    size_t cap;
+    char data[];
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock* head;
+} Arena;
+
+static void* arena_alloc(Arena* a, size_t size) {
+    size = (size + 7) & ~(size_t)7;
+    if (!a->head || a->head->cap - a->head->used < size) {
+        size_t cap = size > WORD_ARENA_BLOCK ? size : WORD_ARENA_BLOCK;
+        ArenaBlock* b = malloc(sizeof(ArenaBlock) + cap);
+        if (!b) return NULL;
+        b->next = a->head;
+        b->used = 0;
+        b->cap = cap;
+        a->head = b;
+    }
+    void* p = a->head->data + a->head->used;
+    a->head->used += size;
+    return p;
+}
+
+static void arena_free(Arena* a) {
+    ArenaBlock* b = a->head;
+    while (b) {
+        ArenaBlock* next = b->next;
+        free(b);
+        b = next;
     }
-    index_head = NULL;
+    a->head = NULL;
 }
 
-void build_index() {
-    free_index();
-    if (!file_content) return;
+typedef struct WordOccurrence {
+    uint32_t chunk;             // Chunk that saw it
+    uint32_t sentence;          // Chunk-local sentence, 0 = the one open when the chunk began
+    struct WordOccurrence* next;
+} WordOccurrence;
 
-    // Use a copy for tokenization that preserves original content
-    char* content_for_tokens = strdup(file_content);
-    if (!content_for_tokens) return;
+typedef struct WordEntry {
+    uint64_t hash;
+    long count;
+    WordOccurrence* occ_head;   // File order
+    WordOccurrence* occ_tail;
+    char word[];                // Lowercased, at most MAX_WORD_LEN - 1 chars
+} WordEntry;
+
+typedef struct {
+    WordEntry** slots;          // Open addressing, capacity is a power of two
+    size_t cap;
+    size_t count;
+} WordTable;
+
+typedef struct {
+    const char* text;
+    size_t begin, end;
+    uint32_t id;
+    Arena arena;
+    WordTable table;
+    size_t* breaks;             // Offsets just past each '.', '!' or '?'
+    size_t break_count, break_cap;
+    long words, lines, chars;
+    int failed;
+    int truncated;              // The file shrank under the mapping while this chunk read it
+} WordChunk;
+
+typedef struct {
+    WordTable table;
+    WordChunk* chunks;
+    size_t chunk_count;
+    size_t* sentences;          // Sentence start offsets in file order; [0] is the file start
+    size_t* sentence_base;      // Per chunk: index in sentences of its sentence 1
+    long words, lines, chars;
+} WordIndex;
 
-    const char* delimiters = " \t\n\r,.;:!?\"()[]{}";
-    char* token = strtok(content_for_tokens, delimiters);
+static WordIndex word_index;
 
-    while (token != NULL) {
-        char normalized_token[MAX_WORD_LEN];
-        strncpy(normalized_token, token, MAX_WORD_LEN - 1);
-        normalized_token[MAX_WORD_LEN - 1] = '\0';
-        for (char* p = normalized_token; *p; ++p) *p = tolower((unsigned char)*p);
+static void release_uploaded_file(void);
 
-        // Find where this token is in the *original* file_content
-        ptrdiff_t offset = token - content_for_tokens;
-        const char* original_pos = file_content + offset;
+static WordEntry** word_table_slot(WordTable* t, const char* word, uint64_t h) {
+    size_t mask = t->cap - 1;
+    size_t i = h & mask;
+    while (t->slots[i] && (t->slots[i]->hash != h || strcmp(t->slots[i]->word, word) != 0)) {
+        i = (i + 1) & mask;
+    }
+    return &t->slots[i];
+}
 
-        // Find the start of the sentence for this token
-        const char* sentence_start = original_pos;
-        while (sentence_start > file_content) {
-            if (*(sentence_start - 1) == '.' || *(sentence_start - 1) == '!' || *(sentence_start - 1) == '?') {
-                break;
+static int word_table_reserve(WordTable* t) {
+    if (t->cap && (t->count + 1) * 2 <= t->cap) return 0;
+    size_t new_cap = t->cap ? t->cap * 2 : 1024;
+    WordEntry** ns = calloc(new_cap, sizeof(WordEntry*));
+    if (!ns) return -1;
+    for (size_t i = 0; i < t->cap; i++) {
+        WordEntry* e = t->slots[i];
+        if (!e) continue;
+        size_t j = e->hash & (new_cap - 1);
+        while (ns[j]) j = (j + 1) & (new_cap - 1);
+        ns[j] = e;
+    }
+    free(t->slots);
+    t->slots = ns;
+    t->cap = new_cap;
+    return 0;
+}
+
+static int word_chunk_add(WordChunk* c, const char* token, size_t len) {
+    char word[MAX_WORD_LEN];
+    if (len > MAX_WORD_LEN - 1) len = MAX_WORD_LEN - 1;
+    for (size_t i = 0; i < len; i++) word[i] = (char)tolower((unsigned char)token[i]);
+    word[len] = '\0';
+
+    if (word_table_reserve(&c->table) != 0) return -1;
+    uint64_t h = fnv1a64(word, len);
+    WordEntry** slot = word_table_slot(&c->table, word, h);
+    WordEntry* e = *slot;
+    if (!e) {
+        e = arena_alloc(&c->arena, sizeof(WordEntry) + len + 1);
+        if (!e) return -1;
+        e->hash = h;
+        e->count = 0;
+        e->occ_head = e->occ_tail = NULL;
+        memcpy(e->word, word, len + 1);
+        *slot = e;
+        c->table.count++;
+    }
+
+    WordOccurrence* occ = arena_alloc(&c->arena, sizeof(WordOccurrence));
+    if (!occ) return -1;
+    occ->chunk = c->id;
+    occ->sentence = (uint32_t)c->break_count;
+    occ->next = NULL;
+    if (e->occ_tail) e->occ_tail->next = occ;
+    else e->occ_head = occ;
+    e->occ_tail = occ;
+    e->count++;
+    return 0;
+}
+
+// Reading a page of the mapping past the end of a file that was truncated
+// after it was mapped raises SIGBUS. Code that reads file_content runs
+// under with_mapping_guard(), which turns that fault into an error.
+static __thread sigjmp_buf* mapping_guard;
+
+static void mapping_sigbus_handler(int sig, siginfo_t* info, void* ctx) {
+    (void)ctx;
+    const char* addr = info->si_addr;
+    if (mapping_guard && file_content && addr >= file_content && addr < file_content + file_size) {
+        siglongjmp(*mapping_guard, 1);
+    }
+    // Not a guarded read: returning re-runs the access with the default action
+    signal(sig, SIG_DFL);
+}
+
+// Runs fn(arg) and returns its result, or -1 if the uploaded file was
+// truncated while fn was reading it.
+static int with_mapping_guard(int (*fn)(void*), void* arg) {
+    sigjmp_buf guard;
+    sigjmp_buf* outer = mapping_guard;
+    if (sigsetjmp(guard, 1) != 0) {
+        mapping_guard = outer;
+        return -1;
+    }
+    mapping_guard = &guard;
+    int rc = fn(arg);
+    mapping_guard = outer;
+    return rc;
+}
+
+static int word_chunk_scan(void* arg) {
+    WordChunk* c = arg;
+    // Token delimiters and the whitespace that separates counted words
+    static const char token_delims[] = " \t\n\r,.;:!?\"()[]{}";
+    int is_delim[256] = {0};
+    for (const char* d = token_delims; *d; d++) is_delim[(unsigned char)*d] = 1;
+
+    const char* text = c->text;
+    size_t token_start = 0;
+    int in_token = 0, in_word = 0;
+    for (size_t i = c->begin; i < c->end; i++) {
+        unsigned char ch = (unsigned char)text[i];
+        int ws = (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r');
+        if (!ws && !in_word) c->words++;
+        in_word = !ws;
+        if (ch == '\n') c->lines++;
+        if (!isspace(ch)) c->chars++;
+
+        if (is_delim[ch]) {
+            if (in_token && word_chunk_add(c, text + token_start, i - token_start) != 0) {
+                c->failed = 1;
+                return -1;
+            }
+            in_token = 0;
+            if (ch == '.' || ch == '!' || ch == '?') {
+                if (c->break_count == c->break_cap) {
+                    size_t new_cap = c->break_cap ? c->break_cap * 2 : 256;
+                    size_t* nb = realloc(c->breaks, new_cap * sizeof(size_t));
+                    if (!nb) { c->failed = 1; return -1; }
+                    c->breaks = nb;
+                    c->break_cap = new_cap;
+                }
+                c->breaks[c->break_count++] = i + 1;
             }
-            sentence_start--;
+        } else if (!in_token) {
+            in_token = 1;
+            token_start = i;
         }
-        // Trim leading whitespace from the sentence start
-        while (*sentence_start && isspace((unsigned char)*sentence_start)) {
-            sentence_start++;
+    }
+    if (in_token && word_chunk_add(c, text + token_start, c->end - token_start) != 0) {
+        c->failed = 1;
+        return -1;
+    }
+    return 0;
+}
+
+static void* word_chunk_build(void* arg) {
+    WordChunk* c = arg;
+    if (with_mapping_guard(word_chunk_scan, c) != 0 && !c->failed) c->truncated = 1;
+    return NULL;
+}
+
+// Maps the uploaded file read-only in place of the previous one. Nothing is
+// copied, so multi-GB logs cost address space, not RAM.
+static int map_uploaded_file(const char* path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return -1;
+    }
+
+    const char* mapped = "";
+    if (st.st_size > 0) {
+        void* m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m == MAP_FAILED) {
+            close(fd);
+            return -1;
         }
+        madvise(m, (size_t)st.st_size, MADV_SEQUENTIAL); // The index build reads it front to back
+        mapped = m;
+    }
+    close(fd);
+
+    release_uploaded_file();
+    file_content = mapped;
+    file_size = (size_t)st.st_size;
+    return 0;
+}
+
+static void release_uploaded_file(void) {
+    if (file_content && file_size > 0) munmap((void*)file_content, file_size);
+    file_content = NULL;
+    file_size = 0;
+}
+
+#define REWRITE_BLOCK (256 * 1024)
+
+// Replaces every target with replacement in path, streaming through a
+// temporary file that is renamed over the original. Memory use is one block
+// regardless of the file size. Returns NULL on success or an error message;
+// the file is left untouched when nothing matched.
+static const char* rewrite_uploaded_file(const char* path, const char* target, const char* replacement, long* occurrences_out) {
+    size_t target_len = strnlen(target, MAX_WORD_LEN);
+    size_t new_len = strnlen(replacement, MAX_WORD_LEN);
+    *occurrences_out = 0;
+    if (target_len == 0) return "Error: Target word cannot be empty.";
+
+    FILE* in = fopen(path, "rb");
+    if (!in) return "Error: Could not open source file for reading.";
 
-        WordIndex* entry = index_head;
-        while (entry != NULL) {
-            if (strcmp(entry->word, normalized_token) == 0) {
-                entry->count++;
+    char temp_path[PATH_MAX + 4];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    FILE* out = fopen(temp_path, "wb");
+    if (!out) {
+        fclose(in);
+        return "Error: Could not create temporary file for writing.";
+    }
+
+    // buf holds the unmatched tail of the previous block (< target_len bytes) plus the next block
+    char* buf = malloc(REWRITE_BLOCK + target_len);
+    if (!buf) {
+        fclose(in);
+        fclose(out);
+        remove(temp_path);
+        return "Error: Memory allocation failed for file buffer.";
+    }
+
+    const char* error = NULL;
+    long occurrences = 0;
+    size_t carry = 0;
+    for (;;) {
+        size_t got = fread(buf + carry, 1, REWRITE_BLOCK, in);
+        if (got == 0 && ferror(in)) { error = "Error: Failed to read source file content."; break; }
+        size_t avail = carry + got;
+        int at_eof = (got == 0);
+
+        size_t pos = 0;
+        for (;;) {
+            char* hit = memmem(buf + pos, avail - pos, target, target_len);
+            if (!hit) break;
+            size_t before = (size_t)(hit - (buf + pos));
+            if (fwrite(buf + pos, 1, before, out) != before || fwrite(replacement, 1, new_len, out) != new_len) {
+                error = "Error: Failed to write to temporary file.";
                 break;
             }
-            entry = entry->next;
+            occurrences++;
+            pos += before + target_len;
         }
+        if (error) break;
 
-        if (entry == NULL) { // New word
-            entry = malloc(sizeof(WordIndex));
-            if (entry) {
-                strcpy(entry->word, normalized_token);
-                entry->count = 1;
-                entry->occurrences = NULL; // Initialize occurrences
-                entry->next = index_head;
-                index_head = entry;
-            }
-        }
+        // A match may straddle the block edge: keep the last target_len - 1 bytes for the next round
+        size_t keep = at_eof ? 0 : (avail - pos < target_len - 1 ? avail - pos : target_len - 1);
+        size_t flush = avail - pos - keep;
+        if (fwrite(buf + pos, 1, flush, out) != flush) { error = "Error: Failed to write to temporary file."; break; }
+        memmove(buf, buf + pos + flush, keep);
+        carry = keep;
+        if (at_eof) break;
+    }
+    free(buf);
+    fclose(in);
+
+    if (fclose(out) != 0 && !error) error = "Error: Failed to write to temporary file.";
+    if (!error && occurrences > 0 && rename(temp_path, path) != 0) error = "Error: Failed to replace original file.";
+    if (error || occurrences == 0) remove(temp_path);
+
+    *occurrences_out = error ? 0 : occurrences;
+    return error;
+}
+
+void free_index() {
+    for (size_t i = 0; i < word_index.chunk_count; i++) {
+        arena_free(&word_index.chunks[i].arena);
+        free(word_index.chunks[i].table.slots);
+        free(word_index.chunks[i].breaks);
+    }
+    free(word_index.chunks);
+    free(word_index.table.slots);
+    free(word_index.sentences);
+    free(word_index.sentence_base);
+    memset(&word_index, 0, sizeof(word_index));
+}
+
+// Splits [0, len) into up to n chunks that start and end on whitespace.
+static size_t word_index_split(const char* text, size_t len, WordChunk* chunks, size_t n) {
+    size_t count = 0, begin = 0;
+    for (size_t k = 1; k <= n && begin < len; k++) {
+        size_t end = (k == n) ? len : len / n * k;
+        if (end < begin) end = begin;
+        while (end < len && !(text[end] == ' ' || text[end] == '\t' || text[end] == '\n' || text[end] == '\r')) end++;
+        if (end == begin) continue;
+        chunks[count].text = text;
+        chunks[count].begin = begin;
+        chunks[count].end = end;
+        chunks[count].id = (uint32_t)count;
+        count++;
+        begin = end;
+    }
+    return count;
+}
 
-        if (entry) { // Add the occurrence
-            WordOccurrence* new_occ = malloc(sizeof(WordOccurrence));
-            if(new_occ) {
-                new_occ->sentence_start = sentence_start;
-                new_occ->next = entry->occurrences;
-                entry->occurrences = new_occ;
+static int index_uploaded_file(void* unused) {
+    (void)unused;
+
+    // Tokens stop at the first NUL, like the rest of the string handling here
+    size_t text_len = strnlen(file_content, file_size);
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t threads = text_len / WORD_CHUNK_MIN;
+    if (threads > (size_t)(cpus > 0 ? cpus : 1)) threads = (size_t)(cpus > 0 ? cpus : 1);
+    if (threads > WORD_CHUNK_MAX_THREADS) threads = WORD_CHUNK_MAX_THREADS;
+    if (threads < 1) threads = 1;
+
+    word_index.chunks = calloc(threads, sizeof(WordChunk));
+    if (!word_index.chunks) return 0;
+    word_index.chunk_count = word_index_split(file_content, text_len, word_index.chunks, threads);
+
+    pthread_t tids[WORD_CHUNK_MAX_THREADS];
+    int started[WORD_CHUNK_MAX_THREADS] = {0};
+    for (size_t i = 1; i < word_index.chunk_count; i++) {
+        started[i] = pthread_create(&tids[i], NULL, word_chunk_build, &word_index.chunks[i]) == 0;
+    }
+    if (word_index.chunk_count > 0) word_chunk_build(&word_index.chunks[0]);
+    for (size_t i = 1; i < word_index.chunk_count; i++) {
+        if (started[i]) pthread_join(tids[i], NULL);
+        else word_chunk_build(&word_index.chunks[i]);
+    }
+
+    // Merge in file order: sentence starts first, then each chunk's words
+    size_t total_breaks = 0;
+    for (size_t i = 0; i < word_index.chunk_count; i++) {
+        if (word_index.chunks[i].truncated) return -1;
+        if (word_index.chunks[i].failed) {
+            fprintf(stderr, "[Cloud] Out of memory while indexing the uploaded file.\n");
+            free_index();
+            return 0;
+        }
+        total_breaks += word_index.chunks[i].break_count;
+    }
+    word_index.sentences = malloc((total_breaks + 1) * sizeof(size_t));
+    word_index.sentence_base = malloc((word_index.chunk_count + 1) * sizeof(size_t));
+    if (!word_index.sentences || !word_index.sentence_base) {
+        free_index();
+        return 0;
+    }
+    size_t s = 0;
+    word_index.sentences[s++] = 0;
+    for (size_t i = 0; i < word_index.chunk_count; i++) {
+        WordChunk* c = &word_index.chunks[i];
+        word_index.sentence_base[i] = s;
+        if (c->break_count) memcpy(&word_index.sentences[s], c->breaks, c->break_count * sizeof(size_t));
+        s += c->break_count;
+        word_index.words += c->words;
+        word_index.lines += c->lines;
+        word_index.chars += c->chars;
+
+        for (size_t j = 0; j < c->table.cap; j++) {
+            WordEntry* e = c->table.slots[j];
+            if (!e) continue;
+            if (word_table_reserve(&word_index.table) != 0) {
+                free_index();
+                return 0;
+            }
+            WordEntry** slot = word_table_slot(&word_index.table, e->word, e->hash);
+            if (!*slot) {
+                *slot = e;
+                word_index.table.count++;
+            } else {
+                (*slot)->occ_tail->next = e->occ_head;
+                (*slot)->occ_tail = e->occ_tail;
+                (*slot)->count += e->count;
             }
         }
+    }
+
+    // Bytes past an embedded NUL still count as lines and characters
+    for (size_t i = text_len; i < file_size; i++) {
+        if (file_content[i] == '\n') word_index.lines++;
+        if (!isspace((unsigned char)file_content[i])) word_index.chars++;
+    }
+    if (file_size > 0) word_index.lines++; // Count last line if no trailing newline
+
+    printf("[Cloud] File indexed successfully (%zu distinct words, %zu chunk%s).\n",
+           word_index.table.count, word_index.chunk_count, word_index.chunk_count == 1 ? "" : "s");
+    return 0;
+}
+
+// Indexes the uploaded file. Returns -1, with the file released, if it was
+// truncated on disk while being read.
+int build_index() {
+    free_index();
+    if (!file_content) return 0;
+    if (with_mapping_guard(index_uploaded_file, NULL) == 0) return 0;
+
+    fprintf(stderr, "[Cloud] %s was truncated while it was being indexed.\n", last_uploaded_file_path);
+    free_index();
+    release_uploaded_file();
+    return -1;
+}
 
-        token = strtok(NULL, delimiters);
+static WordEntry* word_index_find(const char* word) {
+    if (!word_index.table.cap) return NULL;
+    return *word_table_slot(&word_index.table, word, fnv1a64(word, strlen(word)));
+}
+
+// Start of the sentence holding occ, with leading whitespace skipped.
+static const char* word_occurrence_sentence(const WordOccurrence* occ) {
+    size_t idx = word_index.sentence_base[occ->chunk] - 1 + occ->sentence;
+    const char* start = file_content + word_index.sentences[idx];
+    const char* end = file_content + file_size;
+    while (start < end && *start && isspace((unsigned char)*start)) start++;
+    return start;
+}
+
+// Length of the sentence at start, up to and including its '.', '!' or '?'
+static size_t word_sentence_length(const char* start) {
+    size_t max = (size_t)(file_content + file_size - start);
+    if (max > MAX_SENTENCE_LEN - 1) max = MAX_SENTENCE_LEN - 1;
+    size_t len = 0;
+    while (len < max && start[len]) {
+        char ch = start[len++];
+        if (ch == '.' || ch == '!' || ch == '?') break;
+    }
+    return len;
+}
+
+typedef struct {
+    const WordEntry* entry;
+    const char* word;
+    query_response_t* resp;     // NULL if it could not be allocated
+    size_t size;
+} QueryResponse;
+
+// Fills q->resp with the count and the first sentences holding q->entry.
+// It reads the mapped file, so it runs under with_mapping_guard().
+static int build_query_response(void* arg) {
+    QueryResponse* q = arg;
+    // Calculate total size for response
+    int num_sentences_to_send = 0;
+    size_t sentences_total_len = 0;
+    const WordOccurrence* occ = q->entry->occ_head;
+    while (occ && num_sentences_to_send < MAX_SENTENCES) {
+        sentences_total_len += word_sentence_length(word_occurrence_sentence(occ)) + 1; // +1 for null terminator
+        num_sentences_to_send++;
+        occ = occ->next;
+    }
+
+    q->size = sizeof(query_response_t) + sentences_total_len;
+    q->resp = malloc(q->size);
+    if (!q->resp) return 0;
+
+    q->resp->count = (int)q->entry->count;
+    strncpy(q->resp->word, q->word, MAX_WORD_LEN - 1);
+    q->resp->num_sentences = num_sentences_to_send;
+
+    char* current_sentence_ptr = q->resp->sentences;
+    occ = q->entry->occ_head;
+    for (int i = 0; occ && i < num_sentences_to_send; i++, occ = occ->next) {
+        const char* sentence_start = word_occurrence_sentence(occ);
+        size_t len = word_sentence_length(sentence_start);
+        memcpy(current_sentence_ptr, sentence_start, len);
+        current_sentence_ptr[len] = '\0';
+        current_sentence_ptr += len + 1;
     }
-    free(content_for_tokens);
-    printf("[Cloud] File indexed successfully.\n");
+    return 0;
 }
 
 // Sends a response back to the query daemon, wrapping it with the original request_id
@@ -1374,55 +2957,317 @@ void send_wrapped_response_zc(cortez_mesh_t* mesh, pid_t query_daemon_pid, uint1
     uint32_t total_payload_size = sizeof(request_id) + response_payload_size;
     int sent_ok = 0;
 
+    // Assemble the full payload on the heap first: other writers to the same
+    // inbox can reserve alongside us, but are published only after we commit.
+    char* temp_buffer = malloc(total_payload_size);
+    if (!temp_buffer) {
+        fprintf(stderr, "[Cloud] Out of memory when creating response buffer.\n");
+        return;
+    }
+    memcpy(temp_buffer, &request_id, sizeof(request_id));
+    memcpy(temp_buffer + sizeof(request_id), response_payload, response_payload_size);
+
     for (int i = 0; i < 50; i++) {
-        cortez_write_handle_t* h = cortez_mesh_begin_send_zc(mesh, query_daemon_pid, total_payload_size);
-        if (!h) {
-            // Peer is not yet visible on the mesh, wait and retry.
-            usleep(200000); // 100ms
+        cortez_write_handle_t h;
+        if (cortez_mesh_begin_send_zc_into(mesh, query_daemon_pid, total_payload_size, &h) != CORTEZ_OK) {
+            // Peer is not yet visible on the mesh, or its inbox is full; wait and retry.
+            usleep(200000); // 200ms
             continue;
         }
 
-        // Allocate the temporary buffer on the heap to prevent stack overflow.
-        char* temp_buffer = malloc(total_payload_size);
-        if (!temp_buffer) {
-            fprintf(stderr, "[Cloud] Out of memory when creating response buffer.\n");
-            cortez_mesh_abort_send_zc(h); // Abort the transaction
-            break; // Exit retry loop on critical error
+        // This helper function safely copies from the temp buffer into the shared memory handle.
+        write_to_handle(&h, temp_buffer, total_payload_size);
+        int rc = cortez_mesh_commit_send_zc(&h, msg_type);
+        if (rc != CORTEZ_OK) {
+            // The message was dropped (e.g. a stalled writer ahead of us); send it again.
+            fprintf(stderr, "[Cloud] Commit of response #%lu failed: %s. Retrying.\n", request_id, cortez_strerror(rc));
+            continue;
         }
+        sent_ok = 1;
+        break; // Success! Exit the loop.
+    }
+    free(temp_buffer);
+
+    if (!sent_ok) {
+        fprintf(stderr, "[Cloud] Failed to send response for request #%lu to query daemon %d after retries.\n", request_id, query_daemon_pid);
+    }
+}
 
-        // Assemble the full payload in the heap buffer
-        memcpy(temp_buffer, &request_id, sizeof(request_id));
-        memcpy(temp_buffer + sizeof(request_id), response_payload, response_payload_size);
 
-        // This helper function safely copies from the temp buffer into the shared memory handle.
-        write_to_handle(h, temp_buffer, total_payload_size);
+void write_to_handle(cortez_write_handle_t* h, const void* data, size_t size) {
+    size_t part1_size = 0;
+    char* part1 = cortez_write_handle_get_part1(h, &part1_size);
+    
+    if (size <= part1_size) {
+        memcpy(part1, data, size);
+    } else {
+        size_t part2_size;
+        char* part2 = cortez_write_handle_get_part2(h, &part2_size);
+        memcpy(part1, data, part1_size);
+        memcpy(part2, (const char*)data + part1_size, size - part1_size);
+    }
+}
+
+// --- Event coalescing ---
+// The watcher queues events per node; they are merged per path and applied
+// in one batch once the node's window has elapsed. Lock order:
+// flush_mutex -> node_list_lock -> pending_event_mutex.
+
+static int64_t monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint64_t pending_event_hash(const WatchedNode* node, const char* name) {
+    return fnv1a64(name, strlen(name)) ^ ((uint64_t)(uintptr_t)node * 0x9E3779B97F4A7C15ULL);
+}
+
+static PendingEvent* pending_event_find_locked(const WatchedNode* node, const char* name, uint64_t h) {
+    for (PendingEvent* ev = pending_event_buckets[h % PENDING_EVENT_BUCKETS]; ev; ev = ev->hash_next) {
+        if (ev->hash == h && ev->node == node && strcmp(ev->name, name) == 0) return ev;
+    }
+    return NULL;
+}
+
+static void pending_event_unindex_locked(PendingEvent* ev) {
+    if (!ev || !ev->indexed) return;
+    PendingEvent** pptr = &pending_event_buckets[ev->hash % PENDING_EVENT_BUCKETS];
+    while (*pptr && *pptr != ev) pptr = &(*pptr)->hash_next;
+    if (*pptr) *pptr = ev->hash_next;
+    ev->hash_next = NULL;
+    ev->indexed = 0;
+}
+
+static void pending_event_free(PendingEvent* ev) {
+    free(ev->name);
+    free(ev->from_name);
+    free(ev->details);
+    free(ev);
+}
+
+static void pending_event_set_details(PendingEvent* ev, const char* details) {
+    free(ev->details);
+    ev->details = details ? strdup(details) : NULL;
+}
+
+// Queues an event for node, merging it with a pending event on the same path:
+//   created/modified + modified -> unchanged (content is read at flush time)
+//   deleted + created (file)    -> modified
+//   created + deleted           -> nothing
+//   modified + deleted          -> deleted
+// Moves are never merged; they only stop earlier events on either path from
+// absorbing later ones, so the order around a rename is kept.
+static void queue_node_event(WatchedNode* node, EventType type, const char* name, const char* from_name,
+                             const char* user, const char* details, int is_dir) {
+    uint64_t h = pending_event_hash(node, name);
+
+    pthread_mutex_lock(&pending_event_mutex);
+    PendingEvent* prev = pending_event_find_locked(node, name, h);
+    if (type == EV_MOVED) {
+        pending_event_unindex_locked(prev);
+        if (from_name) pending_event_unindex_locked(pending_event_find_locked(node, from_name, pending_event_hash(node, from_name)));
+        prev = NULL;
+    }
+
+    if (prev) {
+        int merged = 1;
+        if (type == EV_MODIFIED && (prev->type == EV_CREATED || prev->type == EV_MODIFIED)) {
+            // Keep the earlier record
+        } else if (type == EV_CREATED && (prev->type == EV_CREATED || prev->type == EV_MODIFIED)) {
+            // Duplicate create
+        } else if (type == EV_CREATED && prev->type == EV_DELETED && !prev->is_dir && !is_dir) {
+            prev->type = EV_MODIFIED;
+            pending_event_set_details(prev, NULL);
+        } else if (type == EV_DELETED && prev->type == EV_CREATED) {
+            prev->dropped = 1;
+            pending_event_unindex_locked(prev);
+        } else if (type == EV_DELETED && prev->type == EV_MODIFIED) {
+            prev->type = EV_DELETED;
+            prev->is_dir = is_dir;
+            pending_event_set_details(prev, details);
+        } else if (type == EV_DELETED && prev->type == EV_DELETED) {
+            // Duplicate delete (e.g. our own unlink of a filtered file)
+        } else {
+            merged = 0;
+            pending_event_unindex_locked(prev);
+        }
+        if (merged) {
+            if (!prev->dropped) strncpy(prev->user, user, sizeof(prev->user) - 1);
+            pthread_mutex_unlock(&pending_event_mutex);
+            return;
+        }
+    }
+
+    PendingEvent* ev = calloc(1, sizeof(PendingEvent));
+    if (ev) {
+        ev->name = strdup(name);
+        ev->from_name = from_name ? strdup(from_name) : NULL;
+        ev->details = details ? strdup(details) : NULL;
+    }
+    if (!ev || !ev->name || (from_name && !ev->from_name) || (details && !ev->details)) {
+        pthread_mutex_unlock(&pending_event_mutex);
+        if (ev) pending_event_free(ev);
+        fprintf(stderr, "[Watcher] Out of memory, dropping event for '%s'\n", name);
+        return;
+    }
+    ev->type = type;
+    ev->is_dir = is_dir;
+    strncpy(ev->user, user, sizeof(ev->user) - 1);
+    ev->node = node;
+    ev->hash = h;
+    if (type != EV_MOVED) {
+        ev->hash_next = pending_event_buckets[h % PENDING_EVENT_BUCKETS];
+        pending_event_buckets[h % PENDING_EVENT_BUCKETS] = ev;
+        ev->indexed = 1;
+    }
+
+    if (node->pending_tail) node->pending_tail->next = ev;
+    else {
+        node->pending_head = ev;
+        node->pending_since_ms = monotonic_ms();
+    }
+    node->pending_tail = ev;
+    node->pending_count++;
+    pthread_mutex_unlock(&pending_event_mutex);
+}
+
+static PendingEvent* detach_node_events_locked(WatchedNode* node) {
+    PendingEvent* head = node->pending_head;
+    for (PendingEvent* ev = head; ev; ev = ev->next) pending_event_unindex_locked(ev);
+    node->pending_head = node->pending_tail = NULL;
+    node->pending_count = 0;
+    return head;
+}
+
+static void apply_pending_event(PendingEvent* ev) {
+    WatchedNode* node = ev->node;
+    char full_path[PATH_MAX];
+    snprintf(full_path, sizeof(full_path), "%s/%s", node->path, ev->name);
+
+    switch (ev->type) {
+        case EV_CREATED:
+            add_event_to_node(node, EV_CREATED, ev->name, ev->user, ev->details);
+            if (!ev->is_dir) {
+                char* content = read_file_content(full_path);
+                if (content) {
+                    update_file_cache(full_path, content);
+                    free(content);
+                }
+            }
+            break;
+        case EV_MODIFIED:
+            handle_file_modification(node, full_path, ev->user);
+            break;
+        case EV_DELETED:
+            add_event_to_node(node, EV_DELETED, ev->name, ev->user, ev->details);
+            if (ev->is_dir) file_cache_remove_tree(full_path);
+            else update_file_cache(full_path, NULL);
+            break;
+        case EV_MOVED: {
+            add_event_to_node(node, EV_MOVED, ev->name, ev->user, ev->details);
+            char from_full[PATH_MAX];
+            snprintf(from_full, sizeof(from_full), "%s/%s", node->path, ev->from_name);
+            if (ev->is_dir) {
+                file_cache_remove_tree(from_full);
+            } else {
+                update_file_cache(from_full, NULL);
+                char* content = read_file_content(full_path);
+                if (content) {
+                    update_file_cache(full_path, content);
+                    free(content);
+                }
+            }
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&contents_mutex);
+    contents_apply_event_locked(node, ev->type, ev->name, ev->from_name);
+    pthread_mutex_unlock(&contents_mutex);
+}
 
-        // Free the heap buffer now that the data has been copied.
-        free(temp_buffer);
+// Tells the snapshot tool's stat cache which paths of the node changed,
+// in one append for the whole run [head, end) of a node's events.
+static void mark_run_dirty(PendingEvent* head, PendingEvent* end) {
+    size_t count = 0;
+    for (PendingEvent* ev = head; ev != end; ev = ev->next) {
+        if (!ev->dropped) count += ev->from_name ? 2 : 1;
+    }
+    if (count == 0) return;
+    const char** paths = malloc(count * sizeof(char*));
+    if (!paths) return;
+    size_t n = 0;
+    for (PendingEvent* ev = head; ev != end; ev = ev->next) {
+        if (ev->dropped) continue;
+        paths[n++] = ev->name;
+        if (ev->from_name) paths[n++] = ev->from_name;
+    }
+    if (exodus_index_mark_dirty(head->node->path, paths, n) != 0) {
+        fprintf(stderr, "[Watcher] Could not record dirty paths for '%s': %s\n", head->node->path, strerror(errno));
+    }
+    free(paths);
+}
 
-        cortez_mesh_commit_send_zc(h, msg_type);
-        sent_ok = 1;
-        break; // Success! Exit the loop.
+// Applies the pending events of every node whose window has elapsed (all of
+// them when force is set), then rewrites each touched node's contents.json once.
+static void flush_pending_events(int force) {
+    pthread_mutex_lock(&flush_mutex);
+
+    PendingEvent* batch_head = NULL;
+    PendingEvent** batch_tail = &batch_head;
+    int64_t now = monotonic_ms();
+
+    pthread_rwlock_rdlock(&node_list_lock);
+    pthread_mutex_lock(&pending_event_mutex);
+    for (WatchedNode* node = watched_nodes_head; node; node = node->next) {
+        if (!node->pending_head) continue;
+        if (!force && node->pending_count < COALESCE_MAX_PENDING &&
+            now - node->pending_since_ms < node->coalesce_ms) {
+            continue;
+        }
+        *batch_tail = detach_node_events_locked(node);
+        while (*batch_tail) batch_tail = &(*batch_tail)->next;
+    }
+    pthread_mutex_unlock(&pending_event_mutex);
+    pthread_rwlock_unlock(&node_list_lock);
+
+    // Events are grouped by node, so each node's index is written at the end of its run
+    PendingEvent* ev = batch_head;
+    PendingEvent* run_head = batch_head;
+    while (ev) {
+        PendingEvent* next = ev->next;
+        if (!ev->dropped) apply_pending_event(ev);
+        if (!next || next->node != ev->node) {
+            pthread_mutex_lock(&contents_mutex);
+            if (ev->node->contents.dirty) write_node_contents_json_locked(ev->node);
+            pthread_mutex_unlock(&contents_mutex);
+            mark_run_dirty(run_head, next);
+            while (run_head != next) {
+                PendingEvent* run_next = run_head->next;
+                pending_event_free(run_head);
+                run_head = run_next;
+            }
+        }
+        ev = next;
     }
 
-    if (!sent_ok) {
-        fprintf(stderr, "[Cloud] Failed to send response for request #%lu to query daemon %d after retries.\n", request_id, query_daemon_pid);
-    }
+    pthread_mutex_unlock(&flush_mutex);
 }
 
-
-void write_to_handle(cortez_write_handle_t* h, const void* data, size_t size) {
-    size_t part1_size;
-    char* part1 = cortez_write_handle_get_part1(h, &part1_size);
-    
-    if (size <= part1_size) {
-        memcpy(part1, data, size);
-    } else {
-        size_t part2_size;
-        char* part2 = cortez_write_handle_get_part2(h, &part2_size);
-        memcpy(part1, data, part1_size);
-        memcpy(part2, (const char*)data + part1_size, size - part1_size);
-    }
+// Drops a node's queued events without applying them. Used when the node is removed.
+static void discard_node_events(WatchedNode* node) {
+    pthread_mutex_lock(&flush_mutex);
+    pthread_mutex_lock(&pending_event_mutex);
+    PendingEvent* ev = detach_node_events_locked(node);
+    pthread_mutex_unlock(&pending_event_mutex);
+    discard_node_diff_bases_locked(node);
+    while (ev) {
+        PendingEvent* next = ev->next;
+        pending_event_free(ev);
+        ev = next;
+    }
+    pthread_mutex_unlock(&flush_mutex);
 }
 
 static void process_stale_moves_locked(time_t now) {
@@ -1433,7 +3278,7 @@ static void process_stale_moves_locked(time_t now) {
         // Check if the move event has expired
         if (now > entry->timestamp + MOVE_TIMEOUT_SECONDS) { 
             // Move expired, log it as a simple deletion from its source
-            add_event_to_node(entry->from_node, EV_DELETED, entry->from_path, entry->user, NULL);
+            queue_node_event(entry->from_node, EV_DELETED, entry->from_path, NULL, entry->user, NULL, entry->is_dir);
             
             // Unlink from the list and free
             *pptr = entry->next; 
@@ -1445,25 +3290,49 @@ static void process_stale_moves_locked(time_t now) {
     }
 }
 
+// Re-scans every active node after the kernel dropped events (IN_Q_OVERFLOW).
+static void regenerate_all_contents(void) {
+    pthread_rwlock_rdlock(&node_list_lock);
+    for (WatchedNode* node = watched_nodes_head; node; node = node->next) {
+        if (node->active) generate_node_contents_json(node);
+    }
+    pthread_rwlock_unlock(&node_list_lock);
+}
+
 void* watcher_thread_func(void* arg) {
     (void)arg;
-    // Increased buffer size to handle multiple events at once
-    char buffer[4 * (sizeof(struct inotify_event) + NAME_MAX + 1)];
+    // Large enough to drain a burst in one read
+    char buffer[64 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd pfd = { .fd = inotify_fd, .events = POLLIN };
+    const char* stats_env = getenv("EXODUS_WATCHER_STATS");
+    int report_batches = stats_env && *stats_env && strcmp(stats_env, "0") != 0;
+    WatcherBatch batch;
 
     while (keep_running) {
-        ssize_t len = read(inotify_fd, buffer, sizeof(buffer));
-        if (len <= 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                usleep(250000); // 250ms sleep
-                continue; 
+        // Wake up regularly so coalescing windows and stale moves expire on time
+        int ready = poll(&pfd, 1, COALESCE_POLL_MS);
+
+        time_t now = time(NULL);
+        pthread_mutex_lock(&pending_move_mutex);
+        process_stale_moves_locked(now);
+        pthread_mutex_unlock(&pending_move_mutex);
+
+        if (ready <= 0) {
+            if (ready < 0 && errno != EINTR && keep_running) {
+                perror("[Watcher] poll error");
+                usleep(100000);
             }
-            
+            flush_pending_events(0);
+            continue;
+        }
 
-            if (errno == EINTR) {
+        ssize_t len = read(inotify_fd, buffer, sizeof(buffer));
+        if (len <= 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                flush_pending_events(0);
                 continue;
             }
 
-
             if (keep_running) {
                  perror("[Watcher] read error");
             }
@@ -1472,22 +3341,45 @@ void* watcher_thread_func(void* arg) {
             continue;
         }
 
-        time_t now = time(NULL);
-        pthread_mutex_lock(&pending_move_mutex);
-        process_stale_moves_locked(now);
-        pthread_mutex_unlock(&pending_move_mutex);
+        watcher_batch_begin(&batch);
+        uid_cache_revalidate(&batch);
 
         ssize_t i = 0;
         while (i < len) {
             struct inotify_event* event = (struct inotify_event*)&buffer[i];
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were lost; apply what we have and rebuild the indexes from disk
+                fprintf(stderr, "[Watcher] Event queue overflowed, re-indexing nodes.\n");
+                flush_pending_events(1);
+                regenerate_all_contents();
+                i += sizeof(struct inotify_event) + event->len;
+                continue;
+            }
             
-            // Find the path and node associated with this event's watch descriptor
-            pthread_mutex_lock(&wd_map_mutex);
+            // Find the path and node associated with this event's watch descriptor.
+            // Work on a copy: the entry can be freed once the lock is dropped.
+            // The owner is looked up under the lock, while the entry's dir_fd is valid.
+            WatchDescriptorMap map_copy;
             WatchDescriptorMap* map_entry = NULL;
-            for (WatchDescriptorMap* current = wd_map_head; current; current = current->next) {
-                if (current->wd == event->wd) {
-                    map_entry = current;
-                    break;
+            char event_full_path[PATH_MAX];
+            int ignored = 0;
+            uid_t event_uid = (uid_t)-1;
+            pthread_mutex_lock(&wd_map_mutex);
+            WatchDescriptorMap* found = wd_table_find_locked(event->wd);
+            if (found) {
+                map_copy.wd = found->wd;
+                map_copy.parent_node = found->parent_node;
+                strcpy(map_copy.path, found->path);
+                map_entry = &map_copy;
+                if (event->len > 0) {
+                    snprintf(event_full_path, sizeof(event_full_path), "%s/%s", found->path, event->name);
+                    // Ignore events from our own log directory
+                    ignored = strstr(event_full_path, "/.log") != NULL;
+                    if (!ignored) {
+                        batch.events++;
+                        event_uid = watcher_event_uid_locked(found, event, &batch);
+                    }
                 }
             }
             pthread_mutex_unlock(&wd_map_mutex);
@@ -1495,38 +3387,27 @@ void* watcher_thread_func(void* arg) {
             if (map_entry) {
                 // We only process events with a name.
                 if (event->len > 0) {
-                    char event_full_path[PATH_MAX];
-                    snprintf(event_full_path, sizeof(event_full_path), "%s/%s", map_entry->path, event->name);
-                    
-                    // Ignore events from our own log directory
-                    if (strstr(event_full_path, "/.log")) {
+                    if (ignored) {
                         i += sizeof(struct inotify_event) + event->len;
                         continue;
                     }
                     
                     const char* relative_path = event_full_path + strlen(map_entry->parent_node->path) + 1;
-
-                    uid_t event_uid = (uid_t)-1;
-                    if (event->mask & (IN_CREATE | IN_MOVED_TO | IN_MODIFY)) {
-                        // File exists, stat it
-                        event_uid = get_uid_for_path(event_full_path);
-                    } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
-                        // File is gone, stat the parent directory
-                        event_uid = get_uid_for_path(map_entry->path);
-                    }
+                    int is_dir = (event->mask & IN_ISDIR) != 0;
 
                     char event_user[64] = "unknown";
                     if (event_uid != (uid_t)-1) {
-                        get_username_from_uid(event_uid, event_user, sizeof(event_user));
+                        uid_cache_lookup(event_uid, event_user, sizeof(event_user), &batch);
                     }
 
                     if (event->mask & IN_MOVED_FROM) {
-                        PendingMove* new_move = malloc(sizeof(PendingMove));
+                        PendingMove* new_move = calloc(1, sizeof(PendingMove));
                         if (new_move) {
                             new_move->cookie = event->cookie;
                             strncpy(new_move->from_path, relative_path, sizeof(new_move->from_path) - 1);
                             new_move->from_node = map_entry->parent_node;
                             new_move->timestamp = now;
+                            new_move->is_dir = is_dir;
                             strncpy(new_move->user, event_user, sizeof(new_move->user) - 1);
     
                             pthread_mutex_lock(&pending_move_mutex);
@@ -1549,21 +3430,27 @@ void* watcher_thread_func(void* arg) {
                             PendingMove* entry = *pptr;
                             if (entry->cookie == event->cookie) {
                                 // We found the matching IN_MOVED_FROM! This is a rename/move.
-                                
-                                // Create JSON details: {"from": "old_path", "to": "new_path"}
-                                ctz_json_value* details_obj = ctz_json_new_object();
-                                ctz_json_object_set_value(details_obj, "from", ctz_json_new_string(entry->from_path));
-                                ctz_json_object_set_value(details_obj, "to", ctz_json_new_string(relative_path));
-                                char* details_str = ctz_json_stringify(details_obj, 0);
-                                
-                                // Log it as ONE event
-                                add_event_to_node(map_entry->parent_node, EV_MOVED, relative_path, event_user, details_str);
-                                
-                                if (details_str) free(details_str);
-                                ctz_json_free(details_obj);
+                                if (entry->from_node == map_entry->parent_node) {
+                                    // Create JSON details: {"from": "old_path", "to": "new_path"}
+                                    ctz_json_value* details_obj = ctz_json_new_object();
+                                    ctz_json_object_set_value(details_obj, "from", ctz_json_new_string(entry->from_path));
+                                    ctz_json_object_set_value(details_obj, "to", ctz_json_new_string(relative_path));
+                                    char* details_str = ctz_json_stringify(details_obj, 0);
+
+                                    // Log it as ONE event
+                                    queue_node_event(map_entry->parent_node, EV_MOVED, relative_path, entry->from_path,
+                                                     event_user, details_str, is_dir);
+
+                                    if (details_str) free(details_str);
+                                    ctz_json_free(details_obj);
+                                } else {
+                                    // Moved between nodes: gone from one, new in the other
+                                    queue_node_event(entry->from_node, EV_DELETED, entry->from_path, NULL, entry->user, NULL, entry->is_dir);
+                                    queue_node_event(map_entry->parent_node, EV_CREATED, relative_path, NULL, event_user, NULL, is_dir);
+                                }
     
                                 // If it's a new directory, add watches for it
-                                if (event->mask & IN_ISDIR) {
+                                if (is_dir) {
                                     add_watches_recursively(map_entry->parent_node, event_full_path);
                                 }
     
@@ -1590,8 +3477,8 @@ void* watcher_thread_func(void* arg) {
                         if (is_file_filtered(event->name, map_entry->parent_node->filter_list_head)) {
                                 // File is filtered. Delete it and log as "Deleted".
                                 unlink(event_full_path);
-                                add_event_to_node(map_entry->parent_node, EV_DELETED, relative_path, event_user, "{\"reason\":\"Filtered\"}");
-                                update_file_cache(event_full_path, NULL); // Remove from cache
+                                queue_node_event(map_entry->parent_node, EV_DELETED, relative_path, NULL, event_user,
+                                                 "{\"reason\":\"Filtered\"}", 0);
                                 
                                 // Skip all other processing for this event
                                 i += sizeof(struct inotify_event) + event->len;
@@ -1600,38 +3487,24 @@ void* watcher_thread_func(void* arg) {
                         }
 
 
-                    if (event->mask & IN_ISDIR) {
+                    if (is_dir) {
                         // Event on a directory
-                        if (event->mask & IN_CREATE) { // MOVED_TO is handled above
-                            add_event_to_node(map_entry->parent_node, EV_CREATED, relative_path, event_user, NULL);
+                        if (event->mask & (IN_CREATE | IN_MOVED_TO)) { // Matched moves are handled above
+                            queue_node_event(map_entry->parent_node, EV_CREATED, relative_path, NULL, event_user, NULL, 1);
                             add_watches_recursively(map_entry->parent_node, event_full_path);
                         } else if (event->mask & IN_DELETE) { // MOVED_FROM is handled above
-                            add_event_to_node(map_entry->parent_node, EV_DELETED, relative_path, event_user, NULL);
+                            queue_node_event(map_entry->parent_node, EV_DELETED, relative_path, NULL, event_user, NULL, 1);
                         }
                     } else {
-                        // Event on a file
-                        if (event->mask & IN_CREATE) { // MOVED_TO is separate now
-                            add_event_to_node(map_entry->parent_node, EV_CREATED, relative_path, event_user, NULL);
-                            char* content = read_file_content(event_full_path);
-                            if (content) {
-                                update_file_cache(event_full_path, content);
-                                free(content);
-                            }
+                        // Event on a file; cache updates happen when the batch is flushed
+                        if (event->mask & (IN_CREATE | IN_MOVED_TO)) { // MOVED_TO here is a move *into* the area
+                            queue_node_event(map_entry->parent_node, EV_CREATED, relative_path, NULL, event_user, NULL, 0);
                         }
                         if (event->mask & IN_DELETE) { // MOVED_FROM is handled above
-                            add_event_to_node(map_entry->parent_node, EV_DELETED, relative_path, event_user, NULL);
-                            update_file_cache(event_full_path, NULL); // Remove from cache
-                        }
-                        if (event->mask & IN_MOVED_TO) { // Fall-through case (move *into* area)
-                            add_event_to_node(map_entry->parent_node, EV_CREATED, relative_path, event_user, NULL);
-                            char* content = read_file_content(event_full_path);
-                            if (content) {
-                                update_file_cache(event_full_path, content);
-                                free(content);
-                            }
+                            queue_node_event(map_entry->parent_node, EV_DELETED, relative_path, NULL, event_user, NULL, 0);
                         }
                         if (event->mask & IN_MODIFY) {
-                            handle_file_modification(map_entry->parent_node, event_full_path, event_user);
+                            queue_node_event(map_entry->parent_node, EV_MODIFIED, relative_path, NULL, event_user, NULL, 0);
                         }
                     }
                 }
@@ -1640,25 +3513,23 @@ void* watcher_thread_func(void* arg) {
             // Handle watch being removed (e.g., directory deleted)
             if (event->mask & IN_IGNORED) {
                 pthread_mutex_lock(&wd_map_mutex);
-                WatchDescriptorMap** pptr = &wd_map_head;
-                while (*pptr) {
-                    WatchDescriptorMap* entry = *pptr;
-                    if (entry->wd == event->wd) {
-                        *pptr = entry->next; // Unlink
-                        free(entry);
-                        break; // Found and removed
-                    }
-                    pptr = &(*pptr)->next;
-                }
+                wd_table_remove_locked(event->wd);
                 pthread_mutex_unlock(&wd_map_mutex);
             }
             i += sizeof(struct inotify_event) + event->len;
         }
+
+        if (report_batches) watcher_batch_report(&batch);
+        flush_pending_events(0);
     }
+
+    // Don't lose the last window on shutdown
+    flush_pending_events(1);
     return NULL;
 }
 
 void free_node_history(WatchedNode* node) {
+    pthread_mutex_lock(&history_mutex);
     NodeEvent* current = node->history_head;
     while (current) {
         NodeEvent* next = current->next;
@@ -1666,7 +3537,7 @@ void free_node_history(WatchedNode* node) {
         current = next;
     }
     node->history_head = NULL;
-    
+    pthread_mutex_unlock(&history_mutex);
 
     free_filter_list(node->filter_list_head);
     node->filter_list_head = NULL;
@@ -1681,82 +3552,29 @@ void add_event_to_node(WatchedNode* node, EventType type, const char* name, cons
     strncpy(new_event->name, name, sizeof(new_event->name) - 1);
     new_event->name[sizeof(new_event->name) - 1] = '\0';
     
-    pthread_mutex_lock(&node_list_mutex);
+    pthread_mutex_lock(&history_mutex);
     new_event->next = node->history_head;
     node->history_head = new_event;
-    pthread_mutex_unlock(&node_list_mutex);
-
-
-    char log_file_path[PATH_MAX];
-    snprintf(log_file_path, sizeof(log_file_path), "%s/.log/history.json", node->path);
-
-    // 1. Load the existing history file, or create a new array if it doesn't exist.
-    ctz_json_value* history_array = ctz_json_load_file(log_file_path, NULL, 0);
-    if (!history_array || ctz_json_get_type(history_array) != CTZ_JSON_ARRAY) {
-        if (history_array) ctz_json_free(history_array); // Free if loading resulted in a non-array
-        history_array = ctz_json_new_array();
-        if (!history_array) {
-            fprintf(stderr, "[Cloud] Failed to create new JSON history array.\n");
-            return;
-        }
-    }
-
-    // 2. Create the new JSON object for this event.
-    ctz_json_value* event_obj = ctz_json_new_object();
-    if (!event_obj) {
-        ctz_json_free(history_array);
-        return;
-    }
-    
-    const char* type_str = (type == EV_CREATED) ? "Created" :
-                           (type == EV_DELETED ? "Deleted" :
-                           (type == EV_MODIFIED ? "Modified" : "Moved"));
-    ctz_json_object_set_value(event_obj, "event", ctz_json_new_string(type_str));
-    ctz_json_object_set_value(event_obj, "name", ctz_json_new_string(name));
-    ctz_json_object_set_value(event_obj, "user", ctz_json_new_string(user ? user : "unknown"));
-
-    if (node->time_format == TIME_REAL) {
-        char time_buf[64];
-        get_real_time_string(time_buf, sizeof(time_buf));
-        ctz_json_object_set_value(event_obj, "timestamp", ctz_json_new_string(time_buf));
-    } else {
-        ctz_json_object_set_value(event_obj, "timestamp", ctz_json_new_number((double)new_event->timestamp));
-    }
-
-    // 3. If details are provided, parse them as a JSON object and add to the event.
-    if (details_json_obj && strlen(details_json_obj) > 2) {
-        char error_buf[128];
-        ctz_json_value* changes_obj = ctz_json_parse(details_json_obj, error_buf, sizeof(error_buf));
-        if (changes_obj) {
-            ctz_json_object_set_value(event_obj, "changes", changes_obj);
-        } else {
-             fprintf(stderr, "[Cloud] Warning: Failed to parse event details JSON: %s\n", error_buf);
-        }
-    }
+    pthread_mutex_unlock(&history_mutex);
 
-    // 4. Add the new event to the main history array.
-    ctz_json_array_push_value(history_array, event_obj);
 
-    // 5. Stringify the entire updated array back to a formatted string.
-    char* json_output = ctz_json_stringify(history_array, 1); // Pretty print enabled
-
-    // 6. Overwrite the log file with the new, correct content.
-    if (json_output) {
-        FILE* f = fopen(log_file_path, "w");
-        if (f) {
-            fprintf(f, "%s", json_output);
-            fclose(f);
-        } else {
-            fprintf(stderr, "[Cloud] CRITICAL: Failed to write to log file %s\n", log_file_path);
+    // Append to the node's journal; history.json is only rewritten on compaction
+    exodus_journal_event_t journal_event = {
+        .type = (exodus_journal_type)type,
+        .timestamp = (int64_t)new_event->timestamp,
+        .time_real = (node->time_format == TIME_REAL),
+        .name = name,
+        .user = user,
+        .details = details_json_obj,
+    };
+    size_t journal_size = 0;
+    if (exodus_journal_append(node->path, &journal_event, &journal_size) != 0) {
+        fprintf(stderr, "[Cloud] CRITICAL: Failed to append event to journal of node '%s'\n", node->name);
+    } else if (journal_size >= EXODUS_JOURNAL_COMPACT_BYTES) {
+        if (exodus_journal_materialize(node->path) != 0) {
+            fprintf(stderr, "[Cloud] Warning: Failed to compact journal of node '%s'\n", node->name);
         }
-        free(json_output); // Free the string created by stringify
     }
-
-    // 7. Clean up the ctz_json value structure.
-    ctz_json_free(history_array);
-    
-    // Re-index the node's file list since something changed
-    generate_node_contents_json(node);
 }
 
 
@@ -1840,7 +3658,7 @@ void send_local_node_list_to_signal(cortez_mesh_t* mesh) {
     ctz_json_value* root_array = ctz_json_new_array();
     if (!root_array) return;
 
-    pthread_mutex_lock(&node_list_mutex);
+    pthread_rwlock_rdlock(&node_list_lock);
     for (WatchedNode* n = watched_nodes_head; n; n = n->next) {
         ctz_json_value* node_obj = ctz_json_new_object();
         ctz_json_object_set_value(node_obj, "name", ctz_json_new_string(n->name));
@@ -1848,7 +3666,7 @@ void send_local_node_list_to_signal(cortez_mesh_t* mesh) {
         ctz_json_object_set_value(node_obj, "tag", ctz_json_new_string(n->tag));
         ctz_json_array_push_value(root_array, node_obj);
     }
-    pthread_mutex_unlock(&node_list_mutex);
+    pthread_rwlock_unlock(&node_list_lock);
 
     char* json_body = ctz_json_stringify(root_array, 0);
     ctz_json_free(root_array);
@@ -1962,9 +3780,7 @@ void handle_incoming_sync_data(const sig_sync_data_t* req) {
         return;
     }
 
-    char local_history_path[PATH_MAX];
-    snprintf(local_history_path, sizeof(local_history_path), "%s/.log/history.json", node->path);
-    ctz_json_value* local_history = ctz_json_load_file(local_history_path, NULL, 0);
+    ctz_json_value* local_history = exodus_journal_load_history(node->path);
 
     // --- 1. Find ONLY the new events to apply ---
     ctz_json_value* events_to_apply = ctz_json_new_array();
@@ -2077,17 +3893,10 @@ void handle_incoming_sync_data(const sig_sync_data_t* req) {
     // --- 3. Save the newly merged and sorted history file ---
     ctz_json_value* merged_history = merge_history_arrays(local_history, remote_history);
     
-    char* json_output = ctz_json_stringify(merged_history, 1); // Pretty-print
-    if (json_output) {
-        FILE* f = fopen(local_history_path, "w");
-        if (f) {
-            fprintf(f, "%s", json_output);
-            fclose(f);
-            printf("[Cloud] Successfully merged and sorted remote history into '%s'.\n", node->name);
-        } else {
-            fprintf(stderr, "[Cloud] CRITICAL: Failed to write merged history file: %s\n", local_history_path);
-        }
-        free(json_output);
+    if (merged_history && exodus_journal_replace(node->path, merged_history) == 0) {
+        printf("[Cloud] Successfully merged and sorted remote history into '%s'.\n", node->name);
+    } else {
+        fprintf(stderr, "[Cloud] CRITICAL: Failed to write merged history for node '%s'\n", node->name);
     }
     
     // --- 4. Clean up ---
@@ -2125,7 +3934,7 @@ void load_nodes() {
         return;
     }
 
-    pthread_mutex_lock(&node_list_mutex);
+    pthread_rwlock_wrlock(&node_list_lock);
     for (size_t i = 0; i < ctz_json_get_object_size(root); i++) {
         const char* name = ctz_json_get_object_key(root, i);
         ctz_json_value* node_obj = ctz_json_get_object_value(root, i);
@@ -2139,6 +3948,7 @@ void load_nodes() {
         new_node->active = 1;
         new_node->time_format = TIME_UNIX; // Default
         new_node->filter_list_head = NULL; // Default
+        new_node->coalesce_ms = COALESCE_DEFAULT_MS;
 
         ctz_json_value* path_val = ctz_json_find_object_value(node_obj, "path");
         if (path_val && ctz_json_get_type(path_val) == CTZ_JSON_STRING) {
@@ -2179,6 +3989,9 @@ void load_nodes() {
                     if (strcmp(line + 5, "Real") == 0) {
                         new_node->time_format = TIME_REAL;
                     }
+                } else if (strncmp(line, "coalesce=", 9) == 0) {
+                    int ms = atoi(line + 9);
+                    if (ms >= 0) new_node->coalesce_ms = ms;
                 } else if (strncmp(line, "filter=", 7) == 0) {
                     free_filter_list(new_node->filter_list_head); // Clear just in case
                     new_node->filter_list_head = NULL;
@@ -2205,17 +4018,17 @@ void load_nodes() {
         new_node->next = watched_nodes_head;
         watched_nodes_head = new_node;
     }
-    pthread_mutex_unlock(&node_list_mutex);
+    pthread_rwlock_unlock(&node_list_lock);
     ctz_json_free(root);
 }
 
 
+// Caller holds node_list_lock (a read lock is enough)
 void save_nodes() {
     FILE* f = fopen(config_file_path, "w");
     if (!f) return;
 
     fprintf(f, "{\n");
-    //pthread_mutex_lock(&node_list_mutex);
     WatchedNode* current = watched_nodes_head;
     while (current) {
         fprintf(f, "  \"%s\": {\n", current->name);
@@ -2227,7 +4040,6 @@ void save_nodes() {
         fprintf(f, "  }%s\n", current->next ? "," : "");
         current = current->next;
     }
-    pthread_mutex_unlock(&node_list_mutex);
     fprintf(f, "}\n");
     fclose(f);
 }
@@ -2236,7 +4048,7 @@ void* stop_guardians_thread(void* arg) {
     (void)arg;
 
     printf("[Cloud] Stopping any active node guardians in background...\n");
-    pthread_mutex_lock(&node_list_mutex);
+    pthread_rwlock_rdlock(&node_list_lock);
     for (WatchedNode* n = watched_nodes_head; n; n = n->next) {
         if (n->is_auto) {
             char username[64];
@@ -2273,181 +4085,162 @@ void* stop_guardians_thread(void* arg) {
             system(command);
         }
     }
-    pthread_mutex_unlock(&node_list_mutex);
+    pthread_rwlock_unlock(&node_list_lock);
     printf("[Cloud] Background guardian stop complete.\n");
     return NULL;
 }
 
 
 
-int main() {
-    signal(SIGINT, int_handler);
-    signal(SIGTERM, int_handler);
-
-    printf("[Cloud] Initializing Cloud & Indexer Daemon...\n");
-    cortez_mesh_t* mesh = cortez_mesh_init(CLOUD_DAEMON_NAME, NULL);
-    if (!mesh) {
-        fprintf(stderr, "[Cloud] Failed to initialize mesh.\n");
-        return 1;
-    }
-
-    char exe_dir[PATH_MAX];
-    if (get_executable_dir(exe_dir, sizeof(exe_dir)) != 0) {
-        fprintf(stderr, "[Cloud] CRITICAL: Could not determine executable directory. Aborting.\n");
-        cortez_mesh_shutdown(mesh);
-        return 1;
-    }
-
-    strncpy(g_exe_dir, exe_dir, sizeof(g_exe_dir) - 1);
-
-    snprintf(config_file_path, sizeof(config_file_path), "%s/%s", exe_dir, NODE_CONFIG_FILE);
-    printf("[Cloud] Using config file: %s\n", config_file_path);
-
-    printf("[Cloud] Daemon running with PID: %d. Waiting for tasks.\n", cortez_mesh_get_pid(mesh));
-
-    inotify_fd = inotify_init1(IN_NONBLOCK);
-    if (inotify_fd == -1) {
-        perror("[Cloud] Failed to initialize inotify");
-        cortez_mesh_shutdown(mesh);
-        return 1;
-    }
-
+// --- Request worker pool ---
+// The main thread only reads the inbox. Read-only node queries go to a pool
+// of workers so they run side by side; everything else goes to a single
+// control worker, which keeps mutations in the order they arrived.
 
-    load_nodes();
-    pthread_t watcher_thread;
-    if (pthread_create(&watcher_thread, NULL, watcher_thread_func, NULL) != 0) {
-        fprintf(stderr, "[Cloud] Failed to create watcher thread.\n");
-        close(inotify_fd);
-        cortez_mesh_shutdown(mesh);
-        return 1;
+static int request_queue_for(uint16_t msg_type) {
+    switch (msg_type) {
+        case MSG_LIST_NODES:
+        case MSG_VIEW_NODE:
+        case MSG_INFO_NODE:
+        case MSG_SEARCH_ATTR:
+        case MSG_LOOKUP_ITEM:
+            return REQUEST_QUEUE_QUERY;
+        default:
+            return REQUEST_QUEUE_CONTROL;
     }
+}
 
-    printf("[Cloud] Stopping any Independent Nodes...\n");
-    pthread_t stop_thread;
-    if (pthread_create(&stop_thread, NULL, stop_guardians_thread, NULL) != 0) {
-        fprintf(stderr, "[Cloud] Warning: Failed to create guardian-stopper thread.\n");
-    } else {
-        pthread_join(stop_thread, NULL);
-        printf("[Cloud] Guardian stop sequence finished.\n");
-    }
+static void handle_request(cortez_mesh_t* mesh, const CloudRequest* req);
 
-    char signal_daemon_path[PATH_MAX];
-    snprintf(signal_daemon_path, sizeof(signal_daemon_path), "%s/exodus-signal", g_exe_dir);
+static void* request_worker_func(void* arg) {
+    RequestQueue* q = arg;
+    for (;;) {
+        pthread_mutex_lock(&q->mutex);
+        while (!q->head && !q->closing) {
+            pthread_cond_wait(&q->cond, &q->mutex);
+        }
+        CloudRequest* req = q->head;
+        if (!req) { // Closing and drained
+            pthread_mutex_unlock(&q->mutex);
+            break;
+        }
+        q->head = req->next;
+        if (!q->head) q->tail = NULL;
+        q->depth--;
+        pthread_mutex_unlock(&q->mutex);
 
-    g_signal_daemon_pid = fork();
-    if (g_signal_daemon_pid == 0) {
-        // Child process
-        printf("[Cloud] Launching child process: %s\n", signal_daemon_path);
-        execl(signal_daemon_path, "exodus-signal", (char*)NULL);
-        perror("[Cloud] FATAL: execl exodus-signal failed");
-        exit(1);
-    } else if (g_signal_daemon_pid < 0) {
-        perror("[Cloud] FATAL: fork for exodus-signal failed");
-        g_signal_daemon_pid = 0;
-        fprintf(stderr, "[Cloud] WARNING: Network features will be disabled.\n");
-    } else {
-        printf("[Cloud] Started exodus-signal process with PID: %d\n", g_signal_daemon_pid);
+        handle_request(g_mesh, req);
+        free(req);
     }
+    return NULL;
+}
 
-    printf("[Cloud] Activating watches for all loaded nodes...\n");
-    pthread_mutex_lock(&node_list_mutex);
-    for (WatchedNode* n = watched_nodes_head; n; n = n->next) {
-        if (n->active) {
-            printf("[Cloud] ...resuming surveillance for node '%s' at %s\n", n->name, n->path);
-            // This function adds the inotify watches
-            add_watches_recursively(n, n->path);
-            
-            // This re-generates the contents.json so the 'look' command works immediately
-            generate_node_contents_json(n);
+// Watched directories keep an O_PATH fd, so lift the soft limit to the hard
+// one and size the dir_fd budget from it, leaving WATCH_FD_HEADROOM free.
+// Watches past the budget still work, just without the fd.
+static void raise_fd_limit(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0) return;
+    if (rl.rlim_cur < rl.rlim_max) {
+        rlim_t soft = rl.rlim_cur;
+        rl.rlim_cur = rl.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &rl) != 0) {
+            fprintf(stderr, "[Cloud] Could not raise the open file limit: %s\n", strerror(errno));
+            rl.rlim_cur = soft;
         }
     }
-    pthread_mutex_unlock(&node_list_mutex);
-    printf("[Cloud] Initial surveillance activation complete.\n");
-
-    send_local_node_list_to_signal(mesh);
-
-    while (keep_running) {
-        cortez_msg_t* msg = cortez_mesh_read(mesh, 1000); // 1-second timeout
-        if (!msg) continue;
+    rlim_t budget = rl.rlim_cur > WATCH_FD_HEADROOM ? rl.rlim_cur - WATCH_FD_HEADROOM : 0;
+    wd_dir_fd_budget = budget < WATCH_DIR_FD_MAX ? (size_t)budget : WATCH_DIR_FD_MAX;
+}
 
-        pid_t sender_pid = cortez_msg_sender_pid(msg);
-        uint16_t msg_type = cortez_msg_type(msg);
+static int request_workers_from_env(void) {
+    const char* env = getenv("EXODUS_CLOUD_WORKERS");
+    if (!env || !*env) return REQUEST_WORKERS_DEFAULT;
+    char* end = NULL;
+    long n = strtol(env, &end, 10);
+    if (end == env || *end != '\0' || n < 1 || n > REQUEST_WORKERS_MAX) {
+        fprintf(stderr, "[Cloud] Ignoring invalid EXODUS_CLOUD_WORKERS='%s'\n", env);
+        return REQUEST_WORKERS_DEFAULT;
+    }
+    return (int)n;
+}
 
-        if (sender_pid == g_signal_daemon_pid) {
-            switch (msg_type) {
-                case MSG_SIG_RESPONSE_UNIT_LIST:
-                case MSG_SIG_RESPONSE_VIEW_UNIT:
-                case MSG_SIG_RESPONSE_VIEW_CACHE:
-                case MSG_SIG_RESPONSE_RESOLVE_UNIT:
-                case MSG_SIG_RELOAD_CONFIG:
-                case MSG_OPERATION_ACK:
-                {
-                    printf("[Cloud] Received response from signal, forwarding to query daemon.\n");
-                    pid_t query_daemon_pid = cortez_mesh_find_peer_by_name(mesh, QUERY_DAEMON_NAME);
-                    if (query_daemon_pid > 0) {
-                        // Forward the *entire* payload, which includes the request_id
-                        write_to_handle_and_commit(mesh, query_daemon_pid, msg_type, 
-                                                   cortez_msg_payload(msg), 
-                                                   cortez_msg_payload_size(msg));
-                    } else {
-                        fprintf(stderr, "[Cloud] Cannot find query_daemon to forward response!\n");
-                    }
-                    break;
-                }
-                case MSG_SIG_SYNC_DATA:
-                    handle_incoming_sync_data((const sig_sync_data_t*)cortez_msg_payload(msg));
-                    break;
-                case MSG_SIG_STATUS_UPDATE: {
-                    const sig_status_update_t* status = (const sig_status_update_t*)cortez_msg_payload(msg);
-                    if (cortez_msg_payload_size(msg) == sizeof(sig_status_update_t)) {
-                        printf("[Cloud] Signal Status Update: %s to %s\n", 
-                               status->connected ? "Connected" : "Disconnected", 
-                               status->coordinator_url);
-                    }
-                    break;
-                }
+static int start_request_workers(cortez_mesh_t* mesh) {
+    g_mesh = mesh;
+    int counts[REQUEST_QUEUE_COUNT] = { [REQUEST_QUEUE_QUERY] = request_workers_from_env(), [REQUEST_QUEUE_CONTROL] = 1 };
+    const char* names[REQUEST_QUEUE_COUNT] = { [REQUEST_QUEUE_QUERY] = "query", [REQUEST_QUEUE_CONTROL] = "control" };
+
+    for (int i = 0; i < REQUEST_QUEUE_COUNT; i++) {
+        RequestQueue* q = &request_queues[i];
+        memset(q, 0, sizeof(*q));
+        q->name = names[i];
+        pthread_mutex_init(&q->mutex, NULL);
+        pthread_cond_init(&q->cond, NULL);
+        q->threads = calloc((size_t)counts[i], sizeof(pthread_t));
+        if (!q->threads) return -1;
+        for (int t = 0; t < counts[i]; t++) {
+            if (pthread_create(&q->threads[t], NULL, request_worker_func, q) != 0) {
+                fprintf(stderr, "[Cloud] Failed to start %s worker %d.\n", q->name, t);
+                break;
             }
-            cortez_mesh_msg_release(mesh, msg);
-            continue; // Skip rest of loop
-        }
-
-        if (msg_type == MSG_PING) {
-             printf("[Cloud] Received PING request from client %d\n", sender_pid);
-             // Echo back to sender (wrapper handles routing)
-             const void* wrapped_payload = cortez_msg_payload(msg);
-             uint32_t wrapped_payload_size = cortez_msg_payload_size(msg);
-             
-             // Extract request ID to send back proper wrapped response
-             if (wrapped_payload_size >= sizeof(uint64_t)) {
-                 uint64_t request_id;
-                 memcpy(&request_id, wrapped_payload, sizeof(uint64_t));
-                 
-                 // We just echo the payload back (excluding req id which send_wrapped_response_zc adds)
-                 const void* actual_payload = (const char*)wrapped_payload + sizeof(uint64_t);
-                 uint32_t actual_payload_size = wrapped_payload_size - sizeof(uint64_t);
-                 
-                 send_wrapped_response_zc(mesh, sender_pid, MSG_PING, request_id, actual_payload, actual_payload_size);
-             }
-             cortez_mesh_msg_release(mesh, msg);
-             continue;
+            q->thread_count++;
         }
+        if (q->thread_count == 0) return -1;
+    }
+    printf("[Cloud] Request workers: %d query, %d control.\n",
+           request_queues[REQUEST_QUEUE_QUERY].thread_count, request_queues[REQUEST_QUEUE_CONTROL].thread_count);
+    return 0;
+}
 
-        if (msg_type == MSG_TERMINATE) {
-            printf("[Cloud] Termination signal received.\n");
-            keep_running = 0;
-        } else if (cortez_msg_payload_size(msg) < sizeof(uint64_t)) {
+// Copies the message out of the inbox and queues it for its worker.
+static void enqueue_request(const cortez_msg_t* msg) {
+    uint32_t size = cortez_msg_payload_size(msg);
+    CloudRequest* req = malloc(sizeof(CloudRequest) + size);
+    if (!req) {
+        fprintf(stderr, "[Cloud] Out of memory, dropping request (type %d).\n", cortez_msg_type(msg));
+        return;
+    }
+    req->msg_type = cortez_msg_type(msg);
+    req->sender_pid = cortez_msg_sender_pid(msg);
+    req->size = size;
+    req->next = NULL;
+    memcpy(req->data, cortez_msg_payload(msg), size);
+
+    RequestQueue* q = &request_queues[request_queue_for(req->msg_type)];
+    pthread_mutex_lock(&q->mutex);
+    if (q->tail) q->tail->next = req;
+    else q->head = req;
+    q->tail = req;
+    q->depth++;
+    pthread_cond_signal(&q->cond);
+    pthread_mutex_unlock(&q->mutex);
+}
 
-            fprintf(stderr, "[Cloud] Received malformed (too small) request, ignoring.\n");
+// Lets the workers finish what is queued, then joins them.
+static void stop_request_workers(void) {
+    for (int i = 0; i < REQUEST_QUEUE_COUNT; i++) {
+        RequestQueue* q = &request_queues[i];
+        pthread_mutex_lock(&q->mutex);
+        q->closing = 1;
+        pthread_cond_broadcast(&q->cond);
+        pthread_mutex_unlock(&q->mutex);
+    }
+    for (int i = 0; i < REQUEST_QUEUE_COUNT; i++) {
+        RequestQueue* q = &request_queues[i];
+        for (int t = 0; t < q->thread_count; t++) pthread_join(q->threads[t], NULL);
+        free(q->threads);
+        q->threads = NULL;
+        q->thread_count = 0;
+    }
+}
 
-        }else{
-        
-        const void* wrapped_payload = cortez_msg_payload(msg);
-        uint32_t wrapped_payload_size = cortez_msg_payload_size(msg);
-        if (wrapped_payload_size < sizeof(uint64_t)) {
-            fprintf(stderr, "[Cloud] Received malformed (too small) request, ignoring.\n");
-            cortez_mesh_msg_release(mesh, msg);
-            continue;
-        }
+// Runs one mesh request on a worker thread. req->data holds the wrapped
+// payload exactly as received (request id followed by the request body).
+static void handle_request(cortez_mesh_t* mesh, const CloudRequest* req) {
+        pid_t sender_pid = req->sender_pid;
+        uint16_t msg_type = req->msg_type;
+        const void* wrapped_payload = req->data;
+        uint32_t wrapped_payload_size = req->size;
 
         uint64_t request_id;
         memcpy(&request_id, wrapped_payload, sizeof(uint64_t));
@@ -2459,26 +4252,18 @@ int main() {
         strncpy(ack.details, "Operation successful.", sizeof(ack.details)-1);
 
 
-        switch (cortez_msg_type(msg)) {
+        switch (msg_type) {
             case MSG_UPLOAD_FILE: {
                 const char* file_path = payload;
 
                 // Store the file path
                 strncpy(last_uploaded_file_path, file_path, sizeof(last_uploaded_file_path) - 1);
                 printf("[Cloud] Received upload request for: %s\n", file_path);
-                FILE* f = fopen(file_path, "rb");
-                if (f) {
-                    fseek(f, 0, SEEK_END);
-                    long f_size = ftell(f);
-                    fseek(f, 0, SEEK_SET);
-                    free(file_content);
-                    file_content = malloc(f_size + 1);
-                    if (file_content) {
-                        file_size = fread(file_content, 1, f_size, f);
-                        file_content[file_size] = '\0';
-                        build_index();
+                if (map_uploaded_file(file_path) == 0) {
+                    if (build_index() != 0) {
+                        ack.success = 0;
+                        snprintf(ack.details, sizeof(ack.details), "File changed while indexing: %s", file_path);
                     }
-                    fclose(f);
                 } else {
                     ack.success = 0;
                     snprintf(ack.details, sizeof(ack.details), "Failed to open file: %s", file_path);
@@ -2491,51 +4276,22 @@ case MSG_QUERY_WORD: {
         const char* word = payload;
         printf("[Cloud] Received query for word: %s\n", word);
         
-        WordIndex* entry = index_head;
-        while (entry != NULL) {
-            if (strcmp(entry->word, word) == 0) break;
-            entry = entry->next;
+        WordEntry* entry = word_index_find(word);
+        QueryResponse q = { .entry = entry, .word = word };
+
+        if (entry && with_mapping_guard(build_query_response, &q) != 0) {
+            // The file was truncated under us: answer as if the word is gone
+            fprintf(stderr, "[Cloud] %s was truncated; dropping its index.\n", last_uploaded_file_path);
+            free(q.resp);
+            free_index();
+            release_uploaded_file();
+            entry = NULL;
         }
 
         if (entry) {
-            // Calculate total size for response
-            int num_sentences_to_send = 0;
-            size_t sentences_total_len = 0;
-            WordOccurrence* occ = entry->occurrences;
-            while(occ && num_sentences_to_send < MAX_SENTENCES) {
-                const char* sentence_end = strpbrk(occ->sentence_start, ".!?");
-                size_t len = sentence_end ? (sentence_end - occ->sentence_start + 1) : strlen(occ->sentence_start);
-                if (len > MAX_SENTENCE_LEN - 1) len = MAX_SENTENCE_LEN - 1;
-                sentences_total_len += len + 1; // +1 for null terminator
-                num_sentences_to_send++;
-                occ = occ->next;
-            }
-            
-            size_t total_resp_size = sizeof(query_response_t) + sentences_total_len;
-            query_response_t* resp = malloc(total_resp_size);
-            if (!resp) { /* handle error */ break; }
-
-            resp->count = entry->count;
-            strncpy(resp->word, word, MAX_WORD_LEN - 1);
-            resp->num_sentences = num_sentences_to_send;
-
-            char* current_sentence_ptr = resp->sentences;
-            occ = entry->occurrences;
-            int i = 0;
-            while(occ && i < num_sentences_to_send) {
-                const char* sentence_end = strpbrk(occ->sentence_start, ".!?");
-                size_t len = sentence_end ? (sentence_end - occ->sentence_start + 1) : strlen(occ->sentence_start);
-                if (len > MAX_SENTENCE_LEN - 1) len = MAX_SENTENCE_LEN - 1;
-                
-                memcpy(current_sentence_ptr, occ->sentence_start, len);
-                current_sentence_ptr[len] = '\0';
-                current_sentence_ptr += len + 1;
-                i++;
-                occ = occ->next;
-            }
-
-            send_wrapped_response_zc(mesh, sender_pid, MSG_QUERY_RESPONSE, request_id, resp, total_resp_size);
-            free(resp);
+            if (!q.resp) { /* handle error */ break; }
+            send_wrapped_response_zc(mesh, sender_pid, MSG_QUERY_RESPONSE, request_id, q.resp, q.size);
+            free(q.resp);
 
         } else { // Word not found
             query_response_t resp = {0};
@@ -2547,11 +4303,6 @@ case MSG_QUERY_WORD: {
 
 case MSG_CHANGE_WORD: {
     ack_t ack = {.success = 0};
-    char* current_content = NULL;
-    char* new_content = NULL;
-    FILE* original_file = NULL;
-    FILE* temp_file = NULL;
-    char temp_file_path[PATH_MAX + 4] = {0};
 
     if (payload_size < sizeof(change_word_req_t)) {
         snprintf(ack.details, sizeof(ack.details), "Invalid payload size for change request.");
@@ -2566,117 +4317,29 @@ case MSG_CHANGE_WORD: {
         break;
     }
 
-    original_file = fopen(last_uploaded_file_path, "rb");
-    if (!original_file) {
-        snprintf(ack.details, sizeof(ack.details), "Error: Could not open source file for reading.");
-        send_wrapped_response_zc(mesh, sender_pid, MSG_OPERATION_ACK, request_id, &ack, sizeof(ack));
-        break;
-    }
-
-    fseek(original_file, 0, SEEK_END);
-    long current_size = ftell(original_file);
-    fseek(original_file, 0, SEEK_SET);
-
-    current_content = malloc(current_size + 1);
-    if (!current_content) {
-        fclose(original_file);
-        snprintf(ack.details, sizeof(ack.details), "Error: Memory allocation failed for file buffer.");
-        send_wrapped_response_zc(mesh, sender_pid, MSG_OPERATION_ACK, request_id, &ack, sizeof(ack));
-        break;
-    }
-
-    if (fread(current_content, 1, current_size, original_file) != (size_t)current_size) {
-        fclose(original_file);
-        free(current_content);
-        snprintf(ack.details, sizeof(ack.details), "Error: Failed to read source file content.");
-        send_wrapped_response_zc(mesh, sender_pid, MSG_OPERATION_ACK, request_id, &ack, sizeof(ack));
-        break;
-    }
-    current_content[current_size] = '\0';
-    fclose(original_file);
-    original_file = NULL;
-
     long occurrences = 0;
-    const char* temp_ptr = current_content;
-    size_t target_len = strnlen(req->target_word, MAX_WORD_LEN);
-    if (target_len == 0) {
-        free(current_content);
-        snprintf(ack.details, sizeof(ack.details), "Error: Target word cannot be empty.");
+    const char* error = rewrite_uploaded_file(last_uploaded_file_path, req->target_word, req->new_word, &occurrences);
+    if (error) {
+        snprintf(ack.details, sizeof(ack.details), "%s", error);
         send_wrapped_response_zc(mesh, sender_pid, MSG_OPERATION_ACK, request_id, &ack, sizeof(ack));
         break;
     }
 
-    while ((temp_ptr = strstr(temp_ptr, req->target_word))) {
-        occurrences++;
-        temp_ptr += target_len;
-    }
-
     if (occurrences == 0) {
-        free(current_content);
         ack.success = 1;
         snprintf(ack.details, sizeof(ack.details), "Target word not found. No changes made.");
         send_wrapped_response_zc(mesh, sender_pid, MSG_OPERATION_ACK, request_id, &ack, sizeof(ack));
         break;
     }
 
-    size_t new_word_len = strnlen(req->new_word, MAX_WORD_LEN);
-    long new_size = current_size + occurrences * (new_word_len - target_len);
-    
-    new_content = malloc(new_size + 1);
-    if (!new_content) {
-        free(current_content);
-        snprintf(ack.details, sizeof(ack.details), "Error: Memory allocation failed for new content.");
-        send_wrapped_response_zc(mesh, sender_pid, MSG_OPERATION_ACK, request_id, &ack, sizeof(ack));
-        break;
-    }
-
-    char* current_pos = current_content;
-    char* new_pos = new_content;
-    char* occurrence;
-    while ((occurrence = strstr(current_pos, req->target_word))) {
-        ptrdiff_t len = occurrence - current_pos;
-        memcpy(new_pos, current_pos, len);
-        new_pos += len;
-        memcpy(new_pos, req->new_word, new_word_len);
-        new_pos += new_word_len;
-        current_pos = occurrence + target_len;
-    }
-    strcpy(new_pos, current_pos);
-    free(current_content);
-    current_content = NULL;
-
-    snprintf(temp_file_path, sizeof(temp_file_path), "%s.tmp", last_uploaded_file_path);
-    temp_file = fopen(temp_file_path, "wb");
-    if (!temp_file) {
-        free(new_content);
-        snprintf(ack.details, sizeof(ack.details), "Error: Could not create temporary file for writing.");
-        send_wrapped_response_zc(mesh, sender_pid, MSG_OPERATION_ACK, request_id, &ack, sizeof(ack));
-        break;
-    }
-
-    if (fwrite(new_content, 1, new_size, temp_file) != (size_t)new_size) {
-        fclose(temp_file);
-        remove(temp_file_path);
-        free(new_content);
-        snprintf(ack.details, sizeof(ack.details), "Error: Failed to write to temporary file.");
-        send_wrapped_response_zc(mesh, sender_pid, MSG_OPERATION_ACK, request_id, &ack, sizeof(ack));
-        break;
-    }
-    fclose(temp_file);
-
-    if (rename(temp_file_path, last_uploaded_file_path) != 0) {
-        remove(temp_file_path);
-        free(new_content);
-        snprintf(ack.details, sizeof(ack.details), "Error: Failed to replace original file.");
-        send_wrapped_response_zc(mesh, sender_pid, MSG_OPERATION_ACK, request_id, &ack, sizeof(ack));
-        break;
+    free_index();
+    if (map_uploaded_file(last_uploaded_file_path) == 0) {
+        build_index();
+    } else {
+        release_uploaded_file();
+        fprintf(stderr, "[Cloud] Could not re-map %s after rewriting it.\n", last_uploaded_file_path);
     }
 
-    free(file_content);
-    file_content = new_content;
-    file_size = new_size;
-    build_index();
-
     ack.success = 1;
     snprintf(ack.details, sizeof(ack.details), "File updated successfully. %ld occurrences changed.", occurrences);
     send_wrapped_response_zc(mesh, sender_pid, MSG_OPERATION_ACK, request_id, &ack, sizeof(ack));
@@ -2685,48 +4348,21 @@ case MSG_CHANGE_WORD: {
 
     case MSG_WORD_COUNT: {
         printf("[Cloud] Received word count request.\n");
-        long count = 0;
-        if(file_content) {
-            char* content_copy = strdup(file_content);
-            char* token = strtok(content_copy, " \t\n\r");
-            while(token) {
-                count++;
-                token = strtok(NULL, " \t\n\r");
-            }
-            free(content_copy);
-        }
-        count_response_t resp = {count};
+        count_response_t resp = {word_index.words}; // Counted while indexing
         send_wrapped_response_zc(mesh, sender_pid, MSG_COUNT_RESPONSE, request_id, &resp, sizeof(resp));
         break;
     }
 
     case MSG_LINE_COUNT: {
         printf("[Cloud] Received line count request.\n");
-        long count = 0;
-        if(file_content) {
-            for(size_t i = 0; i < file_size; i++) {
-                if(file_content[i] == '\n') {
-                    count++;
-                }
-            }
-            if(file_size > 0) count++; // Count last line if no trailing newline
-        }
-        count_response_t resp = {count};
+        count_response_t resp = {word_index.lines};
         send_wrapped_response_zc(mesh, sender_pid, MSG_COUNT_RESPONSE, request_id, &resp, sizeof(resp));
         break;
     }
     
     case MSG_CHAR_COUNT: {
         printf("[Cloud] Received char count request.\n");
-        long count = 0;
-        if(file_content) {
-            for(size_t i = 0; i < file_size; i++) {
-                if(!isspace((unsigned char)file_content[i])) {
-                    count++;
-                }
-            }
-        }
-        count_response_t resp = {count};
+        count_response_t resp = {word_index.chars};
         send_wrapped_response_zc(mesh, sender_pid, MSG_COUNT_RESPONSE, request_id, &resp, sizeof(resp));
         break;
     }
@@ -2747,15 +4383,16 @@ case MSG_CHANGE_WORD: {
                     strncpy(new_node->path, req->path, sizeof(new_node->path) - 1);
                     new_node->active = 1;
                     new_node->history_head = NULL;
+                    new_node->coalesce_ms = COALESCE_DEFAULT_MS;
                     
-                    pthread_mutex_lock(&node_list_mutex);
+                    pthread_rwlock_wrlock(&node_list_lock);
                     new_node->next = watched_nodes_head;
                     watched_nodes_head = new_node;
-                    pthread_mutex_unlock(&node_list_mutex);
+                    pthread_rwlock_unlock(&node_list_lock);
                     
-                    pthread_mutex_lock(&node_list_mutex);
+                    pthread_rwlock_rdlock(&node_list_lock);
                     save_nodes();
-                    pthread_mutex_unlock(&node_list_mutex);
+                    pthread_rwlock_unlock(&node_list_lock);
 
                     initialize_node_log_file(new_node->path);
                     add_watches_recursively(new_node, new_node->path);
@@ -2782,12 +4419,12 @@ case MSG_CHANGE_WORD: {
                 char buffer[4096] = {0};
                 char* current = buffer;
                 int count = 0;
-                pthread_mutex_lock(&node_list_mutex);
+                pthread_rwlock_rdlock(&node_list_lock);
                 for (WatchedNode* n = watched_nodes_head; n; n = n->next) {
                     current += snprintf(current, sizeof(buffer) - (current - buffer), "%s (%s)\n", n->name, n->active ? "active" : "inactive") + 1;
                     count++;
                 }
-                pthread_mutex_unlock(&node_list_mutex);
+                pthread_rwlock_unlock(&node_list_lock);
                 
                 size_t payload_size = sizeof(list_resp_t) + (current - buffer);
                 list_resp_t* resp = malloc(payload_size);
@@ -2805,20 +4442,22 @@ case MSG_CHANGE_WORD: {
                 char buffer[8192] = {0}; // Larger buffer for history
                 char* pos = buffer;
                 int count = 0;
-                pthread_mutex_lock(&node_list_mutex);
+                pthread_rwlock_rdlock(&node_list_lock);
                 WatchedNode* node = watched_nodes_head;
                 while (node) {
                     if (strcmp(node->name, req->node_name) == 0) break;
                     node = node->next;
                 }
                 if (node) {
+                    pthread_mutex_lock(&history_mutex);
                     for (NodeEvent* ev = node->history_head; ev; ev = ev->next) {
                         const char* type_str = ev->type == EV_CREATED ? "{Created}" : (ev->type == EV_DELETED ? "{Deleted}" : "{Modified}");
                         pos += snprintf(pos, sizeof(buffer) - (pos-buffer), "%s: \"%s\"\n", type_str, ev->name) + 1;
                         count++;
                     }
+                    pthread_mutex_unlock(&history_mutex);
                 }
-                pthread_mutex_unlock(&node_list_mutex);
+                pthread_rwlock_unlock(&node_list_lock);
                 
                 size_t payload_size = sizeof(list_resp_t) + (pos - buffer);
                 list_resp_t* resp = malloc(payload_size);
@@ -2835,26 +4474,30 @@ case MSG_CHANGE_WORD: {
         case MSG_DEACTIVATE_NODE: {
     const node_req_t* req = payload;
     int found = 0;
-    int is_activating = (cortez_msg_type(msg) == MSG_ACTIVATE_NODE);
-
-    pthread_mutex_lock(&node_list_mutex);
+    int is_activating = (msg_type == MSG_ACTIVATE_NODE);
+
+    // Flip the flag under the lock, then walk the tree outside it: adding
+    // watches also fills the file cache and can take a long time. Node
+    // changes all run on the control worker, so the node cannot be removed
+    // before the walk ends.
+    WatchedNode* changed = NULL;
+    pthread_rwlock_wrlock(&node_list_lock);
     for (WatchedNode* n = watched_nodes_head; n; n = n->next) {
         if (strcmp(n->name, req->node_name) == 0) {
             if (n->active != is_activating) {
                 n->active = is_activating;
-                if (is_activating) {
-
-                    add_watches_recursively(n, n->path);
-                } else {
-
-                    remove_all_watches_for_node(n);
-                }
+                changed = n;
             }
             found = 1;
             break;
         }
     }
-    pthread_mutex_unlock(&node_list_mutex);
+    pthread_rwlock_unlock(&node_list_lock);
+
+    if (changed) {
+        if (is_activating) add_watches_recursively(changed, changed->path);
+        else remove_all_watches_for_node(changed);
+    }
 
     ack.success = found;
     snprintf(ack.details, sizeof(ack.details), "Node '%s' %s.", req->node_name, ack.success ? (is_activating ? "activated" : "deactivated") : "not found");
@@ -2868,7 +4511,7 @@ case MSG_REMOVE_NODE: {
     WatchedNode* node_to_remove = NULL;
 
     // --- Step 1: Find and unlink the node from the list ---
-    pthread_mutex_lock(&node_list_mutex);
+    pthread_rwlock_wrlock(&node_list_lock);
     WatchedNode** pptr = &watched_nodes_head;
     while (*pptr) {
         WatchedNode* entry = *pptr;
@@ -2880,33 +4523,41 @@ case MSG_REMOVE_NODE: {
         }
         pptr = &(*pptr)->next;
     }
-    pthread_mutex_unlock(&node_list_mutex);
+    pthread_rwlock_unlock(&node_list_lock);
 
     // --- Step 2: Perform all slow I/O and cleanup outside the lock ---
     if (node_to_remove) {
 
         remove_all_watches_for_node(node_to_remove);
+        discard_node_events(node_to_remove);
     
         // Delete log files
         char log_dir_path[PATH_MAX];
         char contents_file_path[PATH_MAX];
         char history_file_path[PATH_MAX];
+        char journal_file_path[PATH_MAX];
+        char lock_file_path[PATH_MAX];
         snprintf(log_dir_path, sizeof(log_dir_path), "%s/.log", node_to_remove->path);
         snprintf(contents_file_path, sizeof(contents_file_path), "%s/contents.json", log_dir_path);
-        snprintf(history_file_path, sizeof(history_file_path), "%s/history.json", log_dir_path);
+        snprintf(history_file_path, sizeof(history_file_path), "%s/%s", log_dir_path, EXODUS_HISTORY_FILE);
+        snprintf(journal_file_path, sizeof(journal_file_path), "%s/%s", log_dir_path, EXODUS_JOURNAL_FILE);
+        snprintf(lock_file_path, sizeof(lock_file_path), "%s/history.lock", log_dir_path);
         remove(contents_file_path);
         remove(history_file_path);
+        remove(journal_file_path);
+        remove(lock_file_path);
         rmdir(log_dir_path);
 
         // Free node's own memory
         free_node_history(node_to_remove);
+        free_node_contents(node_to_remove);
         free(node_to_remove);
     }
 
     if (found) {
-        pthread_mutex_lock(&node_list_mutex);
+        pthread_rwlock_rdlock(&node_list_lock);
         save_nodes(); // Update the config file
-        pthread_mutex_unlock(&node_list_mutex);
+        pthread_rwlock_unlock(&node_list_lock);
 
         ack.success = 1;
         snprintf(ack.details, sizeof(ack.details), "Node '%s' removed.", req->node_name);
@@ -2925,7 +4576,7 @@ case MSG_REMOVE_NODE: {
     case MSG_ATTR_NODE: {
             const attr_node_req_t* req = payload;
             int found = 0;
-            pthread_mutex_lock(&node_list_mutex);
+            pthread_rwlock_wrlock(&node_list_lock);
             for (WatchedNode* n = watched_nodes_head; n; n = n->next) {
                 if (strcmp(n->name, req->node_name) == 0) {
                     if (req->flags & ATTR_FLAG_AUTHOR) strncpy(n->author, req->author, MAX_ATTR_LEN - 1);
@@ -2935,12 +4586,12 @@ case MSG_REMOVE_NODE: {
                     break;
                 }
             }
-            pthread_mutex_unlock(&node_list_mutex);
+            pthread_rwlock_unlock(&node_list_lock);
 
             if (found) {
-                pthread_mutex_lock(&node_list_mutex);
+                pthread_rwlock_rdlock(&node_list_lock);
                 save_nodes();
-                pthread_mutex_unlock(&node_list_mutex);
+                pthread_rwlock_unlock(&node_list_lock);
                 snprintf(ack.details, sizeof(ack.details), "Attributes for '%s' updated.", req->node_name);
             } else {
                 ack.success = 0;
@@ -2953,7 +4604,7 @@ case MSG_REMOVE_NODE: {
         case MSG_INFO_NODE: {
             const node_req_t* req = payload;
             info_node_resp_t resp = { .success = 0 };
-            pthread_mutex_lock(&node_list_mutex);
+            pthread_rwlock_rdlock(&node_list_lock);
             memset(&resp, 0, sizeof(resp));
             for (WatchedNode* n = watched_nodes_head; n; n = n->next) {
                 if (strcmp(n->name, req->node_name) == 0) {
@@ -2965,7 +4616,7 @@ case MSG_REMOVE_NODE: {
                     break;
                 }
             }
-            pthread_mutex_unlock(&node_list_mutex);
+            pthread_rwlock_unlock(&node_list_lock);
             send_wrapped_response_zc(mesh, sender_pid, MSG_INFO_NODE_RESPONSE, request_id, &resp, sizeof(resp));
             break;
         }
@@ -2975,7 +4626,7 @@ case MSG_REMOVE_NODE: {
             char buffer[8192] = {0};
             char* current = buffer;
             int count = 0;
-            pthread_mutex_lock(&node_list_mutex);
+            pthread_rwlock_rdlock(&node_list_lock);
             for (WatchedNode* n = watched_nodes_head; n; n = n->next) {
                 int match = 0;
                 if (req->type == SEARCH_BY_AUTHOR && strcmp(n->author, req->target) == 0) match = 1;
@@ -2986,7 +4637,7 @@ case MSG_REMOVE_NODE: {
                     count++;
                 }
             }
-            pthread_mutex_unlock(&node_list_mutex);
+            pthread_rwlock_unlock(&node_list_lock);
 
             size_t payload_size = sizeof(list_resp_t) + (current - buffer);
             list_resp_t* resp = malloc(payload_size);
@@ -3001,47 +4652,20 @@ case MSG_REMOVE_NODE: {
         }
 
     case MSG_LOOKUP_ITEM: {
-                const lookup_req_t* req = payload;
-                char result_buffer[8192] = {0}; // Large buffer for results
-                char* current = result_buffer;
-                int count = 0;
-
-                pthread_mutex_lock(&node_list_mutex);
-                for (WatchedNode* n = watched_nodes_head; n; n = n->next) {
-                    char contents_path[PATH_MAX];
-                    snprintf(contents_path, sizeof(contents_path), "%s/.log/contents.json", n->path);
-
-                    char error_buf[256];
-                    ctz_json_value* contents = ctz_json_load_file(contents_path, error_buf, sizeof(error_buf));
-                    if (contents && ctz_json_get_type(contents) == CTZ_JSON_ARRAY) {
-                        for (size_t i = 0; i < ctz_json_get_array_size(contents); i++) {
-                            ctz_json_value* item = ctz_json_get_array_element(contents, i);
-                            ctz_json_value* name_val = ctz_json_find_object_value(item, "name");
-                            if (name_val && strcmp(ctz_json_get_string(name_val), req->item_name) == 0) {
-                                ctz_json_value* path_val = ctz_json_find_object_value(item, "path");
-                                current += snprintf(current, sizeof(result_buffer) - (current - result_buffer), 
-                                    "'%s' Found in Node '%s' | Path: %s\n", 
-                                    req->item_name, n->name, ctz_json_get_string(path_val)) + 1;
-                                count++;
-                            }
-                        }
-                    }
-                    if (contents) ctz_json_free(contents);
-                }
-                pthread_mutex_unlock(&node_list_mutex);
+                // Older clients send only the name: exact match, first page
+                lookup_req_t req = {0};
+                memcpy(&req, payload, payload_size < sizeof(req) ? payload_size : sizeof(req));
+                req.item_name[sizeof(req.item_name) - 1] = '\0';
 
-                if (count == 0) {
-                    snprintf(current, sizeof(result_buffer) - (current - result_buffer), "'%s' not found in any active node.\n", req->item_name);
-                    current += strlen(current) + 1;
-                }
-                
-                size_t payload_size = sizeof(list_resp_t) + (current - result_buffer);
-                list_resp_t* resp = malloc(payload_size);
+                size_t resp_size = 0;
+                lookup_resp_t* resp = build_lookup_page(&req, &resp_size);
                 if (resp) {
-                    resp->item_count = count;
-                    memcpy(resp->data, result_buffer, (current - result_buffer));
-                    send_wrapped_response_zc(mesh, sender_pid, MSG_LOOKUP_RESPONSE, request_id, resp, payload_size);
+                    send_wrapped_response_zc(mesh, sender_pid, MSG_LOOKUP_RESPONSE, request_id, resp, resp_size);
                     free(resp);
+                } else {
+                    ack.success = 0;
+                    snprintf(ack.details, sizeof(ack.details), "Out of memory while looking up '%s'.", req.item_name);
+                    send_wrapped_response_zc(mesh, sender_pid, MSG_OPERATION_ACK, request_id, &ack, sizeof(ack));
                 }
                 break;
             }
@@ -3165,7 +4789,7 @@ case MSG_REMOVE_NODE: {
                 char found_node[MAX_NODE_NAME_LEN] = {0};
 
                 // Find the first occurrence of the item to pin it
-                pthread_mutex_lock(&node_list_mutex);
+                pthread_rwlock_rdlock(&node_list_lock);
                  for (WatchedNode* n = watched_nodes_head; n && !found; n = n->next) {
                     char contents_path[PATH_MAX];
                     snprintf(contents_path, sizeof(contents_path), "%s/.log/contents.json", n->path);
@@ -3185,7 +4809,7 @@ case MSG_REMOVE_NODE: {
                     }
                     if (contents) ctz_json_free(contents);
                 }
-                pthread_mutex_unlock(&node_list_mutex);
+                pthread_rwlock_unlock(&node_list_lock);
 
                 if (found) {
                     char pin_path[PATH_MAX];
@@ -3273,13 +4897,193 @@ case MSG_REMOVE_NODE: {
 
 
         }
+}
+
+int main() {
+    signal(SIGINT, int_handler);
+    signal(SIGTERM, int_handler);
+
+    struct sigaction bus_action = { .sa_sigaction = mapping_sigbus_handler, .sa_flags = SA_SIGINFO };
+    sigemptyset(&bus_action.sa_mask);
+    sigaction(SIGBUS, &bus_action, NULL);
+
+    printf("[Cloud] Initializing Cloud & Indexer Daemon...\n");
+    cortez_mesh_t* mesh = cortez_mesh_init(CLOUD_DAEMON_NAME, NULL);
+    if (!mesh) {
+        fprintf(stderr, "[Cloud] Failed to initialize mesh.\n");
+        return 1;
+    }
+
+    char exe_dir[PATH_MAX];
+    if (get_executable_dir(exe_dir, sizeof(exe_dir)) != 0) {
+        fprintf(stderr, "[Cloud] CRITICAL: Could not determine executable directory. Aborting.\n");
+        cortez_mesh_shutdown(mesh);
+        return 1;
+    }
+
+    strncpy(g_exe_dir, exe_dir, sizeof(g_exe_dir) - 1);
+
+    snprintf(config_file_path, sizeof(config_file_path), "%s/%s", exe_dir, NODE_CONFIG_FILE);
+    printf("[Cloud] Using config file: %s\n", config_file_path);
+
+    printf("[Cloud] Daemon running with PID: %d. Waiting for tasks.\n", cortez_mesh_get_pid(mesh));
+    file_cache_init_budget();
+    init_node_list_lock();
+    raise_fd_limit();
+
+    inotify_fd = inotify_init1(IN_NONBLOCK);
+    if (inotify_fd == -1) {
+        perror("[Cloud] Failed to initialize inotify");
+        cortez_mesh_shutdown(mesh);
+        return 1;
+    }
+
+
+    load_nodes();
+    start_diff_base_worker();
+    pthread_t watcher_thread;
+    if (pthread_create(&watcher_thread, NULL, watcher_thread_func, NULL) != 0) {
+        fprintf(stderr, "[Cloud] Failed to create watcher thread.\n");
+        close(inotify_fd);
+        cortez_mesh_shutdown(mesh);
+        return 1;
+    }
+
+    printf("[Cloud] Stopping any Independent Nodes...\n");
+    pthread_t stop_thread;
+    if (pthread_create(&stop_thread, NULL, stop_guardians_thread, NULL) != 0) {
+        fprintf(stderr, "[Cloud] Warning: Failed to create guardian-stopper thread.\n");
+    } else {
+        pthread_join(stop_thread, NULL);
+        printf("[Cloud] Guardian stop sequence finished.\n");
+    }
+
+    char signal_daemon_path[PATH_MAX];
+    snprintf(signal_daemon_path, sizeof(signal_daemon_path), "%s/exodus-signal", g_exe_dir);
+
+    g_signal_daemon_pid = fork();
+    if (g_signal_daemon_pid == 0) {
+        // Child process
+        printf("[Cloud] Launching child process: %s\n", signal_daemon_path);
+        execl(signal_daemon_path, "exodus-signal", (char*)NULL);
+        perror("[Cloud] FATAL: execl exodus-signal failed");
+        exit(1);
+    } else if (g_signal_daemon_pid < 0) {
+        perror("[Cloud] FATAL: fork for exodus-signal failed");
+        g_signal_daemon_pid = 0;
+        fprintf(stderr, "[Cloud] WARNING: Network features will be disabled.\n");
+    } else {
+        printf("[Cloud] Started exodus-signal process with PID: %d\n", g_signal_daemon_pid);
+    }
+
+    printf("[Cloud] Activating watches for all loaded nodes...\n");
+    pthread_rwlock_rdlock(&node_list_lock);
+    for (WatchedNode* n = watched_nodes_head; n; n = n->next) {
+        if (n->active) {
+            printf("[Cloud] ...resuming surveillance for node '%s' at %s\n", n->name, n->path);
+            // Fold whatever the last run left in the journal (drops a torn tail)
+            exodus_journal_materialize(n->path);
+            // This function adds the inotify watches
+            add_watches_recursively(n, n->path);
+            
+            // This re-generates the contents.json so the 'look' command works immediately
+            generate_node_contents_json(n);
+        }
+    }
+    pthread_rwlock_unlock(&node_list_lock);
+    printf("[Cloud] Initial surveillance activation complete.\n");
+
+    send_local_node_list_to_signal(mesh);
+
+    if (start_request_workers(mesh) != 0) {
+        fprintf(stderr, "[Cloud] Failed to start request workers.\n");
+        keep_running = 0;
     }
 
+    while (keep_running) {
+        cortez_msg_t* msg = cortez_mesh_read(mesh, 1000); // 1-second timeout
+        if (!msg) continue;
+
+        pid_t sender_pid = cortez_msg_sender_pid(msg);
+        uint16_t msg_type = cortez_msg_type(msg);
+
+        if (sender_pid == g_signal_daemon_pid) {
+            switch (msg_type) {
+                case MSG_SIG_RESPONSE_UNIT_LIST:
+                case MSG_SIG_RESPONSE_VIEW_UNIT:
+                case MSG_SIG_RESPONSE_VIEW_CACHE:
+                case MSG_SIG_RESPONSE_RESOLVE_UNIT:
+                case MSG_SIG_RELOAD_CONFIG:
+                case MSG_OPERATION_ACK:
+                {
+                    printf("[Cloud] Received response from signal, forwarding to query daemon.\n");
+                    pid_t query_daemon_pid = cortez_mesh_find_peer_by_name(mesh, QUERY_DAEMON_NAME);
+                    if (query_daemon_pid > 0) {
+                        // Forward the *entire* payload, which includes the request_id
+                        write_to_handle_and_commit(mesh, query_daemon_pid, msg_type, 
+                                                   cortez_msg_payload(msg), 
+                                                   cortez_msg_payload_size(msg));
+                    } else {
+                        fprintf(stderr, "[Cloud] Cannot find query_daemon to forward response!\n");
+                    }
+                    break;
+                }
+                case MSG_SIG_SYNC_DATA:
+                    handle_incoming_sync_data((const sig_sync_data_t*)cortez_msg_payload(msg));
+                    break;
+                case MSG_SIG_STATUS_UPDATE: {
+                    const sig_status_update_t* status = (const sig_status_update_t*)cortez_msg_payload(msg);
+                    if (cortez_msg_payload_size(msg) == sizeof(sig_status_update_t)) {
+                        printf("[Cloud] Signal Status Update: %s to %s\n", 
+                               status->connected ? "Connected" : "Disconnected", 
+                               status->coordinator_url);
+                    }
+                    break;
+                }
+            }
+            cortez_mesh_msg_release(mesh, msg);
+            continue; // Skip rest of loop
+        }
+
+        if (msg_type == MSG_PING) {
+             printf("[Cloud] Received PING request from client %d\n", sender_pid);
+             // Echo back to sender (wrapper handles routing)
+             const void* wrapped_payload = cortez_msg_payload(msg);
+             uint32_t wrapped_payload_size = cortez_msg_payload_size(msg);
+             
+             // Extract request ID to send back proper wrapped response
+             if (wrapped_payload_size >= sizeof(uint64_t)) {
+                 uint64_t request_id;
+                 memcpy(&request_id, wrapped_payload, sizeof(uint64_t));
+                 
+                 // We just echo the payload back (excluding req id which send_wrapped_response_zc adds)
+                 const void* actual_payload = (const char*)wrapped_payload + sizeof(uint64_t);
+                 uint32_t actual_payload_size = wrapped_payload_size - sizeof(uint64_t);
+                 
+                 send_wrapped_response_zc(mesh, sender_pid, MSG_PING, request_id, actual_payload, actual_payload_size);
+             }
+             cortez_mesh_msg_release(mesh, msg);
+             continue;
+        }
+
+        if (msg_type == MSG_TERMINATE) {
+            printf("[Cloud] Termination signal received.\n");
+            keep_running = 0;
+        } else if (cortez_msg_payload_size(msg) < sizeof(uint64_t)) {
+
+            fprintf(stderr, "[Cloud] Received malformed (too small) request, ignoring.\n");
+
+        } else {
+            // Hand the request to a worker; the inbox slot is released right away
+            enqueue_request(msg);
+        }
+
         cortez_mesh_msg_release(mesh, msg);
     }
 
     printf("[Cloud] Shutting down.\n");
     keep_running = 0; // Signal watcher thread to stop
+    stop_request_workers();
 
     if (g_signal_daemon_pid > 0) {
         printf("[Cloud] Sending termination signal to exodus-signal (PID %d)...\n", g_signal_daemon_pid);
@@ -3292,11 +5096,19 @@ case MSG_REMOVE_NODE: {
     }
 
     pthread_join(watcher_thread, NULL); // Wait for it
+    stop_diff_base_worker(); // The watcher is gone, so nothing else is queued
     close(inotify_fd);
 
+    // Leave a complete history.json behind for the guardians and the CLI
+    pthread_rwlock_rdlock(&node_list_lock);
+    for (WatchedNode* n = watched_nodes_head; n; n = n->next) {
+        exodus_journal_materialize(n->path);
+    }
+    pthread_rwlock_unlock(&node_list_lock);
+
     sleep(1);
     printf("[Cloud] Handing off surveillance to node guardians...\n");
-    pthread_mutex_lock(&node_list_mutex);
+    pthread_rwlock_rdlock(&node_list_lock);
     for (WatchedNode* n = watched_nodes_head; n; n = n->next) {
         if (n->is_auto) {
             char username[64];
@@ -3347,14 +5159,14 @@ case MSG_REMOVE_NODE: {
             }
         }
     }
-    pthread_mutex_unlock(&node_list_mutex);
+    pthread_rwlock_unlock(&node_list_lock);
 
-    pthread_mutex_lock(&node_list_mutex);
+    pthread_rwlock_rdlock(&node_list_lock);
     save_nodes();
-    pthread_mutex_unlock(&node_list_mutex);
+    pthread_rwlock_unlock(&node_list_lock);
 
-    free(file_content);
     free_index();
+    release_uploaded_file();
     cortez_mesh_shutdown(mesh);
     return 0;
 }
\ No newline at end of file
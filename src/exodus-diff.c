@@ -0,0 +1,438 @@
+/*
+ * exodus-diff.c
+ * gcc -Wall -Wextra -O2 -c exodus-diff.c -o exodus-diff.o -Iinclude
+ *
+ * Pipeline:
+ *   1. Intern every line into a class id (FNV-1a hash + length + memcmp).
+ *   2. Lines whose class never occurs on the other side can't be part of
+ *      any common subsequence; they become ADD/DEL directly and are left out
+ *      of the Myers pass. This makes rewrites of whole regions cheap.
+ *   3. Myers' bisection (middle snake) on the remaining class ids, trimming
+ *      common prefixes and suffixes at every level. Workspace is two
+ *      vectors of 2*(N+M) ints, reused by every level of the recursion.
+ *   4. Optional move detection: per-class FIFO of added lines, so each
+ *      removed line finds its partner in O(1).
+ */
+#include "exodus-diff.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// Below this many edit steps the exact search always runs to completion.
+#define DIFF_MIN_COST_LIMIT 256
+
+typedef struct {
+    uint64_t hash;
+    const char* data;
+    size_t len;
+    int class_id;       // -1 marks an empty slot
+} DiffClassSlot;
+
+typedef struct {
+    const int* a;       // Class ids of the old side (reduced)
+    const int* b;       // Class ids of the new side (reduced)
+    int* a_match;       // a index -> matched b index, or -1
+    int* v_fwd;
+    int* v_rev;
+    int cost_limit;
+} DiffContext;
+
+static uint64_t diff_hash_line(const char* data, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)data[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static int diff_isqrt(int n) {
+    int r = 1;
+    while ((long)(r + 1) * (r + 1) <= n) r++;
+    return r;
+}
+
+int exodus_diff_split_lines(char* buf, size_t size, exodus_diff_line** lines_out) {
+    *lines_out = NULL;
+    if (!buf || size == 0) return 0;
+
+    size_t count = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (buf[i] == '\n') count++;
+    }
+    if (buf[size - 1] != '\n') count++;
+    if (count > INT32_MAX) return -1;
+
+    exodus_diff_line* lines = malloc(count * sizeof(exodus_diff_line));
+    if (!lines) return -1;
+
+    size_t n = 0;
+    size_t start = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (buf[i] == '\n') {
+            buf[i] = '\0';
+            lines[n].data = buf + start;
+            lines[n].len = i - start;
+            n++;
+            start = i + 1;
+        }
+    }
+    if (start < size) {
+        lines[n].data = buf + start;
+        lines[n].len = size - start;
+        n++;
+    }
+
+    *lines_out = lines;
+    return (int)n;
+}
+
+// Assigns a class id to every line of both sides. Returns the class count or -1.
+static int diff_classify(const exodus_diff_line* old_lines, int old_count,
+                         const exodus_diff_line* new_lines, int new_count,
+                         int* old_class, int* new_class) {
+    size_t total = (size_t)old_count + (size_t)new_count;
+    size_t capacity = 16;
+    while (capacity < total * 2) capacity <<= 1;
+
+    DiffClassSlot* table = malloc(capacity * sizeof(DiffClassSlot));
+    if (!table) return -1;
+    for (size_t i = 0; i < capacity; i++) table[i].class_id = -1;
+
+    int next_class = 0;
+    for (int side = 0; side < 2; side++) {
+        const exodus_diff_line* lines = side ? new_lines : old_lines;
+        int count = side ? new_count : old_count;
+        int* classes = side ? new_class : old_class;
+
+        for (int i = 0; i < count; i++) {
+            uint64_t h = diff_hash_line(lines[i].data, lines[i].len);
+            size_t slot = (size_t)h & (capacity - 1);
+            while (table[slot].class_id != -1) {
+                if (table[slot].hash == h && table[slot].len == lines[i].len &&
+                    memcmp(table[slot].data, lines[i].data, lines[i].len) == 0) {
+                    break;
+                }
+                slot = (slot + 1) & (capacity - 1);
+            }
+            if (table[slot].class_id == -1) {
+                table[slot].hash = h;
+                table[slot].data = lines[i].data;
+                table[slot].len = lines[i].len;
+                table[slot].class_id = next_class++;
+            }
+            classes[i] = table[slot].class_id;
+        }
+    }
+
+    free(table);
+    return next_class;
+}
+
+/*
+ * Finds the middle snake of a[lo1..hi1) x b[lo2..hi2) and stores the split
+ * point in *x_out, *y_out. Both ranges are non-empty and share no common
+ * prefix or suffix. Past the cost limit, the furthest forward point reached
+ * so far is used instead; any interior point yields a valid script.
+ */
+static void diff_bisect(DiffContext* c, int lo1, int hi1, int lo2, int hi2, int* x_out, int* y_out) {
+    const int* a = c->a + lo1;
+    const int* b = c->b + lo2;
+    int n = hi1 - lo1;
+    int m = hi2 - lo2;
+    int max_d = (n + m + 1) / 2;
+    int v_offset = max_d;
+    int v_length = 2 * max_d + 2;
+    int* v1 = c->v_fwd;
+    int* v2 = c->v_rev;
+
+    for (int i = 0; i < v_length; i++) {
+        v1[i] = -1;
+        v2[i] = -1;
+    }
+    v1[v_offset + 1] = 0;
+    v2[v_offset + 1] = 0;
+
+    int delta = n - m;
+    int front = (delta & 1) != 0;
+    int k1start = 0, k1end = 0, k2start = 0, k2end = 0;
+    int best_x = -1, best_y = -1;
+
+    for (int d = 0; d < max_d; d++) {
+        if (d > c->cost_limit) break;
+
+        // Forward path
+        for (int k1 = -d + k1start; k1 <= d - k1end; k1 += 2) {
+            int k1_offset = v_offset + k1;
+            int x1;
+            if (k1 == -d || (k1 != d && v1[k1_offset - 1] < v1[k1_offset + 1])) {
+                x1 = v1[k1_offset + 1];
+            } else {
+                x1 = v1[k1_offset - 1] + 1;
+            }
+            int y1 = x1 - k1;
+            while (x1 < n && y1 < m && a[x1] == b[y1]) {
+                x1++;
+                y1++;
+            }
+            v1[k1_offset] = x1;
+            if (x1 > n) {
+                k1end += 2;     // Ran off the right edge
+            } else if (y1 > m) {
+                k1start += 2;   // Ran off the bottom edge
+            } else {
+                if (x1 + y1 > best_x + best_y && (x1 < n || y1 < m)) {
+                    best_x = x1;
+                    best_y = y1;
+                }
+                if (front) {
+                    int k2_offset = v_offset + delta - k1;
+                    if (k2_offset >= 0 && k2_offset < v_length && v2[k2_offset] != -1) {
+                        int x2 = n - v2[k2_offset];
+                        if (x1 >= x2) {
+                            *x_out = lo1 + x1;
+                            *y_out = lo2 + y1;
+                            return;
+                        }
+                    }
+                }
+            }
+        }
+
+        // Reverse path
+        for (int k2 = -d + k2start; k2 <= d - k2end; k2 += 2) {
+            int k2_offset = v_offset + k2;
+            int x2;
+            if (k2 == -d || (k2 != d && v2[k2_offset - 1] < v2[k2_offset + 1])) {
+                x2 = v2[k2_offset + 1];
+            } else {
+                x2 = v2[k2_offset - 1] + 1;
+            }
+            int y2 = x2 - k2;
+            while (x2 < n && y2 < m && a[n - x2 - 1] == b[m - y2 - 1]) {
+                x2++;
+                y2++;
+            }
+            v2[k2_offset] = x2;
+            if (x2 > n) {
+                k2end += 2;
+            } else if (y2 > m) {
+                k2start += 2;
+            } else if (!front) {
+                int k1_offset = v_offset + delta - k2;
+                if (k1_offset >= 0 && k1_offset < v_length && v1[k1_offset] != -1) {
+                    int x1 = v1[k1_offset];
+                    int y1 = v_offset + x1 - k1_offset;
+                    if (x1 >= n - x2) {
+                        *x_out = lo1 + x1;
+                        *y_out = lo2 + y1;
+                        return;
+                    }
+                }
+            }
+        }
+    }
+
+    // Cost limit reached: split at the furthest forward point
+    if (best_x + best_y <= 0) {
+        best_x = (n + 1) / 2;
+        best_y = m / 2;
+    }
+    *x_out = lo1 + best_x;
+    *y_out = lo2 + best_y;
+}
+
+static void diff_range(DiffContext* c, int lo1, int hi1, int lo2, int hi2) {
+    for (;;) {
+        while (lo1 < hi1 && lo2 < hi2 && c->a[lo1] == c->b[lo2]) {
+            c->a_match[lo1++] = lo2++;
+        }
+        while (lo1 < hi1 && lo2 < hi2 && c->a[hi1 - 1] == c->b[hi2 - 1]) {
+            c->a_match[--hi1] = --hi2;
+        }
+        if (lo1 == hi1 || lo2 == hi2) return; // Remainder is pure ADD or DEL
+
+        int x, y;
+        diff_bisect(c, lo1, hi1, lo2, hi2, &x, &y);
+        diff_range(c, lo1, x, lo2, y);
+        // Continue with the second half iteratively
+        lo1 = x;
+        lo2 = y;
+    }
+}
+
+static int diff_push_op(exodus_diff_result* out, size_t* capacity, exodus_diff_op_type type, int old_index, int new_index) {
+    if (out->op_count == *capacity) {
+        size_t new_capacity = *capacity ? *capacity * 2 : 64;
+        exodus_diff_op* ops = realloc(out->ops, new_capacity * sizeof(exodus_diff_op));
+        if (!ops) return -1;
+        out->ops = ops;
+        *capacity = new_capacity;
+    }
+    exodus_diff_op* op = &out->ops[out->op_count++];
+    op->type = type;
+    op->old_index = old_index;
+    op->new_index = new_index;
+    op->moved = 0;
+    return 0;
+}
+
+// Pairs each removed line with the first unpaired added line of the same class.
+static int diff_find_moves(exodus_diff_result* out, const int* old_class, const int* new_class,
+                           int new_count, int class_count) {
+    int* queue_head = malloc((size_t)class_count * sizeof(int));
+    int* queue_next = malloc((size_t)(new_count ? new_count : 1) * sizeof(int));
+    int* queue_tail = malloc((size_t)class_count * sizeof(int));
+    size_t* add_op = malloc((size_t)(new_count ? new_count : 1) * sizeof(size_t));
+    if (!queue_head || !queue_next || !queue_tail || !add_op) {
+        free(queue_head); free(queue_next); free(queue_tail); free(add_op);
+        return -1;
+    }
+    for (int i = 0; i < class_count; i++) queue_head[i] = queue_tail[i] = -1;
+
+    // Queue added lines per class in file order
+    for (size_t i = 0; i < out->op_count; i++) {
+        exodus_diff_op* op = &out->ops[i];
+        if (op->type != EXODUS_DIFF_ADD) continue;
+        int cls = new_class[op->new_index];
+        queue_next[op->new_index] = -1;
+        add_op[op->new_index] = i;
+        if (queue_tail[cls] == -1) queue_head[cls] = op->new_index;
+        else queue_next[queue_tail[cls]] = op->new_index;
+        queue_tail[cls] = op->new_index;
+    }
+
+    size_t capacity = 0;
+    int rc = 0;
+    for (size_t i = 0; i < out->op_count; i++) {
+        exodus_diff_op* op = &out->ops[i];
+        if (op->type != EXODUS_DIFF_DEL) continue;
+        int cls = old_class[op->old_index];
+        int added = queue_head[cls];
+        if (added == -1) continue;
+        queue_head[cls] = queue_next[added];
+
+        if (out->move_count == capacity) {
+            size_t new_capacity = capacity ? capacity * 2 : 16;
+            exodus_diff_move* moves = realloc(out->moves, new_capacity * sizeof(exodus_diff_move));
+            if (!moves) { rc = -1; break; }
+            out->moves = moves;
+            capacity = new_capacity;
+        }
+        out->moves[out->move_count].old_index = op->old_index;
+        out->moves[out->move_count].new_index = added;
+        out->move_count++;
+        op->moved = 1;
+        out->ops[add_op[added]].moved = 1;
+    }
+
+    free(queue_head);
+    free(queue_next);
+    free(queue_tail);
+    free(add_op);
+    return rc;
+}
+
+int exodus_diff_compute(const exodus_diff_line* old_lines, int old_count,
+                        const exodus_diff_line* new_lines, int new_count,
+                        int flags, exodus_diff_result* out) {
+    memset(out, 0, sizeof(*out));
+    if (old_count < 0 || new_count < 0) return -1;
+
+    int total = old_count + new_count;
+    int rc = -1;
+    int* old_class = malloc((size_t)(old_count + 1) * sizeof(int));
+    int* new_class = malloc((size_t)(new_count + 1) * sizeof(int));
+    int* a = malloc((size_t)(old_count + 1) * sizeof(int));      // Reduced old side
+    int* b = malloc((size_t)(new_count + 1) * sizeof(int));      // Reduced new side
+    int* a_orig = malloc((size_t)(old_count + 1) * sizeof(int)); // Reduced -> original index
+    int* b_orig = malloc((size_t)(new_count + 1) * sizeof(int));
+    int* a_match = malloc((size_t)(old_count + 1) * sizeof(int));
+    int* v = malloc((size_t)(2 * (total + 2)) * sizeof(int) * 2);
+    int* in_old = NULL;
+    int* in_new = NULL;
+    int* old_match = NULL;
+
+    if (!old_class || !new_class || !a || !b || !a_orig || !b_orig || !a_match || !v) goto cleanup;
+
+    int class_count = diff_classify(old_lines, old_count, new_lines, new_count, old_class, new_class);
+    if (class_count < 0) goto cleanup;
+
+    in_old = calloc((size_t)class_count + 1, sizeof(int));
+    in_new = calloc((size_t)class_count + 1, sizeof(int));
+    old_match = malloc((size_t)(old_count + 1) * sizeof(int));
+    if (!in_old || !in_new || !old_match) goto cleanup;
+
+    for (int i = 0; i < old_count; i++) in_old[old_class[i]] = 1;
+    for (int j = 0; j < new_count; j++) in_new[new_class[j]] = 1;
+
+    int na = 0, nb = 0;
+    for (int i = 0; i < old_count; i++) {
+        old_match[i] = -1;
+        if (in_new[old_class[i]]) { a_orig[na] = i; a[na++] = old_class[i]; }
+    }
+    for (int j = 0; j < new_count; j++) {
+        if (in_old[new_class[j]]) { b_orig[nb] = j; b[nb++] = new_class[j]; }
+    }
+
+    for (int i = 0; i < na; i++) a_match[i] = -1;
+    int cost_limit = diff_isqrt(na + nb);
+    if (cost_limit < DIFF_MIN_COST_LIMIT) cost_limit = DIFF_MIN_COST_LIMIT;
+    DiffContext ctx = { a, b, a_match, v, v + 2 * (total + 2), cost_limit };
+    diff_range(&ctx, 0, na, 0, nb);
+
+    for (int i = 0; i < na; i++) {
+        if (a_match[i] >= 0) old_match[a_orig[i]] = b_orig[a_match[i]];
+    }
+
+    // Walk both files in order: deletions, then additions, then the common line
+    size_t capacity = 0;
+    int i = 0, j = 0;
+    while (i < old_count || j < new_count) {
+        while (i < old_count && old_match[i] < 0) {
+            if (diff_push_op(out, &capacity, EXODUS_DIFF_DEL, i, -1) != 0) goto fail;
+            i++;
+        }
+        int next_match = (i < old_count) ? old_match[i] : new_count;
+        while (j < next_match) {
+            if (diff_push_op(out, &capacity, EXODUS_DIFF_ADD, -1, j) != 0) goto fail;
+            j++;
+        }
+        if (i < old_count) {
+            if (diff_push_op(out, &capacity, EXODUS_DIFF_SAME, i, j) != 0) goto fail;
+            i++;
+            j++;
+        }
+    }
+
+    if ((flags & EXODUS_DIFF_DETECT_MOVES) &&
+        diff_find_moves(out, old_class, new_class, new_count, class_count) != 0) {
+        goto fail;
+    }
+    rc = 0;
+    goto cleanup;
+
+fail:
+    exodus_diff_result_free(out);
+cleanup:
+    free(old_class);
+    free(new_class);
+    free(a);
+    free(b);
+    free(a_orig);
+    free(b_orig);
+    free(a_match);
+    free(v);
+    free(in_old);
+    free(in_new);
+    free(old_match);
+    return rc;
+}
+
+void exodus_diff_result_free(exodus_diff_result* result) {
+    if (!result) return;
+    free(result->ops);
+    free(result->moves);
+    memset(result, 0, sizeof(*result));
+}
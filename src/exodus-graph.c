@@ -0,0 +1,421 @@
+/*
+ * exodus-graph.c
+ * gcc -Wall -Wextra -O2 -c exodus-graph.c -o exodus-graph.o -Iinclude
+ *
+ * On-disk layout of <node>/.log/commit-graph:
+ *
+ *   "EXGRPH01"                              file magic (8 bytes)
+ *   { GraphRecord, tag, author, crc32 }     one per commit, oldest first
+ *
+ * Each crc32 covers its record and strings. Loading stops at the first
+ * record that is cut short or fails its check; the next save cuts the file
+ * back to the last good record before appending.
+ */
+#define _GNU_SOURCE
+#include "exodus-graph.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+#define GRAPH_MAGIC "EXGRPH01"
+#define GRAPH_MAGIC_LEN 8
+#define GRAPH_MIN_BUCKETS 256
+#define GRAPH_RAW_HASH_LEN 32
+
+// GraphRecord.flags: which optional hashes are set
+#define GRAPH_HAS_PARENT   0x1
+#define GRAPH_HAS_TREE     0x2
+#define GRAPH_HAS_ANCHOR   0x4
+#define GRAPH_HAS_PROMOTED 0x8
+
+typedef struct {
+    uint8_t hash[GRAPH_RAW_HASH_LEN];
+    uint8_t parent[GRAPH_RAW_HASH_LEN];
+    uint8_t tree[GRAPH_RAW_HASH_LEN];
+    uint8_t anchor[GRAPH_RAW_HASH_LEN];
+    uint8_t promoted[GRAPH_RAW_HASH_LEN];
+    int64_t timestamp;
+    uint32_t generation;
+    uint16_t tag_len;
+    uint16_t author_len;
+    char type;
+    uint8_t flags;
+    uint8_t reserved[6];
+} GraphRecord;
+
+_Static_assert(sizeof(GraphRecord) == 184, "GraphRecord must stay 184 bytes");
+
+typedef struct GraphEntry {
+    exodus_graph_commit commit;     // First, so a commit pointer is its entry
+    struct GraphEntry* parent;
+    struct GraphEntry* hash_next;
+    struct GraphEntry* tag_next;
+    uint64_t hash_key;
+    uint64_t tag_key;
+    int saved;                      // Already in the file
+    char strings[];                 // tag, then author, both NUL-terminated
+} GraphEntry;
+
+struct exodus_graph {
+    GraphEntry** by_hash;
+    GraphEntry** by_tag;
+    size_t bucket_count;
+    size_t count;
+    GraphEntry** order;             // Insertion order (parents first), for save
+    size_t order_capacity;
+    off_t loaded_size;              // File size at load
+    off_t valid_size;               // Bytes up to the last good record
+};
+
+static uint64_t graph_fnv1a64(const char* data, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)data[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static void graph_file_path(const char* node_path, char* out, size_t size) {
+    snprintf(out, size, "%s/.log/%s", node_path, EXODUS_GRAPH_FILE);
+}
+
+static int write_all(int fd, const void* buf, size_t len) {
+    const char* p = buf;
+    while (len > 0) {
+        ssize_t w = write(fd, p, len);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += w;
+        len -= (size_t)w;
+    }
+    return 0;
+}
+
+// Reads a whole file. Returns NULL (with *size_out = 0) if it is missing.
+static char* read_whole_file(const char* path, size_t* size_out) {
+    *size_out = 0;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) { close(fd); return NULL; }
+    size_t size = (size_t)st.st_size;
+    char* buf = malloc(size);
+    if (!buf) { close(fd); return NULL; }
+    size_t got = 0;
+    while (got < size) {
+        ssize_t r = read(fd, buf + got, size - got);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        got += (size_t)r;
+    }
+    close(fd);
+    *size_out = got;
+    return buf;
+}
+
+// --- Hashes ---
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// Accepts "" (unset) or a full lowercase hex hash.
+static int valid_hash(const char* hex) {
+    if (hex[0] == '\0') return 1;
+    for (int i = 0; i < EXODUS_GRAPH_HASH_LEN; i++) {
+        if (hex_value(hex[i]) < 0) return 0;
+    }
+    return hex[EXODUS_GRAPH_HASH_LEN] == '\0';
+}
+
+static void hash_to_raw(const char* hex, uint8_t* raw) {
+    for (int i = 0; i < GRAPH_RAW_HASH_LEN; i++) {
+        raw[i] = (uint8_t)((hex_value(hex[i * 2]) << 4) | hex_value(hex[i * 2 + 1]));
+    }
+}
+
+static void raw_to_hash(const uint8_t* raw, char* hex) {
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < GRAPH_RAW_HASH_LEN; i++) {
+        hex[i * 2] = digits[raw[i] >> 4];
+        hex[i * 2 + 1] = digits[raw[i] & 0xF];
+    }
+    hex[EXODUS_GRAPH_HASH_LEN] = '\0';
+}
+
+// --- Tables ---
+
+static int graph_grow(exodus_graph* graph) {
+    size_t new_count = graph->bucket_count ? graph->bucket_count * 2 : GRAPH_MIN_BUCKETS;
+    GraphEntry** nh = calloc(new_count, sizeof(GraphEntry*));
+    GraphEntry** nt = calloc(new_count, sizeof(GraphEntry*));
+    if (!nh || !nt) { free(nh); free(nt); return -1; }
+    // Rehash in insertion order, so tag chains keep the newest commit first
+    for (size_t i = 0; i < graph->count; i++) {
+        GraphEntry* e = graph->order[i];
+        size_t b = e->hash_key & (new_count - 1);
+        e->hash_next = nh[b];
+        nh[b] = e;
+        b = e->tag_key & (new_count - 1);
+        e->tag_next = nt[b];
+        nt[b] = e;
+    }
+    free(graph->by_hash);
+    free(graph->by_tag);
+    graph->by_hash = nh;
+    graph->by_tag = nt;
+    graph->bucket_count = new_count;
+    return 0;
+}
+
+static GraphEntry* graph_find(const exodus_graph* graph, const char* hash) {
+    if (!graph->bucket_count) return NULL;
+    uint64_t h = graph_fnv1a64(hash, strlen(hash));
+    for (GraphEntry* e = graph->by_hash[h & (graph->bucket_count - 1)]; e; e = e->hash_next) {
+        if (e->hash_key == h && strcmp(e->commit.hash, hash) == 0) return e;
+    }
+    return NULL;
+}
+
+static GraphEntry* graph_insert(exodus_graph* graph, const exodus_graph_commit* commit) {
+    if (!valid_hash(commit->hash) || commit->hash[0] == '\0' || !valid_hash(commit->parent) ||
+        !valid_hash(commit->tree) || !valid_hash(commit->anchor) || !valid_hash(commit->promoted)) {
+        return NULL;
+    }
+    const char* tag = commit->tag ? commit->tag : "";
+    const char* author = commit->author ? commit->author : "";
+    size_t tag_len = strlen(tag), author_len = strlen(author);
+    if (tag_len > UINT16_MAX || author_len > UINT16_MAX) return NULL;
+
+    GraphEntry* parent = NULL;
+    if (commit->parent[0] != '\0') {
+        parent = graph_find(graph, commit->parent);
+        if (!parent) return NULL;
+    }
+
+    if (graph->count + 1 > graph->order_capacity) {
+        size_t cap = graph->order_capacity ? graph->order_capacity * 2 : GRAPH_MIN_BUCKETS;
+        GraphEntry** order = realloc(graph->order, cap * sizeof(GraphEntry*));
+        if (!order) return NULL;
+        graph->order = order;
+        graph->order_capacity = cap;
+    }
+    if (graph->count + 1 > graph->bucket_count && graph_grow(graph) != 0) return NULL;
+
+    GraphEntry* e = calloc(1, sizeof(GraphEntry) + tag_len + 1 + author_len + 1);
+    if (!e) return NULL;
+    e->commit = *commit;
+    memcpy(e->strings, tag, tag_len + 1);
+    memcpy(e->strings + tag_len + 1, author, author_len + 1);
+    e->commit.tag = e->strings;
+    e->commit.author = e->strings + tag_len + 1;
+    e->commit.generation = parent ? parent->commit.generation + 1 : 1;
+    e->parent = parent;
+    e->hash_key = graph_fnv1a64(e->commit.hash, strlen(e->commit.hash));
+    e->tag_key = graph_fnv1a64(tag, tag_len);
+
+    size_t b = e->hash_key & (graph->bucket_count - 1);
+    e->hash_next = graph->by_hash[b];
+    graph->by_hash[b] = e;
+    b = e->tag_key & (graph->bucket_count - 1);
+    e->tag_next = graph->by_tag[b];
+    graph->by_tag[b] = e;
+    graph->order[graph->count++] = e;
+    return e;
+}
+
+static void parse_graph(exodus_graph* graph, const char* buf, size_t size) {
+    if (size < GRAPH_MAGIC_LEN || memcmp(buf, GRAPH_MAGIC, GRAPH_MAGIC_LEN) != 0) return;
+    char* strings = malloc(2 * (UINT16_MAX + 1)); // NUL-terminated tag and author
+    if (!strings) return;
+    char* tag = strings;
+    char* author = strings + UINT16_MAX + 1;
+    const char* p = buf + GRAPH_MAGIC_LEN;
+    const char* end = buf + size;
+    graph->valid_size = GRAPH_MAGIC_LEN;
+
+    while ((size_t)(end - p) >= sizeof(GraphRecord)) {
+        GraphRecord rec;
+        memcpy(&rec, p, sizeof(rec));
+        size_t body = sizeof(rec) + rec.tag_len + rec.author_len;
+        if ((size_t)(end - p) < body + sizeof(uint32_t)) break;
+        uint32_t stored_crc;
+        memcpy(&stored_crc, p + body, sizeof(uint32_t));
+        if ((uint32_t)crc32(0L, (const Bytef*)p, (uInt)body) != stored_crc) break;
+
+        memcpy(tag, p + sizeof(rec), rec.tag_len);
+        tag[rec.tag_len] = '\0';
+        memcpy(author, p + sizeof(rec) + rec.tag_len, rec.author_len);
+        author[rec.author_len] = '\0';
+
+        exodus_graph_commit commit = {0};
+        raw_to_hash(rec.hash, commit.hash);
+        if (rec.flags & GRAPH_HAS_PARENT) raw_to_hash(rec.parent, commit.parent);
+        if (rec.flags & GRAPH_HAS_TREE) raw_to_hash(rec.tree, commit.tree);
+        if (rec.flags & GRAPH_HAS_ANCHOR) raw_to_hash(rec.anchor, commit.anchor);
+        if (rec.flags & GRAPH_HAS_PROMOTED) raw_to_hash(rec.promoted, commit.promoted);
+        commit.type = rec.type;
+        commit.timestamp = rec.timestamp;
+        commit.tag = tag;
+        commit.author = author;
+
+        // Duplicates (two writers) and orphans are skipped, not fatal.
+        // Generations are recomputed from the parent links.
+        if (!graph_find(graph, commit.hash)) {
+            GraphEntry* e = graph_insert(graph, &commit);
+            if (e) e->saved = 1;
+        }
+        p += body + sizeof(uint32_t);
+        graph->valid_size = (off_t)(p - buf);
+    }
+    free(strings);
+}
+
+// --- Public API ---
+
+exodus_graph* exodus_graph_load(const char* node_path) {
+    exodus_graph* graph = calloc(1, sizeof(exodus_graph));
+    if (!graph) return NULL;
+
+    char path[PATH_MAX];
+    graph_file_path(node_path, path, sizeof(path));
+    size_t size;
+    char* buf = read_whole_file(path, &size);
+    if (buf) {
+        graph->loaded_size = (off_t)size;
+        parse_graph(graph, buf, size);
+        free(buf);
+    }
+    return graph;
+}
+
+const exodus_graph_commit* exodus_graph_lookup(const exodus_graph* graph, const char* hash) {
+    if (!graph || !hash) return NULL;
+    GraphEntry* e = graph_find(graph, hash);
+    return e ? &e->commit : NULL;
+}
+
+const exodus_graph_commit* exodus_graph_parent(const exodus_graph* graph, const exodus_graph_commit* commit) {
+    (void)graph;
+    const GraphEntry* e = (const GraphEntry*)commit;
+    return e && e->parent ? &e->parent->commit : NULL;
+}
+
+const exodus_graph_commit* exodus_graph_find_tag(const exodus_graph* graph, const exodus_graph_commit* head,
+                                                 const char* tag) {
+    if (!graph || !head || !graph->bucket_count) return NULL;
+    uint64_t h = graph_fnv1a64(tag, strlen(tag));
+    const GraphEntry* best = NULL;
+    for (const GraphEntry* e = graph->by_tag[h & (graph->bucket_count - 1)]; e; e = e->tag_next) {
+        if (e->tag_key != h || strcmp(e->commit.tag, tag) != 0) continue;
+        uint32_t gen = e->commit.generation;
+        if (gen > head->generation || (best && gen <= best->commit.generation)) continue;
+        // On head's history exactly when head's ancestor of the same generation is e
+        const GraphEntry* x = (const GraphEntry*)head;
+        while (x && x->commit.generation > gen) x = x->parent;
+        if (x == e) best = e;
+    }
+    return best ? &best->commit : NULL;
+}
+
+int exodus_graph_add(exodus_graph* graph, const exodus_graph_commit* commit) {
+    if (!graph || !commit) return -1;
+    if (graph_find(graph, commit->hash)) return 0;
+    return graph_insert(graph, commit) ? 0 : -1;
+}
+
+int exodus_graph_save(exodus_graph* graph, const char* node_path) {
+    if (!graph) return -1;
+    size_t total = 0;
+    for (size_t i = 0; i < graph->count; i++) {
+        GraphEntry* e = graph->order[i];
+        if (e->saved) continue;
+        total += sizeof(GraphRecord) + strlen(e->commit.tag) + strlen(e->commit.author) + sizeof(uint32_t);
+    }
+    if (total == 0) return 0;
+
+    char* buf = malloc(total);
+    if (!buf) return -1;
+    char* p = buf;
+    for (size_t i = 0; i < graph->count; i++) {
+        GraphEntry* e = graph->order[i];
+        if (e->saved) continue;
+        const exodus_graph_commit* c = &e->commit;
+        GraphRecord rec;
+        memset(&rec, 0, sizeof(rec));
+        hash_to_raw(c->hash, rec.hash);
+        if (c->parent[0]) { hash_to_raw(c->parent, rec.parent); rec.flags |= GRAPH_HAS_PARENT; }
+        if (c->tree[0]) { hash_to_raw(c->tree, rec.tree); rec.flags |= GRAPH_HAS_TREE; }
+        if (c->anchor[0]) { hash_to_raw(c->anchor, rec.anchor); rec.flags |= GRAPH_HAS_ANCHOR; }
+        if (c->promoted[0]) { hash_to_raw(c->promoted, rec.promoted); rec.flags |= GRAPH_HAS_PROMOTED; }
+        rec.timestamp = c->timestamp;
+        rec.generation = c->generation;
+        rec.tag_len = (uint16_t)strlen(c->tag);
+        rec.author_len = (uint16_t)strlen(c->author);
+        rec.type = c->type;
+
+        char* start = p;
+        memcpy(p, &rec, sizeof(rec));
+        p += sizeof(rec);
+        memcpy(p, c->tag, rec.tag_len);
+        p += rec.tag_len;
+        memcpy(p, c->author, rec.author_len);
+        p += rec.author_len;
+        uint32_t crc = (uint32_t)crc32(0L, (const Bytef*)start, (uInt)(p - start));
+        memcpy(p, &crc, sizeof(crc));
+        p += sizeof(crc);
+    }
+
+    char path[PATH_MAX];
+    graph_file_path(node_path, path, sizeof(path));
+    int fd = open(path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) { free(buf); return -1; }
+    int rc = -1;
+    off_t end = -1;
+    struct stat st;
+    if (flock(fd, LOCK_EX) == 0 && fstat(fd, &st) == 0) {
+        rc = 0;
+        // A damaged tail (or a file that was never valid) is cut before appending.
+        // Records other writers appended since our load are left alone.
+        if (graph->valid_size < graph->loaded_size) {
+            if (ftruncate(fd, graph->valid_size) != 0) rc = -1;
+            st.st_size = graph->valid_size;
+        }
+        if (rc == 0 && st.st_size == 0 && write_all(fd, GRAPH_MAGIC, GRAPH_MAGIC_LEN) != 0) rc = -1;
+        if (rc == 0 && (lseek(fd, 0, SEEK_END) < 0 || write_all(fd, buf, total) != 0)) rc = -1;
+        if (rc == 0) end = lseek(fd, 0, SEEK_CUR);
+    }
+    close(fd); // Drops the lock
+    free(buf);
+    if (rc != 0) return -1;
+
+    for (size_t i = 0; i < graph->count; i++) graph->order[i]->saved = 1;
+    graph->loaded_size = graph->valid_size = end;
+    return 0;
+}
+
+void exodus_graph_free(exodus_graph* graph) {
+    if (!graph) return;
+    for (size_t i = 0; i < graph->count; i++) free(graph->order[i]);
+    free(graph->order);
+    free(graph->by_hash);
+    free(graph->by_tag);
+    free(graph);
+}
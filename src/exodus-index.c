@@ -0,0 +1,476 @@
+/*
+ * exodus-index.c
+ * gcc -Wall -Wextra -O2 -c exodus-index.c -o exodus-index.o -Iinclude
+ *
+ * On-disk layout of <node>/.log/index:
+ *
+ *   "EXIDX001"                              file magic (8 bytes)
+ *   IndexHeader                             entry count, walk start time
+ *   { IndexRecord, path }                   repeated for every entry
+ *   crc32                                   of everything before it
+ *
+ * An index that fails any check is treated as empty.
+ *
+ * <node>/.log/index.dirty holds NUL-terminated relative paths. A commit
+ * renames it to index.dirty.taken before reading, so paths the daemon
+ * appends during the commit land in a fresh file for the next one. The
+ * taken file is removed once the new index is saved; if the commit fails
+ * it is read again next time.
+ */
+#define _GNU_SOURCE
+#include "exodus-index.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <limits.h>
+#include <zlib.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+#define INDEX_MAGIC "EXIDX001"
+#define INDEX_MAGIC_LEN 8
+#define INDEX_MIN_BUCKETS 1024
+
+typedef struct {
+    uint32_t count;
+    uint32_t reserved;
+    int64_t walk_sec;       // Start of the walk that wrote this index
+    int64_t walk_nsec;
+} IndexHeader;
+
+typedef struct {
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    int64_t ctime_sec;
+    int64_t ctime_nsec;
+    uint64_t size;
+    uint64_t ino;
+    double entropy;
+    uint32_t mode;
+    uint16_t path_len;
+    char type;
+    uint8_t reserved;
+    char hash[EXODUS_INDEX_HASH_LEN];
+} IndexRecord;
+
+_Static_assert(sizeof(IndexRecord) == 128, "IndexRecord must stay 128 bytes");
+
+typedef struct IndexEntry {
+    IndexRecord rec;
+    uint64_t path_hash;
+    int seen;                   // Looked up or recorded during this walk
+    struct IndexEntry* next;
+    char path[];
+} IndexEntry;
+
+typedef struct DirtyPath {
+    uint64_t path_hash;
+    struct DirtyPath* next;
+    char path[];
+} DirtyPath;
+
+struct exodus_index {
+    IndexEntry** buckets;
+    size_t bucket_count;
+    size_t count;
+    DirtyPath** dirty;          // Small chained set, sized at load
+    size_t dirty_bucket_count;
+    struct timespec loaded_walk;    // Walk time stored in the index we loaded
+    struct timespec walk_start;     // Start of the current walk
+};
+
+static uint64_t index_fnv1a64(const char* data, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)data[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static void index_file_path(const char* node_path, const char* file, char* out, size_t size) {
+    snprintf(out, size, "%s/.log/%s", node_path, file);
+}
+
+static int write_all(int fd, const void* buf, size_t len) {
+    const char* p = buf;
+    while (len > 0) {
+        ssize_t w = write(fd, p, len);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += w;
+        len -= (size_t)w;
+    }
+    return 0;
+}
+
+// Reads a whole file. Returns NULL (with *size_out = 0) if it is missing.
+static char* read_whole_file(const char* path, size_t* size_out) {
+    *size_out = 0;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) { close(fd); return NULL; }
+    size_t size = (size_t)st.st_size;
+    char* buf = malloc(size);
+    if (!buf) { close(fd); return NULL; }
+    size_t got = 0;
+    while (got < size) {
+        ssize_t r = read(fd, buf + got, size - got);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        got += (size_t)r;
+    }
+    close(fd);
+    *size_out = got;
+    return buf;
+}
+
+// --- Entry table ---
+
+static int index_grow(exodus_index* index) {
+    size_t new_count = index->bucket_count ? index->bucket_count * 2 : INDEX_MIN_BUCKETS;
+    IndexEntry** nb = calloc(new_count, sizeof(IndexEntry*));
+    if (!nb) return -1;
+    for (size_t i = 0; i < index->bucket_count; i++) {
+        IndexEntry* e = index->buckets[i];
+        while (e) {
+            IndexEntry* next = e->next;
+            size_t b = e->path_hash & (new_count - 1);
+            e->next = nb[b];
+            nb[b] = e;
+            e = next;
+        }
+    }
+    free(index->buckets);
+    index->buckets = nb;
+    index->bucket_count = new_count;
+    return 0;
+}
+
+static IndexEntry* index_find(exodus_index* index, const char* path, size_t len, uint64_t h) {
+    if (!index->bucket_count) return NULL;
+    for (IndexEntry* e = index->buckets[h & (index->bucket_count - 1)]; e; e = e->next) {
+        if (e->path_hash == h && e->rec.path_len == len && memcmp(e->path, path, len) == 0) return e;
+    }
+    return NULL;
+}
+
+static IndexEntry* index_insert(exodus_index* index, const char* path, size_t len, uint64_t h) {
+    if (index->count + 1 > index->bucket_count && index_grow(index) != 0) return NULL;
+    IndexEntry* e = calloc(1, sizeof(IndexEntry) + len + 1);
+    if (!e) return NULL;
+    memcpy(e->path, path, len);
+    e->path[len] = '\0';
+    e->rec.path_len = (uint16_t)len;
+    e->path_hash = h;
+    size_t b = h & (index->bucket_count - 1);
+    e->next = index->buckets[b];
+    index->buckets[b] = e;
+    index->count++;
+    return e;
+}
+
+static void fill_stat(IndexRecord* rec, const struct stat* st) {
+    rec->mtime_sec = st->st_mtim.tv_sec;
+    rec->mtime_nsec = st->st_mtim.tv_nsec;
+    rec->ctime_sec = st->st_ctim.tv_sec;
+    rec->ctime_nsec = st->st_ctim.tv_nsec;
+    rec->size = (uint64_t)st->st_size;
+    rec->ino = (uint64_t)st->st_ino;
+    rec->mode = (uint32_t)st->st_mode;
+}
+
+static int stat_matches(const IndexRecord* rec, const struct stat* st) {
+    return rec->mtime_sec == st->st_mtim.tv_sec && rec->mtime_nsec == st->st_mtim.tv_nsec &&
+           rec->ctime_sec == st->st_ctim.tv_sec && rec->ctime_nsec == st->st_ctim.tv_nsec &&
+           rec->size == (uint64_t)st->st_size && rec->ino == (uint64_t)st->st_ino &&
+           rec->mode == (uint32_t)st->st_mode;
+}
+
+static int parse_index(exodus_index* index, const char* buf, size_t size) {
+    if (size < INDEX_MAGIC_LEN + sizeof(IndexHeader) + sizeof(uint32_t)) return -1;
+    if (memcmp(buf, INDEX_MAGIC, INDEX_MAGIC_LEN) != 0) return -1;
+    uint32_t stored_crc;
+    memcpy(&stored_crc, buf + size - sizeof(uint32_t), sizeof(uint32_t));
+    if ((uint32_t)crc32(0L, (const Bytef*)buf, (uInt)(size - sizeof(uint32_t))) != stored_crc) return -1;
+
+    IndexHeader hdr;
+    memcpy(&hdr, buf + INDEX_MAGIC_LEN, sizeof(hdr));
+    index->loaded_walk.tv_sec = hdr.walk_sec;
+    index->loaded_walk.tv_nsec = hdr.walk_nsec;
+
+    const char* p = buf + INDEX_MAGIC_LEN + sizeof(hdr);
+    const char* end = buf + size - sizeof(uint32_t);
+    for (uint32_t i = 0; i < hdr.count; i++) {
+        IndexRecord rec;
+        if ((size_t)(end - p) < sizeof(rec)) return -1;
+        memcpy(&rec, p, sizeof(rec));
+        p += sizeof(rec);
+        if ((size_t)(end - p) < rec.path_len) return -1;
+        uint64_t h = index_fnv1a64(p, rec.path_len);
+        IndexEntry* e = index_insert(index, p, rec.path_len, h);
+        if (!e) return -1;
+        e->rec = rec;
+        p += rec.path_len;
+    }
+    return 0;
+}
+
+// --- Dirty paths ---
+
+static int dirty_add(exodus_index* index, const char* path, size_t len) {
+    uint64_t h = index_fnv1a64(path, len);
+    size_t b = h & (index->dirty_bucket_count - 1);
+    for (DirtyPath* d = index->dirty[b]; d; d = d->next) {
+        if (d->path_hash == h && strcmp(d->path, path) == 0) return 0;
+    }
+    DirtyPath* d = malloc(sizeof(DirtyPath) + len + 1);
+    if (!d) return -1;
+    memcpy(d->path, path, len + 1);
+    d->path_hash = h;
+    d->next = index->dirty[b];
+    index->dirty[b] = d;
+    return 0;
+}
+
+static int dirty_contains(const exodus_index* index, const char* path, size_t len) {
+    if (!index->dirty_bucket_count) return 0;
+    uint64_t h = index_fnv1a64(path, len);
+    for (DirtyPath* d = index->dirty[h & (index->dirty_bucket_count - 1)]; d; d = d->next) {
+        if (d->path_hash == h && strlen(d->path) == len && memcmp(d->path, path, len) == 0) return 1;
+    }
+    return 0;
+}
+
+// A path is dirty if it, or any directory above it, was reported changed.
+static int is_dirty(const exodus_index* index, const char* path) {
+    if (!index->dirty_bucket_count) return 0;
+    size_t len = strlen(path);
+    if (dirty_contains(index, path, len)) return 1;
+    for (size_t i = len; i > 0; i--) {
+        if (path[i - 1] == '/' && dirty_contains(index, path, i - 1)) return 1;
+    }
+    return 0;
+}
+
+static int load_dirty(exodus_index* index, const char* node_path) {
+    char dirty_path[PATH_MAX], taken_path[PATH_MAX];
+    index_file_path(node_path, EXODUS_INDEX_DIRTY_FILE, dirty_path, sizeof(dirty_path));
+    index_file_path(node_path, EXODUS_INDEX_DIRTY_FILE ".taken", taken_path, sizeof(taken_path));
+
+    // A leftover taken file belongs to a commit that never saved; read it again
+    if (access(taken_path, F_OK) != 0 && rename(dirty_path, taken_path) != 0 && errno != ENOENT) {
+        return -1;
+    }
+
+    size_t size;
+    char* buf = read_whole_file(taken_path, &size);
+    if (!buf) return 0;
+
+    size_t paths = 0;
+    for (size_t i = 0; i < size; i++) if (buf[i] == '\0') paths++;
+    size_t buckets = 16;
+    while (buckets < paths * 2) buckets *= 2;
+    index->dirty = calloc(buckets, sizeof(DirtyPath*));
+    if (!index->dirty) { free(buf); return -1; }
+    index->dirty_bucket_count = buckets;
+
+    size_t start = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (buf[i] != '\0') continue;
+        if (i > start && dirty_add(index, buf + start, i - start) != 0) { free(buf); return -1; }
+        start = i + 1;
+    }
+    free(buf);
+    return 0;
+}
+
+// --- Public API ---
+
+exodus_index* exodus_index_load(const char* node_path) {
+    exodus_index* index = calloc(1, sizeof(exodus_index));
+    if (!index) return NULL;
+    // Coarse on purpose: file timestamps come from the same clock
+    clock_gettime(CLOCK_REALTIME_COARSE, &index->walk_start);
+
+    if (load_dirty(index, node_path) != 0) {
+        exodus_index_free(index);
+        return NULL;
+    }
+
+    char path[PATH_MAX];
+    index_file_path(node_path, EXODUS_INDEX_FILE, path, sizeof(path));
+    size_t size;
+    char* buf = read_whole_file(path, &size);
+    if (buf) {
+        if (parse_index(index, buf, size) != 0) {
+            // Start over with an empty table
+            for (size_t i = 0; i < index->bucket_count; i++) {
+                IndexEntry* e = index->buckets[i];
+                while (e) { IndexEntry* next = e->next; free(e); e = next; }
+                index->buckets[i] = NULL;
+            }
+            index->count = 0;
+        }
+        free(buf);
+    }
+    return index;
+}
+
+int exodus_index_lookup(exodus_index* index, const char* relative_path, const struct stat* st,
+                        exodus_index_object* obj) {
+    if (!index) return 0;
+    size_t len = strlen(relative_path);
+    IndexEntry* e = index_find(index, relative_path, len, index_fnv1a64(relative_path, len));
+    if (!e || !stat_matches(&e->rec, st)) return 0;
+    if (e->rec.ctime_sec > index->loaded_walk.tv_sec ||
+        (e->rec.ctime_sec == index->loaded_walk.tv_sec && e->rec.ctime_nsec >= index->loaded_walk.tv_nsec)) {
+        return 0; // Racily clean: changed in the tick the last walk started
+    }
+    if (is_dirty(index, relative_path)) return 0;
+
+    e->seen = 1;
+    obj->type = e->rec.type;
+    memcpy(obj->hash, e->rec.hash, EXODUS_INDEX_HASH_LEN);
+    obj->hash[EXODUS_INDEX_HASH_LEN] = '\0';
+    obj->entropy = e->rec.entropy;
+    return 1;
+}
+
+int exodus_index_record(exodus_index* index, const char* relative_path, const struct stat* st,
+                        const exodus_index_object* obj) {
+    if (!index) return 0;
+    size_t len = strlen(relative_path);
+    if (len > UINT16_MAX || strlen(obj->hash) != EXODUS_INDEX_HASH_LEN) return 0; // Not cacheable
+    uint64_t h = index_fnv1a64(relative_path, len);
+    IndexEntry* e = index_find(index, relative_path, len, h);
+    if (!e) e = index_insert(index, relative_path, len, h);
+    if (!e) return -1;
+    fill_stat(&e->rec, st);
+    e->rec.type = obj->type;
+    memcpy(e->rec.hash, obj->hash, EXODUS_INDEX_HASH_LEN);
+    e->rec.entropy = obj->entropy;
+    e->seen = 1;
+    return 0;
+}
+
+int exodus_index_for_each_object(const exodus_index* index,
+                                 int (*fn)(const exodus_index_object* obj, void* ctx), void* ctx) {
+    if (!index) return 0;
+    for (size_t i = 0; i < index->bucket_count; i++) {
+        for (IndexEntry* e = index->buckets[i]; e; e = e->next) {
+            exodus_index_object obj;
+            obj.type = e->rec.type;
+            memcpy(obj.hash, e->rec.hash, EXODUS_INDEX_HASH_LEN);
+            obj.hash[EXODUS_INDEX_HASH_LEN] = '\0';
+            obj.entropy = e->rec.entropy;
+            int rc = fn(&obj, ctx);
+            if (rc) return rc;
+        }
+    }
+    return 0;
+}
+
+int exodus_index_save(exodus_index* index, const char* node_path) {
+    if (!index) return -1;
+    char path[PATH_MAX], tmp_path[PATH_MAX], taken_path[PATH_MAX];
+    index_file_path(node_path, EXODUS_INDEX_FILE, path, sizeof(path));
+    index_file_path(node_path, EXODUS_INDEX_FILE ".tmp", tmp_path, sizeof(tmp_path));
+    index_file_path(node_path, EXODUS_INDEX_DIRTY_FILE ".taken", taken_path, sizeof(taken_path));
+
+    size_t total = INDEX_MAGIC_LEN + sizeof(IndexHeader) + sizeof(uint32_t);
+    uint32_t count = 0;
+    for (size_t i = 0; i < index->bucket_count; i++) {
+        for (IndexEntry* e = index->buckets[i]; e; e = e->next) {
+            if (!e->seen) continue;
+            total += sizeof(IndexRecord) + e->rec.path_len;
+            count++;
+        }
+    }
+
+    char* buf = malloc(total);
+    if (!buf) return -1;
+    char* p = buf;
+    memcpy(p, INDEX_MAGIC, INDEX_MAGIC_LEN);
+    p += INDEX_MAGIC_LEN;
+    IndexHeader hdr = { count, 0, index->walk_start.tv_sec, index->walk_start.tv_nsec };
+    memcpy(p, &hdr, sizeof(hdr));
+    p += sizeof(hdr);
+    for (size_t i = 0; i < index->bucket_count; i++) {
+        for (IndexEntry* e = index->buckets[i]; e; e = e->next) {
+            if (!e->seen) continue;
+            memcpy(p, &e->rec, sizeof(e->rec));
+            p += sizeof(e->rec);
+            memcpy(p, e->path, e->rec.path_len);
+            p += e->rec.path_len;
+        }
+    }
+    uint32_t crc = (uint32_t)crc32(0L, (const Bytef*)buf, (uInt)(p - buf));
+    memcpy(p, &crc, sizeof(crc));
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) { free(buf); return -1; }
+    int rc = write_all(fd, buf, total);
+    free(buf);
+    if (close(fd) != 0) rc = -1;
+    if (rc != 0 || rename(tmp_path, path) != 0) {
+        unlink(tmp_path);
+        return -1;
+    }
+    unlink(taken_path);
+    return 0;
+}
+
+void exodus_index_free(exodus_index* index) {
+    if (!index) return;
+    for (size_t i = 0; i < index->bucket_count; i++) {
+        IndexEntry* e = index->buckets[i];
+        while (e) { IndexEntry* next = e->next; free(e); e = next; }
+    }
+    free(index->buckets);
+    for (size_t i = 0; i < index->dirty_bucket_count; i++) {
+        DirtyPath* d = index->dirty[i];
+        while (d) { DirtyPath* next = d->next; free(d); d = next; }
+    }
+    free(index->dirty);
+    free(index);
+}
+
+int exodus_index_mark_dirty(const char* node_path, const char* const* paths, size_t count) {
+    if (!node_path || count == 0) return 0;
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) total += strlen(paths[i]) + 1;
+    char* buf = malloc(total);
+    if (!buf) return -1;
+    char* p = buf;
+    for (size_t i = 0; i < count; i++) {
+        size_t len = strlen(paths[i]) + 1;
+        memcpy(p, paths[i], len);
+        p += len;
+    }
+
+    char path[PATH_MAX];
+    index_file_path(node_path, EXODUS_INDEX_DIRTY_FILE, path, sizeof(path));
+    int fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) { free(buf); return -1; }
+    struct stat st;
+    int rc = 0;
+    if (fstat(fd, &st) == 0 && st.st_size + (off_t)total > EXODUS_INDEX_DIRTY_MAX_BYTES) {
+        rc = 0; // Full; the stat comparison still catches these changes
+    } else {
+        rc = write_all(fd, buf, total);
+    }
+    close(fd);
+    free(buf);
+    return rc;
+}
@@ -0,0 +1,519 @@
+/*
+ * exodus-journal.c
+ * gcc -Wall -Wextra -O2 -c exodus-journal.c -o exodus-journal.o -Iinclude
+ *
+ * On-disk layout of <node>/.log/history.journal:
+ *
+ *   "EXJRNL01"                              file magic (8 bytes)
+ *   { length, crc32 } payload               repeated for every event
+ *
+ * where payload = JournalRecord + name + user + details (no terminators).
+ * A record whose length or CRC does not check out marks the torn tail of an
+ * interrupted write; it and everything after it are ignored.
+ *
+ * Compaction (materialize):
+ *   1. write history.json.tmp = history.json + journal records, fsync
+ *   2. rename history.journal -> history.journal.folded
+ *   3. rename history.json.tmp -> history.json
+ *   4. unlink history.journal.folded
+ * A leftover .folded file means the crash happened between 2 and 4: if the
+ * temp file is still there step 3 is redone, otherwise only step 4 is.
+ */
+#define _GNU_SOURCE
+#include "exodus-journal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <limits.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+#define JOURNAL_MAGIC "EXJRNL01"
+#define JOURNAL_MAGIC_LEN 8
+#define JOURNAL_MAX_RECORD (64u * 1024 * 1024)
+
+typedef struct {
+    uint32_t length;    // Payload bytes following this frame
+    uint32_t crc32;     // CRC32 of the payload
+} JournalFrame;
+
+typedef struct {
+    int64_t timestamp;
+    uint32_t details_len;
+    uint16_t name_len;
+    uint16_t user_len;
+    uint8_t type;
+    uint8_t flags;
+    uint16_t reserved;
+    uint32_t reserved2;
+} JournalRecord;
+
+_Static_assert(sizeof(JournalRecord) == 24, "JournalRecord must stay 24 bytes");
+
+#define JOURNAL_FLAG_TIME_REAL 0x01
+
+// --- CRC32 (IEEE 802.3, reflected), nibble table ---
+
+static uint32_t journal_crc32(const void* data, size_t len) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+        0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+        0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    const uint8_t* p = data;
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= p[i];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+// --- Paths & Locking ---
+
+static void log_file_path(const char* node_path, const char* file, char* out, size_t size) {
+    snprintf(out, size, "%s/.log/%s", node_path, file);
+}
+
+// Serializes compaction, reset and replace between processes.
+static int lock_compaction(const char* node_path) {
+    char lock_path[PATH_MAX];
+    log_file_path(node_path, "history.lock", lock_path, sizeof(lock_path));
+    int fd = open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) fd = open(lock_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    while (flock(fd, LOCK_EX) != 0) {
+        if (errno != EINTR) { close(fd); return -1; }
+    }
+    return fd;
+}
+
+static void unlock_compaction(int fd) {
+    if (fd < 0) return;
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+
+// True if fd still refers to the file currently linked at path.
+static int fd_is_current(int fd, const char* path) {
+    struct stat fst, pst;
+    if (fstat(fd, &fst) != 0 || stat(path, &pst) != 0) return 0;
+    return fst.st_dev == pst.st_dev && fst.st_ino == pst.st_ino;
+}
+
+// Opens the live journal and takes its append lock. Retries if a compaction
+// renamed the file away while we were waiting for the lock.
+static int open_journal_locked(const char* journal_path, int flags) {
+    for (int attempt = 0; attempt < 16; attempt++) {
+        int fd = open(journal_path, flags | O_CLOEXEC, 0644);
+        if (fd < 0) return -1;
+        while (flock(fd, LOCK_EX) != 0) {
+            if (errno != EINTR) { close(fd); return -1; }
+        }
+        if (fd_is_current(fd, journal_path)) return fd;
+        flock(fd, LOCK_UN);
+        close(fd);
+    }
+    errno = EAGAIN;
+    return -1;
+}
+
+static int write_all(int fd, const void* buf, size_t len) {
+    const char* p = buf;
+    while (len > 0) {
+        ssize_t w = write(fd, p, len);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += w;
+        len -= (size_t)w;
+    }
+    return 0;
+}
+
+static int write_file_synced(const char* path, const char* data, size_t len) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+    if (write_all(fd, data, len) != 0 || fsync(fd) != 0) {
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    return close(fd);
+}
+
+static char* read_whole_file(const char* path, size_t* len_out) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0) { close(fd); return NULL; }
+
+    char* buf = malloc((size_t)st.st_size + 1);
+    if (!buf) { close(fd); return NULL; }
+
+    size_t done = 0;
+    while (done < (size_t)st.st_size) {
+        ssize_t r = read(fd, buf + done, (size_t)st.st_size - done);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            free(buf);
+            close(fd);
+            return NULL;
+        }
+        if (r == 0) break;
+        done += (size_t)r;
+    }
+    close(fd);
+    buf[done] = '\0';
+    *len_out = done;
+    return buf;
+}
+
+// --- Record Encoding ---
+
+static const char* type_to_string(uint8_t type) {
+    switch (type) {
+        case EXODUS_JOURNAL_CREATED: return "Created";
+        case EXODUS_JOURNAL_DELETED: return "Deleted";
+        case EXODUS_JOURNAL_MODIFIED: return "Modified";
+        default: return "Moved";
+    }
+}
+
+static ctz_json_value* record_to_json(const JournalRecord* rec, const char* strings) {
+    ctz_json_value* event_obj = ctz_json_new_object();
+    if (!event_obj) return NULL;
+
+    char name[PATH_MAX];
+    char user[256];
+    size_t name_len = rec->name_len < sizeof(name) ? rec->name_len : sizeof(name) - 1;
+    size_t user_len = rec->user_len < sizeof(user) ? rec->user_len : sizeof(user) - 1;
+    memcpy(name, strings, name_len);
+    name[name_len] = '\0';
+    memcpy(user, strings + rec->name_len, user_len);
+    user[user_len] = '\0';
+
+    ctz_json_object_set_value(event_obj, "event", ctz_json_new_string(type_to_string(rec->type)));
+    ctz_json_object_set_value(event_obj, "name", ctz_json_new_string(name));
+    ctz_json_object_set_value(event_obj, "user", ctz_json_new_string(user_len ? user : "unknown"));
+
+    if (rec->flags & JOURNAL_FLAG_TIME_REAL) {
+        char time_buf[64];
+        time_t ts = (time_t)rec->timestamp;
+        struct tm local_time;
+        localtime_r(&ts, &local_time);
+        strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", &local_time);
+        ctz_json_object_set_value(event_obj, "timestamp", ctz_json_new_string(time_buf));
+    } else {
+        ctz_json_object_set_value(event_obj, "timestamp", ctz_json_new_number((double)rec->timestamp));
+    }
+
+    if (rec->details_len > 2) {
+        char* details = malloc(rec->details_len + 1);
+        if (details) {
+            memcpy(details, strings + rec->name_len + rec->user_len, rec->details_len);
+            details[rec->details_len] = '\0';
+            ctz_json_value* changes_obj = ctz_json_parse(details, NULL, 0);
+            if (changes_obj) ctz_json_object_set_value(event_obj, "changes", changes_obj);
+            free(details);
+        }
+    }
+    return event_obj;
+}
+
+// Decodes every intact record of a journal image and pushes it onto array.
+// Returns the number of records decoded.
+static size_t decode_journal(const char* data, size_t len, ctz_json_value* array) {
+    if (len < JOURNAL_MAGIC_LEN || memcmp(data, JOURNAL_MAGIC, JOURNAL_MAGIC_LEN) != 0) return 0;
+
+    size_t count = 0;
+    size_t off = JOURNAL_MAGIC_LEN;
+    while (len - off >= sizeof(JournalFrame)) {
+        JournalFrame frame;
+        memcpy(&frame, data + off, sizeof(frame));
+        const char* payload = data + off + sizeof(frame);
+        size_t remaining = len - off - sizeof(frame);
+
+        if (frame.length < sizeof(JournalRecord) || frame.length > remaining) break;
+        if (journal_crc32(payload, frame.length) != frame.crc32) break;
+
+        JournalRecord rec;
+        memcpy(&rec, payload, sizeof(rec));
+        if ((size_t)rec.name_len + rec.user_len + rec.details_len != frame.length - sizeof(rec)) break;
+
+        ctz_json_value* event_obj = record_to_json(&rec, payload + sizeof(rec));
+        if (event_obj) {
+            ctz_json_array_push_value(array, event_obj);
+            count++;
+        }
+        off += sizeof(frame) + frame.length;
+    }
+    return count;
+}
+
+static ctz_json_value* load_history_array(const char* path) {
+    ctz_json_value* history = ctz_json_load_file(path, NULL, 0);
+    if (!history || ctz_json_get_type(history) != CTZ_JSON_ARRAY) {
+        if (history) ctz_json_free(history);
+        history = ctz_json_new_array();
+    }
+    return history;
+}
+
+static int write_history_tmp(const char* tmp_path, const ctz_json_value* history) {
+    char* json_output = ctz_json_stringify(history, 1); // Pretty print, same as before
+    if (!json_output) return -1;
+    int rc = write_file_synced(tmp_path, json_output, strlen(json_output));
+    free(json_output);
+    return rc;
+}
+
+// Finishes a compaction interrupted between rename steps. Caller holds the
+// compaction lock.
+static int recover_locked(const char* node_path) {
+    char folded_path[PATH_MAX], tmp_path[PATH_MAX], history_path[PATH_MAX];
+    log_file_path(node_path, EXODUS_JOURNAL_FILE ".folded", folded_path, sizeof(folded_path));
+    log_file_path(node_path, EXODUS_HISTORY_FILE ".tmp", tmp_path, sizeof(tmp_path));
+    log_file_path(node_path, EXODUS_HISTORY_FILE, history_path, sizeof(history_path));
+
+    if (access(folded_path, F_OK) == 0) {
+        if (access(tmp_path, F_OK) == 0 && rename(tmp_path, history_path) != 0) return -1;
+        unlink(folded_path);
+    } else {
+        unlink(tmp_path); // Stale output of a compaction that never committed
+    }
+    return 0;
+}
+
+// --- Public API ---
+
+int exodus_journal_append(const char* node_path, const exodus_journal_event_t* ev, size_t* journal_size_out) {
+    if (!node_path || !ev || !ev->name) return -1;
+
+    const char* user = ev->user ? ev->user : "";
+    const char* details = ev->details ? ev->details : "";
+
+    JournalRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.timestamp = ev->timestamp;
+    rec.name_len = (uint16_t)strnlen(ev->name, UINT16_MAX);
+    rec.user_len = (uint16_t)strnlen(user, UINT16_MAX);
+    rec.details_len = (uint32_t)strlen(details);
+    rec.type = (uint8_t)ev->type;
+    rec.flags = ev->time_real ? JOURNAL_FLAG_TIME_REAL : 0;
+
+    size_t payload_len = sizeof(rec) + rec.name_len + rec.user_len + rec.details_len;
+    if (payload_len > JOURNAL_MAX_RECORD) return -1;
+
+    // Checksum the payload pieces as one stream
+    char* payload = malloc(payload_len);
+    if (!payload) return -1;
+    memcpy(payload, &rec, sizeof(rec));
+    memcpy(payload + sizeof(rec), ev->name, rec.name_len);
+    memcpy(payload + sizeof(rec) + rec.name_len, user, rec.user_len);
+    memcpy(payload + sizeof(rec) + rec.name_len + rec.user_len, details, rec.details_len);
+
+    JournalFrame frame = { .length = (uint32_t)payload_len, .crc32 = journal_crc32(payload, payload_len) };
+
+    char journal_path[PATH_MAX];
+    log_file_path(node_path, EXODUS_JOURNAL_FILE, journal_path, sizeof(journal_path));
+    int fd = open_journal_locked(journal_path, O_WRONLY | O_CREAT | O_APPEND);
+    if (fd < 0) {
+        free(payload);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        free(payload);
+        flock(fd, LOCK_UN);
+        close(fd);
+        return -1;
+    }
+    off_t start = st.st_size;
+
+    struct iovec iov[3];
+    int iov_count = 0;
+    size_t total = sizeof(frame) + payload_len;
+    if (start == 0) {
+        iov[iov_count].iov_base = (void*)JOURNAL_MAGIC;
+        iov[iov_count++].iov_len = JOURNAL_MAGIC_LEN;
+        total += JOURNAL_MAGIC_LEN;
+    }
+    iov[iov_count].iov_base = &frame;
+    iov[iov_count++].iov_len = sizeof(frame);
+    iov[iov_count].iov_base = payload;
+    iov[iov_count++].iov_len = payload_len;
+
+    ssize_t w;
+    do {
+        w = writev(fd, iov, iov_count);
+    } while (w < 0 && errno == EINTR);
+
+    int rc = 0;
+    if (w != (ssize_t)total) {
+        // Never leave a torn record behind for the next append to bury
+        if (ftruncate(fd, start) != 0) {
+            perror("[Journal] ftruncate after short write");
+        }
+        rc = -1;
+    } else if (journal_size_out) {
+        *journal_size_out = (size_t)start + total;
+    }
+
+    free(payload);
+    flock(fd, LOCK_UN);
+    close(fd);
+    return rc;
+}
+
+int exodus_journal_materialize(const char* node_path) {
+    if (!node_path) return -1;
+
+    char journal_path[PATH_MAX], folded_path[PATH_MAX], history_path[PATH_MAX], tmp_path[PATH_MAX];
+    log_file_path(node_path, EXODUS_JOURNAL_FILE, journal_path, sizeof(journal_path));
+    log_file_path(node_path, EXODUS_JOURNAL_FILE ".folded", folded_path, sizeof(folded_path));
+    log_file_path(node_path, EXODUS_HISTORY_FILE, history_path, sizeof(history_path));
+    log_file_path(node_path, EXODUS_HISTORY_FILE ".tmp", tmp_path, sizeof(tmp_path));
+
+    struct stat st;
+    if (stat(journal_path, &st) != 0 && access(folded_path, F_OK) != 0) {
+        return 0; // Nothing pending and nothing to recover
+    }
+
+    int lock_fd = lock_compaction(node_path);
+    if (lock_fd < 0) return -1;
+
+    if (recover_locked(node_path) != 0) {
+        unlock_compaction(lock_fd);
+        return -1;
+    }
+
+    int jfd = open_journal_locked(journal_path, O_RDONLY);
+    if (jfd < 0) {
+        unlock_compaction(lock_fd);
+        return (errno == ENOENT) ? 0 : -1;
+    }
+
+    int rc = -1;
+    size_t len = 0;
+    char* data = read_whole_file(journal_path, &len);
+    if (!data) goto out;
+
+    if (len <= JOURNAL_MAGIC_LEN) {
+        // Empty journal, just drop it
+        unlink(journal_path);
+        rc = 0;
+        goto out;
+    }
+
+    ctz_json_value* history = load_history_array(history_path);
+    if (!history) goto out;
+    decode_journal(data, len, history);
+
+    if (write_history_tmp(tmp_path, history) == 0 &&
+        rename(journal_path, folded_path) == 0) {
+        if (rename(tmp_path, history_path) == 0) {
+            unlink(folded_path);
+            rc = 0;
+        } else {
+            // Leave .folded + .tmp in place; recover_locked() finishes the job
+            perror("[Journal] rename history export");
+        }
+    } else {
+        unlink(tmp_path);
+    }
+    ctz_json_free(history);
+
+out:
+    free(data);
+    flock(jfd, LOCK_UN);
+    close(jfd);
+    unlock_compaction(lock_fd);
+    return rc;
+}
+
+ctz_json_value* exodus_journal_load_history(const char* node_path) {
+    char history_path[PATH_MAX];
+    log_file_path(node_path, EXODUS_HISTORY_FILE, history_path, sizeof(history_path));
+
+    if (exodus_journal_materialize(node_path) == 0) {
+        return load_history_array(history_path);
+    }
+
+    // Read-only fallback: build the view in memory without touching .log
+    char journal_path[PATH_MAX], folded_path[PATH_MAX], tmp_path[PATH_MAX];
+    log_file_path(node_path, EXODUS_JOURNAL_FILE, journal_path, sizeof(journal_path));
+    log_file_path(node_path, EXODUS_JOURNAL_FILE ".folded", folded_path, sizeof(folded_path));
+    log_file_path(node_path, EXODUS_HISTORY_FILE ".tmp", tmp_path, sizeof(tmp_path));
+
+    int interrupted = access(folded_path, F_OK) == 0 && access(tmp_path, F_OK) == 0;
+    ctz_json_value* history = load_history_array(interrupted ? tmp_path : history_path);
+    if (!history) return NULL;
+
+    size_t len = 0;
+    char* data = read_whole_file(journal_path, &len);
+    if (data) {
+        decode_journal(data, len, history);
+        free(data);
+    }
+    return history;
+}
+
+static int replace_history(const char* node_path, const ctz_json_value* history_array, int drop_pending) {
+    char journal_path[PATH_MAX], history_path[PATH_MAX], tmp_path[PATH_MAX];
+    log_file_path(node_path, EXODUS_JOURNAL_FILE, journal_path, sizeof(journal_path));
+    log_file_path(node_path, EXODUS_HISTORY_FILE, history_path, sizeof(history_path));
+    log_file_path(node_path, EXODUS_HISTORY_FILE ".tmp", tmp_path, sizeof(tmp_path));
+
+    int lock_fd = lock_compaction(node_path);
+    if (lock_fd < 0) return -1;
+    recover_locked(node_path);
+
+    int rc = -1;
+    int jfd = drop_pending ? open_journal_locked(journal_path, O_RDONLY) : -1;
+    if (write_history_tmp(tmp_path, history_array) == 0) {
+        // Drop pending records first: a crash in between re-shows old events
+        // instead of silently losing the new history.
+        if (jfd >= 0) unlink(journal_path);
+        if (rename(tmp_path, history_path) == 0) {
+            rc = 0;
+        } else {
+            unlink(tmp_path);
+        }
+    }
+
+    if (jfd >= 0) {
+        flock(jfd, LOCK_UN);
+        close(jfd);
+    }
+    unlock_compaction(lock_fd);
+    return rc;
+}
+
+int exodus_journal_reset(const char* node_path) {
+    if (!node_path) return -1;
+    ctz_json_value* empty = ctz_json_new_array();
+    if (!empty) return -1;
+    int rc = replace_history(node_path, empty, 1);
+    ctz_json_free(empty);
+    return rc;
+}
+
+int exodus_journal_replace(const char* node_path, const ctz_json_value* history_array) {
+    if (!node_path || !history_array) return -1;
+    return replace_history(node_path, history_array, 0);
+}
@@ -23,6 +23,8 @@
 
 #include "ctz-json.h"
 #include "exodus-common.h"
+#include "exodus-journal.h"
+#include "exodus-diff.h"
 #include <linux/limits.h>
 
 // --- Struct Definitions (Copied from cloud-daemon) ---
@@ -60,21 +62,6 @@ typedef struct FilterEntry {
     struct FilterEntry* next;
 } FilterEntry;
 
-typedef struct DiffChange {
-    char op; 
-    int line_num;
-    const char* content;
-    struct DiffChange* next;
-    int matched;
-} DiffChange;
-
-typedef struct MovedChange {
-    int from_line;
-    int to_line;
-    const char* content;
-    struct MovedChange* next;
-} MovedChange;
-
 // --- Global Variables ---
 
 static volatile int g_keep_running = 1;
@@ -153,61 +140,6 @@ static void get_username_from_uid(uid_t uid, char* buf, size_t buf_size) {
     }
 }
 
-static int split_lines(char* content_copy, char*** lines_array_out) {
-    if (!content_copy) {
-        *lines_array_out = NULL;
-        return 0;
-    }
-
-    int line_count = 0;
-    // 1. Count the lines
-    for (char* p = content_copy; *p; p++) {
-        if (*p == '\n') {
-            line_count++;
-        }
-    }
-    // Account for the last line if the file doesn't end with \n
-    if (content_copy[0] != '\0' && (line_count == 0 || content_copy[strlen(content_copy) - 1] != '\n')) {
-         line_count++;
-    }
-
-    if (line_count == 0) {
-        *lines_array_out = NULL;
-        return 0;
-    }
-
-    // 2. Allocate the array
-    *lines_array_out = malloc(line_count * sizeof(char*));
-    if (!*lines_array_out) return 0;
-
-    int current_line = 0;
-    char* line_start = content_copy;
-    
-    // Always add the first line
-    (*lines_array_out)[current_line++] = line_start;
-
-    // Iterate and manually split the string
-    for (char* p = content_copy; *p; p++) {
-        if (*p == '\n') {
-            *p = '\0'; // Terminate the current line string
-
-            if (current_line < line_count) {
-                (*lines_array_out)[current_line++] = p + 1;
-            }
-        }
-    }
-    
-    return current_line;
-}
-
-static void free_lcs_matrix(int** matrix, int rows) {
-    if (!matrix) return;
-    for (int i = 0; i < rows; i++) {
-        free(matrix[i]);
-    }
-    free(matrix);
-}
-
 static int check_and_update_debounce(const char* full_path) {
     const int DEBOUNCE_SECONDS = 2;
     time_t now = time(NULL);
@@ -250,13 +182,6 @@ static int check_and_update_debounce(const char* full_path) {
     return should_process;
 }
 
-static void get_real_time_string(char* buf, size_t size) {
-    time_t now = time(NULL);
-    struct tm local_time;
-    localtime_r(&now, &local_time);
-    strftime(buf, size, "%Y-%m-%d %H:%M:%S", &local_time);
-}
-
 static void free_filter_list() {
     FilterEntry* current = g_filter_list_head;
     while (current) {
@@ -373,92 +298,42 @@ void update_file_cache(const char* path, const char* content) {
 }
 
 void add_event_to_history(EventType type, const char* name, const char* user, const char* details_json_obj){
-    
-    // 1. Load the existing history file
-    ctz_json_value* history_array = ctz_json_load_file(g_history_file_path, NULL, 0);
-    if (!history_array || ctz_json_get_type(history_array) != CTZ_JSON_ARRAY) {
-        if (history_array) ctz_json_free(history_array);
-        history_array = ctz_json_new_array();
-    }
+    // Last logged event, to drop duplicates without re-reading the history
+    static char last_name[PATH_MAX] = {0};
+    static EventType last_type = EV_CREATED;
+    static time_t last_time = 0;
 
-    // 2. Create the new JSON object for this event.
-    ctz_json_value* event_obj = ctz_json_new_object();
     const char* type_str = (type == EV_CREATED) ? "Created" : (type == EV_DELETED ? "Deleted" : "Modified");
-    
-    ctz_json_object_set_value(event_obj, "event", ctz_json_new_string(type_str));
-    ctz_json_object_set_value(event_obj, "name", ctz_json_new_string(name));
-    ctz_json_object_set_value(event_obj, "user", ctz_json_new_string(user ? user : "unknown"));
-
-    
-    if (g_time_format == TIME_REAL) {
-        char time_buf[64];
-        get_real_time_string(time_buf, sizeof(time_buf));
-        ctz_json_object_set_value(event_obj, "timestamp", ctz_json_new_string(time_buf));
-    } else {
-        double new_timestamp = (double)time(NULL);
-        ctz_json_object_set_value(event_obj, "timestamp", ctz_json_new_number(new_timestamp));
-    }
-    
+    time_t now = time(NULL);
 
-    if (details_json_obj) {
-        ctz_json_value* changes_obj = ctz_json_parse(details_json_obj, NULL, 0);
-        if (changes_obj) {
-            ctz_json_object_set_value(event_obj, "changes", changes_obj);
-        }
+    // If name and event are the same in the same second, it's a duplicate
+    if (g_time_format == TIME_UNIX && type == last_type && last_time == now && strcmp(last_name, name) == 0) {
+        fprintf(stderr, "[Guardian] Skipping duplicate event (same second): %s %s\n", type_str, name);
+        return;
     }
 
-
-    size_t history_size = ctz_json_get_array_size(history_array);
-    if (history_size > 0) {
-        ctz_json_value* last_event = ctz_json_get_array_element(history_array, history_size - 1);
-        if (last_event && ctz_json_get_type(last_event) == CTZ_JSON_OBJECT) {
-            ctz_json_value* last_name_val = ctz_json_find_object_value(last_event, "name");
-            ctz_json_value* last_event_val = ctz_json_find_object_value(last_event, "event");
-
-            if (last_name_val && last_event_val) {
-                const char* last_name = ctz_json_get_string(last_name_val);
-                const char* last_event_str = ctz_json_get_string(last_event_val);
-                
-                // If name and event are the same, check timestamp to see if it's *too* close
-                if (strcmp(last_name, name) == 0 && strcmp(last_event_str, type_str) == 0) {
-                    double last_time_num = 0;
-                    ctz_json_value* last_time_val = ctz_json_find_object_value(last_event, "timestamp");
-                    if (last_time_val && ctz_json_get_type(last_time_val) == CTZ_JSON_NUMBER) {
-                        last_time_num = ctz_json_get_number(last_time_val);
-                    }
-                    
-                    if (g_time_format == TIME_UNIX) {
-                         // If timestamps are identical (same second), it's a duplicate
-                        if (last_time_num == (double)time(NULL)) {
-                             fprintf(stderr, "[Guardian] Skipping duplicate event (same second): %s %s\n", type_str, name);
-                             ctz_json_free(event_obj);
-                             ctz_json_free(history_array);
-                             return;
-                        }
-                    }
-                    // Cannot easily check for 'Real' time duplicates, so we allow them
-                }
-            }
-        }
+    exodus_journal_event_t journal_event = {
+        .type = (exodus_journal_type)type,
+        .timestamp = (int64_t)now,
+        .time_real = (g_time_format == TIME_REAL),
+        .name = name,
+        .user = user,
+        .details = details_json_obj,
+    };
+    size_t journal_size = 0;
+    if (exodus_journal_append(g_node_path, &journal_event, &journal_size) != 0) {
+        fprintf(stderr, "[Guardian] CRITICAL: Failed to append to journal of %s\n", g_history_file_path);
+        return;
     }
+    fprintf(stderr, "[Guardian] Logged event: %s %s\n", type_str, name);
 
+    strncpy(last_name, name, sizeof(last_name) - 1);
+    last_type = type;
+    last_time = now;
 
-    ctz_json_array_push_value(history_array, event_obj);
-
-    // 5. Stringify and save
-    char* json_output = ctz_json_stringify(history_array, 1); // Pretty print
-    if (json_output) {
-        FILE* f = fopen(g_history_file_path, "w");
-        if (f) {
-            fprintf(f, "%s", json_output);
-            fclose(f);
-            fprintf(stderr, "[Guardian] Logged event: %s %s\n", type_str, name);
-        } else {
-            fprintf(stderr, "[Guardian] CRITICAL: Failed to write to log file %s\n", g_history_file_path);
-        }
-        free(json_output);
+    if (journal_size >= EXODUS_JOURNAL_COMPACT_BYTES) {
+        exodus_journal_materialize(g_node_path);
     }
-    ctz_json_free(history_array);
 }
 
 void handle_file_modification(const char* full_path, const char* user) {
@@ -502,128 +377,36 @@ void handle_file_modification(const char* full_path, const char* user) {
 
     char* old_copy = strdup(old_content);
     char* new_copy = strdup(new_content);
-    
-    char** old_lines = NULL;
-    char** new_lines = NULL;
 
-    int old_count = split_lines(old_copy, &old_lines);
-    int new_count = split_lines(new_copy, &new_lines);
+    exodus_diff_line* old_lines = NULL;
+    exodus_diff_line* new_lines = NULL;
+    int old_count = old_copy ? exodus_diff_split_lines(old_copy, strlen(old_copy), &old_lines) : -1;
+    int new_count = new_copy ? exodus_diff_split_lines(new_copy, strlen(new_copy), &new_lines) : -1;
 
-    // 1. Allocate and fill the LCS dynamic programming matrix
-    int** lcs_matrix = malloc((old_count + 1) * sizeof(int*));
-    if (!lcs_matrix) { /* handle malloc failure */ }
-    
-    for (int i = 0; i <= old_count; i++) {
-        lcs_matrix[i] = calloc((new_count + 1), sizeof(int));
-        if (!lcs_matrix[i]) { /* handle malloc failure */ }
-    }
-
-    for (int i = 1; i <= old_count; i++) {
-        for (int j = 1; j <= new_count; j++) {
-            if (strcmp(old_lines[i - 1], new_lines[j - 1]) == 0) {
-                lcs_matrix[i][j] = lcs_matrix[i - 1][j - 1] + 1;
-            } else {
-                int above = lcs_matrix[i - 1][j];
-                int left = lcs_matrix[i][j - 1];
-                lcs_matrix[i][j] = (above > left) ? above : left;
-            }
-        }
-    }
-
-    // 2. Backtrack through the matrix to build the diff lists
-    DiffChange* added_list_head = NULL;
-    DiffChange* removed_list_head = NULL;
-    int i = old_count;
-    int j = new_count;
-    while (i > 0 || j > 0) {
-        if (i > 0 && j > 0 && strcmp(old_lines[i - 1], new_lines[j - 1]) == 0) {
-            i--;
-            j--;
-        } else if (j > 0 && (i == 0 || lcs_matrix[i][j - 1] >= lcs_matrix[i - 1][j])) {
-            // Added line (from new)
-            DiffChange* change = malloc(sizeof(DiffChange));
-            change->op = 'a';
-            change->line_num = j;
-            change->content = new_lines[j - 1];
-            change->matched = 0;
-            change->next = added_list_head;
-            added_list_head = change;
-            j--;
-        } else if (i > 0 && (j == 0 || lcs_matrix[i][j - 1] < lcs_matrix[i - 1][j])) {
-            // Removed line (from old)
-            DiffChange* change = malloc(sizeof(DiffChange));
-            change->op = 'd';
-            change->line_num = i;
-            change->content = old_lines[i - 1];
-            change->matched = 0;
-            change->next = removed_list_head;
-            removed_list_head = change;
-            i--;
-        }
-    }
-
-    // 2.5. Detect Moved Lines (Post-processing)
-    MovedChange* moved_list_head = NULL;
-    for (DiffChange* r_node = removed_list_head; r_node; r_node = r_node->next) {
-        if (r_node->matched) continue;
-        for (DiffChange* a_node = added_list_head; a_node; a_node = a_node->next) {
-            if (a_node->matched) continue;
-            if (strcmp(r_node->content, a_node->content) == 0) {
-                // We found a move!
-                MovedChange* move = malloc(sizeof(MovedChange));
-                move->from_line = r_node->line_num;
-                move->to_line = a_node->line_num;
-                move->content = r_node->content;
-                move->next = moved_list_head;
-                moved_list_head = move;
-                r_node->matched = 1;
-                a_node->matched = 1;
-                break;
-            }
-        }
-    }
-
-    // 3. Convert the diff linked lists into the final JSON arrays
-    MovedChange* current_move = moved_list_head;
-    while (current_move) {
-        ctz_json_value* change_obj = ctz_json_new_object();
-        ctz_json_object_set_value(change_obj, "from", ctz_json_new_number(current_move->from_line));
-        ctz_json_object_set_value(change_obj, "to", ctz_json_new_number(current_move->to_line));
-        ctz_json_object_set_value(change_obj, "content", ctz_json_new_string(current_move->content));
-        ctz_json_array_push_value(moved_array, change_obj);
-        MovedChange* next = current_move->next;
-        free(current_move);
-        current_move = next;
-    }
-
-    DiffChange* current_change = added_list_head;
-    while (current_change) {
-        if (!current_change->matched) {
+    exodus_diff_result diff;
+    if (old_count >= 0 && new_count >= 0 &&
+        exodus_diff_compute(old_lines, old_count, new_lines, new_count, EXODUS_DIFF_DETECT_MOVES, &diff) == 0) {
+        // Split lines are NUL-terminated in place, so .data can go straight into JSON
+        for (size_t k = 0; k < diff.move_count; k++) {
             ctz_json_value* change_obj = ctz_json_new_object();
-            ctz_json_object_set_value(change_obj, "line", ctz_json_new_number(current_change->line_num));
-            ctz_json_object_set_value(change_obj, "content", ctz_json_new_string(current_change->content));
-            ctz_json_array_push_value(added_array, change_obj);
+            ctz_json_object_set_value(change_obj, "from", ctz_json_new_number(diff.moves[k].old_index + 1));
+            ctz_json_object_set_value(change_obj, "to", ctz_json_new_number(diff.moves[k].new_index + 1));
+            ctz_json_object_set_value(change_obj, "content", ctz_json_new_string(old_lines[diff.moves[k].old_index].data));
+            ctz_json_array_push_value(moved_array, change_obj);
         }
-        DiffChange* next = current_change->next;
-        free(current_change);
-        current_change = next;
-    }
-
-    current_change = removed_list_head;
-    while (current_change) {
-        if (!current_change->matched) {
+        for (size_t k = 0; k < diff.op_count; k++) {
+            const exodus_diff_op* op = &diff.ops[k];
+            if (op->type == EXODUS_DIFF_SAME || op->moved) continue;
+            int added = (op->type == EXODUS_DIFF_ADD);
+            int line = added ? op->new_index : op->old_index;
             ctz_json_value* change_obj = ctz_json_new_object();
-            ctz_json_object_set_value(change_obj, "line", ctz_json_new_number(current_change->line_num));
-            ctz_json_object_set_value(change_obj, "content", ctz_json_new_string(current_change->content));
-            ctz_json_array_push_value(removed_array, change_obj);
+            ctz_json_object_set_value(change_obj, "line", ctz_json_new_number(line + 1));
+            ctz_json_object_set_value(change_obj, "content", ctz_json_new_string(added ? new_lines[line].data : old_lines[line].data));
+            ctz_json_array_push_value(added ? added_array : removed_array, change_obj);
         }
-        DiffChange* next = current_change->next;
-        free(current_change);
-        current_change = next;
+        exodus_diff_result_free(&diff);
     }
 
-    // 4. Clean up all allocations
-    free_lcs_matrix(lcs_matrix, old_count + 1);
     free(old_lines);
     free(new_lines);
     free(old_copy);
@@ -887,7 +670,8 @@ int main() {
     fprintf(stderr, "[Guardian] Logging to: %s\n", g_history_file_path);
 
     load_guardian_config();
-    
+    exodus_journal_materialize(g_node_path);
+
 
     g_inotify_fd = inotify_init1(IN_NONBLOCK);
     if (g_inotify_fd == -1) {
@@ -912,6 +696,7 @@ int main() {
     fprintf(stderr, "[Guardian] Shutting down watcher thread...\n");
     pthread_join(watcher_thread, NULL);
     close(g_inotify_fd);
+    exodus_journal_materialize(g_node_path);
 
     fprintf(stderr, "[Guardian] Cleaning up resources...\n");
     free_file_cache();
@@ -17,6 +17,7 @@
 #include <libgen.h>     
 #include <ctype.h>
 #include "ctz-json.h" 
+#include "exodus-journal.h"
 
 #ifndef PATH_MAX
 #define PATH_MAX 4096
@@ -505,11 +506,7 @@ FileStatusNode* find_or_create_status(FileStatusNode** head, const char* path) {
 void load_node_status(const char* node_path) {
     free_status_map(); // Clear previous status
     
-    char history_path[PATH_MAX];
-    snprintf(history_path, sizeof(history_path), "%s/.log/history.json", node_path);
-
-    char error_buf[256];
-    ctz_json_value* root = ctz_json_load_file(history_path, error_buf, sizeof(error_buf));
+    ctz_json_value* root = exodus_journal_load_history(node_path);
     if (!root || ctz_json_get_type(root) != CTZ_JSON_ARRAY) {
         if (root) ctz_json_free(root);
         return; // No history or corrupt, just return
@@ -23,6 +23,7 @@
 #include "ctz-json.h"
 #include "cortez_ipc.h"
 #include "ctz-set.h"
+#include "exodus-journal.h"
 #include <libgen.h>
 
 
@@ -446,7 +447,7 @@ static void InvSubBytes(uint8_t (*state)[4]) {
 }
 
 static void write_to_handle(cortez_write_handle_t* h, const void* data, size_t size) {
-    size_t part1_size;
+    size_t part1_size = 0;
     char* part1 = cortez_write_handle_get_part1(h, &part1_size);
     
     if (size <= part1_size) {
@@ -922,6 +923,31 @@ pid_t find_query_daemon_pid() {
     return query_pid;
 }
 
+// Prints one MSG_LOOKUP_RESPONSE page; returns how many results it held.
+static uint32_t print_lookup_page(const lookup_resp_t* resp, const char* item_name) {
+    const char* current = resp->data;
+    for (uint32_t i = 0; i < resp->item_count; i++) {
+        const char* node_name = current;
+        const char* item_path = node_name + strlen(node_name) + 1;
+        printf("'%s' Found in Node '%s' | Path: %s\n", item_name, node_name, item_path);
+        current = item_path + strlen(item_path) + 1;
+    }
+    return resp->item_count;
+}
+
+static int send_lookup_request(cortez_mesh_t* mesh, pid_t target_pid, const char* item_name, uint8_t mode, uint32_t offset) {
+    cortez_write_handle_t* h = cortez_mesh_begin_send_zc(mesh, target_pid, sizeof(lookup_req_t));
+    if (!h) return -1;
+    lookup_req_t req;
+    memset(&req, 0, sizeof(req));
+    strncpy(req.item_name, item_name, MAX_PATH_LEN - 1);
+    req.mode = mode;
+    req.offset = offset;
+    write_to_handle(h, &req, sizeof(req));
+    cortez_mesh_commit_send_zc(h, MSG_LOOKUP_ITEM);
+    return 0;
+}
+
 static int get_node_conf_path(const char* node_name, const char* node_path, char* conf_path_buffer, size_t buffer_size) {
     if (snprintf(conf_path_buffer, buffer_size, "%s/.log/%s.conf", node_path, node_name) >= (int)buffer_size) {
         fprintf(stderr, "Error: Config path is too long.\n");
@@ -1147,7 +1173,7 @@ static void run_node_man(int argc, char* argv[]) {
                 sent_ok = 1;
                 break;
             }
-            usleep(200000); // 0.2s sleep for send buffer contention
+            usleep(200000); // 0.2s sleep while the inbox is full or not yet visible
         }
 
         // 3. Wait for response
@@ -1360,18 +1386,12 @@ static void run_clean_history(int argc, char* argv[]) {
         return; // Error message already printed by the function
     }
 
-    char history_path[PATH_MAX];
-    snprintf(history_path, sizeof(history_path), "%s/.log/history.json", node_path);
-
-    // Open in "w" mode to truncate the file to zero bytes
-    FILE* f = fopen(history_path, "w");
-    if (!f) {
-        perror("Error: Could not open history.json to clear it");
-        fprintf(stderr, "Path: %s\n", history_path);
+    // Drops the pending journal and empties history.json
+    if (exodus_journal_reset(node_path) != 0) {
+        perror("Error: Could not clear history.json");
+        fprintf(stderr, "Path: %s/.log/history.json\n", node_path);
         return;
     }
-    
-    fclose(f);
 
     printf("Successfully cleared uncommitted history for node '%s'.\n", node_name);
 }
@@ -1384,6 +1404,7 @@ static void run_node_conf(int argc, char* argv[]) {
         fprintf(stderr, "  -h <1>                      (With --auto) Use headless (systemd) mode instead of XDG (desktop).\n");
         fprintf(stderr, "  --time <Unix|Real>          Set event timestamp format (Unix timestamp or Realtime string).\n");
         fprintf(stderr, "  --filter [.ext1 .ext2 ...]  Set file extensions to auto-delete (guardian only).\n");
+        fprintf(stderr, "  --coalesce <ms>             Merge file events within this window before logging (default 500).\n");
         return;
     }
 
@@ -1402,6 +1423,7 @@ static void run_node_conf(int argc, char* argv[]) {
     char conf_auto[16] = "auto=0";
     char conf_time[32] = "time=Unix";
     char conf_filter[PATH_MAX] = "filter=";
+    char conf_coalesce[32] = ""; // Only written once set
 
     // 1. Read existing config file to load current values
     FILE* f = fopen(conf_path, "r");
@@ -1415,6 +1437,8 @@ static void run_node_conf(int argc, char* argv[]) {
                 strncpy(conf_time, line, sizeof(conf_time) - 1);
             } else if (strncmp(line, "filter=", 7) == 0) {
                 strncpy(conf_filter, line, sizeof(conf_filter) - 1);
+            } else if (strncmp(line, "coalesce=", 9) == 0) {
+                strncpy(conf_coalesce, line, sizeof(conf_coalesce) - 1);
             }
         }
         fclose(f);
@@ -1462,6 +1486,20 @@ static void run_node_conf(int argc, char* argv[]) {
             } else {
                  fprintf(stderr, "Error: --time requires an argument.\n"); i++;
             }
+        } else if (strcmp(argv[i], "--coalesce") == 0) {
+            if (i + 1 < argc) {
+                char* end = NULL;
+                long ms = strtol(argv[i+1], &end, 10);
+                if (end != argv[i+1] && *end == '\0' && ms >= 0 && ms <= 60000) {
+                    snprintf(conf_coalesce, sizeof(conf_coalesce), "coalesce=%ld", ms);
+                    printf("Setting coalesce=%ld\n", ms);
+                } else {
+                    fprintf(stderr, "Error: --coalesce value must be 0-60000 milliseconds.\n");
+                }
+                i += 2;
+            } else {
+                 fprintf(stderr, "Error: --coalesce requires an argument.\n"); i++;
+            }
         } else if (strcmp(argv[i], "--filter") == 0) {
             if (i + 1 < argc) {
                 snprintf(conf_filter, sizeof(conf_filter), "filter="); // Reset filter list
@@ -1499,6 +1537,7 @@ static void run_node_conf(int argc, char* argv[]) {
     fprintf(f, "%s\n", conf_auto);
     fprintf(f, "%s\n", conf_time);
     fprintf(f, "%s\n", conf_filter);
+    if (conf_coalesce[0]) fprintf(f, "%s\n", conf_coalesce);
     fclose(f);
 
     printf("Node '%s' config updated at '%s'.\n", node_name, conf_path);
@@ -2346,13 +2385,10 @@ static void run_sync_node(cortez_mesh_t* mesh, pid_t target_pid,
         return;
     }
     
-    // 2. Read local history.json
-    char local_history_path[PATH_MAX];
-    snprintf(local_history_path, sizeof(local_history_path), "%s/.log/history.json", local_node_path);
-    char error_buf[256];
-    ctz_json_value* history_json = ctz_json_load_file(local_history_path, error_buf, sizeof(error_buf));
+    // 2. Read local history (history.json + pending journal)
+    ctz_json_value* history_json = exodus_journal_load_history(local_node_path);
     if (!history_json) {
-        exodus_error("Could not read local history file: %s (%s)", local_history_path, error_buf);
+        exodus_error("Could not read local history of node at %s", local_node_path);
         history_json = ctz_json_new_array(); // Send empty history
     }
 
@@ -2967,6 +3003,8 @@ static void print_detailed_usage(void) {
     fprintf(stderr, "  %-12s View History of a node(what changed in a node e.g: Modified, Created, Moved or Deleted)\n", "history");
     fprintf(stderr, "  %-12s Show the commit history for the active subsection\n", "log");
     fprintf(stderr, "  %-12s Clear the uncommitted change history for a node\n", "clean");
+    fprintf(stderr, "  %-12s Pack a node's snapshot objects into a single indexed packfile\n", "repack");
+    fprintf(stderr, "  %-12s Delete snapshot objects no subsection can reach (--dry-run to report only)\n", "gc");
     fprintf(stderr, "\n");
 
     fprintf(stderr, "Subsection (Branch) Management\n");
@@ -2995,7 +3033,7 @@ static void print_detailed_usage(void) {
     fprintf(stderr, "  %-12s Set metadata (author, tag, desc) for a node\n", "attr-node");
     fprintf(stderr, "  %-12s View metadata for a node\n", "info-node");
     fprintf(stderr, "  %-12s Find nodes by author or tag\n", "search-attr");
-    fprintf(stderr, "  %-12s Find a file/folder, or pin it with 'look <file> --pin <name>'\n", "look");
+    fprintf(stderr, "  %-12s Find a file/folder (--prefix, --glob), or pin it with 'look <file> --pin <name>'\n", "look");
     fprintf(stderr, "  %-12s Remove a pinned shortcut\n", "unpin");
     fprintf(stderr, "\n");
     
@@ -3441,10 +3479,10 @@ int main(int argc, char* argv[]) {
         }
 
         // 3. Check for uncommitted changes
-        char history_path[PATH_MAX];
-        snprintf(history_path, sizeof(history_path), "%s/.log/history.json", node_path);
-        struct stat st_hist = {0};
-        if (stat(history_path, &st_hist) == 0 && st_hist.st_size > 5) {
+        ctz_json_value* pending = exodus_journal_load_history(node_path);
+        size_t pending_count = pending ? ctz_json_get_array_size(pending) : 0;
+        if (pending) ctz_json_free(pending);
+        if (pending_count > 0) {
             fprintf(stderr, "Error: Cannot switch subsection with uncommitted changes.\n");
             fprintf(stderr, "Please run 'exodus commit' or 'exodus node-status' to review changes.\n");
             return 1;
@@ -3569,6 +3607,50 @@ int main(int argc, char* argv[]) {
         if (result != 0) {
              fprintf(stderr, "Failed to start log process.\n");
         }
+    } else if (strcmp(argv[1], "repack") == 0) {
+        if (argc != 3) {
+            fprintf(stderr, "Usage: exodus repack <node_name>\n");
+            return 1;
+        }
+        char node_path[PATH_MAX];
+        if (find_node_path_in_config(argv[2], node_path, sizeof(node_path)) != 0) return 1;
+
+        char subsection_name[MAX_NODE_NAME_LEN];
+        get_current_subsection(node_path, subsection_name, sizeof(subsection_name));
+        printf("Repacking snapshot objects of node '%s'...\n", argv[2]);
+
+        int result = cortez_ipc_send("./exodus_snapshot",
+                                     CORTEZ_TYPE_STRING, "repack",
+                                     CORTEZ_TYPE_STRING, argv[2],
+                                     CORTEZ_TYPE_STRING, node_path,
+                                     CORTEZ_TYPE_STRING, subsection_name,
+                                     0);
+        if (result != 0) {
+            fprintf(stderr, "Failed to start repack process. Is 'exodus_snapshot' in the same directory?\n");
+        }
+    } else if (strcmp(argv[1], "gc") == 0) {
+        int dry_run = argc == 4 && strcmp(argv[3], "--dry-run") == 0;
+        if (argc != 3 && !dry_run) {
+            fprintf(stderr, "Usage: exodus gc <node_name> [--dry-run]\n");
+            return 1;
+        }
+        char node_path[PATH_MAX];
+        if (find_node_path_in_config(argv[2], node_path, sizeof(node_path)) != 0) return 1;
+
+        char subsection_name[MAX_NODE_NAME_LEN];
+        get_current_subsection(node_path, subsection_name, sizeof(subsection_name));
+        printf("%s unreachable snapshot objects of node '%s'...\n", dry_run ? "Counting" : "Removing", argv[2]);
+
+        int result = cortez_ipc_send("./exodus_snapshot",
+                                     CORTEZ_TYPE_STRING, "gc",
+                                     CORTEZ_TYPE_STRING, argv[2],
+                                     CORTEZ_TYPE_STRING, node_path,
+                                     CORTEZ_TYPE_STRING, subsection_name,
+                                     CORTEZ_TYPE_STRING, dry_run ? "--dry-run" : "--prune",
+                                     0);
+        if (result != 0) {
+            fprintf(stderr, "Failed to start gc process. Is 'exodus_snapshot' in the same directory?\n");
+        }
     } else if (strcmp(argv[1], "commit") == 0) {
     if (argc != 4) {
         fprintf(stderr, "Usage: exodus commit <node_name> <version_tag>\n");
@@ -3726,6 +3808,8 @@ int main(int argc, char* argv[]) {
             title = "Persistent Commit History (Versions)";
 
         } else if (argc == 3) {
+            // Fold pending journal records so the file below is current
+            exodus_journal_materialize(node_path);
             snprintf(data_path, sizeof(data_path), "%s/.log/history.json", node_path);
             title = "Recent Activity (Uncommitted Changes)";
         } else {
@@ -3836,25 +3920,7 @@ int main(int argc, char* argv[]) {
         if (find_node_path_in_config(argv[2], node_path, sizeof(node_path)) != 0) {
             return 1;
         }
-        char history_path[PATH_MAX];
-        snprintf(history_path, sizeof(history_path), "%s/.log/history.json", node_path);
-        FILE* f = fopen(history_path, "r");
-        if (!f) {
-            fprintf(stderr, "Error: Could not open history file at %s.\n", history_path);
-            return 1;
-        }
-        
-        fseek(f, 0, SEEK_END);
-        long length = ftell(f);
-        fseek(f, 0, SEEK_SET);
-        char* buffer = malloc(length + 1);
-        if (!buffer) { fclose(f); return 1; }
-        fread(buffer, 1, length, f);
-        buffer[length] = '\0';
-        fclose(f);
-        char error_buf[256];
-        ctz_json_value* root = ctz_json_parse(buffer, error_buf, sizeof(error_buf));
-        free(buffer);
+        ctz_json_value* root = exodus_journal_load_history(node_path);
         if (!root || ctz_json_get_type(root) != CTZ_JSON_ARRAY) {
             fprintf(stderr, "Node is clean or history.json is corrupt.\n");
             if (root) ctz_json_free(root);
@@ -4006,9 +4072,26 @@ int main(int argc, char* argv[]) {
         ctz_json_free(root);
     } else if (strcmp(argv[1], "look") == 0) {
         if (argc < 3) {
-            fprintf(stderr, "Usage: exodus look <file/folder> [--pin <pin_name>]\n");
+            fprintf(stderr, "Usage: exodus look <file/folder|pattern> [--prefix | --glob] [--pin <pin_name>]\n");
             return 1;
         }
+        const char* pin_name = NULL;
+        // Wildcards in the name mean a glob unless told otherwise
+        uint8_t mode = strpbrk(argv[2], "*?[") ? LOOKUP_GLOB : LOOKUP_EXACT;
+        for (int a = 3; a < argc; a++) {
+            if (strcmp(argv[a], "--pin") == 0 && a + 1 < argc) {
+                pin_name = argv[++a];
+            } else if (strcmp(argv[a], "--prefix") == 0) {
+                mode = LOOKUP_PREFIX;
+            } else if (strcmp(argv[a], "--glob") == 0) {
+                mode = LOOKUP_GLOB;
+            } else if (strcmp(argv[a], "--exact") == 0) {
+                mode = LOOKUP_EXACT;
+            } else {
+                fprintf(stderr, "Unknown option for look: %s\n", argv[a]);
+                return 1;
+            }
+        }
         cortez_mesh_t* mesh = cortez_mesh_init("exodus_client", NULL);
         if (!mesh) {
             fprintf(stderr, "Could not connect to exodus mesh. Are daemons running?\n");
@@ -4023,28 +4106,19 @@ int main(int argc, char* argv[]) {
         }
         int sent_ok = 0;
         for (int i = 0; i < 5; i++) {
-            cortez_write_handle_t* h = NULL;
-            if (argc == 5 && strcmp(argv[3], "--pin") == 0) {
+            if (pin_name) {
                 uint32_t payload_size = sizeof(pin_req_t);
-                h = cortez_mesh_begin_send_zc(mesh, target_pid, payload_size);
+                cortez_write_handle_t* h = cortez_mesh_begin_send_zc(mesh, target_pid, payload_size);
                 if(h) {
                     size_t part1_size;
                     pin_req_t* req = cortez_write_handle_get_part1(h, &part1_size);
                     strncpy(req->item_name, argv[2], MAX_PATH_LEN - 1);
-                    strncpy(req->pin_name, argv[4], MAX_NODE_NAME_LEN - 1);
+                    strncpy(req->pin_name, pin_name, MAX_NODE_NAME_LEN - 1);
                     cortez_mesh_commit_send_zc(h, MSG_PIN_ITEM);
                     sent_ok = 1;
                 }
-            } else { // Handle simple look
-                uint32_t payload_size = sizeof(lookup_req_t);
-                h = cortez_mesh_begin_send_zc(mesh, target_pid, payload_size);
-                if(h) {
-                    size_t part1_size;
-                    lookup_req_t* req = cortez_write_handle_get_part1(h, &part1_size);
-                    strncpy(req->item_name, argv[2], MAX_PATH_LEN - 1);
-                    cortez_mesh_commit_send_zc(h, MSG_LOOKUP_ITEM);
-                    sent_ok = 1;
-                }
+            } else if (send_lookup_request(mesh, target_pid, argv[2], mode, 0) == 0) { // Handle simple look
+                sent_ok = 1;
             }
             if (sent_ok) break;
             if (i < 4) {
@@ -4054,26 +4128,44 @@ int main(int argc, char* argv[]) {
         }
         if (sent_ok) {
             printf("Waiting for response...\n");
-            cortez_msg_t* msg = cortez_mesh_read(mesh, 10000);
-            if(msg) {
+            uint32_t shown = 0;
+            int first_page = 1;
+            for (;;) {
+                cortez_msg_t* msg = cortez_mesh_read(mesh, 10000);
+                if (!msg) {
+                    printf("No response from daemon (timeout).\n");
+                    break;
+                }
+                int next_page = 0;
+                uint32_t next_offset = 0;
                 if(cortez_msg_type(msg) == MSG_OPERATION_ACK) {
                     const ack_t* ack = cortez_msg_payload(msg);
                     printf("Result: %s (%s)\n", ack->success ? "Success" : "Failure", ack->details);
-                } else if (cortez_msg_type(msg) == MSG_LOOKUP_RESPONSE) {
-                    const list_resp_t* resp = cortez_msg_payload(msg);
-                    printf("--- Lookup Results ---\n");
-                    const char* current = resp->data;
-                    for (int i = 0; i < resp->item_count; i++) {
-                        printf("%s", current);
-                        current += strlen(current) + 1;
-                    }
-                    if (resp->item_count == 0 && strlen(resp->data) > 0) {
-                        printf("%s", resp->data);
+                } else if (cortez_msg_type(msg) == MSG_LOOKUP_RESPONSE &&
+                           cortez_msg_payload_size(msg) >= sizeof(lookup_resp_t)) {
+                    const lookup_resp_t* resp = cortez_msg_payload(msg);
+                    if (first_page) printf("--- Lookup Results (%u) ---\n", resp->total);
+                    first_page = 0;
+                    shown += print_lookup_page(resp, argv[2]);
+                    if (resp->total == 0) {
+                        printf("'%s' not found in any active node.\n", argv[2]);
                     }
+                    // Stop if a page came back empty so a shrinking index can't loop us
+                    next_page = resp->more && resp->item_count > 0;
+                    next_offset = resp->next_offset;
                 }
                 cortez_mesh_msg_release(mesh, msg);
-            } else {
-                printf("No response from daemon (timeout).\n");
+                if (!next_page) break;
+
+                int page_sent = 0;
+                for (int i = 0; i < 5 && !page_sent; i++) {
+                    if (send_lookup_request(mesh, target_pid, argv[2], mode, next_offset) == 0) page_sent = 1;
+                    else usleep(100000);
+                }
+                if (!page_sent) {
+                    fprintf(stderr, "Failed to request the next page after %u results.\n", shown);
+                    break;
+                }
             }
         } else {
              fprintf(stderr, "Failed to send message to query daemon after 5 attempts.\n");
@@ -4415,16 +4507,9 @@ int main(int argc, char* argv[]) {
                     current += strlen(current) + 1;
                 }
             }else if (cortez_msg_type(msg) == MSG_LOOKUP_RESPONSE) {
-                const list_resp_t* resp = cortez_msg_payload(msg);
-                printf("--- Lookup Results ---\n");
-                const char* current = resp->data;
-                for (int i = 0; i < resp->item_count; i++) {
-                    printf("%s", current);
-                    current += strlen(current) + 1;
-                }
-                if (resp->item_count == 0 && strlen(resp->data) > 0) {
-                    printf("%s", resp->data);
-                }
+                const lookup_resp_t* resp = cortez_msg_payload(msg);
+                printf("--- Lookup Results (%u) ---\n", resp->total);
+                print_lookup_page(resp, "item");
             }else if (cortez_msg_type(msg) == MSG_INFO_NODE_RESPONSE) {
                 const info_node_resp_t* resp = cortez_msg_payload(msg);
                 if (resp->success) {